@@ -126,6 +126,34 @@ ACSVM_CodeList(InvU,         0)
 ACSVM_CodeList(NegI,         0)
 ACSVM_CodeList(NotU,         0)
 
+// Superinstruction codes. These are written over sequences of other codes by
+// Module::fuseCode, and skip the rest of the words of the codes they replace.
+#define ACSVM_CodeList_LitOpSet(name) \
+   ACSVM_CodeList(name##_Lit,     2)
+ACSVM_CodeList_LitOpSet(AddU)
+ACSVM_CodeList_LitOpSet(AndU)
+ACSVM_CodeList_LitOpSet(CmpI_GE)
+ACSVM_CodeList_LitOpSet(CmpI_GT)
+ACSVM_CodeList_LitOpSet(CmpI_LE)
+ACSVM_CodeList_LitOpSet(CmpI_LT)
+ACSVM_CodeList_LitOpSet(CmpU_EQ)
+ACSVM_CodeList_LitOpSet(CmpU_NE)
+ACSVM_CodeList_LitOpSet(DivI)
+ACSVM_CodeList_LitOpSet(ModI)
+ACSVM_CodeList_LitOpSet(MulU)
+ACSVM_CodeList_LitOpSet(OrIU)
+ACSVM_CodeList_LitOpSet(ShLU)
+ACSVM_CodeList_LitOpSet(ShRI)
+ACSVM_CodeList_LitOpSet(SubU)
+#undef ACSVM_CodeList_LitOpSet
+ACSVM_CodeList(Jcnd_LocLit_EQ, 6)
+ACSVM_CodeList(Jcnd_LocLit_GE, 6)
+ACSVM_CodeList(Jcnd_LocLit_GT, 6)
+ACSVM_CodeList(Jcnd_LocLit_LE, 6)
+ACSVM_CodeList(Jcnd_LocLit_LT, 6)
+ACSVM_CodeList(Jcnd_LocLit_NE, 6)
+ACSVM_CodeList(CallSpec_LitPad, 0)
+
 #undef ACSVM_CodeList
 #endif
 
@@ -112,6 +112,7 @@ namespace ACSVM
    Environment::Environment() :
       branchLimit  {0},
       scriptLocRegC{ScriptLocRegCDefault},
+      profile      {false},
 
       funcV{nullptr},
       funcC{0},
@@ -311,6 +312,18 @@ namespace ACSVM
       return pd->modules.find(name);
    }
 
+   //
+   // Environment::forEachScript
+   //
+   void Environment::forEachScript(std::function<void(Script &)> const &fn)
+   {
+      for(auto &module : pd->modules)
+      {
+         for(auto &script : module.scriptV)
+            fn(script);
+      }
+   }
+
    //
    // Environment::freeFunction
    //
@@ -355,6 +368,8 @@ namespace ACSVM
    void Environment::freeThread(Thread *thread)
    {
       thread->link.relink(&threadFree);
+      thread->execLink.unlink();
+      thread->execWake = 0;
    }
 
    //
@@ -687,6 +702,19 @@ namespace ACSVM
          scope.refStrings();
    }
 
+   //
+   // Environment::resetProfile
+   //
+   void Environment::resetProfile()
+   {
+      forEachScript([](Script &script)
+      {
+         script.profExecC = 0;
+         script.profCodeC = 0;
+         script.profTime  = 0;
+      });
+   }
+
    //
    // Environment::resetStrings
    //
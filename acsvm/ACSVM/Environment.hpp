@@ -16,6 +16,8 @@
 #include "List.hpp"
 #include "String.hpp"
 
+#include <functional>
+
 
 //----------------------------------------------------------------------------|
 // Types                                                                      |
@@ -63,6 +65,9 @@ namespace ACSVM
 
       Module *findModule(ModuleName const &name) const;
 
+      // Calls fn for every Script of every loaded Module.
+      void forEachScript(std::function<void(Script &)> const &fn);
+
       // Used by Module when unloading.
       void freeFunction(Function *func);
 
@@ -134,6 +139,9 @@ namespace ACSVM
 
       virtual void refStrings();
 
+      // Clears the profiling counters of every Script.
+      void resetProfile();
+
       virtual void resetStrings();
 
       virtual void saveState(Serial &out) const;
@@ -156,6 +164,10 @@ namespace ACSVM
       // Default number of script variables. Default is 20.
       Word scriptLocRegC;
 
+      // If true, Thread::exec keeps count of the codes executed and the time
+      // spent by each Script. Default is false.
+      bool profile;
+
 
       // Prints an array to a print buffer, truncating elements of the array to
       // fit char.
@@ -13,12 +13,73 @@
 #include "Module.hpp"
 
 #include "Array.hpp"
+#include "Code.hpp"
+#include "CodeData.hpp"
 #include "Environment.hpp"
 #include "Function.hpp"
 #include "Init.hpp"
 #include "Jump.hpp"
 #include "Script.hpp"
 
+#include <memory>
+
+
+//----------------------------------------------------------------------------|
+// Static Functions                                                           |
+//
+
+namespace ACSVM
+{
+   //
+   // FuseLitOp
+   //
+   // Returns the superinstruction for a binary operator with a literal right
+   // operand, or None if there is none.
+   //
+   static Code FuseLitOp(Word code)
+   {
+      switch(static_cast<Code>(code))
+      {
+      case Code::AddU:    return Code::AddU_Lit;
+      case Code::AndU:    return Code::AndU_Lit;
+      case Code::CmpI_GE: return Code::CmpI_GE_Lit;
+      case Code::CmpI_GT: return Code::CmpI_GT_Lit;
+      case Code::CmpI_LE: return Code::CmpI_LE_Lit;
+      case Code::CmpI_LT: return Code::CmpI_LT_Lit;
+      case Code::CmpU_EQ: return Code::CmpU_EQ_Lit;
+      case Code::CmpU_NE: return Code::CmpU_NE_Lit;
+      case Code::DivI:    return Code::DivI_Lit;
+      case Code::ModI:    return Code::ModI_Lit;
+      case Code::MulU:    return Code::MulU_Lit;
+      case Code::OrIU:    return Code::OrIU_Lit;
+      case Code::ShLU:    return Code::ShLU_Lit;
+      case Code::ShRI:    return Code::ShRI_Lit;
+      case Code::SubU:    return Code::SubU_Lit;
+      default:            return Code::None;
+      }
+   }
+
+   //
+   // FuseJcnd
+   //
+   // Returns the superinstruction for a comparison whose result is branched
+   // on, or None if there is none. Jcnd_Nil branches on the opposite result.
+   //
+   static Code FuseJcnd(Word cmp, bool onTrue)
+   {
+      switch(static_cast<Code>(cmp))
+      {
+      case Code::CmpI_GE: return onTrue ? Code::Jcnd_LocLit_GE : Code::Jcnd_LocLit_LT;
+      case Code::CmpI_GT: return onTrue ? Code::Jcnd_LocLit_GT : Code::Jcnd_LocLit_LE;
+      case Code::CmpI_LE: return onTrue ? Code::Jcnd_LocLit_LE : Code::Jcnd_LocLit_GT;
+      case Code::CmpI_LT: return onTrue ? Code::Jcnd_LocLit_LT : Code::Jcnd_LocLit_GE;
+      case Code::CmpU_EQ: return onTrue ? Code::Jcnd_LocLit_EQ : Code::Jcnd_LocLit_NE;
+      case Code::CmpU_NE: return onTrue ? Code::Jcnd_LocLit_NE : Code::Jcnd_LocLit_EQ;
+      default:            return Code::None;
+      }
+   }
+}
+
 
 //----------------------------------------------------------------------------|
 // Extern Functions                                                           |
@@ -56,6 +117,199 @@ namespace ACSVM
       reset();
    }
 
+   //
+   // Module::fuseCode
+   //
+   // Rewrites common sequences of translated codes as superinstructions. A
+   // superinstruction is written over the first code of its sequence and
+   // skips the words of the rest, so no code moves and jump targets and saved
+   // code positions stay valid. A sequence is only fused if nothing can enter
+   // it after its first code.
+   //
+   void Module::fuseCode()
+   {
+      std::size_t codeC = codeV.size();
+      Word       *code  = codeV.data();
+
+      std::unique_ptr<Byte[]> target{new Byte[codeC + 1]{}};
+
+      // Gets the size of the code at idx, or 0 if it doesn't fit.
+      auto codeSize = [&](std::size_t idx) -> std::size_t
+      {
+         std::size_t size;
+
+         switch(static_cast<Code>(code[idx]))
+         {
+         case Code::CallFunc_Lit:
+         case Code::CallSpec_Lit:
+            size = idx + 1 < codeC ? code[idx + 1] + 3 : codeC;
+            break;
+
+         case Code::Push_LitArr:
+            size = idx + 1 < codeC ? code[idx + 1] + 2 : codeC;
+            break;
+
+         default:
+            size = env->getCodeData(static_cast<Code>(code[idx]))->argc + 1;
+            break;
+         }
+
+         return size <= codeC - idx ? size : 0;
+      };
+
+      auto setTarget = [&](Word idx) {if(idx < codeC) target[idx] = true;};
+
+      // Entry points.
+
+      for(Function *&func : functionV)
+         if(func && func->module == this) setTarget(func->codeIdx);
+
+      for(Jump &jump : jumpV)
+         setTarget(jump.codeIdx);
+
+      for(JumpMap &jumpMap : jumpMapV)
+      {
+         for(auto &jump : jumpMap.table)
+            setTarget(jump.val);
+      }
+
+      for(Script &scr : scriptV)
+         setTarget(scr.codeIdx);
+
+      // Branch targets, and where execution resumes after calls and waits.
+      for(std::size_t idx = 0, size; idx != codeC; idx += size)
+      {
+         if(!(size = codeSize(idx)))
+            return;
+
+         switch(static_cast<Code>(code[idx]))
+         {
+         case Code::Jcnd_Lit:
+            setTarget(code[idx + 2]);
+            break;
+
+         case Code::Jcnd_Nil:
+         case Code::Jcnd_Tru:
+         case Code::Jump_Lit:
+            setTarget(code[idx + 1]);
+            break;
+
+         case Code::Call_Lit:
+         case Code::Call_Stk:
+         case Code::CallFunc:
+         case Code::CallFunc_Lit:
+         case Code::ScrDelay:
+         case Code::ScrDelay_Lit:
+         case Code::ScrHalt:
+         case Code::ScrWaitI:
+         case Code::ScrWaitI_Lit:
+         case Code::ScrWaitS:
+         case Code::ScrWaitS_Lit:
+            target[idx + size] = true;
+            break;
+
+         default:
+            break;
+         }
+      }
+
+      // Fuse sequences.
+      for(std::size_t idx = 0, size; idx != codeC; idx += size)
+      {
+         size = codeSize(idx);
+
+         switch(static_cast<Code>(code[idx]))
+         {
+            // Push_LocReg(r) Push_Lit(v) Cmp* Jcnd_Nil/Jcnd_Tru(j)
+            // -> Jcnd_LocLit_*(r ... v ... j)
+         case Code::Push_LocReg:
+            if(codeC - idx >= 7 &&
+               code[idx + 2] == static_cast<Word>(Code::Push_Lit) &&
+               !target[idx + 2] && !target[idx + 4] && !target[idx + 5])
+            {
+               Code fused = Code::None;
+
+               if(code[idx + 5] == static_cast<Word>(Code::Jcnd_Tru))
+                  fused = FuseJcnd(code[idx + 4], true);
+               else if(code[idx + 5] == static_cast<Word>(Code::Jcnd_Nil))
+                  fused = FuseJcnd(code[idx + 4], false);
+
+               if(fused != Code::None)
+               {
+                  code[idx] = static_cast<Word>(fused);
+                  size = 7;
+               }
+            }
+            break;
+
+            // Push_Lit/Push_LitArr... CallSpec(argc, spec)
+            // -> CallSpec_LitPad(pad, argc, spec, args...)
+            // Push_Lit(v) Op -> Op_Lit(v ...)
+         case Code::Push_Lit:
+         case Code::Push_LitArr:
+            {
+               Word        argV[8];
+               Word        argC = 0;
+               std::size_t iter = idx, iterSize;
+
+               // Gather literal pushes up to a CallSpec.
+               for(; (iterSize = codeSize(iter)); iter += iterSize)
+               {
+                  if(iter != idx && target[iter])
+                     break;
+
+                  if(code[iter] == static_cast<Word>(Code::Push_Lit))
+                  {
+                     if(argC == 8) break;
+                     argV[argC++] = code[iter + 1];
+                  }
+                  else if(code[iter] == static_cast<Word>(Code::Push_LitArr))
+                  {
+                     if(code[iter + 1] > 8 - argC) break;
+                     for(Word i = 0; i != code[iter + 1]; ++i)
+                        argV[argC++] = code[iter + 2 + i];
+                  }
+                  else
+                     break;
+               }
+
+               if(iterSize && iter != idx && !target[iter] &&
+                  code[iter] == static_cast<Word>(Code::CallSpec) &&
+                  code[iter + 1] == argC)
+               {
+                  Word spec = code[iter + 2];
+
+                  code[idx + 0] = static_cast<Word>(Code::CallSpec_LitPad);
+                  code[idx + 1] = static_cast<Word>(iter + 3 - idx - 1);
+                  code[idx + 2] = argC;
+                  code[idx + 3] = spec;
+                  for(Word i = 0; i != argC; ++i)
+                     code[idx + 4 + i] = argV[i];
+
+                  size = iter + 3 - idx;
+                  break;
+               }
+            }
+
+            if(code[idx] == static_cast<Word>(Code::Push_Lit) &&
+               codeC - idx >= 3 && !target[idx + 2])
+            {
+               Code fused = FuseLitOp(code[idx + 2]);
+
+               if(fused != Code::None)
+               {
+                  code[idx] = static_cast<Word>(fused);
+                  size = 3;
+               }
+            }
+            break;
+
+         default:
+            break;
+         }
+      }
+   }
+
    //
    // Module::refStrings
    //
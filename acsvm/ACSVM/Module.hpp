@@ -147,6 +147,8 @@ namespace ACSVM
       bool chunkerACSE_STRL(Byte const *data, std::size_t size, Word chunkName);
       bool chunkerACSE_SVCT(Byte const *data, std::size_t size, Word chunkName);
 
+      void fuseCode();
+
       void readBytecodeACS0(Byte const *data, std::size_t size);
       void readBytecodeACSE(Byte const *data, std::size_t size,
          bool compressed, std::size_t iter = 4);
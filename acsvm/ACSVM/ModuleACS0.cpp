@@ -138,6 +138,8 @@ namespace ACSVM
       jumpMapV.alloc(tracer.jumpMapC);
 
       tracer.translate(this);
+
+      fuseCode();
    }
 
    //
@@ -24,6 +24,7 @@
 #include "Thread.hpp"
 
 #include <algorithm>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -55,12 +56,30 @@ namespace ACSVM
    //
    struct MapScope::PrivData
    {
+      static constexpr std::size_t DelaySlotC = 1024;
+
       HashMapFixed<Module *, ModuleScope> scopes;
 
       HashMapFixed<Word,     Script *> scriptInt;
       HashMapFixed<String *, Script *> scriptStr;
 
       HashMapFixed<Script *, Thread *> scriptThread;
+
+      // Threads to visit each exec, in start order. Threads delayed past the
+      // next tic are parked by the tic they wake on instead, and threads
+      // waiting on a tag by tag type and number, until signalTag.
+      ListLink<Thread> threadRun;
+      ListLink<Thread> threadDelay[DelaySlotC];
+
+      std::unordered_map<DWord, ListLink<Thread>> threadWait;
+
+      std::vector<Thread *> threadWake;
+
+      DWord execSeq = 0;
+
+
+      static DWord WaitKey(Word type, Word tag)
+         {return static_cast<DWord>(type) << 32 | tag;}
    };
 }
 
@@ -516,6 +535,8 @@ namespace ACSVM
       active       {false},
       clampCallSpec{false},
 
+      execTic{0},
+
       pd{new PrivData}
    {
    }
@@ -613,6 +634,16 @@ namespace ACSVM
          scope.val.import();
    }
 
+   //
+   // MapScope::addThread
+   //
+   void MapScope::addThread(Thread *thread)
+   {
+      thread->execSeq  = ++pd->execSeq;
+      thread->execWake = 0;
+      thread->execLink.relink(&pd->threadRun);
+   }
+
    //
    // MapScope::countActiveThread
    //
@@ -654,14 +685,49 @@ namespace ACSVM
          delete action;
       }
 
+      ++execTic;
+
+      // Return threads whose delay ends this tic to the run list, in order.
+      auto &slot = pd->threadDelay[execTic % PrivData::DelaySlotC];
+      for(auto &thread : slot)
+      {
+         if(thread.execWake == execTic)
+            pd->threadWake.push_back(&thread);
+      }
+
+      if(!pd->threadWake.empty())
+      {
+         std::sort(pd->threadWake.begin(), pd->threadWake.end(),
+            [](Thread *l, Thread *r){return l->execSeq < r->execSeq;});
+
+         auto pos = pd->threadRun.next;
+         for(Thread *thread : pd->threadWake)
+         {
+            while(pos->obj && pos->obj->execSeq < thread->execSeq)
+               pos = pos->next;
+
+            thread->delay    = 1;
+            thread->execWake = 0;
+            thread->execLink.relink(pos);
+         }
+
+         pd->threadWake.clear();
+      }
+
       // Execute running threads.
-      for(auto itr = threadActive.begin(), end = threadActive.end(); itr != end;)
+      for(auto link = pd->threadRun.next; link->obj;)
       {
-         itr->exec();
-         if(itr->state == ThreadState::Inactive)
-            freeThread(&*itr++);
+         Thread *thread = link->obj;
+
+         thread->exec();
+
+         // Threads started or woken by this one can change what follows it.
+         link = link->next;
+
+         if(thread->state == ThreadState::Inactive)
+            freeThread(thread);
          else
-            ++itr;
+            parkThread(thread);
       }
    }
 
@@ -805,6 +871,7 @@ namespace ACSVM
          Thread *thread = env->getFreeThread();
          thread->link.insert(&threadActive);
          thread->loadState(in);
+         addThread(thread);
 
          if(in.in->get())
          {
@@ -830,6 +897,26 @@ namespace ACSVM
          thread.lockStrings();
    }
 
+   //
+   // MapScope::parkThread
+   //
+   // Takes a thread out of the run list if nothing can happen to it until a
+   // later tic or a tag signal.
+   //
+   void MapScope::parkThread(Thread *thread)
+   {
+      if(thread->delay > 1)
+      {
+         thread->execWake = execTic + thread->delay;
+         thread->execLink.relink(&pd->threadDelay[thread->execWake % PrivData::DelaySlotC]);
+      }
+      else if(!thread->delay && thread->state == ThreadState::WaitTag)
+      {
+         auto key = PrivData::WaitKey(thread->state.type, thread->state.data);
+         thread->execLink.relink(&pd->threadWait[key]);
+      }
+   }
+
    //
    // MapScope::refStrings
    //
@@ -862,6 +949,8 @@ namespace ACSVM
 
       active = false;
 
+      pd->threadWait.clear();
+
       pd->scopes.free();
 
       pd->scriptInt.free();
@@ -869,6 +958,22 @@ namespace ACSVM
       pd->scriptThread.free();
    }
 
+   //
+   // MapScope::runThread
+   //
+   // Returns a thread parked on a tag to the run list, in start order.
+   //
+   void MapScope::runThread(Thread *thread)
+   {
+      thread->execLink.unlink();
+
+      auto pos = &pd->threadRun;
+      while(pos->prev->obj && pos->prev->obj->execSeq > thread->execSeq)
+         pos = pos->prev;
+
+      thread->execLink.insert(pos);
+   }
+
    //
    // MapScope::saveModules
    //
@@ -930,6 +1035,8 @@ namespace ACSVM
          return false;
 
       default:
+         if((*itr)->state == ThreadState::WaitTag && !(*itr)->execWake)
+            runThread(*itr);
          (*itr)->state = ThreadState::Paused;
          return true;
       }
@@ -1107,6 +1214,8 @@ namespace ACSVM
          return false;
 
       default:
+         if((*itr)->state == ThreadState::WaitTag && !(*itr)->execWake)
+            runThread(*itr);
          (*itr)->state = ThreadState::Stopped;
          (*itr)        = nullptr;
          return true;
@@ -1130,6 +1239,21 @@ namespace ACSVM
          return false;
    }
 
+   //
+   // MapScope::signalTag
+   //
+   void MapScope::signalTag(Word type, Word tag)
+   {
+      auto itr = pd->threadWait.find(PrivData::WaitKey(type, tag));
+      if(itr == pd->threadWait.end())
+         return;
+
+      while(itr->second.next->obj)
+         runThread(itr->second.next->obj);
+
+      pd->threadWait.erase(itr);
+   }
+
    //
    // MapScope::unlockStrings
    //
@@ -170,6 +170,9 @@ namespace ACSVM
 
       void addModules(Module *const *moduleV, std::size_t moduleC);
 
+      // Used by Thread when starting.
+      void addThread(Thread *thread);
+
       std::size_t countActiveThread() const;
 
       void exec();
@@ -211,6 +214,10 @@ namespace ACSVM
       bool scriptStop(Script *script);
       bool scriptStop(ScriptName name, ScopeID scope);
 
+      // Wakes threads waiting on a tag. Threads in WaitTag are not polled, so
+      // this must be called whenever checkTag may have become true for it.
+      void signalTag(Word type, Word tag);
+
       void unlockStrings() const;
 
       Environment *const env;
@@ -227,6 +234,9 @@ namespace ACSVM
       bool active;
       bool clampCallSpec;
 
+      // Number of calls to exec.
+      Word execTic;
+
    protected:
       void freeThread(Thread *thread);
 
@@ -236,6 +246,10 @@ namespace ACSVM
       void loadModules(Serial &in);
       void loadThreads(Serial &in);
 
+      void parkThread(Thread *thread);
+
+      void runThread(Thread *thread);
+
       void saveModules(Serial &out) const;
       void saveThreads(Serial &out) const;
 
@@ -37,6 +37,10 @@ namespace ACSVM
       locRegC{module->env->scriptLocRegC},
       type   {0},
 
+      profExecC{0},
+      profCodeC{0},
+      profTime {0},
+
       flagClient{false},
       flagNet   {false}
    {
@@ -57,6 +57,11 @@ namespace ACSVM
       Word locRegC;
       Word type;
 
+      // Profiling counters, kept while Environment::profile is set.
+      DWord profExecC; // Calls to Thread::exec which ran code.
+      DWord profCodeC; // Codes executed.
+      DWord profTime;  // Nanoseconds spent executing.
+
       bool flagClient : 1;
       bool flagNet    : 1;
    };
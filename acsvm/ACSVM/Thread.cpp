@@ -36,6 +36,7 @@ namespace ACSVM
       env{env_},
 
       link{this},
+      execLink{this},
 
       codePtr {nullptr},
       module  {nullptr},
@@ -45,6 +46,8 @@ namespace ACSVM
       scopeMod{nullptr},
       script  {nullptr},
       delay   {0},
+      execSeq {0},
+      execWake{0},
       result  {0}
    {
    }
@@ -181,7 +184,8 @@ namespace ACSVM
       WriteVLN(out, scopeHub->id);
       WriteVLN(out, scopeMap->id);
       env->writeScript(out, script);
-      WriteVLN(out, delay);
+      // A delay parked by the MapScope is only counted down when it wakes.
+      WriteVLN(out, execWake ? execWake - scopeMap->execTic : delay);
       WriteVLN(out, result);
 
       WriteVLN(out, callStk.size());
@@ -240,6 +244,8 @@ namespace ACSVM
       delay  = 0;
       result = 0;
       state  = ThreadState::Running;
+
+      map->addThread(this);
    }
 
    //
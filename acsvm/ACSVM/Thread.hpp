@@ -124,6 +124,7 @@ namespace ACSVM
       Environment *const env;
 
       ListLink<Thread> link;
+      ListLink<Thread> execLink; // MapScope run, delay, or wait list.
 
       Stack<CallFrame> callStk;
       Stack<Word>      dataStk;
@@ -140,6 +141,8 @@ namespace ACSVM
       ModuleScope *scopeMod;
       Script      *script;  // Current execution Script.
       Word         delay;   // Execution delay tics.
+      DWord        execSeq; // Start order, which threads are run in.
+      Word         execWake;// Tic a parked delay ends, or 0 if not parked.
       Word         result;  // Code-defined thread result.
 
 
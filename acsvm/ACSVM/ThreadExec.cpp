@@ -21,6 +21,8 @@
 #include "Scope.hpp"
 #include "Script.hpp"
 
+#include <chrono>
+
 
 //----------------------------------------------------------------------------|
 // Macros                                                                     |
@@ -78,7 +80,7 @@
 // NextCase
 //
 #if ACSVM_DynamicGoto
-#define NextCase() goto *cases[*codePtr++]
+#define NextCase() goto *cases[(++codeC, *codePtr++)]
 #else
 #define NextCase() goto next_case
 #endif
@@ -140,6 +142,33 @@
       Op_##op(*scopeMod->regV[*codePtr++]); \
       NextCase()
 
+//
+// LitSet
+//
+// Binary operator fused with the Push_Lit of its right operand.
+//
+#define LitSet(op, expr) \
+   DeclCase(op##_Lit): \
+      {Word &lop = dataStk[1]; Word rop = codePtr[0]; expr;} \
+      codePtr += 2; \
+      NextCase()
+
+//
+// JcndSet
+//
+// Comparison of a LocReg with a literal fused with the branch on its result.
+//
+#define JcndSet(cmp, expr) \
+   DeclCase(Jcnd_LocLit_##cmp): \
+      { \
+         Word lop = localReg[codePtr[0]], rop = codePtr[2]; \
+         if(expr) \
+            BranchTo(codePtr[5]); \
+         else \
+            codePtr += 6; \
+      } \
+      NextCase()
+
 
 //----------------------------------------------------------------------------|
 // Static Functions                                                           |
@@ -273,33 +302,41 @@ namespace ACSVM
 
       auto branches = env->branchLimit;
 
+      // Profiling is charged to the script the thread is running.
+      Script *profScript = env->profile ? script : nullptr;
+      DWord   codeC      = 0;
+
+      std::chrono::steady_clock::time_point profStart;
+      if(profScript)
+         profStart = std::chrono::steady_clock::now();
+
    exec_intr:
       switch(state.state)
       {
-      case ThreadState::Inactive: return;
+      case ThreadState::Inactive: goto thread_done;
       case ThreadState::Stopped:  goto thread_stop;
-      case ThreadState::Paused:   return;
+      case ThreadState::Paused:   goto thread_done;
 
       case ThreadState::Running:
          if(delay)
-            return;
+            goto thread_done;
          break;
 
       case ThreadState::WaitScrI:
          if(scopeMap->isScriptActive(scopeMap->findScript(state.data)))
-            return;
+            goto thread_done;
          state = ThreadState::Running;
          break;
 
       case ThreadState::WaitScrS:
          if(scopeMap->isScriptActive(scopeMap->findScript(scopeMap->getString(state.data))))
-            return;
+            goto thread_done;
          state = ThreadState::Running;
          break;
 
       case ThreadState::WaitTag:
          if(!module->env->checkTag(state.type, state.data))
-            return;
+            goto thread_done;
          state = ThreadState::Running;
          break;
       }
@@ -315,7 +352,7 @@ namespace ACSVM
       #if ACSVM_DynamicGoto
       NextCase();
       #else
-      next_case: switch(*codePtr++)
+      next_case: switch(++codeC, *codePtr++)
       #endif
       {
       DeclCase(Nop):
@@ -632,10 +669,56 @@ namespace ACSVM
       DeclCase(NotU):
          dataStk[1] = !dataStk[1];
          NextCase();
+
+         //================================================
+         // Superinstruction codes.
+         //
+
+         LitSet(AddU, lop += rop);
+         LitSet(AndU, lop &= rop);
+         LitSet(CmpI_GE, OpFunc_CmpI_GE(lop, rop));
+         LitSet(CmpI_GT, OpFunc_CmpI_GT(lop, rop));
+         LitSet(CmpI_LE, OpFunc_CmpI_LE(lop, rop));
+         LitSet(CmpI_LT, OpFunc_CmpI_LT(lop, rop));
+         LitSet(CmpU_EQ, OpFunc_CmpU_EQ(lop, rop));
+         LitSet(CmpU_NE, OpFunc_CmpU_NE(lop, rop));
+         LitSet(DivI, OpFunc_DivI(lop, rop));
+         LitSet(ModI, OpFunc_ModI(lop, rop));
+         LitSet(MulU, lop *= rop);
+         LitSet(OrIU, lop |= rop);
+         LitSet(ShLU, lop <<= rop & 31);
+         LitSet(ShRI, OpFunc_ShRI(lop, rop));
+         LitSet(SubU, lop -= rop);
+
+         JcndSet(EQ, lop == rop);
+         JcndSet(GE, static_cast<SWord>(lop) >= static_cast<SWord>(rop));
+         JcndSet(GT, static_cast<SWord>(lop) >  static_cast<SWord>(rop));
+         JcndSet(LE, static_cast<SWord>(lop) <= static_cast<SWord>(rop));
+         JcndSet(LT, static_cast<SWord>(lop) <  static_cast<SWord>(rop));
+         JcndSet(NE, lop != rop);
+
+      DeclCase(CallSpec_LitPad):
+         {
+            Word        argc = codePtr[1];
+            Word        spec = codePtr[2];
+            Word const *argv = codePtr + 3;
+            codePtr += codePtr[0];
+            env->callSpec(this, spec, argv, argc);
+         }
+         NextCase();
       }
 
    thread_stop:
       stop();
+
+   thread_done:
+      if(profScript && codeC)
+      {
+         profScript->profExecC += 1;
+         profScript->profCodeC += codeC;
+         profScript->profTime  += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - profStart).count();
+      }
    }
 }
 
@@ -436,7 +436,7 @@ cfg_t *cfg_gettitleprops(cfg_t *cfg)
 // Internal Value Maintenance
 //
 
-static cfg_value_t *cfg_addval(cfg_opt_t *opt)
+cfg_value_t *cfg_addval(cfg_opt_t *opt)
 {
    opt->values = erealloc(cfg_value_t **, opt->values,
                           (opt->nvalues+1) * sizeof(cfg_value_t *));
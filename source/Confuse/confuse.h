@@ -543,6 +543,12 @@ int           cfg_getnflag(cfg_t *cfg, const char *name, unsigned int index);
 
 cfg_value_t *cfg_setopt(cfg_t *cfg, cfg_opt_t *opt, const char *value);
 
+/** Append a new, zeroed value to an option, without parsing anything.
+ * Used to rebuild a tree that was saved after parsing.
+ * @param opt The option.
+ */
+cfg_value_t *cfg_addval(cfg_opt_t *opt);
+
 /** Return the number of values this option has. If the option does
  * not have the CFGF_LIST or CFGF_MULTI flag set, this function will
  * always return 1.
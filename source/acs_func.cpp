@@ -56,6 +56,7 @@
 #include "p_map3d.h"
 #include "p_maputl.h"
 #include "p_portal.h"   // ioanch 20160116
+#include "p_sightcache.h"
 #include "p_spec.h"
 #include "p_xenemy.h"
 #include "r_data.h"
@@ -1827,6 +1828,9 @@ static void ACS_setLineBlocking(int tag, int block)
          break;
       }
    }
+
+   // BLOCKALL lines stop sight
+   P_InvalidateSightCache();
 }
 
 //
@@ -29,9 +29,12 @@
 //
 //----------------------------------------------------------------------------
 
+#include <algorithm>
+
 #include "z_zone.h"
 
 #include "acs_intr.h"
+#include "c_io.h"
 #include "c_runcmd.h"
 #include "doomstat.h"
 #include "e_hash.h"
@@ -40,6 +43,7 @@
 #include "hu_stuff.h"
 #include "m_buffer.h"
 #include "m_collection.h"
+#include "m_profile.h"
 #include "m_qstr.h"
 #include "m_swap.h"
 #include "m_utils.h"
@@ -72,6 +76,9 @@
 
 ACSEnvironment ACSenv;
 
+static bool acs_profile;     // count codes and time spent per script
+static int  acsprofiletics;  // tics run while profiling
+
 // ACS_thingtypes:
 // This array translates from ACS spawn numbers to internal thingtype indices.
 // ACS spawn numbers are specified via EDF and are gamemode-dependent. EDF takes
@@ -746,9 +753,26 @@ void ACS_LoadLevelScript(WadDirectory *dir, int lump)
 //
 void ACS_Exec()
 {
+   PROFILE_ZONE(PROF_ACS);
+
+   if(ACSenv.profile)
+      ++acsprofiletics;
+
    ACSenv.exec();
 }
 
+//
+// ACS_SignalTag
+//
+// Called when a sector or polyobject mover finishes. Scripts waiting on a tag
+// are not checked again until it is signalled.
+//
+void ACS_SignalTag(int type, int tag)
+{
+   if(ACSenv.map)
+      ACSenv.map->signalTag(type, tag);
+}
+
 //
 // ACS_ExecuteScriptI
 //
@@ -929,5 +953,84 @@ void ACS_Archive(SaveArchive &arc)
    }
 }
 
+//=============================================================================
+//
+// Console Commands
+//
+
+VARIABLE_TOGGLE(acs_profile, NULL, onoff);
+CONSOLE_VARIABLE(acs_profile, acs_profile, 0)
+{
+   ACSenv.profile = acs_profile;
+}
+
+//
+// ACS_printProfile
+//
+// Lists the scripts which have taken the most time since profiling was
+// started or last reset.
+//
+static void ACS_printProfile(int count)
+{
+   PODCollection<ACSVM::Script *> scripts;
+   uint64_t totaltime = 0;
+
+   ACSenv.forEachScript([&](ACSVM::Script &script)
+   {
+      if(script.profExecC)
+      {
+         scripts.add(&script);
+         totaltime += script.profTime;
+      }
+   });
+
+   if(scripts.isEmpty())
+   {
+      C_Printf("No scripts have run while acs_profile was on\n");
+      return;
+   }
+
+   std::sort(scripts.begin(), scripts.end(),
+             [](const ACSVM::Script *a, const ACSVM::Script *b) {
+                return a->profTime > b->profTime;
+             });
+
+   const int tics = acsprofiletics ? acsprofiletics : 1;
+
+   C_Printf("%d tics, %.3f ms per tic\n", acsprofiletics,
+            static_cast<double>(totaltime) / 1000000.0 / tics);
+   C_Printf("script       module        runs       codes  ms total  us/tic\n");
+
+   for(ACSVM::Script *script : scripts)
+   {
+      if(count-- <= 0)
+         break;
+
+      qstring name;
+      if(script->name.s)
+         name = script->name.s->str;
+      else
+         name << static_cast<int>(script->name.i);
+
+      C_Printf("%-12.12s %-8.8s %9llu %11llu %9.2f %7.1f\n", name.constPtr(),
+               script->module->name.s ? script->module->name.s->str : "",
+               static_cast<unsigned long long>(script->profExecC),
+               static_cast<unsigned long long>(script->profCodeC),
+               static_cast<double>(script->profTime) / 1000000.0,
+               static_cast<double>(script->profTime) / 1000.0 / tics);
+   }
+}
+
+CONSOLE_COMMAND(acs_profileinfo, 0)
+{
+   ACS_printProfile(Console.argc ? Console.argv[0]->toInt() : 20);
+}
+
+CONSOLE_COMMAND(acs_profilereset, 0)
+{
+   ACSenv.resetProfile();
+   acsprofiletics = 0;
+}
+
 // EOF
 
@@ -293,6 +293,7 @@ void ACS_NewGame();
 void ACS_InitLevel();
 void ACS_LoadLevelScript(WadDirectory *dir, int lump);
 void ACS_Exec();
+void ACS_SignalTag(int type, int tag);
 
 void ACS_Archive(SaveArchive &arc);
 
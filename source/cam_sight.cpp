@@ -28,6 +28,7 @@
 
 #include "cam_common.h"
 #include "cam_sight.h"
+#include "p_sightcache.h"
 #include "doomstat.h"   // ioanch 20160101: for bullet attacks
 #include "d_gi.h"       // ioanch 20160131: for use
 #include "d_player.h"   // ioanch 20151230: for autoaim
@@ -518,7 +519,9 @@ bool CamContext::checkSight(const camsightparams_t &params,
 
    bool result = false;
 
-   if(link || !(rejectmatrix[pnum >> 3] & (1 << (pnum & 7))))
+   // the visibility rows are only in use on maps without linked portals
+   if(link || (!(rejectmatrix[pnum >> 3] & (1 << (pnum & 7))) &&
+               P_SectorsMaySee(int(s1), int(s2))))
    {
       // killough 4/19/98: make fake floors and ceilings block monster view
       if((csec->heightsec != -1 &&
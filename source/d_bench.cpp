@@ -0,0 +1,267 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Per-frame timedemo benchmarking. With -benchcsv <file>, a -timedemo or
+//      -fastdemo run records how long every frame took to draw, broken down
+//      into phases, and writes one CSV row per frame when the demo ends.
+//      Percentiles of each phase are added to the final timedemo message.
+//
+//      Render phases are timed separately in every render context. Since the
+//      slices are drawn at the same time, the time kept for a phase is that
+//      of the slowest slice.
+//
+//-----------------------------------------------------------------------------
+
+#include "z_zone.h"
+#include "d_bench.h"
+#include "d_main.h"
+#include "doomstat.h"
+#include "m_argv.h"
+#include "m_collection.h"
+#include "m_profile.h"
+#include "m_qstr.h"
+#include "r_context.h"
+
+// Set while frames are being recorded
+bool d_benchactive;
+
+struct benchframe_t
+{
+   int      gametic;
+   uint64_t total;
+   uint64_t phases[NUMBENCHPHASES];
+};
+
+static const char *benchphasenames[NUMBENCHPHASES] =
+{
+   "bsp", "planes", "masked", "portals", "hud", "blit"
+};
+
+static const char *benchfilename;
+static uint64_t    benchframestart;
+
+// Each render context only ever adds to its own row
+static uint64_t benchctxtimes[R_MAXCONTEXTS][NUMBENCHPHASES];
+
+static PODCollection<benchframe_t> benchframes;
+
+//
+// D_BenchInit
+//
+// Checks for -benchcsv on the command line.
+//
+void D_BenchInit()
+{
+   int p;
+
+   if((p = M_CheckParm("-benchcsv")) && ++p < myargc)
+      benchfilename = myargv[p];
+}
+
+//
+// D_BenchStart
+//
+// Called when a timed demo starts playing. Does nothing if no CSV was asked
+// for.
+//
+void D_BenchStart()
+{
+   if(!benchfilename || d_benchactive)
+      return;
+
+   memset(benchctxtimes, 0, sizeof(benchctxtimes));
+   benchframes.makeEmpty();
+   d_benchactive = true;
+}
+
+//
+// D_BenchClock
+//
+// Returns a timestamp in nanoseconds, or 0 when not benchmarking.
+//
+uint64_t D_BenchClock()
+{
+   if(!d_benchactive)
+      return 0;
+
+   return M_ProfileClock();
+}
+
+//
+// D_BenchAddPhase
+//
+// Adds the time since starttime, which came from D_BenchClock, to a phase of
+// the current frame. May be called from any render context.
+//
+void D_BenchAddPhase(int phase, uint64_t starttime)
+{
+   if(!d_benchactive)
+      return;
+
+   benchctxtimes[r_context->index][phase] += D_BenchClock() - starttime;
+}
+
+//
+// D_BenchStartFrame
+//
+void D_BenchStartFrame()
+{
+   benchframestart = D_BenchClock();
+}
+
+//
+// D_BenchEndFrame
+//
+// Records the frame which just finished.
+//
+void D_BenchEndFrame()
+{
+   if(!d_benchactive)
+      return;
+
+   benchframe_t &frame = benchframes.addNew();
+
+   frame.gametic = gametic;
+   frame.total   = D_BenchClock() - benchframestart;
+
+   for(int phase = 0; phase < NUMBENCHPHASES; phase++)
+   {
+      uint64_t slowest = 0;
+
+      for(int i = 0; i < R_MAXCONTEXTS; i++)
+      {
+         if(benchctxtimes[i][phase] > slowest)
+            slowest = benchctxtimes[i][phase];
+         benchctxtimes[i][phase] = 0;
+      }
+
+      frame.phases[phase] = slowest;
+   }
+}
+
+//
+// D_benchCompare
+//
+// qsort callback for sorting frame times.
+//
+static int D_benchCompare(const void *a, const void *b)
+{
+   uint64_t ta = *static_cast<const uint64_t *>(a);
+   uint64_t tb = *static_cast<const uint64_t *>(b);
+
+   return (ta > tb) - (ta < tb);
+}
+
+//
+// D_benchAddPercentiles
+//
+// Sorts one column of frame times and adds a line of percentiles for it to
+// the report. Nearest-rank percentiles are used.
+//
+static void D_benchAddPercentiles(qstring &report, const char *name,
+                                  uint64_t *times, size_t count)
+{
+   static const int percents[] = { 50, 90, 95, 99 };
+   qstring column;
+
+   qsort(times, count, sizeof(uint64_t), D_benchCompare);
+
+   column.Printf(0, "%-8s", name);
+   report << column;
+   for(int percent : percents)
+   {
+      size_t rank = (count * percent + 99) / 100;
+      column.Printf(0, " %8.3f", times[rank ? rank - 1 : 0] / 1000000.0);
+      report << column;
+   }
+   column.Printf(0, " %8.3f\n", times[count - 1] / 1000000.0);
+   report << column;
+}
+
+//
+// D_BenchFinish
+//
+// Stops recording, writes the CSV file, and fills in report with percentiles
+// of the frame times in milliseconds.
+//
+void D_BenchFinish(qstring &report)
+{
+   FILE   *f;
+   size_t  count = benchframes.getLength();
+   qstring line;
+
+   if(!d_benchactive)
+      return;
+
+   d_benchactive = false;
+
+   if(!count)
+      return;
+
+   if(!(f = fopen(benchfilename, "w")))
+      line.Printf(0, "Could not write %s\n", benchfilename);
+   else
+   {
+      fputs("frame,gametic,total_ms", f);
+      for(const char *name : benchphasenames)
+         fprintf(f, ",%s_ms", name);
+      fputc('\n', f);
+
+      for(size_t i = 0; i < count; i++)
+      {
+         const benchframe_t &frame = benchframes[i];
+
+         fprintf(f, "%u,%d,%.3f", unsigned(i), frame.gametic,
+                 frame.total / 1000000.0);
+         for(uint64_t time : frame.phases)
+            fprintf(f, ",%.3f", time / 1000000.0);
+         fputc('\n', f);
+      }
+
+      fclose(f);
+      line.Printf(0, "Wrote %u frames to %s\n", unsigned(count), benchfilename);
+   }
+   report << line;
+
+   uint64_t *times = emalloc(uint64_t *, count * sizeof(uint64_t));
+
+   report << "phase         p50      p90      p95      p99      max (ms)\n";
+
+   for(size_t i = 0; i < count; i++)
+      times[i] = benchframes[i].total;
+   D_benchAddPercentiles(report, "total", times, count);
+
+   for(int phase = 0; phase < NUMBENCHPHASES; phase++)
+   {
+      for(size_t i = 0; i < count; i++)
+         times[i] = benchframes[i].phases[phase];
+      D_benchAddPercentiles(report, benchphasenames[phase], times, count);
+   }
+
+   efree(times);
+   benchframes.clear();
+}
+
+// EOF
+
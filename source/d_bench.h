@@ -0,0 +1,59 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Per-frame timedemo benchmarking.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef D_BENCH_H__
+#define D_BENCH_H__
+
+class qstring;
+
+// Parts of a frame which are timed separately
+enum benchphase_e
+{
+   BENCH_BSP,      // BSP walk, including solid wall drawing
+   BENCH_PLANES,   // visplanes of the main view
+   BENCH_MASKED,   // sprites, masked midtextures and portal overlays
+   BENCH_PORTALS,  // everything rendered through portals
+   BENCH_HUD,      // status bar, HUD, console and menus
+   BENCH_BLIT,     // I_FinishUpdate
+   NUMBENCHPHASES
+};
+
+extern bool d_benchactive;
+
+void     D_BenchInit();
+void     D_BenchStart();
+uint64_t D_BenchClock();
+void     D_BenchAddPhase(int phase, uint64_t starttime);
+void     D_BenchStartFrame();
+void     D_BenchEndFrame();
+void     D_BenchFinish(qstring &report);
+
+#endif
+
+// EOF
+
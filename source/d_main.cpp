@@ -39,6 +39,7 @@
 #include "c_io.h"
 #include "c_net.h"
 #include "c_runcmd.h"
+#include "d_bench.h"
 #include "d_deh.h"      // Ty 04/08/98 - Externalizations
 #include "d_dehtbl.h"
 #include "d_event.h"
@@ -68,6 +69,7 @@
 #include "m_argv.h"
 #include "m_compare.h"
 #include "m_misc.h"
+#include "m_profile.h"
 #include "m_syscfg.h"
 #include "m_qstr.h"
 #include "m_utils.h"
@@ -569,10 +571,13 @@ void D_DrawWings()
 //
 static void D_Display()
 {
+   uint64_t hudstart, blitstart;
+
    if(nodrawers)                // for comparative timing / profiling
       return;
 
    i_haltimer.StartDisplay();
+   D_BenchStartFrame();
 
    if(setsizeneeded)            // change the view size if needed
    {
@@ -611,8 +616,10 @@ static void D_Display()
             R_RenderPlayerView(&players[displayplayer], camera);
          }
          
+         hudstart = D_BenchClock();
          ST_Drawer(scaledwindow.height == SCREENHEIGHT);  // killough 11/98
          HU_Drawer();
+         D_BenchAddPhase(BENCH_HUD, hudstart);
          break;
       case GS_INTERMISSION:
          IN_Drawer();
@@ -695,12 +702,16 @@ static void D_Display()
             Wipe_Drawer();
       }
 
+      hudstart = D_BenchClock();
       C_Drawer();
+      D_BenchAddPhase(BENCH_HUD, hudstart);
 
    } // if(!MN_CheckFullScreen())
 
    // menus go directly to the screen
+   hudstart = D_BenchClock();
    MN_Drawer();         // menu is drawn even on top of everything
+   D_BenchAddPhase(BENCH_HUD, hudstart);
    NetUpdate();         // send out any new accumulation
    
    //sf : now system independent
@@ -710,13 +721,18 @@ static void D_Display()
    if(d_drawfps)
       D_showDrawnFPS();
 
+   M_ProfileDrawer();
+
 #ifdef INSTRUMENTED
    if(printstats)
       D_showMemStats();
 #endif
    
+   blitstart = D_BenchClock();
    I_FinishUpdate();              // page flip or blit buffer
+   D_BenchAddPhase(BENCH_BLIT, blitstart);
 
+   D_BenchEndFrame();
    i_haltimer.EndDisplay();
 }
 
@@ -1521,6 +1537,7 @@ static void D_DoomInit()
    // killough 3/2/98: allow -nodraw -noblit generally
    nodrawers = !!M_CheckParm("-nodraw");
    noblit    = !!M_CheckParm("-noblit");
+   headless  = !!M_CheckParm("-headless");
 
    // haleyjd: need to do this before M_LoadDefaults
    C_InitPlayerName();
@@ -1863,6 +1880,10 @@ static void D_DoomInit()
       singledemo = true;
    }
 
+   // per-frame timing for -fastdemo and -timedemo
+   if(timingdemo)
+      D_BenchInit();
+
    startlevel = estrdup(G_GetNameForMap(startepisode, startmap));
 
    if(slot && ++slot < myargc)
@@ -1936,7 +1957,11 @@ void D_DoomMain()
       S_UpdateSounds(players[displayplayer].mo); // move positional sounds
 
       // Update display, next frame, with current state.
-      D_Display();
+      {
+         PROFILE_ZONE(PROF_FRAME);
+         D_Display();
+      }
+      M_ProfileEndFrame();
 
       // Sound mixing for the buffer is synchronous.
       I_UpdateSound();
@@ -1947,6 +1972,9 @@ void D_DoomMain()
 
       // haleyjd 12/06/06: garbage-collect all alloca blocks
       Z_FreeAlloca();
+
+      // let go of stale purgable blocks past the cache budget
+      Z_TrimCache();
    }
 }
 
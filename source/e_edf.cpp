@@ -98,6 +98,7 @@
 
 #include "e_lib.h"
 #include "e_edf.h"
+#include "e_edfcache.h"
 
 #include "e_anim.h"
 #include "e_args.h"
@@ -569,6 +570,7 @@ static int bex_include(cfg_t *cfg, cfg_opt_t *opt, int argc,
 
    // queue the file for later processing
    D_QueueDEH(filename, 0);
+   E_EDFCacheInvalidate("bexinclude was used");
 
    return 0;
 }
@@ -1766,7 +1768,20 @@ void E_ProcessEDF(const char *filename)
    // haleyjd 03/21/10: All parsing is now streamlined into a single process,
    // using the unified cfg_t object created above.
    //
-   E_ParseEDF(cfg, filename);
+   // The parsed tree is cached on disk, and read back instead if nothing
+   // it was parsed from has changed.
+   //
+   E_EDFCacheBegin(cfg, filename, edf_enables);
+   if(E_EDFCacheLoad(cfg, edf_enables))
+   {
+      puts("E_ProcessEDF: Loaded parsed EDF from cache.\n");
+      E_EDFLogPuts("\t* Loaded parsed EDF from cache\n");
+   }
+   else
+   {
+      E_ParseEDF(cfg, filename);
+      E_EDFCacheSave(cfg, edf_enables);
+   }
 
    //
    // Processing
@@ -0,0 +1,760 @@
+// Emacs style mode select -*- C++ -*-
+//----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//----------------------------------------------------------------------------
+//
+// EDF Parse Cache
+//
+// Parsing the EDF root and all of its includes through libConfuse makes up
+// most of the time spent in E_ProcessEDF. After a successful parse the whole
+// cfg_t tree is written to edf.cache in the user game directory, and on the
+// next launch it is read back instead of parsing, as long as nothing the
+// parse depended on has changed.
+//
+// The cache is keyed by the engine version, the layout of the EDF option
+// tables, the command line, the enable values, the game type and the full
+// wad directory. On top of that, every file and lump which was parsed is
+// recorded along with its SHA-1 digest, and each is re-read and checked
+// before the cache is trusted. Files which userinclude looked for and did
+// not find must still be missing.
+//
+// Only the tree is cached. Processing still runs on every launch, since it
+// builds the engine's tables in place and is interleaved with DeHackEd
+// and DECORATE state handling which depend on the rest of the startup.
+//
+//----------------------------------------------------------------------------
+
+#include "z_zone.h"
+#include "i_system.h"
+
+#include "Confuse/confuse.h"
+#include "Confuse/lexer.h"
+
+#include "e_lib.h"
+#include "e_edf.h"
+#include "e_edfcache.h"
+
+#include "d_gi.h"
+#include "d_io.h"
+#include "doomstat.h"
+#include "m_argv.h"
+#include "m_buffer.h"
+#include "m_collection.h"
+#include "m_hash.h"
+#include "m_qstr.h"
+#include "m_utils.h"
+#include "version.h"
+#include "w_wad.h"
+#include "z_auto.h"
+
+#define EDFCACHE_MAGIC   "EEEDFC\x1a\x01"
+#define EDFCACHE_VERSION 1
+#define EDFCACHE_NOSTR   0xffffffffu
+
+// Pseudo lump number for a userinclude file which wasn't found
+#define EDFCACHE_MISSING -2
+
+struct edfcachesource_t
+{
+   char    *name;    // file path, or name the lump was included by
+   int      lumpnum; // -1 for a file, or EDFCACHE_MISSING
+   uint32_t digest[5];
+};
+
+static PODCollection<edfcachesource_t> edfcachesources;
+
+static bool     edfcacherecording;
+static bool     edfcacheinvalid;
+static qstring  edfcachefile;
+static uint32_t edfcachekey[5];
+
+//=============================================================================
+//
+// Key
+//
+
+static void E_hashInt(HashData &hash, int32_t value)
+{
+   uint8_t bytes[4] =
+   {
+      uint8_t(value), uint8_t(value >> 8), uint8_t(value >> 16), uint8_t(value >> 24)
+   };
+
+   hash.addData(bytes, 4);
+}
+
+static void E_hashString(HashData &hash, const char *str)
+{
+   if(!str)
+   {
+      E_hashInt(hash, -1);
+      return;
+   }
+
+   size_t len = strlen(str);
+
+   E_hashInt(hash, int32_t(len));
+   hash.addData(reinterpret_cast<const uint8_t *>(str), uint32_t(len));
+}
+
+//
+// E_hashOptions
+//
+// Adds the layout of an option table to the key, so that a cache written by
+// a build with different EDF syntax is never used.
+//
+static void E_hashOptions(HashData &hash, const cfg_opt_t *opts, int depth)
+{
+   if(depth > 16) // guard against a table containing itself
+      return;
+
+   for(const cfg_opt_t *opt = opts; opt->name; opt++)
+   {
+      E_hashString(hash, opt->name);
+      E_hashInt(hash, opt->type);
+      E_hashInt(hash, opt->flags);
+
+      if(opt->subopts && (opt->type == CFGT_SEC || opt->type == CFGT_MVPROP))
+         E_hashOptions(hash, opt->subopts, depth + 1);
+   }
+   E_hashInt(hash, -1);
+}
+
+//
+// E_hashDirectory
+//
+// Adds every lump in the global directory to the key. The contents of lumps
+// which are parsed are checked separately; this catches the addition or
+// removal of lumps that the parser would have found.
+//
+static void E_hashDirectory(HashData &hash)
+{
+   lumpinfo_t **lumpinfo = wGlobalDir.getLumpInfo();
+   int numlumps   = wGlobalDir.getNumLumps();
+   int lastsource = -1;
+
+   E_hashInt(hash, numlumps);
+
+   for(int i = 0; i < numlumps; i++)
+   {
+      const lumpinfo_t *lump = lumpinfo[i];
+
+      if(lump->source != lastsource)
+      {
+         lastsource = lump->source;
+         E_hashInt(hash, lastsource);
+         E_hashString(hash, wGlobalDir.getLumpFileName(i));
+      }
+
+      E_hashString(hash, lump->name);
+      E_hashString(hash, lump->lfn);
+      E_hashInt(hash, lump->li_namespace);
+      E_hashInt(hash, int32_t(lump->size));
+   }
+
+   // Color values are looked up in the palette while parsing
+   int palette;
+   if((palette = W_CheckNumForName("PLAYPAL")) >= 0)
+   {
+      ZAutoBuffer buffer;
+
+      wGlobalDir.cacheLumpAuto(palette, buffer);
+      hash.addData(buffer.getAs<const uint8_t *>(), uint32_t(buffer.getSize()));
+   }
+}
+
+//
+// E_EDFCacheBegin
+//
+// Called by E_ProcessEDF before the root EDF is parsed. Works out the cache
+// key and starts recording the parse's dependencies. The cache is not used
+// with -noedfcache, or with -edfout since a verbose log of the parse is
+// wanted then.
+//
+void E_EDFCacheBegin(cfg_t *cfg, const char *rootfile,
+                     const E_Enable_s *enables)
+{
+   edfcacherecording = false;
+   edfcacheinvalid   = false;
+
+   if(M_CheckParm("-noedfcache") || M_CheckParm("-edfout") || !usergamepath)
+      return;
+
+   HashData key(HashData::SHA1);
+
+   E_hashString(key, EDFCACHE_MAGIC);
+   E_hashInt(key, version);
+   E_hashInt(key, subversion);
+   E_hashOptions(key, cfg->opts, 0);
+   E_hashInt(key, GameModeInfo->type);
+   for(const E_Enable_s *enable = enables; enable->name; enable++)
+   {
+      E_hashString(key, enable->name);
+      E_hashInt(key, enable->enabled);
+   }
+   E_hashString(key, rootfile);
+   E_hashInt(key, myargc);
+   for(int i = 1; i < myargc; i++)
+      E_hashString(key, myargv[i]);
+   E_hashDirectory(key);
+   key.wrapUp();
+
+   for(int i = 0; i < 5; i++)
+      edfcachekey[i] = key.getDigestPart(i);
+
+   edfcachefile = M_SafeFilePath(usergamepath, "edf.cache");
+   edfcacherecording = true;
+}
+
+//=============================================================================
+//
+// Dependencies
+//
+
+//
+// E_clearSources
+//
+static void E_clearSources()
+{
+   for(edfcachesource_t &source : edfcachesources)
+      efree(source.name);
+   edfcachesources.makeEmpty();
+}
+
+//
+// E_EDFCacheAddSource
+//
+// Called by E_CheckInclude for every data source the parser opens, whether
+// or not it is then declined as a duplicate.
+//
+void E_EDFCacheAddSource(const char *name, int lumpnum, const HashData &hash)
+{
+   if(!edfcacherecording)
+      return;
+
+   edfcachesource_t &source = edfcachesources.addNew();
+
+   source.name    = estrdup(name ? name : "");
+   source.lumpnum = lumpnum;
+   for(int i = 0; i < 5; i++)
+      source.digest[i] = hash.getDigestPart(i);
+}
+
+//
+// E_EDFCacheAddMissingFile
+//
+// Called by userinclude when the file it looks for doesn't exist.
+//
+void E_EDFCacheAddMissingFile(const char *filename)
+{
+   if(!edfcacherecording)
+      return;
+
+   edfcachesource_t &source = edfcachesources.addNew();
+
+   source.name    = estrdup(filename);
+   source.lumpnum = EDFCACHE_MISSING;
+   memset(source.digest, 0, sizeof(source.digest));
+}
+
+//
+// E_EDFCacheInvalidate
+//
+// Called when the parse has a side effect which the cache can't reproduce,
+// such as queueing a DeHackEd file. The tree won't be saved.
+//
+void E_EDFCacheInvalidate(const char *reason)
+{
+   if(!edfcacherecording || edfcacheinvalid)
+      return;
+
+   E_EDFLogPrintf("\t\t* Not caching EDF: %s\n", reason);
+   edfcacheinvalid = true;
+}
+
+//
+// E_checkSource
+//
+// Re-reads a recorded data source and checks it against its digest. The
+// new digest is returned in hash, for the include tracking list.
+//
+static bool E_checkSource(const edfcachesource_t &source, HashData &hash)
+{
+   char  *data;
+   size_t len;
+
+   if(source.lumpnum == EDFCACHE_MISSING)
+      return access(source.name, R_OK) != 0;
+
+   if(source.lumpnum >= wGlobalDir.getNumLumps())
+      return false;
+
+   if(!(data = cfg_lexer_open(source.name, source.lumpnum, &len)))
+      return false;
+
+   hash.initialize(HashData::SHA1);
+   hash.addData(reinterpret_cast<const uint8_t *>(data), uint32_t(len));
+   hash.wrapUp();
+   efree(data);
+
+   for(int i = 0; i < 5; i++)
+   {
+      if(hash.getDigestPart(i) != source.digest[i])
+         return false;
+   }
+
+   return true;
+}
+
+//=============================================================================
+//
+// Tree Output
+//
+
+static void E_writeString(OutBuffer &ob, const char *str)
+{
+   if(!str)
+   {
+      ob.writeUint32(EDFCACHE_NOSTR);
+      return;
+   }
+
+   uint32_t len = uint32_t(strlen(str));
+
+   ob.writeUint32(len);
+   ob.write(str, len);
+}
+
+static void E_writeSection(OutBuffer &ob, cfg_t *sec);
+
+//
+// E_writeValues
+//
+static void E_writeValues(OutBuffer &ob, cfg_opt_t *opt)
+{
+   for(unsigned int i = 0; i < opt->nvalues; i++)
+   {
+      cfg_value_t *val = opt->values[i];
+
+      switch(opt->type)
+      {
+      case CFGT_INT:
+      case CFGT_FLAG:
+         ob.writeSint32(val->number);
+         break;
+      case CFGT_FLOAT:
+         {
+            uint64_t bits;
+            memcpy(&bits, &val->fpnumber, sizeof(bits));
+            ob.writeUint64(bits);
+         }
+         break;
+      case CFGT_BOOL:
+         ob.writeUint8(val->boolean);
+         break;
+      case CFGT_STR:
+      case CFGT_STRFUNC:
+         E_writeString(ob, val->string);
+         break;
+      case CFGT_SEC:
+      case CFGT_MVPROP:
+         {
+            // A redefined section keeps the definitions it displaced. They
+            // are written oldest first, so that reading them back through
+            // cfg_setopt rebuilds the same chain.
+            PODCollection<cfg_t *> chain;
+
+            for(cfg_t *sec = val->section; sec; sec = sec->displaced)
+               chain.add(sec);
+
+            ob.writeUint32(uint32_t(chain.getLength()));
+            for(size_t j = chain.getLength(); j-- > 0; )
+            {
+               E_writeString(ob, chain[j]->title);
+               ob.writeSint32(chain[j]->line);
+               E_writeSection(ob, chain[j]);
+            }
+         }
+         break;
+      default:
+         break;
+      }
+   }
+}
+
+//
+// E_writeSection
+//
+// Options are written by index; the option table layout is part of the
+// cache key.
+//
+static void E_writeSection(OutBuffer &ob, cfg_t *sec)
+{
+   for(int i = 0; sec->opts[i].name; i++)
+   {
+      cfg_opt_t *opt = &sec->opts[i];
+
+      if(!opt->nvalues || opt->type == CFGT_FUNC)
+         continue;
+
+      ob.writeUint16(uint16_t(i));
+      ob.writeUint32(opt->nvalues);
+      E_writeValues(ob, opt);
+   }
+
+   ob.writeUint16(0xffff);
+}
+
+//
+// E_EDFCacheSave
+//
+// Called by E_ProcessEDF after parsing. Writes the tree to a temporary file
+// which then replaces the old cache, so that a failed write can't leave a
+// truncated cache behind.
+//
+void E_EDFCacheSave(cfg_t *cfg, const E_Enable_s *enables)
+{
+   if(!edfcacherecording)
+      return;
+
+   edfcacherecording = false;
+
+   if(!edfcacheinvalid)
+   {
+      qstring   tmpfile(edfcachefile);
+      OutBuffer ob;
+      bool      ok = false;
+
+      tmpfile << ".tmp";
+
+      if(ob.createFile(tmpfile.constPtr(), 65536, OutBuffer::LENDIAN))
+      {
+         ob.setThrowing(true);
+
+         try
+         {
+            uint32_t numenables = 0;
+
+            ob.write(EDFCACHE_MAGIC, 8);
+            ob.writeUint32(EDFCACHE_VERSION);
+            for(uint32_t part : edfcachekey)
+               ob.writeUint32(part);
+
+            ob.writeUint32(uint32_t(edfcachesources.getLength()));
+            for(const edfcachesource_t &source : edfcachesources)
+            {
+               ob.writeSint32(source.lumpnum);
+               E_writeString(ob, source.name);
+               for(uint32_t part : source.digest)
+                  ob.writeUint32(part);
+            }
+
+            // enable values may be changed by the EDF itself
+            for(const E_Enable_s *enable = enables; enable->name; enable++)
+               ++numenables;
+            ob.writeUint32(numenables);
+            for(const E_Enable_s *enable = enables; enable->name; enable++)
+               ob.writeSint32(enable->enabled);
+
+            E_writeSection(ob, cfg);
+
+            ob.close();
+            ok = true;
+         }
+         catch(BufferedIOException)
+         {
+         }
+      }
+
+      if(ok)
+      {
+         remove(edfcachefile.constPtr());
+         ok = !rename(tmpfile.constPtr(), edfcachefile.constPtr());
+      }
+
+      if(!ok)
+      {
+         remove(tmpfile.constPtr());
+         printf("Warning: could not write EDF cache %s\n", edfcachefile.constPtr());
+      }
+   }
+
+   E_clearSources();
+}
+
+//=============================================================================
+//
+// Tree Input
+//
+
+//
+// E_readString
+//
+// Returns false on a read error. A null string is returned as nullptr.
+//
+static bool E_readString(InBuffer &ib, char *&str)
+{
+   uint32_t len;
+
+   str = nullptr;
+
+   if(!ib.readUint32(len))
+      return false;
+   if(len == EDFCACHE_NOSTR)
+      return true;
+   if(len > 0x1000000) // corrupt
+      return false;
+
+   str = emalloc(char *, len + 1);
+   if(ib.read(str, len) != len)
+   {
+      efree(str);
+      str = nullptr;
+      return false;
+   }
+   str[len] = '\0';
+
+   return true;
+}
+
+static bool E_readSection(InBuffer &ib, cfg_t *sec);
+
+//
+// E_readValues
+//
+static bool E_readValues(InBuffer &ib, cfg_t *sec, cfg_opt_t *opt,
+                         uint32_t nvalues)
+{
+   for(uint32_t i = 0; i < nvalues; i++)
+   {
+      switch(opt->type)
+      {
+      case CFGT_INT:
+      case CFGT_FLAG:
+         {
+            int32_t number;
+            if(!ib.readSint32(number))
+               return false;
+            cfg_addval(opt)->number = number;
+         }
+         break;
+      case CFGT_FLOAT:
+         {
+            uint64_t bits;
+            double   fpnumber;
+            if(!ib.readUint64(bits))
+               return false;
+            memcpy(&fpnumber, &bits, sizeof(fpnumber));
+            cfg_addval(opt)->fpnumber = fpnumber;
+         }
+         break;
+      case CFGT_BOOL:
+         {
+            uint8_t boolean;
+            if(!ib.readUint8(boolean))
+               return false;
+            cfg_addval(opt)->boolean = !!boolean;
+         }
+         break;
+      case CFGT_STR:
+      case CFGT_STRFUNC:
+         {
+            char *string;
+            if(!E_readString(ib, string))
+               return false;
+            cfg_addval(opt)->string = string;
+         }
+         break;
+      case CFGT_SEC:
+      case CFGT_MVPROP:
+         {
+            uint32_t chainlen;
+            if(!ib.readUint32(chainlen))
+               return false;
+
+            for(uint32_t j = 0; j < chainlen; j++)
+            {
+               cfg_value_t *val;
+               char        *title;
+               int32_t      line;
+
+               if(!E_readString(ib, title))
+                  return false;
+               if(!ib.readSint32(line) || (!title && (opt->flags & CFGF_TITLE)))
+               {
+                  if(title)
+                     efree(title);
+                  return false;
+               }
+
+               val = cfg_setopt(sec, opt, title);
+               if(title)
+                  efree(title);
+               if(!val)
+                  return false;
+
+               val->section->line = line;
+               if(!E_readSection(ib, val->section))
+                  return false;
+            }
+         }
+         break;
+      default:
+         return false;
+      }
+   }
+
+   return true;
+}
+
+//
+// E_readSection
+//
+static bool E_readSection(InBuffer &ib, cfg_t *sec)
+{
+   int numopts = 0;
+
+   while(sec->opts[numopts].name)
+      ++numopts;
+
+   while(1)
+   {
+      uint16_t index;
+      uint32_t nvalues;
+
+      if(!ib.readUint16(index))
+         return false;
+      if(index == 0xffff)
+         return true;
+      if(index >= numopts || !ib.readUint32(nvalues))
+         return false;
+
+      cfg_opt_t *opt = &sec->opts[index];
+
+      if(opt->simple_value || !E_readValues(ib, sec, opt, nvalues))
+         return false;
+   }
+}
+
+//
+// E_EDFCacheLoad
+//
+// Called by E_ProcessEDF in place of parsing. Returns true if the cached tree
+// was valid and has been read into cfg. On return of false, cfg is left
+// empty and the EDF must be parsed as usual; the cache will be rewritten
+// afterward.
+//
+bool E_EDFCacheLoad(cfg_t *cfg, E_Enable_s *enables)
+{
+   InBuffer ib;
+   char     magic[8];
+   uint32_t num;
+
+   PODCollection<HashData> includes;
+   PODCollection<int>      enablevalues;
+
+   if(!edfcacherecording)
+      return false;
+
+   if(!ib.openFile(edfcachefile.constPtr(), InBuffer::LENDIAN))
+      return false;
+
+   if(ib.read(magic, 8) != 8 || memcmp(magic, EDFCACHE_MAGIC, 8))
+      return false;
+   if(!ib.readUint32(num) || num != EDFCACHE_VERSION)
+      return false;
+
+   for(uint32_t part : edfcachekey)
+   {
+      if(!ib.readUint32(num) || num != part)
+         return false;
+   }
+
+   // check every data source the cached parse depended on
+   if(!ib.readUint32(num))
+      return false;
+   for(uint32_t i = 0; i < num; i++)
+   {
+      edfcachesource_t source;
+      int32_t          lumpnum;
+      HashData         hash;
+      bool             valid;
+
+      if(!ib.readSint32(lumpnum) || !E_readString(ib, source.name) ||
+         !source.name)
+      {
+         if(source.name)
+            efree(source.name);
+         return false;
+      }
+
+      source.lumpnum = lumpnum;
+      valid = true;
+      for(uint32_t &part : source.digest)
+         valid = valid && ib.readUint32(part);
+
+      valid = valid && E_checkSource(source, hash);
+      efree(source.name);
+
+      if(!valid)
+         return false;
+      if(lumpnum != EDFCACHE_MISSING)
+         includes.add(hash);
+   }
+
+   if(!ib.readUint32(num))
+      return false;
+   for(const E_Enable_s *enable = enables; enable->name; enable++)
+   {
+      int32_t value;
+
+      if(!num-- || !ib.readSint32(value))
+         return false;
+      enablevalues.add(value);
+   }
+   if(num)
+      return false;
+
+   cfg->filename = estrdup(edfcachefile.constPtr());
+
+   if(!E_readSection(ib, cfg))
+   {
+      for(int i = 0; cfg->opts[i].name; i++)
+         cfg_free_value(&cfg->opts[i]);
+      efree(cfg->filename);
+      cfg->filename = nullptr;
+      return false;
+   }
+
+   // the parse has been skipped; reproduce its side effects
+   for(size_t i = 0; i < enablevalues.getLength(); i++)
+      enables[i].enabled = enablevalues[i];
+   for(const HashData &hash : includes)
+      E_CheckIncludeHash(hash);
+
+   edfcacherecording = false;
+   E_clearSources();
+
+   return true;
+}
+
+// EOF
+
@@ -0,0 +1,51 @@
+// Emacs style mode select -*- C++ -*-
+//----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//----------------------------------------------------------------------------
+//
+// EDF Parse Cache
+//
+// Saves the parsed startup EDF tree to disk so that it needn't be parsed
+// again on the next launch with the same data.
+//
+//----------------------------------------------------------------------------
+
+#ifndef E_EDFCACHE_H__
+#define E_EDFCACHE_H__
+
+class  HashData;
+struct cfg_t;
+struct E_Enable_s;
+
+void E_EDFCacheBegin(cfg_t *cfg, const char *rootfile,
+                     const E_Enable_s *enables);
+bool E_EDFCacheLoad(cfg_t *cfg, E_Enable_s *enables);
+void E_EDFCacheSave(cfg_t *cfg, const E_Enable_s *enables);
+
+// dependency tracking, called while parsing
+void E_EDFCacheAddSource(const char *name, int lumpnum, const HashData &hash);
+void E_EDFCacheAddMissingFile(const char *filename);
+void E_EDFCacheInvalidate(const char *reason);
+
+#endif
+
+// EOF
+
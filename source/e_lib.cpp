@@ -34,6 +34,7 @@
 
 #include "e_lib.h"
 #include "e_edf.h"
+#include "e_edfcache.h"
 
 #include "autopalette.h"
 #include "d_dehtbl.h"
@@ -79,6 +80,34 @@ void E_ErrorCB(cfg_t *cfg, const char *fmt, va_list ap)
 
 static Collection<HashData> eincludes;
 
+//
+// E_CheckIncludeHash
+//
+// Compares a data source's SHA-1 hash against those of all other data sources
+// that have been included. Returns true if the data should be included, and
+// false otherwise (ie. there was a match).
+//
+bool E_CheckIncludeHash(const HashData &newHash)
+{
+   size_t numincludes = eincludes.getLength();
+
+   // compare against existing includes
+   for(size_t i = 0; i < numincludes; i++)
+   {
+      // found a match?
+      if(newHash == eincludes[i])
+      {
+         E_EDFLogPuts("\t\t\tDeclined, SHA-1 match detected.\n");
+         return false;
+      }
+   }
+
+   // this source has not been processed before, so add its hash to the list
+   eincludes.add(newHash);
+
+   return true;
+}
+
 //
 // E_CheckInclude
 //
@@ -86,10 +115,10 @@ static Collection<HashData> eincludes;
 // hash will be calculated and compared against the SHA-1 hashes of all other
 // data sources that have been sent into this function. Returns true if the
 // data should be included, and false otherwise (ie. there was a match).
+// If the source's name is given, it is recorded for the EDF cache.
 //
-bool E_CheckInclude(const char *data, size_t size)
+bool E_CheckInclude(const char *data, size_t size, const char *name, int lumpnum)
 {
-   size_t numincludes;
    char *digest;
    
    // calculate the SHA-1 hash of the data   
@@ -102,23 +131,10 @@ bool E_CheckInclude(const char *data, size_t size)
 
    efree(digest);
 
-   numincludes = eincludes.getLength();
-
-   // compare against existing includes
-   for(size_t i = 0; i < numincludes; i++)
-   {
-      // found a match?
-      if(newHash == eincludes[i])
-      {
-         E_EDFLogPuts("\t\t\tDeclined, SHA-1 match detected.\n");
-         return false;
-      }
-   }
-
-   // this source has not been processed before, so add its hash to the list
-   eincludes.add(newHash);
+   if(name)
+      E_EDFCacheAddSource(name, lumpnum, newHash);
 
-   return true;
+   return E_CheckIncludeHash(newHash);
 }
 
 //
@@ -147,7 +163,7 @@ static int E_OpenAndCheckInclude(cfg_t *cfg, const char *fn, int lumpnum)
    if((data = cfg_lexer_mustopen(cfg, fn, lumpnum, &len)))
    {
       // see if we already parsed this data source
-      if(E_CheckInclude(data, len))
+      if(E_CheckInclude(data, len, fn, lumpnum))
          code = cfg_lexer_include(cfg, data, fn, lumpnum);
       else
       {
@@ -257,7 +273,7 @@ static int E_findFileInclude(cfg_t *src, const char *name)
 //
 int E_CheckRoot(cfg_t *cfg, const char *data, int size)
 {
-   return !E_CheckInclude(data, (size_t)size);
+   return !E_CheckInclude(data, (size_t)size, cfg->filename, cfg->lumpnum);
 }
 
 //=============================================================================
@@ -494,7 +510,13 @@ int E_UserInclude(cfg_t *cfg, cfg_opt_t *opt, int argc, const char **argv)
 
    filename = E_BuildDefaultFn(argv[0]);
 
-   return !access(filename, R_OK) ? E_OpenAndCheckInclude(cfg, filename, -1) : 0;
+   if(access(filename, R_OK))
+   {
+      E_EDFCacheAddMissingFile(filename);
+      return 0;
+   }
+
+   return E_OpenAndCheckInclude(cfg, filename, -1);
 }
 
 //=============================================================================
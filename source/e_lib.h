@@ -31,6 +31,7 @@
 
 #include "doomtype.h"
 
+class  HashData;
 struct dehflags_t;
 struct dehflagset_t;
 
@@ -81,7 +82,9 @@ void E_CfgListToCommaString(cfg_t *sec, const char *optname, qstring &output);
 
 #endif
 
-bool E_CheckInclude(const char *data, size_t size);
+bool E_CheckIncludeHash(const HashData &newHash);
+bool E_CheckInclude(const char *data, size_t size, const char *name = nullptr,
+                    int lumpnum = -1);
 
 const char *E_BuildDefaultFn(const char *filename);
 
@@ -25,17 +25,21 @@
 //
 //----------------------------------------------------------------------------
 
+#include <atomic>
+
 #include "z_zone.h"
 
+#include "d_io.h" // strncasecmp
 #include "doomstat.h"
 #include "e_exdata.h"
-#include "e_hash.h"
 #include "e_lib.h"
 #include "e_mod.h"
 #include "e_sound.h"
 #include "e_ttypes.h"
 #include "e_udmf.h"
 #include "m_compare.h"
+#include "m_ctype.h"
+#include "m_threadpool.h"
 #include "p_scroll.h"
 #include "p_setup.h"
 #include "p_spec.h"
@@ -705,11 +709,10 @@ enum token_e
 struct keytoken_t
 {
    const char *string;
-   DLListItem<keytoken_t> link;
    token_e token;
 };
 
-#define TOKEN(a) { #a, DLListItem<keytoken_t>(), t_##a }
+#define TOKEN(a) { #a, t_##a }
 
 static keytoken_t gTokenList[] =
 {
@@ -855,18 +858,87 @@ static keytoken_t gTokenList[] =
    TOKEN(zoneboundary),
 };
 
-static EHashTable<keytoken_t, ENCStringHashKey, &keytoken_t::string, &keytoken_t::link> gTokenTable;
+//
+// Keys are looked up through a perfect hash: the first time a TEXTMAP is
+// parsed, a seed is searched for which gives every key a slot of its own, so
+// that a lookup is one hash and one string comparison.
+//
+#define KEYHASH_SIZE 2048
+
+static_assert(earrlen(gTokenList) < 256, "UDMF key slots hold one byte");
+
+static unsigned char gKeySlots[KEYHASH_SIZE]; // key index + 1, or 0 if empty
+static uint32_t      gKeySeed;
+
+//
+// UDMF_keyHash
+//
+// Keys are case-insensitive, so letters are hashed as lowercase. Other
+// characters may collide with one another as a result, which the comparison
+// after the lookup catches.
+//
+static uint32_t UDMF_keyHash(const char *str, size_t length, uint32_t seed)
+{
+   uint32_t hash = 2166136261u ^ (seed * 0x9E3779B9u);
+
+   for(size_t i = 0; i < length; i++)
+   {
+      hash ^= static_cast<unsigned char>(str[i]) | 0x20;
+      hash *= 16777619u;
+   }
+
+   return (hash ^ (hash >> 15)) & (KEYHASH_SIZE - 1);
+}
 
 static void registerAllKeys()
 {
    static bool called = false;
    if(called)
       return;
-   for(size_t i = 0; i < earrlen(gTokenList); ++i)
-      gTokenTable.addObject(gTokenList[i]);
+
+   for(uint32_t seed = 1; ; seed++)
+   {
+      size_t i;
+
+      memset(gKeySlots, 0, sizeof(gKeySlots));
+      for(i = 0; i < earrlen(gTokenList); ++i)
+      {
+         const char *key = gTokenList[i].string;
+         unsigned char &slot = gKeySlots[UDMF_keyHash(key, strlen(key), seed)];
+
+         if(slot)
+            break;
+         slot = static_cast<unsigned char>(i + 1);
+      }
+
+      if(i == earrlen(gTokenList))
+      {
+         gKeySeed = seed;
+         break;
+      }
+   }
+
    called = true;
 }
 
+//
+// UDMF_findKey
+//
+static const keytoken_t *UDMF_findKey(const char *str, size_t length)
+{
+   unsigned char slot = gKeySlots[UDMF_keyHash(str, length, gKeySeed)];
+
+   if(!slot)
+      return nullptr;
+
+   const keytoken_t &kt = gTokenList[slot - 1];
+
+   if(strncasecmp(kt.string, str, length) || kt.string[length])
+      return nullptr;
+
+   return &kt;
+}
+
 //
 // Looks for "ee_compat = true;" in the TEXTMAP in order to accept unknown name-
 // spaces as Eternity-compatible. Useful to support arbitrary namespaces which
@@ -878,24 +950,23 @@ bool UDMFParser::checkForCompatibilityFlag(qstring nstext)
    // ano - read over the file looking for `ee_compat="true"`
    readresult_e result;
    bool eecompatfound = false;
-   // nstext needs to be copied, as contents of it gets overwritten before it's used.
-   qstring nstextcopy(nstext);
 
-   while((result = readItem()) != result_Eof)
+   while((result = mScanner.readItem()) != result_Eof)
    {
       if(result == result_Error)
       {
+         setError(mScanner);
          mError = "UDMF error while checking unsupported namespace '";
-         mError << nstextcopy;
+         mError << nstext;
          mError << "'";
          return false;
       }
 
       if(result == result_Assignment &&
-         !mInBlock &&
-         mKey.strCaseCmp("ee_compat") == 0 &&
-         mValue.type == Token::type_Keyword &&
-         ectype::toUpper(mValue.text[0]) == 'T')
+         !mScanner.inBlock &&
+         mScanner.key.textIs("ee_compat") &&
+         mScanner.value.type == Token::type_Keyword &&
+         ectype::toUpper(mScanner.value.text[0]) == 'T')
       {
          eecompatfound = true;
          break; // while ((result = readItem()) != result_Eof)
@@ -907,7 +978,7 @@ bool UDMFParser::checkForCompatibilityFlag(qstring nstext)
    if(!eecompatfound)
    {
       mError = "Unsupported namespace '";
-      mError << nstextcopy;
+      mError << nstext;
       mError << "'";
       return false;
    }
@@ -922,418 +993,664 @@ bool UDMFParser::checkForCompatibilityFlag(qstring nstext)
 //
 bool UDMFParser::parse(WadDirectory &setupwad, int lump)
 {
-   {
-      ZAutoBuffer buf;
-
-      setupwad.cacheLumpAuto(lump, buf);
-      auto data = buf.getAs<const char *>();
+   // read straight from the wad's mapping if it has one
+   const void *view = setupwad.getLumpView(lump);
 
-      // store it conveniently
-      setData(data, setupwad.lumpLength(lump));
+   if(view)
+      setData(static_cast<const char *>(view), setupwad.lumpLength(lump));
+   else
+   {
+      // otherwise cache it for as long as the parser lives
+      setupwad.cacheLumpAuto(lump, mDataBuf);
+      setData(mDataBuf.getAs<const char *>(), setupwad.lumpLength(lump));
    }
 
-   readresult_e result = readItem();
+   readresult_e result = mScanner.readItem();
    if(result == result_Error)
+   {
+      setError(mScanner);
       return false;
-   if(result != result_Assignment || mKey.strCaseCmp("namespace") ||
-      mValue.type != Token::type_String)
+   }
+   if(result != result_Assignment || !mScanner.key.textIs("namespace") ||
+      mScanner.value.type != Token::type_String)
    {
+      setError(mScanner);
       mError = "TEXTMAP must begin with a namespace assignment";
       return false;
    }
 
    // Set namespace
-   if(!mValue.text.strCaseCmp("eternity"))
+   const Token &ns = mScanner.value;
+   if(ns.textIs("eternity"))
       mNamespace = namespace_Eternity;
-   else if(!mValue.text.strCaseCmp("heretic"))
+   else if(ns.textIs("heretic"))
       mNamespace = namespace_Heretic;
-   else if(!mValue.text.strCaseCmp("hexen"))
+   else if(ns.textIs("hexen"))
       mNamespace = namespace_Hexen;
-   else if(!mValue.text.strCaseCmp("strife"))
+   else if(ns.textIs("strife"))
       mNamespace = namespace_Strife;
-   else if(!mValue.text.strCaseCmp("doom"))
+   else if(ns.textIs("doom"))
       mNamespace = namespace_Doom;
-   else if(!checkForCompatibilityFlag(mValue.text))
-      return false;
-
-   // Gamestuff. Must be null when out of block and only one be set when in
-   // block
-   ULinedef *linedef = nullptr;
-   USidedef *sidedef = nullptr;
-   uvertex_t *vertex = nullptr;
-   USector *sector = nullptr;
-   uthing_t *thing = nullptr;
+   else
+   {
+      qstring nstext;
+      ns.getText(nstext);
+      if(!checkForCompatibilityFlag(nstext))
+         return false;
+   }
 
    registerAllKeys();   // now it's the time
 
-   while((result = readItem()) != result_Eof)
+   return findBlocks() && decodeBlocks();
+}
+
+//
+// First pass over the TEXTMAP. Finds where each top-level block starts and
+// ends without reading what is in it, and makes an object for each block of
+// a known kind, so that the blocks can then be decoded in any order.
+//
+bool UDMFParser::findBlocks()
+{
+   readresult_e result;
+   int counts[block_Unknown] = { 0 };
+
+   while((result = mScanner.readItem()) != result_Eof)
    {
       if(result == result_Error)
+      {
+         setError(mScanner);
          return false;
-      if(result == result_BlockEntry)
+      }
+      if(result != result_BlockEntry)
+         continue;   // top-level assignments besides the namespace are ignored
+
+      blockspan_t &block = mBlocks.addNew();
+      const Token &name = mScanner.key;
+
+      if(name.textIs("linedef"))
+         block.kind = block_Linedef;
+      else if(name.textIs("sidedef"))
+         block.kind = block_Sidedef;
+      else if(name.textIs("vertex"))
+         block.kind = block_Vertex;
+      else if(name.textIs("sector"))
+         block.kind = block_Sector;
+      else if(name.textIs("thing"))
+         block.kind = block_Thing;
+      else
+         block.kind = block_Unknown;
+
+      block.start     = mScanner.pos;
+      block.line      = mScanner.line;
+      block.linestart = mScanner.linestart;
+      block.index     = block.kind < block_Unknown ? counts[block.kind]++ : -1;
+
+      if(!mScanner.skipBlock())
       {
-         // we're now in some block. Alloc stuff
-         if(!mBlockName.strCaseCmp("linedef"))
-         {
-            linedef = &mLinedefs.addNew();
-            linedef->errorline = mLine;
-            linedef->renderstyle = RENDERSTYLE_translucent;
-         }
-         else if(!mBlockName.strCaseCmp("sidedef"))
-         {
-            sidedef = &mSidedefs.addNew();
-            sidedef->texturetop = "-";
-            sidedef->texturebottom = "-";
-            sidedef->texturemiddle = "-";
-            sidedef->errorline = mLine;
-         }
-         else if(!mBlockName.strCaseCmp("vertex"))
-            vertex = &mVertices.addNew();
-         else if(!mBlockName.strCaseCmp("sector"))
-            sector = &mSectors.addNew();
-         else if(!mBlockName.strCaseCmp("thing"))
+         setError(mScanner);
+         return false;
+      }
+
+      if(mScanner.pos < mScanner.end)
+         mScanner.pos++;   // the '}'
+      block.end = mScanner.pos;
+      mScanner.inBlock = false;
+   }
+
+   // Make every object up front, with the defaults the format asks for
+   int i;
+
+   for(i = 0; i < counts[block_Linedef]; i++)
+   {
+      ULinedef &linedef = mLinedefs.addNew();
+      linedef.renderstyle = RENDERSTYLE_translucent;
+   }
+   for(i = 0; i < counts[block_Sidedef]; i++)
+   {
+      USidedef &sidedef = mSidedefs.addNew();
+      sidedef.texturetop = "-";
+      sidedef.texturebottom = "-";
+      sidedef.texturemiddle = "-";
+   }
+   mVertices.resize(counts[block_Vertex]);
+   for(i = 0; i < counts[block_Sector]; i++)
+      mSectors.addNew();
+   for(i = 0; i < counts[block_Thing]; i++)
+      mThings.addNew().health = 1.0;
+
+   for(const blockspan_t &block : mBlocks)
+   {
+      if(block.kind == block_Linedef)
+         mLinedefs[block.index].errorline = block.line;
+      else if(block.kind == block_Sidedef)
+         mSidedefs[block.index].errorline = block.line;
+   }
+
+   return true;
+}
+
+// Blocks decoded in a row by one thread
+#define DECODE_BATCH 256
+
+// Maps with fewer blocks than this aren't worth threading
+#define DECODE_THREADED 4096
+
+#define DECODE_MAXTHREADS 8
+
+struct udmfdecodejob_t
+{
+   UDMFParser       *parser;
+   std::atomic<int>  nextblock;
+   std::atomic<int>  errorblock;  // lowest block found to be in error
+
+   struct
+   {
+      int block;
+      int line;
+      int column;
+      const char *message;
+   } errors[DECODE_MAXTHREADS];
+};
+
+static ThreadPool *decodepool;
+
+//
+// Thread job for decodeBlocks. Blocks are handed out in batches; each thread
+// keeps the first of its blocks found in error. Blocks past one already in
+// error are skipped, but never blocks before it, so the error reported is
+// always the first one in the lump.
+//
+void UDMFParser::DecodeJob(int threadnum, void *data)
+{
+   udmfdecodejob_t *job = static_cast<udmfdecodejob_t *>(data);
+   UDMFParser *parser = job->parser;
+   int numblocks = static_cast<int>(parser->mBlocks.getLength());
+   Scanner scanner;
+   int first;
+
+   job->errors[threadnum].block = INT_MAX;
+
+   while((first = job->nextblock.fetch_add(DECODE_BATCH)) < numblocks)
+   {
+      int last = emin(first + DECODE_BATCH, numblocks);
+
+      for(int i = first; i < last && i < job->errorblock.load(); i++)
+      {
+         if(parser->decodeBlock(scanner, parser->mBlocks[i]))
+            continue;
+
+         if(i < job->errors[threadnum].block)
          {
-            thing = &mThings.addNew();
-            thing->health = 1.0;
+            job->errors[threadnum].block   = i;
+            job->errors[threadnum].line    = scanner.line;
+            job->errors[threadnum].column  = scanner.column();
+            job->errors[threadnum].message = scanner.error;
          }
-         continue;
+
+         int lowest = job->errorblock.load();
+         while(i < lowest && !job->errorblock.compare_exchange_weak(lowest, i))
+            ;
+         break;
       }
-      if(result == result_Assignment && mInBlock)
+   }
+}
+
+//
+// Second pass over the TEXTMAP: reads the contents of every block found by
+// the first pass. Blocks are independent of each other, so on large maps they
+// are shared out between threads.
+//
+bool UDMFParser::decodeBlocks()
+{
+   udmfdecodejob_t job;
+   int numthreads = 1;
+
+   job.parser = this;
+   job.nextblock = 0;
+   job.errorblock = INT_MAX;
+
+   if(mBlocks.getLength() >= DECODE_THREADED)
+   {
+      if(!decodepool)
       {
+         decodepool = new ThreadPool();
+         decodepool->resize(emin(ThreadPool::HardwareThreads(),
+                                 DECODE_MAXTHREADS));
+      }
+      numthreads = decodepool->getNumThreads();
+   }
 
-#define REQUIRE_INT(obj, field, flag) case t_##field: requireInt(obj->field, obj->flag); break
-#define READ_NUMBER(obj, field) case t_##field: readNumber(obj->field); break
-#define READ_BOOL(obj, field) case t_##field: readBool(obj->field); break
-#define READ_STRING(obj, field) case t_##field: readString(obj->field); break
-#define READ_FIXED(obj, field) case t_##field: readFixed(obj->field); break
-#define REQUIRE_FIXED(obj, field, flag) case t_##field: requireFixed(obj->field, obj->flag); break
+   if(numthreads > 1)
+   {
+      // strings longer than a qstring holds inline go to the heap
+      Z_SetLocking(true);
+      decodepool->run(DecodeJob, &job);
+      Z_SetLocking(false);
+   }
+   else
+      DecodeJob(0, &job);
 
-         const keytoken_t *kt = gTokenTable.objectForKey(mKey.constPtr());
-         if(kt)
-         {
-            if(linedef)
-            {
-               switch(kt->token)
-               {
-                  case t_id: readNumber(linedef->identifier); break;
-                  REQUIRE_INT(linedef, v1, v1set);
-                  REQUIRE_INT(linedef, v2, v2set);
-                  REQUIRE_INT(linedef, sidefront, sfrontset);
-                  READ_NUMBER(linedef, sideback);
-                  READ_BOOL(linedef, blocking);
-                  READ_BOOL(linedef, blockmonsters);
-                  READ_BOOL(linedef, twosided);
-                  READ_BOOL(linedef, dontpegtop);
-                  READ_BOOL(linedef, dontpegbottom);
-                  READ_BOOL(linedef, secret);
-                  READ_BOOL(linedef, blocksound);
-                  READ_BOOL(linedef, dontdraw);
-                  READ_BOOL(linedef, mapped);
-                  case t_passuse:
-                        readBool(linedef->passuse);
-                     break;
-                  case t_translucent:
-                        readBool(linedef->translucent);
-                     break;
-                  case t_jumpover:
-                        readBool(linedef->jumpover);
-                     break;
-                  case t_blockfloaters:
-                        readBool(linedef->blockfloaters);
-                     break;
-                  READ_NUMBER(linedef, special);
-                  case t_arg0: readNumber(linedef->arg[0]); break;
-                  case t_arg1: readNumber(linedef->arg[1]); break;
-                  case t_arg2: readNumber(linedef->arg[2]); break;
-                  case t_arg3: readNumber(linedef->arg[3]); break;
-                  case t_arg4: readNumber(linedef->arg[4]); break;
-                  READ_BOOL(linedef, playercross);
-                  READ_BOOL(linedef, playeruse);
-                  READ_BOOL(linedef, monstercross);
-                  READ_BOOL(linedef, monsteruse);
-                  READ_BOOL(linedef, impact);
-                  READ_BOOL(linedef, monstershoot);
-                  READ_BOOL(linedef, playerpush);
-                  READ_BOOL(linedef, monsterpush);
-                  READ_BOOL(linedef, missilecross);
-                  READ_BOOL(linedef, repeatspecial);
-                  READ_BOOL(linedef, polycross);
-
-                  READ_BOOL(linedef, midtex3d);
-                  READ_BOOL(linedef, midtex3dimpassible);
-                  READ_BOOL(linedef, firstsideonly);
-                  READ_BOOL(linedef, blockeverything);
-                  READ_BOOL(linedef, zoneboundary);
-                  READ_BOOL(linedef, clipmidtex);
-                  READ_BOOL(linedef, lowerportal);
-                  READ_BOOL(linedef, upperportal);
-                  READ_NUMBER(linedef, portal);
-                  READ_NUMBER(linedef, alpha);
-                  READ_STRING(linedef, renderstyle);
-                  READ_STRING(linedef, tranmap);
-                  default:
-                     break;
-               }
+   int errorthread = -1;
+   for(int i = 0; i < numthreads; i++)
+   {
+      if(job.errors[i].block != INT_MAX &&
+         (errorthread < 0 || job.errors[i].block < job.errors[errorthread].block))
+         errorthread = i;
+   }
 
-            }
-            else if(sidedef)
-            {
-               switch(kt->token)
-               {
-                  case t_offsetx:
-                     if(mNamespace == namespace_Eternity)
-                        readFixed(sidedef->offsetx);
-                     else
-                        readNumber(sidedef->offsetx);
-                     break;
-                  case t_offsety:
-                     if(mNamespace == namespace_Eternity)
-                        readFixed(sidedef->offsety);
-                     else
-                        readNumber(sidedef->offsety);
-                     break;
-                  READ_STRING(sidedef, texturetop);
-                  READ_STRING(sidedef, texturebottom);
-                  READ_STRING(sidedef, texturemiddle);
-                  REQUIRE_INT(sidedef, sector, sset);
-                  default:
-                     break;
-               }
-            }
-            else if(vertex)
-            {
-               if(kt->token == t_x)
-                  requireFixed(vertex->x, vertex->xset);
-               else if(kt->token == t_y)
-                  requireFixed(vertex->y, vertex->yset);
-            }
-            else if(sector)
-            {
-               switch(kt->token)
-               {
-                  case t_texturefloor:
-                     requireString(sector->texturefloor, sector->tfloorset);
-                     break;
-                  case t_textureceiling:
-                     requireString(sector->textureceiling, sector->tceilset);
-                     break;
-                  READ_NUMBER(sector, lightlevel);
-                  READ_NUMBER(sector, special);
-                  case t_id:
-                     readNumber(sector->identifier);
-                     break;
-                  case t_heightfloor:
-                     if(mNamespace != namespace_Eternity)
-                        readNumber(sector->heightfloor);
-                     else
-                        readFixed(sector->heightfloor);
-                     break;
-                  case t_heightceiling:
-                     if(mNamespace != namespace_Eternity)
-                        readNumber(sector->heightceiling);
-                     else
-                        readFixed(sector->heightceiling);
-                  default:
-                     break;
-               }
-               if(mNamespace == namespace_Eternity)
-               {
-                  switch(kt->token)
-                  {
-                     READ_FIXED(sector, xpanningfloor);
-                     READ_FIXED(sector, ypanningfloor);
-                     READ_FIXED(sector, xpanningceiling);
-                     READ_FIXED(sector, ypanningceiling);
-                     READ_NUMBER(sector, xscaleceiling);
-                     READ_NUMBER(sector, xscalefloor);
-                     READ_NUMBER(sector, yscaleceiling);
-                     READ_NUMBER(sector, yscalefloor);
-                     READ_NUMBER(sector, rotationfloor);
-                     READ_NUMBER(sector, rotationceiling);
-
-                     READ_NUMBER(sector, scroll_ceil_x);
-                     READ_NUMBER(sector, scroll_ceil_y);
-                     READ_STRING(sector, scroll_ceil_type);
-
-                     READ_NUMBER(sector, scroll_floor_x);
-                     READ_NUMBER(sector, scroll_floor_y);
-                     READ_STRING(sector, scroll_floor_type);
-
-                     READ_BOOL(sector, secret);
-                     READ_NUMBER(sector, friction);
-
-                     READ_NUMBER(sector, lightfloor);
-                     READ_NUMBER(sector, lightceiling);
-                     READ_BOOL(sector, lightfloorabsolute);
-                     READ_BOOL(sector, lightceilingabsolute);
-                     READ_BOOL(sector, phasedlight);
-                     READ_BOOL(sector, lightsequence);
-                     READ_BOOL(sector, lightseqalt);
-
-                     READ_STRING(sector, colormaptop);
-                     READ_STRING(sector, colormapmid);
-                     READ_STRING(sector, colormapbottom);
-
-                     READ_NUMBER(sector, leakiness);
-                     READ_NUMBER(sector, damageamount);
-                     READ_NUMBER(sector, damageinterval);
-                     READ_BOOL(sector, damage_endgodmode);
-                     READ_BOOL(sector, damage_exitlevel);
-                     READ_BOOL(sector, damageterraineffect);
-                     READ_STRING(sector, damagetype);
-
-                     READ_STRING(sector, floorterrain);
-                     READ_STRING(sector, ceilingterrain);
-
-                     READ_NUMBER(sector, floorid);
-                     READ_NUMBER(sector, ceilingid);
-                     READ_NUMBER(sector, attachfloor);
-                     READ_NUMBER(sector, attachceiling);
-
-                     READ_STRING(sector, soundsequence);
-
-                     READ_STRING(sector, portal_floor_overlaytype);
-                     READ_NUMBER(sector, alphafloor);
-                     READ_BOOL(sector, portal_floor_blocksound);
-                     READ_BOOL(sector, portal_floor_disabled);
-                     READ_BOOL(sector, portal_floor_nopass);
-                     READ_BOOL(sector, portal_floor_norender);
-                     READ_BOOL(sector, portal_floor_useglobaltex);
-                     READ_BOOL(sector, portal_floor_attached);
-
-                     READ_STRING(sector, portal_ceil_overlaytype);
-                     READ_NUMBER(sector, alphaceiling);
-                     READ_BOOL(sector, portal_ceil_blocksound);
-                     READ_BOOL(sector, portal_ceil_disabled);
-                     READ_BOOL(sector, portal_ceil_nopass);
-                     READ_BOOL(sector, portal_ceil_norender);
-                     READ_BOOL(sector, portal_ceil_useglobaltex);
-                     READ_BOOL(sector, portal_ceil_attached);
-
-                     READ_NUMBER(sector, portalceiling);
-                     READ_NUMBER(sector, portalfloor);
-                     default:
-                        break;
-                  }
-               }
-            }
-            else if(thing)
-            {
-               switch(kt->token)
-               {
-                  case t_id: readNumber(thing->identifier); break;
-                  REQUIRE_FIXED(thing, x, xset);
-                  REQUIRE_FIXED(thing, y, yset);
-                  READ_FIXED(thing, height);
-                  READ_NUMBER(thing, angle);
-                  REQUIRE_INT(thing, type, typeset);
-                  READ_BOOL(thing, skill1);
-                  READ_BOOL(thing, skill2);
-                  READ_BOOL(thing, skill3);
-                  READ_BOOL(thing, skill4);
-                  READ_BOOL(thing, skill5);
-                  READ_BOOL(thing, ambush);
-                  READ_BOOL(thing, single);
-                  READ_BOOL(thing, dm);
-                  READ_BOOL(thing, coop);
-                  case t_friend:
-                        readBool(thing->friendly);
-                     break;
-                  READ_BOOL(thing, dormant);
-                  READ_BOOL(thing, class1);
-                  READ_BOOL(thing, class2);
-                  READ_BOOL(thing, class3);
-                  READ_BOOL(thing, standing);
-                  READ_BOOL(thing, strifeally);
-                  READ_BOOL(thing, translucent);
-                  READ_BOOL(thing, invisible);
-                  case t_special:
-                        readNumber(thing->special);
-                     break;
-                  case t_arg0:
-                        readNumber(thing->arg[0]);
-                     break;
-                  case t_arg1:
-                        readNumber(thing->arg[1]);
-                     break;
-                  case t_arg2:
-                        readNumber(thing->arg[2]);
-                     break;
-                  case t_arg3:
-                        readNumber(thing->arg[3]);
-                     break;
-                  case t_arg4:
-                        readNumber(thing->arg[4]);
-                     break;
-                  default:
-                     break;
-               }
-               if(mNamespace == namespace_Eternity)
-               {
-                  switch(kt->token)
-                  {
-                     READ_NUMBER(thing, health);
-                     default:
-                        break;
-                  }
-               }
-            }
-         }
+   if(errorthread >= 0)
+   {
+      mLine   = job.errors[errorthread].line;
+      mColumn = job.errors[errorthread].column;
+      mError  = job.errors[errorthread].message;
+      return false;
+   }
+
+   return true;
+}
+
+//
+// Reads one block's assignments into its object. Returns false on error,
+// with the scanner left where it happened.
+//
+bool UDMFParser::decodeBlock(Scanner &sc, const blockspan_t &block)
+{
+   readresult_e result;
+
+   sc.set(mData, block.start, block.end, block.line,
+          block.linestart);
+   sc.inBlock = true;
+
+   while((result = sc.readItem()) == result_Assignment)
+   {
+      const keytoken_t *kt = UDMF_findKey(sc.key.text, sc.key.length);
+      if(!kt)
          continue;
+
+      switch(block.kind)
+      {
+      case block_Linedef:
+         assignLinedef(sc, kt->token, &mLinedefs[block.index]);
+         break;
+      case block_Sidedef:
+         assignSidedef(sc, kt->token, &mSidedefs[block.index]);
+         break;
+      case block_Vertex:
+         assignVertex(sc, kt->token, &mVertices[block.index]);
+         break;
+      case block_Sector:
+         assignSector(sc, kt->token, &mSectors[block.index]);
+         break;
+      case block_Thing:
+         assignThing(sc, kt->token, &mThings[block.index]);
+         break;
+      default:
+         break;
       }
-      if(result == result_BlockExit)
+   }
+
+   if(result == result_Error)
+      return false;
+
+   // a block cut off by the end of the lump has never been checked
+   if(result == result_Eof)
+      return true;
+
+   // the block has been read; check that it has what it must
+   switch(block.kind)
+   {
+   case block_Linedef:
       {
-         if(linedef)
-         {
-            if(!linedef->v1set || !linedef->v2set || !linedef->sfrontset)
-            {
-               mError = "Incompletely defined linedef";
-               return false;
-            }
-            linedef = nullptr;
-         }
-         else if(sidedef)
+         const ULinedef &linedef = mLinedefs[block.index];
+         if(!linedef.v1set || !linedef.v2set || !linedef.sfrontset)
          {
-            if(!sidedef->sset)
-            {
-               mError = "Incompletely defined sidedef";
-               return false;
-            }
-            sidedef = nullptr;
+            sc.error = "Incompletely defined linedef";
+            return false;
          }
-         else if(vertex)
+      }
+      break;
+   case block_Sidedef:
+      if(!mSidedefs[block.index].sset)
+      {
+         sc.error = "Incompletely defined sidedef";
+         return false;
+      }
+      break;
+   case block_Vertex:
+      {
+         const uvertex_t &vertex = mVertices[block.index];
+         if(!vertex.xset || !vertex.yset)
          {
-            if(!vertex->xset || !vertex->yset)
-            {
-               mError = "Incompletely defined vertex";
-               return false;
-            }
-            vertex = nullptr;
+            sc.error = "Incompletely defined vertex";
+            return false;
          }
-         else if(sector)
+      }
+      break;
+   case block_Sector:
+      {
+         const USector &sector = mSectors[block.index];
+         if(!sector.tfloorset || !sector.tceilset)
          {
-            if(!sector->tfloorset || !sector->tceilset)
-            {
-               mError = "Incompletely defined sector";
-               return false;
-            }
-            sector = nullptr;
+            sc.error = "Incompletely defined sector";
+            return false;
          }
-         else if(thing)
+      }
+      break;
+   case block_Thing:
+      {
+         const uthing_t &thing = mThings[block.index];
+         if(!thing.xset || !thing.yset || !thing.typeset)
          {
-            if(!thing->xset || !thing->yset || !thing->typeset)
-            {
-               mError = "Incompletely defined thing";
-               return false;
-            }
-            thing = nullptr;
+            sc.error = "Incompletely defined thing";
+            return false;
          }
       }
+      break;
+   default:
+      break;
    }
 
    return true;
 }
 
+#define REQUIRE_INT(obj, field, flag) case t_##field: sc.requireInt(obj->field, obj->flag); break
+#define READ_NUMBER(obj, field) case t_##field: sc.readNumber(obj->field); break
+#define READ_BOOL(obj, field) case t_##field: sc.readBool(obj->field); break
+#define READ_STRING(obj, field) case t_##field: sc.readString(obj->field); break
+#define READ_FIXED(obj, field) case t_##field: sc.readFixed(obj->field); break
+#define REQUIRE_FIXED(obj, field, flag) case t_##field: sc.requireFixed(obj->field, obj->flag); break
+
+//
+// Linedef fields
+//
+void UDMFParser::assignLinedef(const Scanner &sc, int token,
+                               ULinedef *linedef) const
+{
+   switch(token)
+   {
+      case t_id: sc.readNumber(linedef->identifier); break;
+      REQUIRE_INT(linedef, v1, v1set);
+      REQUIRE_INT(linedef, v2, v2set);
+      REQUIRE_INT(linedef, sidefront, sfrontset);
+      READ_NUMBER(linedef, sideback);
+      READ_BOOL(linedef, blocking);
+      READ_BOOL(linedef, blockmonsters);
+      READ_BOOL(linedef, twosided);
+      READ_BOOL(linedef, dontpegtop);
+      READ_BOOL(linedef, dontpegbottom);
+      READ_BOOL(linedef, secret);
+      READ_BOOL(linedef, blocksound);
+      READ_BOOL(linedef, dontdraw);
+      READ_BOOL(linedef, mapped);
+      case t_passuse:
+            sc.readBool(linedef->passuse);
+         break;
+      case t_translucent:
+            sc.readBool(linedef->translucent);
+         break;
+      case t_jumpover:
+            sc.readBool(linedef->jumpover);
+         break;
+      case t_blockfloaters:
+            sc.readBool(linedef->blockfloaters);
+         break;
+      READ_NUMBER(linedef, special);
+      case t_arg0: sc.readNumber(linedef->arg[0]); break;
+      case t_arg1: sc.readNumber(linedef->arg[1]); break;
+      case t_arg2: sc.readNumber(linedef->arg[2]); break;
+      case t_arg3: sc.readNumber(linedef->arg[3]); break;
+      case t_arg4: sc.readNumber(linedef->arg[4]); break;
+      READ_BOOL(linedef, playercross);
+      READ_BOOL(linedef, playeruse);
+      READ_BOOL(linedef, monstercross);
+      READ_BOOL(linedef, monsteruse);
+      READ_BOOL(linedef, impact);
+      READ_BOOL(linedef, monstershoot);
+      READ_BOOL(linedef, playerpush);
+      READ_BOOL(linedef, monsterpush);
+      READ_BOOL(linedef, missilecross);
+      READ_BOOL(linedef, repeatspecial);
+      READ_BOOL(linedef, polycross);
+
+      READ_BOOL(linedef, midtex3d);
+      READ_BOOL(linedef, midtex3dimpassible);
+      READ_BOOL(linedef, firstsideonly);
+      READ_BOOL(linedef, blockeverything);
+      READ_BOOL(linedef, zoneboundary);
+      READ_BOOL(linedef, clipmidtex);
+      READ_BOOL(linedef, lowerportal);
+      READ_BOOL(linedef, upperportal);
+      READ_NUMBER(linedef, portal);
+      READ_NUMBER(linedef, alpha);
+      READ_STRING(linedef, renderstyle);
+      READ_STRING(linedef, tranmap);
+      default:
+         break;
+   }
+}
+
+//
+// Sidedef fields
+//
+void UDMFParser::assignSidedef(const Scanner &sc, int token,
+                               USidedef *sidedef) const
+{
+   switch(token)
+   {
+      case t_offsetx:
+         if(mNamespace == namespace_Eternity)
+            sc.readFixed(sidedef->offsetx);
+         else
+            sc.readNumber(sidedef->offsetx);
+         break;
+      case t_offsety:
+         if(mNamespace == namespace_Eternity)
+            sc.readFixed(sidedef->offsety);
+         else
+            sc.readNumber(sidedef->offsety);
+         break;
+      READ_STRING(sidedef, texturetop);
+      READ_STRING(sidedef, texturebottom);
+      READ_STRING(sidedef, texturemiddle);
+      REQUIRE_INT(sidedef, sector, sset);
+      default:
+         break;
+   }
+}
+
+//
+// Vertex fields
+//
+void UDMFParser::assignVertex(const Scanner &sc, int token,
+                              uvertex_t *vertex) const
+{
+   if(token == t_x)
+      sc.requireFixed(vertex->x, vertex->xset);
+   else if(token == t_y)
+      sc.requireFixed(vertex->y, vertex->yset);
+}
+
+//
+// Sector fields
+//
+void UDMFParser::assignSector(const Scanner &sc, int token,
+                              USector *sector) const
+{
+   switch(token)
+   {
+      case t_texturefloor:
+         sc.requireString(sector->texturefloor, sector->tfloorset);
+         break;
+      case t_textureceiling:
+         sc.requireString(sector->textureceiling, sector->tceilset);
+         break;
+      READ_NUMBER(sector, lightlevel);
+      READ_NUMBER(sector, special);
+      case t_id:
+         sc.readNumber(sector->identifier);
+         break;
+      case t_heightfloor:
+         if(mNamespace != namespace_Eternity)
+            sc.readNumber(sector->heightfloor);
+         else
+            sc.readFixed(sector->heightfloor);
+         break;
+      case t_heightceiling:
+         if(mNamespace != namespace_Eternity)
+            sc.readNumber(sector->heightceiling);
+         else
+            sc.readFixed(sector->heightceiling);
+      default:
+         break;
+   }
+   if(mNamespace == namespace_Eternity)
+   {
+      switch(token)
+      {
+         READ_FIXED(sector, xpanningfloor);
+         READ_FIXED(sector, ypanningfloor);
+         READ_FIXED(sector, xpanningceiling);
+         READ_FIXED(sector, ypanningceiling);
+         READ_NUMBER(sector, xscaleceiling);
+         READ_NUMBER(sector, xscalefloor);
+         READ_NUMBER(sector, yscaleceiling);
+         READ_NUMBER(sector, yscalefloor);
+         READ_NUMBER(sector, rotationfloor);
+         READ_NUMBER(sector, rotationceiling);
+
+         READ_NUMBER(sector, scroll_ceil_x);
+         READ_NUMBER(sector, scroll_ceil_y);
+         READ_STRING(sector, scroll_ceil_type);
+
+         READ_NUMBER(sector, scroll_floor_x);
+         READ_NUMBER(sector, scroll_floor_y);
+         READ_STRING(sector, scroll_floor_type);
+
+         READ_BOOL(sector, secret);
+         READ_NUMBER(sector, friction);
+
+         READ_NUMBER(sector, lightfloor);
+         READ_NUMBER(sector, lightceiling);
+         READ_BOOL(sector, lightfloorabsolute);
+         READ_BOOL(sector, lightceilingabsolute);
+         READ_BOOL(sector, phasedlight);
+         READ_BOOL(sector, lightsequence);
+         READ_BOOL(sector, lightseqalt);
+
+         READ_STRING(sector, colormaptop);
+         READ_STRING(sector, colormapmid);
+         READ_STRING(sector, colormapbottom);
+
+         READ_NUMBER(sector, leakiness);
+         READ_NUMBER(sector, damageamount);
+         READ_NUMBER(sector, damageinterval);
+         READ_BOOL(sector, damage_endgodmode);
+         READ_BOOL(sector, damage_exitlevel);
+         READ_BOOL(sector, damageterraineffect);
+         READ_STRING(sector, damagetype);
+
+         READ_STRING(sector, floorterrain);
+         READ_STRING(sector, ceilingterrain);
+
+         READ_NUMBER(sector, floorid);
+         READ_NUMBER(sector, ceilingid);
+         READ_NUMBER(sector, attachfloor);
+         READ_NUMBER(sector, attachceiling);
+
+         READ_STRING(sector, soundsequence);
+
+         READ_STRING(sector, portal_floor_overlaytype);
+         READ_NUMBER(sector, alphafloor);
+         READ_BOOL(sector, portal_floor_blocksound);
+         READ_BOOL(sector, portal_floor_disabled);
+         READ_BOOL(sector, portal_floor_nopass);
+         READ_BOOL(sector, portal_floor_norender);
+         READ_BOOL(sector, portal_floor_useglobaltex);
+         READ_BOOL(sector, portal_floor_attached);
+
+         READ_STRING(sector, portal_ceil_overlaytype);
+         READ_NUMBER(sector, alphaceiling);
+         READ_BOOL(sector, portal_ceil_blocksound);
+         READ_BOOL(sector, portal_ceil_disabled);
+         READ_BOOL(sector, portal_ceil_nopass);
+         READ_BOOL(sector, portal_ceil_norender);
+         READ_BOOL(sector, portal_ceil_useglobaltex);
+         READ_BOOL(sector, portal_ceil_attached);
+
+         READ_NUMBER(sector, portalceiling);
+         READ_NUMBER(sector, portalfloor);
+         default:
+            break;
+      }
+   }
+}
+
+//
+// Thing fields
+//
+void UDMFParser::assignThing(const Scanner &sc, int token,
+                             uthing_t *thing) const
+{
+   switch(token)
+   {
+      case t_id: sc.readNumber(thing->identifier); break;
+      REQUIRE_FIXED(thing, x, xset);
+      REQUIRE_FIXED(thing, y, yset);
+      READ_FIXED(thing, height);
+      READ_NUMBER(thing, angle);
+      REQUIRE_INT(thing, type, typeset);
+      READ_BOOL(thing, skill1);
+      READ_BOOL(thing, skill2);
+      READ_BOOL(thing, skill3);
+      READ_BOOL(thing, skill4);
+      READ_BOOL(thing, skill5);
+      READ_BOOL(thing, ambush);
+      READ_BOOL(thing, single);
+      READ_BOOL(thing, dm);
+      READ_BOOL(thing, coop);
+      case t_friend:
+            sc.readBool(thing->friendly);
+         break;
+      READ_BOOL(thing, dormant);
+      READ_BOOL(thing, class1);
+      READ_BOOL(thing, class2);
+      READ_BOOL(thing, class3);
+      READ_BOOL(thing, standing);
+      READ_BOOL(thing, strifeally);
+      READ_BOOL(thing, translucent);
+      READ_BOOL(thing, invisible);
+      case t_special:
+            sc.readNumber(thing->special);
+         break;
+      case t_arg0:
+            sc.readNumber(thing->arg[0]);
+         break;
+      case t_arg1:
+            sc.readNumber(thing->arg[1]);
+         break;
+      case t_arg2:
+            sc.readNumber(thing->arg[2]);
+         break;
+      case t_arg3:
+            sc.readNumber(thing->arg[3]);
+         break;
+      case t_arg4:
+            sc.readNumber(thing->arg[4]);
+         break;
+      default:
+         break;
+   }
+   if(mNamespace == namespace_Eternity)
+   {
+      switch(token)
+      {
+         READ_NUMBER(thing, health);
+         default:
+            break;
+      }
+   }
+}
+
 //
 // Quick error message
 //
@@ -1367,11 +1684,13 @@ int UDMFParser::getMapFormat() const
 }
 
 //
-// Loads a new TEXTMAP and clears all variables
+// Loads a new TEXTMAP and clears all variables. The data isn't copied: it must
+// outlive the parse. It doesn't need to be NUL-terminated.
 //
 void UDMFParser::setData(const char *data, size_t size)
 {
-   mData.copy(data, size);
+   mData = data;
+   mDataLength = size;
    reset();
 }
 
@@ -1380,15 +1699,11 @@ void UDMFParser::setData(const char *data, size_t size)
 //
 void UDMFParser::reset()
 {
-   mPos = 0;
+   mScanner.set(mData, 0, mDataLength, 1, 0);
    mLine = 1;
    mColumn = 1;
    mError.clear();
-
-   mKey.clear();
-   mValue.clear();
-   mInBlock = false;
-   mBlockName.clear();
+   mBlocks.makeEmpty();
 
    // Game stuff
    mNamespace = namespace_Doom;  // default to Doom
@@ -1399,24 +1714,59 @@ void UDMFParser::reset()
    mThings.makeEmpty();
 }
 
+//
+// Takes the error and its place from a scanner
+//
+void UDMFParser::setError(const Scanner &scanner)
+{
+   mLine = scanner.line;
+   mColumn = scanner.column();
+   mError = scanner.error;
+}
+
+//
+// Compares a token's text to a string, ignoring case
+//
+bool UDMFParser::Token::textIs(const char *str) const
+{
+   return !strncasecmp(text, str, length) && !str[length];
+}
+
+//
+// Points the scanner at a stretch of the TEXTMAP
+//
+void UDMFParser::Scanner::set(const char *pData, size_t start, size_t pEnd,
+                              int pLine, size_t pLinestart)
+{
+   data = pData;
+   pos = start;
+   end = pEnd;
+   line = pLine;
+   linestart = pLinestart;
+   error = "";
+   key.clear();
+   value.clear();
+   inBlock = false;
+}
+
 //
 // Passes a fixed_t
 //
-void UDMFParser::readFixed(fixed_t &target) const
+void UDMFParser::Scanner::readFixed(fixed_t &target) const
 {
-   if(mValue.type == Token::type_Number)
-      target = M_DoubleToFixed(mValue.number);
+   if(value.type == Token::type_Number)
+      target = M_DoubleToFixed(value.number);
 }
 
 //
 // Passes a float to an object and flags a required element
 //
-void UDMFParser::requireFixed(fixed_t &target,
-                              bool &flagtarget) const
+void UDMFParser::Scanner::requireFixed(fixed_t &target,
+                                       bool &flagtarget) const
 {
-   if(mValue.type == Token::type_Number)
+   if(value.type == Token::type_Number)
    {
-      target = M_DoubleToFixed(mValue.number);
+      target = M_DoubleToFixed(value.number);
       flagtarget = true;
    }
 }
@@ -1424,11 +1774,11 @@ void UDMFParser::requireFixed(fixed_t &target,
 //
 // Requires an int
 //
-void UDMFParser::requireInt(int &target, bool &flagtarget) const
+void UDMFParser::Scanner::requireInt(int &target, bool &flagtarget) const
 {
-   if(mValue.type == Token::type_Number)
+   if(value.type == Token::type_Number)
    {
-      target = static_cast<int>(mValue.number);
+      target = static_cast<int>(value.number);
       flagtarget = true;
    }
 }
@@ -1436,20 +1786,21 @@ void UDMFParser::requireInt(int &target, bool &flagtarget) const
 //
 // Reads a string
 //
-void UDMFParser::readString(qstring &target) const
+void UDMFParser::Scanner::readString(qstring &target) const
 {
-   if(mValue.type == Token::type_String)
-      target = mValue.text;
+   if(value.type == Token::type_String)
+      value.getText(target);
 }
 
 //
 // Passes a string
 //
-void UDMFParser::requireString(qstring &target, bool &flagtarget) const
+void UDMFParser::Scanner::requireString(qstring &target,
+                                        bool &flagtarget) const
 {
-   if(mValue.type == Token::type_String)
+   if(value.type == Token::type_String)
    {
-      target = mValue.text;
+      value.getText(target);
       flagtarget = true;
    }
 }
@@ -1457,11 +1808,11 @@ void UDMFParser::requireString(qstring &target, bool &flagtarget) const
 //
 // Passes a boolean
 //
-void UDMFParser::readBool(bool &target) const
+void UDMFParser::Scanner::readBool(bool &target) const
 {
-   if(mValue.type == Token::type_Keyword)
+   if(value.type == Token::type_Keyword)
    {
-      target = ectype::toUpper(mValue.text[0]) == 'T';
+      target = ectype::toUpper(value.text[0]) == 'T';
    }
 }
 
@@ -1469,11 +1820,11 @@ void UDMFParser::readBool(bool &target) const
 // Passes a number (float/double/int)
 //
 template<typename T>
-void UDMFParser::readNumber(T &target) const
+void UDMFParser::Scanner::readNumber(T &target) const
 {
-   if(mValue.type == Token::type_Number)
+   if(value.type == Token::type_Number)
    {
-      target = static_cast<T>(mValue.number);
+      target = static_cast<T>(value.number);
    }
 
 }
@@ -1481,62 +1832,58 @@ void UDMFParser::readNumber(T &target) const
 //
 // Reads a line or block item. Returns false on error
 //
-UDMFParser::readresult_e UDMFParser::readItem()
+UDMFParser::readresult_e UDMFParser::Scanner::readItem()
 {
    Token token;
-   if(!next(token))
+   if(!next(key))
       return result_Eof;
 
-   if(token.type == Token::type_Symbol && token.symbol == '}')
+   if(key.type == Token::type_Symbol && key.symbol == '}')
    {
-      if(mInBlock)
+      if(inBlock)
       {
-         mInBlock = false;
-         mKey = mBlockName; // preserve the name into "key"
-         mBlockName.clear();
+         inBlock = false;
          return result_BlockExit;
       }
       // not in block: error
-      mError = "Unexpected '}'";
+      error = "Unexpected '}'";
       return result_Error;
    }
 
-   if(token.type != Token::type_Keyword)
+   if(key.type != Token::type_Keyword)
    {
-      mError = "Expected a keyword";
+      error = "Expected a keyword";
       return result_Error;
    }
-   mKey = token.text;
 
    if(!next(token) || token.type != Token::type_Symbol ||
       (token.symbol != '=' && token.symbol != '{'))
    {
-      mError = "Expected '=' or '{'";
+      error = "Expected '=' or '{'";
       return result_Error;
    }
 
    if(token.symbol == '=')
    {
       // assignment
-      if(!next(token) || (token.type != Token::type_Keyword &&
-         token.type != Token::type_String && token.type != Token::type_Number))
+      if(!next(value) || (value.type != Token::type_Keyword &&
+         value.type != Token::type_String && value.type != Token::type_Number))
       {
-         mError = "Expected a number, string or true/false";
+         error = "Expected a number, string or true/false";
          return result_Error;
       }
 
-      if(token.type == Token::type_Keyword && token.text.strCaseCmp("true") &&
-         token.text.strCaseCmp("false"))
+      if(value.type == Token::type_Keyword && !value.textIs("true") &&
+         !value.textIs("false"))
       {
-         mError = "Identifier can only be true or false";
+         error = "Identifier can only be true or false";
          return result_Error;
       }
-      mValue = token;
 
       if(!next(token) || token.type != Token::type_Symbol ||
          token.symbol != ';')
       {
-         mError = "Expected ; after assignment";
+         error = "Expected ; after assignment";
          return result_Error;
       }
 
@@ -1545,166 +1892,223 @@ UDMFParser::readresult_e UDMFParser::readItem()
    else  // {
    {
       // block
-      if(!mInBlock)
+      if(!inBlock)
       {
-         mInBlock = true;
-         mBlockName = mKey;
+         inBlock = true;
          return result_BlockEntry;
       }
       else
       {
-         mError = "Blocks cannot be nested";
+         error = "Blocks cannot be nested";
          return result_Error;
       }
    }
 }
 
 //
-// Gets the next token from mData. Returns false if EOF. It will not return
-// false if there's something to return
+// Skips whitespace and comments. Returns false if the end was reached.
 //
-bool UDMFParser::next(Token &token)
+bool UDMFParser::Scanner::skipSpace()
 {
-   // Skip all leading whitespace
-   bool checkWhite = true;
-   size_t size = mData.length();
-
-   while(checkWhite)
+   while(pos != end)
    {
-      checkWhite = false;  // reset it unless someone else restores it
-
-      while(mPos != size && ectype::isSpace(mData[mPos]))
-         addPos(1);
-      if(mPos == size)
-         return false;
+      char c = data[pos];
 
-      // Skip comments
-      if(mData[mPos] == '/' && mPos + 1 < size && mData[mPos + 1] == '/')
+      if(c == '\n')
+         newline(pos);
+      else if(c == '/' && pos + 1 < end && data[pos + 1] == '/')
       {
-         addPos(2);
-         // one line comment
-         while(mPos != size && mData[mPos] != '\n')
-            addPos(1);
-         if(mPos == size)
-            return false;
-
-         // If here, we hit an "enter"
-         addPos(1);
-         if(mPos == size)
-            return false;
-
-         checkWhite = true;   // look again for whitespaces if reached here
+         // one line comment; the newline is counted next time around
+         const char *eol = static_cast<const char *>(memchr(data + pos, '\n',
+                                                            end - pos));
+         pos = eol ? eol - data : end;
+         continue;
       }
-
-      if(mData[mPos] == '/' && mPos + 1 < size && mData[mPos + 1] == '*')
+      else if(c == '/' && pos + 1 < end && data[pos + 1] == '*')
       {
-         addPos(2);
-         while(mPos + 1 < size && (mData[mPos] != '*' || mData[mPos + 1] != '/'))
-            addPos(1);
-         if(mPos + 1 >= size)
+         for(pos += 2; pos + 1 < end && (data[pos] != '*' || data[pos + 1] != '/');
+             pos++)
          {
-            addPos(1);
-            return false;
+            if(data[pos] == '\n')
+               newline(pos);
          }
-         if(mData[mPos] == '*' && mData[mPos + 1] == '/')
-            addPos(2);
-         if(mPos == size)
+         if(pos + 1 >= end)
+         {
+            pos = end;
             return false;
-         checkWhite = true;
+         }
+         pos += 2;
+         continue;
       }
+      else if(!ectype::isSpace(c))
+         return true;
+
+      pos++;
    }
 
+   return false;
+}
+
+//
+// Gets the next token. Returns false if EOF. It will not return false if
+// there's something to return
+//
+bool UDMFParser::Scanner::next(Token &token)
+{
+   if(!skipSpace())
+      return false;
+
    // now we're clear from whitespaces and comments
+   const char *start = data + pos;
+
+   // Check for number. Plain integers are by far the most common, so they
+   // skip strtod.
+   const char *digits = start + (*start == '-' || *start == '+');
+   if(digits < data + end && ectype::isDigit(*digits))
+   {
+      const char *p = digits;
+      double number = 0;
+
+      while(p < data + end && p - digits < 15 && ectype::isDigit(*p))
+         number = number * 10 + (*p++ - '0');
+
+      if(p == data + end || !(ectype::isAlnum(*p) || *p == '.' || *p == '_'))
+      {
+         token.type = Token::type_Number;
+         token.number = *start == '-' ? -number : number;
+         pos = p - data;
+         return true;
+      }
+   }
+
+   // The data may be a wad mapping with no NUL after it, so give strtod a
+   // terminated copy of whatever could be part of the number.
+   char numbuf[64];
+   size_t numlen = 0;
+   while(numlen < sizeof(numbuf) - 1 && pos + numlen < end &&
+         (ectype::isAlnum(start[numlen]) || start[numlen] == '.' ||
+          start[numlen] == '+' || start[numlen] == '-'))
+   {
+      numbuf[numlen] = start[numlen];
+      ++numlen;
+   }
+   numbuf[numlen] = '\0';
 
-   // Check for number
    char *result = nullptr;
-   double number = strtod(&mData[mPos], &result);
-   if(result > &mData[mPos])  // we have something
+   double number = strtod(numbuf, &result);
+   if(result > numbuf)  // we have something
    {
-      // copy it
       token.type = Token::type_Number;
       token.number = number;
-      addPos(result - mData.constPtr() - mPos);
+      pos += result - numbuf;
       return true;
    }
 
    // Check for string
-   if(mData[mPos] == '"')
+   if(*start == '"')
    {
-      addPos(1);
-
       // we entered a string
-      // find the next string
       token.type = Token::type_String;
+      token.text = start + 1;
+      token.length = 0;
 
-      // we must escape things here
-      token.text.clear();
-      bool escape = false;
-      while(mPos != size)
+      // strings without escapes are used where they lie
+      bool escaped = false;
+      for(pos++; pos != end && data[pos] != '"'; pos++)
       {
-         if(!escape)
+         if(data[pos] == '\\')
          {
-            if(mData[mPos] == '\\')
-               escape = true;
-            else if(mData[mPos] == '"')
-            {
-               addPos(1);     // skip the quote
-               return true;   // we're done
-            }
-            else
-               token.text.Putc(mData[mPos]);
+            escaped = true;
+            if(pos + 1 == end)
+               break;
+            pos++;
          }
-         else
+         if(data[pos] == '\n')
+            newline(pos);
+      }
+      token.length = data + pos - token.text;
+      if(pos != end)
+         pos++;   // skip the quote
+
+      if(escaped)
+      {
+         token.escaped.clear();
+         for(size_t i = 0; i < token.length; i++)
          {
-            token.text.Putc(mData[mPos]);
-            escape = false;
+            if(token.text[i] == '\\' && i + 1 < token.length)
+               i++;
+            token.escaped.Putc(token.text[i]);
          }
-         addPos(1);
+         token.text = token.escaped.constPtr();
+         token.length = token.escaped.length();
       }
       return true;
    }
 
    // keyword: start with a letter or _
-   if(ectype::isAlpha(mData[mPos]) || mData[mPos] == '_')
+   if(ectype::isAlpha(*start) || *start == '_')
    {
       token.type = Token::type_Keyword;
-      token.text.clear();
-      while(mPos != size &&
-            (ectype::isAlnum(mData[mPos]) || mData[mPos] == '_'))
-      {
-         token.text.Putc(mData[mPos]);
-         addPos(1);
-      }
+      token.text = start;
+      while(pos != end && (ectype::isAlnum(data[pos]) || data[pos] == '_'))
+         pos++;
+      token.length = data + pos - start;
       return true;
    }
 
    // symbol. Just put one character
    token.type = Token::type_Symbol;
-   token.symbol = mData[mPos];
-   addPos(1);
+   token.symbol = *start;
+   pos++;
 
    return true;
 }
 
 //
-// Increases position by given amount. Updates line and column accordingly.
+// Skips the rest of a block without reading it, for the first pass. Stops at
+// the closing '}', or at the end of the lump. Returns false if another block
+// is opened within this one.
 //
-void UDMFParser::addPos(size_t amount)
+bool UDMFParser::Scanner::skipBlock()
 {
-   for(size_t i = 0; i < amount; i++)
+   for(; pos < end; pos++)
    {
-      if(mPos == mData.length())
-         return;
-      if(mData[mPos] == '\n')
+      switch(data[pos])
       {
-         mColumn = 1;
-         mLine++;
+      case '\n':
+         newline(pos);
+         break;
+      case '"':
+         for(pos++; pos < end && data[pos] != '"'; pos++)
+         {
+            if(data[pos] == '\\' && pos + 1 < end)
+               pos++;
+            if(data[pos] == '\n')
+               newline(pos);
+         }
+         if(pos == end)
+            return true;
+         break;
+      case '/':
+         if(pos + 1 < end && (data[pos + 1] == '/' || data[pos + 1] == '*'))
+         {
+            if(!skipSpace())
+               return true;
+            pos--;   // back onto the last character skipped
+         }
+         break;
+      case '{':
+         pos++;
+         error = "Blocks cannot be nested";
+         return false;
+      case '}':
+         return true;
+      default:
+         break;
       }
-      else
-         mColumn++;
-      mPos++;
    }
+
+   return true;
 }
 
 // EOF
-
@@ -31,6 +31,7 @@
 #include "m_collection.h"
 #include "m_fixed.h"
 #include "m_qstr.h"
+#include "z_auto.h"
 
 class WadDirectory;
 
@@ -167,7 +168,7 @@ class UDMFParser : public ZoneObject
 {
 public:
    
-   UDMFParser() : mLine(1), mColumn(1)
+   UDMFParser() : mData(nullptr), mDataLength(0), mLine(1), mColumn(1)
    {
       static ULinedef linedef;
       mLinedefs.setPrototype(&linedef);
@@ -205,6 +206,11 @@ public:
 
 private:
 
+   //
+   // A token points into the TEXTMAP rather than holding a copy of its text.
+   // Only strings with escapes in them get unescaped into a buffer of their
+   // own, so tokens must not be copied.
+   //
    class Token
    {
    public:
@@ -218,7 +224,9 @@ private:
 
       type_e type;
       double number;
-      qstring text;
+      const char *text;
+      size_t length;
+      qstring escaped;
       char symbol;
 
       Token()
@@ -230,9 +238,13 @@ private:
       {
          type = type_Keyword;
          number = 0;
-         text.clear();
+         text = "";
+         length = 0;
          symbol = 0;
       }
+
+      bool textIs(const char *str) const;
+      void getText(qstring &target) const { target.copy(text, length); }
    };
 
    enum readresult_e
@@ -244,6 +256,75 @@ private:
       result_Error
    };
 
+   //
+   // Reads tokens and items from a stretch of the TEXTMAP. The first pass
+   // uses one over the whole lump, and each thread decoding blocks has its
+   // own for the blocks it is given.
+   //
+   class Scanner
+   {
+   public:
+      const char *data;
+      size_t pos;
+      size_t end;
+      int line;            // for locating errors. 1-based
+      size_t linestart;    // where the current line begins
+      const char *error;
+
+      Token key;
+      Token value;
+      bool inBlock;
+
+      void set(const char *pData, size_t start, size_t pEnd, int pLine,
+               size_t pLinestart);
+
+      int column() const { return static_cast<int>(pos - linestart) + 1; }
+
+      readresult_e readItem();
+      bool next(Token &token);
+      bool skipBlock();
+
+      void readFixed(fixed_t &target) const;
+      void requireFixed(fixed_t &target, bool &flagtarget) const;
+      void requireInt(int &target, bool &flagtarget) const;
+      void readString(qstring &target) const;
+      void requireString(qstring &target, bool &flagtarget) const;
+      void readBool(bool &target) const;
+      template<typename T>
+      void readNumber(T &target) const;
+
+   private:
+      void newline(size_t at)
+      {
+         ++line;
+         linestart = at + 1;
+      }
+      bool skipSpace();
+   };
+
+   enum blockkind_e
+   {
+      block_Linedef,
+      block_Sidedef,
+      block_Vertex,
+      block_Sector,
+      block_Thing,
+      block_Unknown
+   };
+
+   //
+   // A top-level block found by the first pass
+   //
+   struct blockspan_t
+   {
+      size_t start;     // just after the '{'
+      size_t end;       // just past the '}'
+      size_t linestart;
+      int line;
+      int kind;
+      int index;        // position among the blocks of its kind
+   };
+
    // NOTE: some of these are classes because they contain non-POD objects (e.g.
    // qstring
 
@@ -437,33 +518,28 @@ private:
 
    void setData(const char *data, size_t size);
    void reset();
-
-   void readFixed(fixed_t &target) const;
-   void requireFixed(fixed_t &target, bool &flagtarget) const;
-   void requireInt(int &target, bool &flagtarget) const;
-   void readString(qstring &target) const;
-   void requireString(qstring &target, bool &flagtarget) const;
-   void readBool(bool &target) const;
-   template<typename T>
-   void readNumber(T &target) const;
-
-   readresult_e readItem();
-
-   bool next(Token &token);
-   void addPos(size_t amount);
-
-   bool eof() const { return mPos == mData.length(); }
-
-   qstring mData;
-   size_t mPos;
+   void setError(const Scanner &scanner);
+
+   bool findBlocks();
+   bool decodeBlocks();
+   bool decodeBlock(Scanner &scanner, const blockspan_t &block);
+   static void DecodeJob(int threadnum, void *data);
+
+   void assignLinedef(const Scanner &sc, int token, ULinedef *linedef) const;
+   void assignSidedef(const Scanner &sc, int token, USidedef *sidedef) const;
+   void assignVertex(const Scanner &sc, int token, uvertex_t *vertex) const;
+   void assignSector(const Scanner &sc, int token, USector *sector) const;
+   void assignThing(const Scanner &sc, int token, uthing_t *thing) const;
+
+   const char *mData;   // the TEXTMAP, borrowed for the parse
+   size_t mDataLength;
+   ZAutoBuffer mDataBuf; // holds the TEXTMAP when the wad isn't mapped
+   Scanner mScanner;
    int mLine; // for locating errors. 1-based
    int mColumn;
    qstring mError;
 
-   qstring mKey;
-   Token mValue;
-   bool mInBlock;
-   qstring mBlockName;
+   PODCollection<blockspan_t> mBlocks;
 
    // Game stuff
    namespace_e mNamespace;
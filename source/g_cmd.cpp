@@ -99,6 +99,43 @@ CONSOLE_COMMAND(z_dumpcore, cf_hidden)
    Z_DumpCore();
 }
 
+VARIABLE_INT(zone_cachesize, NULL, 0, 65536, NULL);
+CONSOLE_VARIABLE(zone_cachesize, zone_cachesize, 0) {}
+
+CONSOLE_COMMAND(z_cacheinfo, 0)
+{
+   C_Printf("%u KB of purgable blocks, limit %d MB\n",
+            static_cast<unsigned int>(Z_CacheBytes() >> 10), zone_cachesize);
+}
+
+VARIABLE_INT(z_statsample, NULL, 0, 65536, NULL);
+CONSOLE_VARIABLE(z_statsample, z_statsample, 0) {}
+
+CONSOLE_COMMAND(z_tagstats, 0)
+{
+   Z_PrintTagStats();
+}
+
+CONSOLE_COMMAND(z_topallocs, 0)
+{
+   Z_PrintTopAllocators(Console.argc ? Console.argv[0]->toInt() : 20);
+}
+
+CONSOLE_COMMAND(z_timeline, 0)
+{
+   const char *filename = Console.argc ? Console.argv[0]->constPtr() : "zonetimeline.csv";
+
+   if(Z_WriteTimeline(filename))
+      C_Printf("Wrote zone timeline to %s\n", filename);
+   else
+      C_Printf(FC_ERROR "Couldn't write %s\n", filename);
+}
+
+CONSOLE_COMMAND(z_resetstats, 0)
+{
+   Z_ResetStats();
+}
+
 CONSOLE_COMMAND(starttitle, cf_notnet)
 {
    // haleyjd 04/18/03
@@ -39,6 +39,7 @@
 #include "c_io.h"
 #include "c_net.h"
 #include "c_runcmd.h"
+#include "d_bench.h"
 #include "d_deh.h"              // Ty 3/27/98 deh declarations
 #include "d_event.h"
 #include "d_gi.h"
@@ -63,6 +64,7 @@
 #include "m_buffer.h"
 #include "m_collection.h"
 #include "m_misc.h"
+#include "m_profile.h"
 #include "m_random.h"
 #include "m_shots.h"
 #include "m_utils.h"
@@ -75,6 +77,8 @@
 #include "p_inter.h"
 #include "p_map.h"
 #include "p_maputl.h"
+#include "p_prefetch.h"
+#include "p_rewind.h"
 #include "p_saveg.h"
 #include "p_setup.h"
 #include "p_tick.h"
@@ -1394,6 +1398,7 @@ void G_DoPlayDemo(void)
          starttime = i_haltimer.GetRealTime();
          startgametic = gametic;
          first = 0;
+         D_BenchStart();
       }
    }
 }
@@ -1504,6 +1509,26 @@ static void G_ReadDemoTiccmd(ticcmd_t *cmd)
    }
 }
 
+//
+// G_DemoPosition
+//
+// Offset into the demo being played of the next tic to be read.
+//
+size_t G_DemoPosition()
+{
+   return static_cast<size_t>(demo_p - demobuffer);
+}
+
+//
+// G_SetDemoPosition
+//
+// Moves playback of the demo to a tic, given by its offset.
+//
+void G_SetDemoPosition(size_t pos)
+{
+   demo_p = demobuffer + pos;
+}
+
 //
 // G_ReadDemoContinueTiccmd
 //
@@ -1752,6 +1777,33 @@ static void G_setupMapInfoWMInfo(levelkind_t kind)
    wminfo.li_nextenterpic = next.enterpic;
 }
 
+//
+// G_getNextMap
+//
+// Returns the number of the map the intermission leads to.
+//
+static int G_getNextMap()
+{
+   int map = wminfo.next+1;
+
+   // haleyjd: handle heretic hidden levels via missioninfo samelevel rules
+   if(!wminfo.nextexplicit && GameModeInfo->missionInfo->sameLevels)
+   {
+      samelevel_t *sameLevel = GameModeInfo->missionInfo->sameLevels;
+      while(sameLevel->episode != -1)
+      {
+         if(gameepisode == sameLevel->episode && map == sameLevel->map)
+         {
+            --map; // return to same level by default
+            break;
+         }
+         ++sameLevel;
+      }
+   }
+
+   return map;
+}
+
 //
 // G_DoCompleted
 //
@@ -1865,29 +1917,22 @@ static void G_DoCompleted()
    G_setupMapInfoWMInfo(secretexit ? lk_secret : lk_overt);
    
    IN_Start(&wminfo);
+
+   // read the next level in while the intermission is up, unless it was
+   // skipped
+   if(gameaction != ga_worlddone)
+   {
+      P_StartLevelPrefetch(g_dir, G_getNextLevelName(secretexit ? lk_secret :
+                                                     lk_overt, G_getNextMap()));
+   }
 }
 
 static void G_DoWorldDone()
 {
    idmusnum = -1; //jff 3/17/98 allow new level's music to be loaded
    gamestate = GS_LOADING;
-   gamemap = wminfo.next+1;
+   gamemap = G_getNextMap();
 
-   // haleyjd: handle heretic hidden levels via missioninfo samelevel rules
-   if(!wminfo.nextexplicit && GameModeInfo->missionInfo->sameLevels)
-   {
-      samelevel_t *sameLevel = GameModeInfo->missionInfo->sameLevels;
-      while(sameLevel->episode != -1)
-      {
-         if(gameepisode == sameLevel->episode && gamemap == sameLevel->map)
-         {
-            --gamemap; // return to same level by default
-            break;
-         }
-         ++sameLevel;
-      }
-   }
-   
    // haleyjd: customizable secret exits
    if(secretexit)
       G_SetGameMapName(G_getNextLevelName(lk_secret, gamemap));
@@ -2133,8 +2178,12 @@ static void G_CameraTicker(void)
 //
 void G_Ticker()
 {
+   PROFILE_ZONE(PROF_GTICKER);
    int i;
 
+   // report on a save written in the background once it's done
+   P_UpdateSaveWrite();
+
    // do player reborns if needed
    for(i = 0; i < MAXPLAYERS; i++)
    {
@@ -2215,6 +2264,9 @@ void G_Ticker()
    }
    else
    {
+      // snapshot the game for rewinding before this tic's commands are read
+      P_RewindTicker();
+
       // get commands, check consistency, and build new consistancy check
       int buf = (gametic / ticdup) % BACKUPTICS;
       
@@ -3169,6 +3221,9 @@ void G_InitNew(skill_t skill, const char *name)
    G_SetFastParms(fastparm || skill == sk_nightmare);  // killough 4/10/98
 
    M_ClearRandom();
+
+   // a new game starts a new rewind history
+   P_ResetRewind();
    
    respawnmonsters = 
       (GameModeInfo->flags & GIF_SKILL5RESPAWN && skill == sk_nightmare) 
@@ -3738,12 +3793,16 @@ bool G_CheckDemoStatus()
    if(timingdemo)
    {
       int endtime = i_haltimer.GetRealTime();
+      qstring report;
+
+      D_BenchFinish(report);
 
       // killough -- added fps information and made it work for longer demos:
       unsigned int realtics = endtime - starttime;
-      I_Error("Timed %u gametics in %u realtics = %-.1f frames per second\n",
+      I_Error("Timed %u gametics in %u realtics = %-.1f frames per second\n%s",
               (unsigned int)(gametic), realtics,
-              (unsigned int)(gametic) * (double) TICRATE / realtics);
+              (unsigned int)(gametic) * (double) TICRATE / realtics,
+              report.constPtr());
    }              
 
    if(demoplayback)
@@ -3753,6 +3812,7 @@ bool G_CheckDemoStatus()
       // haleyjd 01/08/11: refactored so that stopping netdemos doesn't cause
       // access violations by leaving the game in "netgame" mode.
       Z_ChangeTag(demobuffer, PU_CACHE);
+      P_ResetRewind();       // snapshots point into the demo
       G_ReloadDefaults();    // killough 3/1/98
       netgame = false;       // killough 3/29/98
 
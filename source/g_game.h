@@ -54,6 +54,8 @@ void G_RecordDemoContinue(const char *in, const char *name);
 void G_SetOldDemoOptions();
 void G_BeginRecording();
 void G_StopDemo();
+size_t G_DemoPosition();
+void G_SetDemoPosition(size_t pos);
 void G_ScrambleRand();
 void G_ExitLevel(int destmap = 0);
 void G_SecretExitLevel(int destmap = 0);
@@ -63,6 +63,9 @@ bool I_CreateDirectory(const qstring &path)
 #if EE_CURRENT_PLATFORM == EE_PLATFORM_LINUX
    if(!mkdir(path.constPtr(), S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH))
       return true;
+#elif EE_CURRENT_PLATFORM == EE_PLATFORM_WINDOWS
+   if(CreateDirectoryA(path.constPtr(), nullptr))
+      return true;
 #endif
 
    return false;
@@ -0,0 +1,198 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2017 James Haley, Max Waine, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//   
+//   Headless video driver. Renders into an offscreen buffer with no window,
+//   for benchmarking on machines with no display. The "blit" converts the
+//   frame to 32-bit colour in memory, so that a timed run still pays for the
+//   same palette conversion the SDL software driver does.
+//
+//-----------------------------------------------------------------------------
+
+#include "../z_zone.h"
+
+#include "i_headlessvideo.h"
+
+#include "../v_misc.h"
+#include "../v_video.h"
+#include "../w_wad.h"
+
+//=============================================================================
+//
+// Graphics Code
+//
+
+static byte     *primary_buffer;
+static uint32_t *rgba_buffer;
+
+static byte     basepal[256 * 3];
+static uint32_t colors[256];
+
+extern char *i_videomode;
+
+//
+// HeadlessVideoDriver::FinishUpdate
+//
+// Convert the newest frame to 32-bit colour. Nothing is displayed.
+//
+void HeadlessVideoDriver::FinishUpdate()
+{
+   if(!primary_buffer)
+      return;
+
+   for(int y = 0; y < video.height; y++)
+   {
+      const byte *src  = primary_buffer + y * video.pitch;
+      uint32_t   *dest = rgba_buffer + y * video.pitch;
+
+      for(int x = 0; x < video.width; x++)
+         dest[x] = colors[src[x]];
+   }
+}
+
+//
+// HeadlessVideoDriver::ReadScreen
+//
+// Get the current screen contents.
+//
+void HeadlessVideoDriver::ReadScreen(byte *scr)
+{
+   VBuffer temp;
+
+   V_InitVBufferFrom(&temp, vbscreen.width, vbscreen.height, 
+                     vbscreen.width, video.bitdepth, scr);
+   V_BlitVBuffer(&temp, 0, 0, &vbscreen, 0, 0, vbscreen.width, vbscreen.height);
+   V_FreeVBuffer(&temp);
+}
+
+//
+// HeadlessVideoDriver::SetPalette
+//
+// Set the palette, or, if palette is nullptr, update the current palette to use 
+// the current gamma setting.
+//
+void HeadlessVideoDriver::SetPalette(byte *palette)
+{
+   if(palette)
+      memcpy(basepal, palette, sizeof(basepal));
+
+   for(int i = 0; i < 256; i++)
+   {
+      colors[i] = 0xff000000u                                    |
+                  (gammatable[usegamma][basepal[i * 3 + 2]] << 16) |
+                  (gammatable[usegamma][basepal[i * 3 + 1]] <<  8) |
+                   gammatable[usegamma][basepal[i * 3    ]];
+   }
+}
+
+//
+// HeadlessVideoDriver::UnsetPrimaryBuffer
+//
+void HeadlessVideoDriver::UnsetPrimaryBuffer()
+{
+   if(primary_buffer)
+   {
+      efree(primary_buffer);
+      primary_buffer = nullptr;
+   }
+   if(rgba_buffer)
+   {
+      efree(rgba_buffer);
+      rgba_buffer = nullptr;
+   }
+   video.screens[0] = nullptr;
+}
+
+//
+// HeadlessVideoDriver::SetPrimaryBuffer
+//
+// Allocate the offscreen buffer the game engine renders frames into and set
+// it to video.screens[0]. The same bump as the SDL driver is added to the
+// pitch, so that cache behaviour at 512 and 1024 wide matches a real run.
+//
+void HeadlessVideoDriver::SetPrimaryBuffer()
+{
+   int bump = (video.width == 512 || video.width == 1024) ? 4 : 0;
+
+   video.pitch = video.width + bump;
+
+   primary_buffer = ecalloc(byte *, video.pitch, video.height);
+   rgba_buffer    = ecalloc(uint32_t *, video.pitch * video.height, sizeof(uint32_t));
+
+   video.screens[0] = primary_buffer;
+}
+
+//
+// HeadlessVideoDriver::ShutdownGraphicsPartway
+//
+void HeadlessVideoDriver::ShutdownGraphicsPartway()
+{
+   UnsetPrimaryBuffer();
+}
+
+//
+// HeadlessVideoDriver::ShutdownGraphics
+//
+void HeadlessVideoDriver::ShutdownGraphics()
+{
+   ShutdownGraphicsPartway();
+}
+
+//
+// HeadlessVideoDriver::InitGraphicsMode
+//
+// Only the resolution of the video mode is used; fullscreen, vsync and the
+// rest have no meaning without a window. Returns false, as this cannot fail.
+//
+bool HeadlessVideoDriver::InitGraphicsMode()
+{
+   bool wantfullscreen = false;
+   bool wantdesktopfs  = false;
+   bool wantvsync      = false;
+   bool wanthardware   = false;
+   bool wantframe      = true;
+   int  v_w            = 640;
+   int  v_h            = 480;
+
+   I_ParseGeom(i_videomode, &v_w, &v_h, &wantfullscreen, &wantvsync,
+               &wanthardware, &wantframe, &wantdesktopfs);
+
+   I_CheckVideoCmds(&v_w, &v_h, &wantfullscreen, &wantvsync, &wanthardware,
+                    &wantframe, &wantdesktopfs);
+
+   video.width     = v_w;
+   video.height    = v_h;
+   video.bitdepth  = 8;
+   video.pixelsize = 1;
+
+   UnsetPrimaryBuffer();
+   SetPrimaryBuffer();
+
+   SetPalette(static_cast<byte *>(wGlobalDir.cacheLumpName("PLAYPAL", PU_CACHE)));
+
+   return false;
+}
+
+// The one and only global instance of the headless video driver.
+HeadlessVideoDriver i_headlessvideodriver;
+
+// EOF
+
@@ -0,0 +1,122 @@
+// Emacs style mode select   -*- C++ -*- 
+//-----------------------------------------------------------------------------
+//
+// Copyright(C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//    Read-only file mapping
+//
+//    Archive files are mapped so that lumps can be read with a memcpy, or
+//    used in place, rather than seeking and reading through stdio. Pages
+//    are shared with the OS file cache and can be dropped by it at any
+//    time, so mapped data costs no heap.
+//
+//-----------------------------------------------------------------------------
+
+#include "../z_zone.h"
+
+#include "i_mapfile.h"
+
+#include "i_platform.h"
+
+#if EE_CURRENT_PLATFORM == EE_PLATFORM_LINUX \
+ || EE_CURRENT_PLATFORM == EE_PLATFORM_MACOSX \
+ || EE_CURRENT_PLATFORM == EE_PLATFORM_FREEBSD
+#include <sys/mman.h>
+#include <unistd.h>
+#define EE_HAVE_MMAP
+#elif EE_CURRENT_PLATFORM == EE_PLATFORM_WINDOWS
+#include <io.h>
+#include <windows.h>
+#endif
+
+//
+// I_MapFile
+//
+// Maps all of an open file read-only. Returns false if the file can't be
+// mapped, in which case it must be read the usual way.
+//
+bool I_MapFile(FILE *f, mappedfile_t &map)
+{
+   map.base = nullptr;
+   map.size = 0;
+
+#if defined(EE_HAVE_MMAP)
+   struct stat sbuf;
+   int fd = fileno(f);
+
+   if(fstat(fd, &sbuf) || !S_ISREG(sbuf.st_mode) || sbuf.st_size <= 0 ||
+      uint64_t(sbuf.st_size) > SIZE_MAX)
+      return false;
+
+   void *base = mmap(nullptr, size_t(sbuf.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+   if(base == MAP_FAILED)
+      return false;
+
+   map.base = base;
+   map.size = size_t(sbuf.st_size);
+   return true;
+#elif EE_CURRENT_PLATFORM == EE_PLATFORM_WINDOWS
+   HANDLE        file = HANDLE(_get_osfhandle(_fileno(f)));
+   LARGE_INTEGER size;
+
+   if(file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size) ||
+      size.QuadPart <= 0 || uint64_t(size.QuadPart) > SIZE_MAX)
+      return false;
+
+   HANDLE mapping = CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+   if(!mapping)
+      return false;
+
+   // the view keeps the mapping alive by itself
+   void *base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+   CloseHandle(mapping);
+   if(!base)
+      return false;
+
+   map.base = base;
+   map.size = size_t(size.QuadPart);
+   return true;
+#else
+   return false;
+#endif
+}
+
+//
+// I_UnmapFile
+//
+void I_UnmapFile(mappedfile_t &map)
+{
+   if(!map.base)
+      return;
+
+#if defined(EE_HAVE_MMAP)
+   munmap(const_cast<void *>(map.base), map.size);
+#elif EE_CURRENT_PLATFORM == EE_PLATFORM_WINDOWS
+   UnmapViewOfFile(map.base);
+#endif
+
+   map.base = nullptr;
+   map.size = 0;
+}
+
+// EOF
+
@@ -41,12 +41,16 @@
 #include "../in_lude.h"
 #include "../m_argv.h"
 #include "../m_misc.h"
+#include "../m_profile.h"
 #include "../m_qstr.h"
 #include "../r_main.h"
 #include "../st_stuff.h"
 #include "../v_misc.h"
 #include "../v_video.h"
 
+// Headless driver, used on any platform when asked for
+#include "i_headlessvideo.h"
+
 // Platform-Specific Video Drivers:
 #ifdef _SDL_VER
 #include "../sdl/i_sdlvideo.h"
@@ -159,6 +163,14 @@ static haldriveritem_t *I_DefaultVideoDriver()
    return item;
 }
 
+// Headless driver item; it is never chosen from the config, only by -headless
+static haldriveritem_t halHeadlessDriverItem =
+{
+   -1,
+   "Headless",
+   &i_headlessvideodriver
+};
+
 //=============================================================================
 //
 // WM-related stuff (see i_input.c)
@@ -172,7 +184,7 @@ void I_InitMouse();
 
 void I_StartTic()
 {
-   if(!D_noWindow())
+   if(!D_noWindow() && !headless)
       I_StartTicInWindow(i_video_driver->window);
 }
 
@@ -183,6 +195,7 @@ void I_StartTic()
 
 int  use_vsync;     // killough 2/8/98: controls whether vsync is called
 bool noblit;
+bool headless;      // render offscreen, with no window
 
 bool in_graphics_mode;
 
@@ -198,6 +211,8 @@ bool i_letterbox;
 //
 void I_FinishUpdate()
 {
+   PROFILE_ZONE(PROF_BLIT);
+
    if(!noblit && in_graphics_mode)
       i_video_driver->FinishUpdate();
 }
@@ -501,8 +516,15 @@ void I_InitGraphics()
    firsttime = false;
    
    // Select video driver based on configuration (out of those available in 
-   // the current compile), or get the default driver if unspecified
-   if(!(driveritem = I_DefaultVideoDriver()))
+   // the current compile), or get the default driver if unspecified.
+   // -headless overrides either, but must not be saved as the config setting.
+   if(headless)
+   {
+      driveritem     = &halHeadlessDriverItem;
+      i_video_driver = driveritem->driver;
+      usermsg(" (using video driver '%s')", driveritem->name);
+   }
+   else if(!(driveritem = I_DefaultVideoDriver()))
    {
       I_Error("I_InitGraphics: invalid video driver %d\n", i_videodriverid);
    }
@@ -81,6 +81,7 @@ int  I_VideoLetterboxOffset(int h, int hl);
 void I_ToggleFullscreen();
 
 extern int use_vsync;  // killough 2/8/98: controls whether vsync is called
+extern bool headless;  // render offscreen with the headless driver
 
 // video modes
 
@@ -44,6 +44,7 @@
 #include "p_enemy.h"
 #include "p_info.h"
 #include "p_mobjcol.h"
+#include "p_prefetch.h"
 #include "p_tick.h"
 #include "r_main.h"
 #include "s_sndseq.h"
@@ -229,6 +230,8 @@ void IN_Ticker()
 
    InterFuncs->Ticker();
 
+   P_LevelPrefetchTicker();
+
 #ifdef UNSAFE_BACKDROP
    // keep the level running when using an intermission camera
    if(realbackdrop)
@@ -42,12 +42,15 @@
     ((t)((b)[2]) << 16) | \
     ((t)((b)[3]) << 24))
 
+// The GetBinary functions below take either byte or const byte data.
+
 //
 // GetBinaryWord
 //
 // Reads an int16 from the lump data and increments the read pointer.
 //
-inline int16_t GetBinaryWord(byte **data)
+template<typename B>
+inline int16_t GetBinaryWord(B **data)
 {
    int16_t val = SwapShort(read16_le(*data, int16_t));
    *data += 2;
@@ -60,7 +63,8 @@ inline int16_t GetBinaryWord(byte **data)
 //
 // Reads a uint16 from the lump data and increments the read pointer.
 //
-inline uint16_t GetBinaryUWord(byte **data)
+template<typename B>
+inline uint16_t GetBinaryUWord(B **data)
 {
    uint16_t val = SwapUShort(read16_le(*data, uint16_t));
    *data += 2;
@@ -73,7 +77,8 @@ inline uint16_t GetBinaryUWord(byte **data)
 //
 // Reads an int32 from the lump data and increments the read pointer.
 //
-inline int32_t GetBinaryDWord(byte **data)
+template<typename B>
+inline int32_t GetBinaryDWord(B **data)
 {
    int32_t val = SwapLong(read32_le(*data, int32_t));
    *data += 4;
@@ -86,7 +91,8 @@ inline int32_t GetBinaryDWord(byte **data)
 //
 // Reads a uint32 from the lump data and increments the read pointer.
 //
-inline uint32_t GetBinaryUDWord(byte **data)
+template<typename B>
+inline uint32_t GetBinaryUDWord(B **data)
 {
    uint32_t val = SwapULong(read32_le(*data, uint32_t));
    *data += 4;
@@ -100,9 +106,10 @@ inline uint32_t GetBinaryUDWord(byte **data)
 // Reads a "len"-byte string from the lump data and writes it into the 
 // destination buffer. The read pointer is incremented by len bytes.
 //
-inline void GetBinaryString(byte **data, char *dest, int len)
+template<typename B>
+inline void GetBinaryString(B **data, char *dest, int len)
 {
-   char *loc = (char *)(*data);
+   const char *loc = (const char *)(*data);
 
    memcpy(dest, loc, len);
 
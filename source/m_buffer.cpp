@@ -25,7 +25,9 @@
 #include "z_zone.h"
 #include "i_system.h"
 #include "m_buffer.h"
+#include "m_compare.h"
 #include "m_swap.h"
+#include "../zlib/zlib.h"
 
 //=============================================================================
 //
@@ -173,6 +175,18 @@ bool OutBuffer::createFile(const char *filename, size_t pLen, int pEndian)
    return true;
 }
 
+//
+// Sets up a buffer which is written to memory instead of a file. It starts out
+// at pLen bytes and grows as needed; the data is got with getData/getSize or
+// taken over with releaseData.
+//
+bool OutBuffer::createMemory(size_t pLen, int pEndian)
+{
+   initBuffer(pLen ? pLen : 1, pEndian);
+
+   return true;
+}
+
 //
 // Call to flush the contents of the buffer to the output file. This will be
 // called automatically before the file is closed, but must be called explicitly
@@ -180,7 +194,7 @@ bool OutBuffer::createFile(const char *filename, size_t pLen, int pEndian)
 //
 bool OutBuffer::flush()
 {
-   if(idx)
+   if(idx && f)
    {
       if(fwrite(buffer, sizeof(byte), idx, f) < idx)
       {
@@ -194,6 +208,37 @@ bool OutBuffer::flush()
    return true;
 }
 
+//
+// Makes room in a full buffer: a file buffer is flushed, while a memory buffer
+// doubles in size.
+//
+bool OutBuffer::makeRoom()
+{
+   if(f)
+      return flush();
+
+   len   *= 2;
+   buffer = erealloc(byte *, buffer, len);
+
+   return true;
+}
+
+//
+// Takes over the data of a memory buffer, which the caller must efree. The
+// buffer is left closed.
+//
+byte *OutBuffer::releaseData(size_t &size)
+{
+   byte *data = buffer;
+
+   size   = idx;
+   buffer = nullptr;
+   idx    = 0;
+   len    = 0;
+
+   return data;
+}
+
 //
 // Overrides BufferedFileBase::Close()
 // Closes the output file, writing any pending data in the buffer first.
@@ -228,9 +273,9 @@ bool OutBuffer::write(const void *data, size_t size)
       
       if(!lWriteAmt)
       {
-         if(!flush())
+         if(!makeRoom())
             return false;
-         lWriteAmt = len;
+         lWriteAmt = len - idx;
       }
 
       if(lBytesToWrite < lWriteAmt)
@@ -308,7 +353,7 @@ bool OutBuffer::writeUint8(uint8_t num)
 {     
    if(idx == len)
    {
-      if(!flush())
+      if(!makeRoom())
          return false;
    }
 
@@ -334,6 +379,58 @@ bool OutBuffer::writeSint8(int8_t num)
 // haleyjd 11/26/10: Buffered file input
 //
 
+#define INFLATE_INPUT_SIZE 16384
+
+//
+// State for inflating the rest of a file as it is read.
+//
+struct inflatestate_t
+{
+   z_stream stream;
+   size_t   outsize;  // size of the buffer inflated into
+   bool     finished; // stream ended or went bad
+   byte     input[INFLATE_INPUT_SIZE];
+};
+
+//
+// Frees everything the buffer holds.
+//
+InBuffer::~InBuffer()
+{
+   close();
+}
+
+//
+// Overrides BufferedFileBase::close()
+// Ends any inflation and forgets a memory source as well as closing the file.
+//
+void InBuffer::close()
+{
+   if(zstate)
+   {
+      inflateEnd(&zstate->stream);
+      efree(zstate);
+      zstate = nullptr;
+   }
+
+   view = nullptr;
+
+   if(ownFile)
+      BufferedFileBase::close();
+   else
+   {
+      f   = nullptr;
+      idx = 0;
+      len = 0;
+
+      if(buffer)
+      {
+         efree(buffer);
+         buffer = nullptr;
+      }
+   }
+}
+
 //
 // Opens a file for binary input.
 //
@@ -362,8 +459,93 @@ bool InBuffer::openExisting(FILE *pf, int pEndian)
    return true;
 }
 
+//
+// Reads from a block of memory instead of a file. The memory is not copied, so
+// it must outlast the buffer.
+//
+bool InBuffer::openMemory(const void *data, size_t size, int pEndian)
+{
+   if(!(view = static_cast<const byte *>(data)))
+      return false;
+
+   len     = size;
+   idx     = 0;
+   endian  = pEndian;
+   ownFile = false;
+
+   return true;
+}
+
+//
+// From the current position on, the file is a zlib stream; everything read
+// after this is inflated from it pLen bytes at a time, as it is needed.
+//
+bool InBuffer::beginInflate(size_t pLen)
+{
+   if(!f || zstate)
+      return false;
+
+   zstate = estructalloc(inflatestate_t, 1);
+
+   if(inflateInit(&zstate->stream) != Z_OK)
+   {
+      efree(zstate);
+      zstate = nullptr;
+      return false;
+   }
+
+   buffer = emalloc(byte *, pLen);
+   zstate->outsize = pLen;
+   len = idx = 0;
+
+   return true;
+}
+
+//
+// Inflates the next piece of the file into the buffer. Returns false once
+// nothing more can be had from the stream.
+//
+bool InBuffer::fill()
+{
+   z_stream &zs = zstate->stream;
+
+   idx = len = 0;
+
+   if(zstate->finished)
+      return false;
+
+   zs.next_out  = buffer;
+   zs.avail_out = static_cast<uInt>(zstate->outsize);
+
+   while(zs.avail_out)
+   {
+      if(!zs.avail_in)
+      {
+         size_t got = fread(zstate->input, 1, INFLATE_INPUT_SIZE, f);
+
+         if(!got)
+            break;
+
+         zs.next_in  = zstate->input;
+         zs.avail_in = static_cast<uInt>(got);
+      }
+
+      // a bad stream reads as if it were cut off
+      if(inflate(&zs, Z_NO_FLUSH) != Z_OK)
+      {
+         zstate->finished = true;
+         break;
+      }
+   }
+
+   len = zstate->outsize - zs.avail_out;
+
+   return len > 0;
+}
+
 //
 // Seeks inside the file via fseek, and then clears the internal buffer.
+// Only for reading straight from a file.
 //
 int InBuffer::seek(long offset, int origin)
 {
@@ -376,7 +558,25 @@ int InBuffer::seek(long offset, int origin)
 //
 size_t InBuffer::read(void *dest, size_t size)
 {
-   return fread(dest, 1, size, f);
+   if(!view && !zstate)
+      return fread(dest, 1, size, f);
+
+   byte  *lDest = static_cast<byte *>(dest);
+   size_t lRead = 0;
+
+   while(lRead < size)
+   {
+      if(idx == len && (view || !fill()))
+         break;
+
+      size_t lAmt = emin(size - lRead, len - idx);
+
+      memcpy(lDest + lRead, (view ? view : buffer) + idx, lAmt);
+      idx   += lAmt;
+      lRead += lAmt;
+   }
+
+   return lRead;
 }
 
 //
@@ -384,7 +584,21 @@ size_t InBuffer::read(void *dest, size_t size)
 //
 int InBuffer::skip(size_t skipAmt)
 {
-   return fseek(f, static_cast<long>(skipAmt), SEEK_CUR);
+   if(!view && !zstate)
+      return fseek(f, static_cast<long>(skipAmt), SEEK_CUR);
+
+   byte lDiscard[256];
+
+   while(skipAmt)
+   {
+      size_t lAmt = emin(skipAmt, sizeof(lDiscard));
+
+      if(read(lDiscard, lAmt) != lAmt)
+         return -1;
+      skipAmt -= lAmt;
+   }
+
+   return 0;
 }
 
 //
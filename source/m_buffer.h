@@ -111,8 +111,12 @@ public:
 //
 class OutBuffer : public BufferedFileBase
 {
+protected:
+   bool makeRoom();
+
 public:
    bool createFile(const char *filename, size_t pLen, int pEndian);
+   bool createMemory(size_t pLen, int pEndian);
    bool flush();
    void close();
 
@@ -125,6 +129,12 @@ public:
    bool writeUint16(uint16_t num);
    bool writeSint8 (int8_t   num);
    bool writeUint8 (uint8_t  num);
+
+   // Memory buffers only: the data written so far
+   const byte *getData() const { return buffer; }
+   size_t      getSize() const { return idx;    }
+   byte *releaseData(size_t &size);
+   void  reset() { idx = 0; }
 };
 
 //
@@ -134,13 +144,23 @@ public:
 //
 class InBuffer : public BufferedFileBase
 {
+protected:
+   const byte *view;              // memory being read, if not a file
+   struct inflatestate_t *zstate; // set while inflating the rest of the file
+
+   bool fill();
+
 public:
-   InBuffer() : BufferedFileBase()
+   InBuffer() : BufferedFileBase(), view(nullptr), zstate(nullptr)
    {
    }
+   ~InBuffer();
 
    bool openFile(const char *filename, int pEndian);
    bool openExisting(FILE *f, int pEndian);
+   bool openMemory(const void *data, size_t size, int pEndian);
+   bool beginInflate(size_t pLen);
+   void close() override;
 
    int    seek(long offset, int origin);
    size_t read(void *dest, size_t size);
@@ -34,6 +34,7 @@
 #include "m_syscfg.h"
 #include "m_argv.h"
 #include "w_wad.h"
+#include "w_zip.h"
 
 // headers needed for externs:
 #include "am_map.h"
@@ -58,7 +59,10 @@
 #include "p_enemy.h"
 #include "p_map.h"
 #include "p_partcl.h"
+#include "p_rewind.h"
+#include "p_tick.h"
 #include "p_user.h"
+#include "r_context.h"
 #include "r_draw.h"
 #include "r_main.h"
 #include "r_sky.h"
@@ -141,6 +145,15 @@ default_t defaults[] =
 
    DEFAULT_INT("s_precache", &s_precache, NULL, 0, 0, 1, default_t::wad_no,
                "precache sounds at startup"),
+
+   DEFAULT_INT("zip_cachesize", &zip_cachesize, NULL, 32, 0, 1024, default_t::wad_no,
+               "megabytes of inflated zip lumps to keep in memory"),
+
+   DEFAULT_INT("rewind_interval", &rewind_interval, NULL, 35, 0, 35*60, default_t::wad_no,
+               "tics between rewind snapshots (0 = no rewinding)"),
+
+   DEFAULT_INT("rewind_memory", &rewind_memory, NULL, 64, 1, 4096, default_t::wad_no,
+               "megabytes of rewind snapshots to keep in memory"),
   
    // killough 2/21/98
    DEFAULT_INT("pitched_sounds", &pitched_sounds, NULL, 0, 0, 1, default_t::wad_yes,
@@ -247,6 +260,9 @@ default_t defaults[] =
    DEFAULT_INT("p_markunknowns", &p_markunknowns, NULL, 1, 0, 1, default_t::wad_no,
                "1 to mark unknown thingtype locations"),
 
+   DEFAULT_BOOL("p_parallelthinkers", &p_parallelthinkers, NULL, false, default_t::wad_no,
+                "1 to run sector lighting and scrolling thinkers in parallel"),
+
    DEFAULT_BOOL("p_pitchedflight", &default_pitchedflight, &pitchedflight, true, default_t::wad_yes, 
                 "1 to enable flying in the direction you are looking"),
    
@@ -805,11 +821,20 @@ default_t defaults[] =
    
    DEFAULT_INT("r_columnengine",&r_column_engine_num, NULL, 
                1, 0, NUMCOLUMNENGINES - 1, default_t::wad_no, 
-               "0 = normal, 1 = optimized quad cache"),
+               "0 = normal, 1 = optimized quad cache, 2 = SSE2/AVX2"),
    
    DEFAULT_INT("r_spanengine",&r_span_engine_num, NULL,
                0, 0, NUMSPANENGINES - 1, default_t::wad_no, 
-               "0 = high precision, 1 = low precision"),
+               "0 = high precision, 1 = SSE2/AVX2"),
+
+   DEFAULT_INT("r_numcontexts", &r_numcontexts, NULL, 1, 1, R_MAXCONTEXTS, default_t::wad_no,
+               "number of threads the view is split between when rendering"),
+
+   DEFAULT_INT("zone_cachesize", &zone_cachesize, NULL, 256, 0, 65536, default_t::wad_no,
+               "megabytes of cached lumps to keep in memory (0 = no limit)"),
+
+   DEFAULT_INT("r_texcachesize", &r_texcachesize, NULL, 64, 1, 4096, default_t::wad_no,
+               "megabytes of composed textures to keep in memory"),
 
    DEFAULT_INT("r_tlstyle", &r_tlstyle, NULL, 1, 0, R_TLSTYLE_NUM - 1, default_t::wad_yes,
                "Doom object translucency style (0 = none, 1 = Boom, 2 = new)"),
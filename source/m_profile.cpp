@@ -0,0 +1,353 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Scoped timing zones, with an on-screen overlay and trace file output.
+//
+//      Every thread which enters a zone gets its own ring of recent zone
+//      events and its own per-frame zone totals, so recording never needs a
+//      lock. The main thread folds the totals into the overlay history at the
+//      end of each frame, when no render context is running. prof_dump writes
+//      the events of the last few frames as a Chrome trace-event JSON file,
+//      which can be opened in chrome://tracing or Perfetto.
+//
+//-----------------------------------------------------------------------------
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "z_zone.h"
+#include "c_io.h"
+#include "c_runcmd.h"
+#include "e_fonts.h"
+#include "m_profile.h"
+#include "m_qstr.h"
+#include "v_font.h"
+#include "v_misc.h"
+
+#define PROF_MAXTHREADS 32    // threads which can record zones
+#define PROF_MAXEVENTS  65536 // zone events kept per thread
+#define PROF_MAXFRAMES  256   // frame ends kept for prof_dump
+#define PROF_AVGFRAMES  35    // frames averaged by the overlay
+
+struct profevent_t
+{
+   uint64_t start;
+   uint64_t end;
+   int      zone;
+};
+
+struct profthread_t
+{
+   profevent_t *events;                  // ring of PROF_MAXEVENTS
+   unsigned int numevents;               // events ever recorded
+   uint64_t     zonetimes[NUMPROFZONES]; // time in each zone this frame
+};
+
+static const char *profzonenames[NUMPROFZONES] =
+{
+   "Frame",
+   "G_Ticker",
+   "P_Ticker",
+   "Thinkers",
+   "ACS",
+   "Particles",
+   "Sound",
+   "BSP",
+   "Planes",
+   "Portals",
+   "Masked",
+   "Blit",
+};
+
+bool prof_active;
+
+static bool prof_overlay;
+static bool prof_record;
+
+static profthread_t profthreads[PROF_MAXTHREADS];
+static std::atomic<int> profnumthreads(1);
+
+// Static initialization happens on the main thread, which is always thread 0
+static const std::thread::id profmainthread = std::this_thread::get_id();
+static thread_local int      profthreadnum  = -1;
+
+static uint64_t     profframeends[PROF_MAXFRAMES];
+static uint64_t     profhistory[PROF_AVGFRAMES][NUMPROFZONES];
+static unsigned int profnumframes;
+
+//
+// M_ProfileClock
+//
+// Returns a timestamp in nanoseconds.
+//
+uint64_t M_ProfileClock()
+{
+   return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+//
+// M_profileThread
+//
+// Returns the calling thread's recording slot, or nullptr if there are too
+// many threads.
+//
+static profthread_t *M_profileThread()
+{
+   if(profthreadnum < 0)
+   {
+      if(std::this_thread::get_id() == profmainthread)
+         profthreadnum = 0;
+      else
+         profthreadnum = profnumthreads++;
+   }
+
+   if(profthreadnum >= PROF_MAXTHREADS)
+      return nullptr;
+
+   profthread_t *pt = &profthreads[profthreadnum];
+
+   if(!pt->events)
+      pt->events = estructalloc(profevent_t, PROF_MAXEVENTS);
+
+   return pt;
+}
+
+//
+// M_ProfileRecord
+//
+// Records one visit to a zone, from start until now.
+//
+void M_ProfileRecord(int zone, uint64_t start)
+{
+   uint64_t      end = M_ProfileClock();
+   profthread_t *pt;
+
+   if(!(pt = M_profileThread()))
+      return;
+
+   profevent_t &ev = pt->events[pt->numevents++ % PROF_MAXEVENTS];
+
+   ev.start = start;
+   ev.end   = end;
+   ev.zone  = zone;
+
+   pt->zonetimes[zone] += end - start;
+}
+
+//
+// M_ProfileEndFrame
+//
+// Called on the main thread after each frame is drawn.
+//
+void M_ProfileEndFrame()
+{
+   if(!prof_active)
+      return;
+
+   uint64_t *history  = profhistory[profnumframes % PROF_AVGFRAMES];
+   int       nthreads = profnumthreads;
+
+   if(nthreads > PROF_MAXTHREADS)
+      nthreads = PROF_MAXTHREADS;
+
+   for(int zone = 0; zone < NUMPROFZONES; zone++)
+   {
+      history[zone] = 0;
+      for(int i = 0; i < nthreads; i++)
+      {
+         history[zone] += profthreads[i].zonetimes[zone];
+         profthreads[i].zonetimes[zone] = 0;
+      }
+   }
+
+   profframeends[profnumframes++ % PROF_MAXFRAMES] = M_ProfileClock();
+}
+
+//
+// M_ProfileDrawer
+//
+// Draws the average and worst time of each zone over the last second or so
+// of frames. Times on render context threads are summed, so with several
+// contexts the render zones show CPU time rather than elapsed time.
+//
+void M_ProfileDrawer()
+{
+   unsigned int numframes;
+   vfont_t     *font;
+   char         msg[64];
+   int          y = 30;
+
+   if(!prof_overlay)
+      return;
+
+   if(!(numframes = profnumframes))
+      return;
+   if(numframes > PROF_AVGFRAMES)
+      numframes = PROF_AVGFRAMES;
+
+   font = E_FontForName("ee_consolefont");
+
+   V_FontWriteText(font, "zone        avg ms  max ms", 5, y);
+   y += font->cy;
+
+   for(int zone = 0; zone < NUMPROFZONES; zone++)
+   {
+      uint64_t total = 0, worst = 0;
+
+      for(unsigned int i = 0; i < numframes; i++)
+      {
+         uint64_t time = profhistory[i][zone];
+
+         total += time;
+         if(time > worst)
+            worst = time;
+      }
+
+      psnprintf(msg, sizeof(msg), "%-10s %7.2f %7.2f", profzonenames[zone],
+                total / (numframes * 1000000.0), worst / 1000000.0);
+      V_FontWriteText(font, msg, 5, y);
+      y += font->cy;
+   }
+}
+
+//
+// M_profileWriteTrace
+//
+// Writes the zone events of the last numframes frames to a file in Chrome's
+// trace-event format. Returns false if the file could not be opened.
+//
+static bool M_profileWriteTrace(const char *filename, unsigned int numframes)
+{
+   FILE    *f;
+   uint64_t windowstart, windowend;
+   int      nthreads = profnumthreads;
+   bool     first = true;
+
+   if(nthreads > PROF_MAXTHREADS)
+      nthreads = PROF_MAXTHREADS;
+
+   if(numframes > PROF_MAXFRAMES - 1)
+      numframes = PROF_MAXFRAMES - 1;
+   if(numframes > profnumframes - 1)
+      numframes = profnumframes - 1;
+
+   // the window starts at the end of the frame before the first one wanted
+   windowstart = profframeends[(profnumframes - numframes - 1) % PROF_MAXFRAMES];
+   windowend   = profframeends[(profnumframes - 1) % PROF_MAXFRAMES];
+
+   if(!(f = fopen(filename, "w")))
+      return false;
+
+   fputs("{\"traceEvents\":[\n", f);
+
+   for(int i = 0; i < nthreads; i++)
+   {
+      const profthread_t &pt = profthreads[i];
+
+      if(!pt.events)
+         continue;
+
+      fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                 "\"args\":{\"name\":\"%s %d\"}}",
+              first ? "" : ",\n", i, i ? "worker" : "main", i);
+      first = false;
+
+      unsigned int count = pt.numevents;
+      if(count > PROF_MAXEVENTS)
+         count = PROF_MAXEVENTS;
+
+      for(unsigned int j = pt.numevents - count; j != pt.numevents; j++)
+      {
+         const profevent_t &ev = pt.events[j % PROF_MAXEVENTS];
+
+         if(ev.start < windowstart || ev.end > windowend)
+            continue;
+
+         fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"ee\",\"ph\":\"X\",\"pid\":1,"
+                    "\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                 profzonenames[ev.zone], i,
+                 (ev.start - windowstart) / 1000.0, (ev.end - ev.start) / 1000.0);
+      }
+   }
+
+   fputs("\n]}\n", f);
+   fclose(f);
+
+   return true;
+}
+
+//=============================================================================
+//
+// Console Commands
+//
+
+static void M_profileUpdateActive()
+{
+   prof_active = prof_overlay || prof_record;
+}
+
+VARIABLE_TOGGLE(prof_overlay, NULL, onoff);
+CONSOLE_VARIABLE(prof_overlay, prof_overlay, 0)
+{
+   M_profileUpdateActive();
+}
+
+VARIABLE_TOGGLE(prof_record, NULL, onoff);
+CONSOLE_VARIABLE(prof_record, prof_record, 0)
+{
+   M_profileUpdateActive();
+}
+
+CONSOLE_COMMAND(prof_dump, 0)
+{
+   unsigned int numframes = PROF_AVGFRAMES;
+
+   if(!Console.argc)
+   {
+      C_Printf("usage: prof_dump filename [frames]\n");
+      return;
+   }
+
+   if(profnumframes < 2)
+   {
+      C_Printf(FC_ERROR "No frames recorded; set prof_record or prof_overlay\n");
+      return;
+   }
+
+   if(Console.argc >= 2 && Console.argv[1]->toInt() > 0)
+      numframes = Console.argv[1]->toInt();
+
+   if(!M_profileWriteTrace(Console.argv[0]->constPtr(), numframes))
+   {
+      C_Printf(FC_ERROR "Could not write trace to %s\n",
+               Console.argv[0]->constPtr());
+   }
+   else
+      C_Printf("Wrote trace to %s\n", Console.argv[0]->constPtr());
+}
+
+// EOF
+
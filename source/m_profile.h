@@ -0,0 +1,88 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Scoped timing zones, with an on-screen overlay and trace file output.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef M_PROFILE_H__
+#define M_PROFILE_H__
+
+// Timed zones. Zones may nest, and may be entered on any thread.
+enum profzone_e
+{
+   PROF_FRAME,      // D_Display
+   PROF_GTICKER,    // G_Ticker
+   PROF_PTICKER,    // P_Ticker
+   PROF_THINKERS,   // Thinker::RunThinkers
+   PROF_ACS,        // ACS_Exec
+   PROF_PARTICLES,  // P_ParticleThinker
+   PROF_SOUND,      // S_UpdateSounds
+   PROF_BSP,        // R_RenderBSPNode, from the top node
+   PROF_PLANES,     // R_DrawPlanes
+   PROF_PORTALS,    // R_RenderPortals
+   PROF_MASKED,     // R_DrawPostBSP
+   PROF_BLIT,       // I_FinishUpdate
+   NUMPROFZONES
+};
+
+// True while zones are being timed
+extern bool prof_active;
+
+uint64_t M_ProfileClock();
+void     M_ProfileRecord(int zone, uint64_t start);
+void     M_ProfileEndFrame();
+void     M_ProfileDrawer();
+
+//
+// ProfileScope
+//
+// Times the rest of the enclosing scope as the given zone. Costs only a test
+// of prof_active when the profiler is off.
+//
+class ProfileScope
+{
+protected:
+   int      zone;
+   uint64_t start;
+
+public:
+   explicit ProfileScope(int pzone)
+      : zone(pzone), start(prof_active ? M_ProfileClock() : 0)
+   {
+   }
+
+   ~ProfileScope()
+   {
+      if(start)
+         M_ProfileRecord(zone, start);
+   }
+};
+
+#define PROFILE_ZONE(zone) ProfileScope profscope(zone)
+
+#endif
+
+// EOF
+
@@ -0,0 +1,107 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Lock-free single-producer, single-consumer queue.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef M_SPSCQUEUE_H__
+#define M_SPSCQUEUE_H__
+
+#include <atomic>
+
+//
+// SPSCQueue
+//
+// A fixed-size ring of N items, where N is a power of two, which one thread
+// may push onto while another pops from it, with neither ever waiting on the
+// other. Items are copied in and out, so T should be plain data.
+//
+template<typename T, size_t N> class SPSCQueue
+{
+   static_assert(N && !(N & (N - 1)), "SPSCQueue size must be a power of two");
+
+protected:
+   T items[N];
+
+   // kept apart so the two threads don't fight over one cache line
+   alignas(64) std::atomic<size_t> head; // next item to pop; consumer's
+   alignas(64) std::atomic<size_t> tail; // next item to push; producer's
+
+public:
+   SPSCQueue() : head(0), tail(0) {}
+
+   SPSCQueue(const SPSCQueue &) = delete;
+   SPSCQueue &operator = (const SPSCQueue &) = delete;
+
+   //
+   // push
+   //
+   // Producer only. Returns false if the queue is full.
+   //
+   bool push(const T &item)
+   {
+      size_t t = tail.load(std::memory_order_relaxed);
+
+      if(t - head.load(std::memory_order_acquire) == N)
+         return false;
+
+      items[t & (N - 1)] = item;
+      tail.store(t + 1, std::memory_order_release);
+      return true;
+   }
+
+   //
+   // pop
+   //
+   // Consumer only. Returns false if the queue is empty.
+   //
+   bool pop(T &item)
+   {
+      size_t h = head.load(std::memory_order_relaxed);
+
+      if(h == tail.load(std::memory_order_acquire))
+         return false;
+
+      item = items[h & (N - 1)];
+      head.store(h + 1, std::memory_order_release);
+      return true;
+   }
+
+   //
+   // isEmpty
+   //
+   // Only a hint on either thread, as the other may change it at any time.
+   //
+   bool isEmpty() const
+   {
+      return head.load(std::memory_order_acquire) ==
+             tail.load(std::memory_order_acquire);
+   }
+};
+
+#endif
+
+// EOF
+
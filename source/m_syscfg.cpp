@@ -41,6 +41,7 @@
 #include "m_misc.h"
 #include "m_shots.h"
 #include "mn_menus.h"
+#include "s_mixer.h"
 #include "s_sound.h"
 #include "s_sndseq.h"
 #include "w_wad.h"
@@ -163,8 +164,8 @@ static default_t sysdefaults[] =
                "Percentage of normal speed (35 fps) realtic clock runs at"),
 
    // killough
-   DEFAULT_INT("snd_channels", &default_numChannels, NULL, 32, 1, 32, default_t::wad_no,
-               "number of sound effects handled simultaneously"),
+   DEFAULT_INT("snd_channels", &default_numChannels, NULL, 128, 1, MAXSNDCHANNELS,
+               default_t::wad_no, "number of sound effects handled simultaneously"),
 
    // haleyjd 12/08/01
    DEFAULT_INT("force_flip_pan", &forceFlipPan, NULL, 0, 0, 1, default_t::wad_no,
@@ -189,6 +190,10 @@ static default_t sysdefaults[] =
    DEFAULT_FLOAT("s_highgain", &s_highgain, NULL, 0.8, 0, 300, default_t::wad_no,
                  "High pass gain"),  
 
+   DEFAULT_INT("s_interpolation", &s_interpolation, NULL, S_INTERP_LINEAR, S_INTERP_NONE,
+               S_INTERP_CUBIC, default_t::wad_no,
+               "Sound effect resampling: 0 = none, 1 = linear, 2 = cubic"),
+
    DEFAULT_INT("s_enviro_volume", &s_enviro_volume, NULL, 4, 0, 16, default_t::wad_no,
                "Volume of environmental sound sequences"),
 
@@ -0,0 +1,199 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Fixed-size pool of persistent worker threads.
+//
+//-----------------------------------------------------------------------------
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "z_zone.h"
+#include "m_threadpool.h"
+
+//
+// Private implementation. Every worker waits for the job generation to
+// change, runs the job with its own index, and reports back by decrementing
+// the pending count. The generation counter rather than a flag is what lets
+// a worker tell a new job from the one it has already run.
+//
+struct ThreadPool::pimpl_t
+{
+   std::mutex               mutex;
+   std::condition_variable  jobready;
+   std::condition_variable  jobdone;
+   std::vector<std::thread> threads;
+
+   jobfn_t      job        = nullptr;
+   void        *jobdata    = nullptr;
+   unsigned int generation = 0;
+   int          pending    = 0;
+   int          quitfrom   = 0;  // workers with index >= this should exit
+
+   void workerLoop(int threadnum, unsigned int seen);
+};
+
+//
+// ThreadPool::pimpl_t::workerLoop
+//
+// seen is the generation current when the worker was spawned, so that a
+// worker added by resize doesn't mistake the last job run for a new one.
+//
+void ThreadPool::pimpl_t::workerLoop(int threadnum, unsigned int seen)
+{
+   for(;;)
+   {
+      jobfn_t fn;
+      void   *data;
+      {
+         std::unique_lock<std::mutex> lock(mutex);
+         jobready.wait(lock, [&] {
+            return generation != seen || (quitfrom && threadnum >= quitfrom);
+         });
+
+         if(quitfrom && threadnum >= quitfrom)
+            return;
+
+         seen = generation;
+         fn   = job;
+         data = jobdata;
+      }
+
+      fn(threadnum, data);
+
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         if(--pending == 0)
+            jobdone.notify_one();
+      }
+   }
+}
+
+//
+// ThreadPool Constructor
+//
+// A new pool only has the calling thread.
+//
+ThreadPool::ThreadPool() : pImpl(new pimpl_t), numthreads(1)
+{
+}
+
+//
+// ThreadPool Destructor
+//
+ThreadPool::~ThreadPool()
+{
+   resize(1);
+   delete pImpl;
+}
+
+//
+// ThreadPool::resize
+//
+// Sets the total number of threads in the pool, counting the calling thread.
+// Must not be called while a job is running.
+//
+void ThreadPool::resize(int newnumthreads)
+{
+   if(newnumthreads < 1)
+      newnumthreads = 1;
+
+   if(newnumthreads == numthreads)
+      return;
+
+   if(newnumthreads < numthreads)
+   {
+      // ask the surplus workers to exit, then wait for them
+      {
+         std::lock_guard<std::mutex> lock(pImpl->mutex);
+         pImpl->quitfrom = newnumthreads;
+      }
+      pImpl->jobready.notify_all();
+
+      for(int i = newnumthreads; i < numthreads; i++)
+         pImpl->threads[i - 1].join();
+
+      pImpl->threads.resize(newnumthreads - 1);
+      pImpl->quitfrom = 0;
+   }
+   else
+   {
+      unsigned int generation;
+      {
+         std::lock_guard<std::mutex> lock(pImpl->mutex);
+         generation = pImpl->generation;
+      }
+
+      for(int i = numthreads; i < newnumthreads; i++)
+         pImpl->threads.emplace_back(&pimpl_t::workerLoop, pImpl, i, generation);
+   }
+
+   numthreads = newnumthreads;
+}
+
+//
+// ThreadPool::run
+//
+// Calls fn(threadnum, data) once on every thread of the pool, with the calling
+// thread taking index 0, and returns when all calls have finished.
+//
+void ThreadPool::run(jobfn_t fn, void *data)
+{
+   if(numthreads > 1)
+   {
+      {
+         std::lock_guard<std::mutex> lock(pImpl->mutex);
+         pImpl->job     = fn;
+         pImpl->jobdata = data;
+         pImpl->pending = numthreads - 1;
+         ++pImpl->generation;
+      }
+      pImpl->jobready.notify_all();
+   }
+
+   fn(0, data);
+
+   if(numthreads > 1)
+   {
+      std::unique_lock<std::mutex> lock(pImpl->mutex);
+      pImpl->jobdone.wait(lock, [this] { return pImpl->pending == 0; });
+   }
+}
+
+//
+// ThreadPool::HardwareThreads
+//
+// Returns the number of hardware threads available, or 1 if unknown.
+//
+int ThreadPool::HardwareThreads()
+{
+   unsigned int count = std::thread::hardware_concurrency();
+
+   return count ? int(count) : 1;
+}
+
+// EOF
+
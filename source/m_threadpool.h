@@ -0,0 +1,71 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Fixed-size pool of persistent worker threads.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef M_THREADPOOL_H__
+#define M_THREADPOOL_H__
+
+//
+// ThreadPool
+//
+// Runs a job once on each thread of the pool, where the calling thread acts
+// as thread 0. Worker threads persist between jobs, so any thread_local data
+// a job builds up stays with the same thread index from one run to the next.
+// Jobs that want dynamic load balancing should share an atomic counter
+// through their data pointer.
+//
+// Pools are intended to live for the life of the program; threads are only
+// joined when the pool shrinks.
+//
+class ThreadPool
+{
+public:
+   typedef void (*jobfn_t)(int threadnum, void *data);
+
+   ThreadPool();
+   ~ThreadPool();
+
+   ThreadPool(const ThreadPool &) = delete;
+   ThreadPool &operator = (const ThreadPool &) = delete;
+
+   void resize(int numthreads);
+   int  getNumThreads() const { return numthreads; }
+   void run(jobfn_t fn, void *data);
+
+   static int HardwareThreads();
+
+protected:
+   struct pimpl_t;
+
+   pimpl_t *pImpl;
+   int      numthreads; // including the calling thread
+};
+
+#endif
+
+// EOF
+
@@ -2266,6 +2266,7 @@ static menuitem_t mn_sound_items[] =
    {it_info,       "Misc"},
    {it_toggle,     "Precache sounds",              "s_precache"},
    {it_toggle,     "Pitched sounds",               "s_pitched"},
+   {it_toggle,     "Sample interpolation",         "s_interpolation"},
    {it_end}
 };
 
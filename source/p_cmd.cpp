@@ -46,6 +46,7 @@
 #include "p_mobj.h"
 #include "p_inter.h"
 #include "p_spec.h"
+#include "p_tick.h"
 #include "p_user.h"
 #include "r_draw.h"
 #include "v_misc.h"
@@ -323,6 +324,10 @@ CONSOLE_VARIABLE(donut_emulation, donut_emulation, 0) {}
 VARIABLE_BOOLEAN(p_markunknowns, NULL, yesno);
 CONSOLE_VARIABLE(p_markunknowns, p_markunknowns, 0) {}
 
+// run sector-local thinkers in parallel outside of demos and netgames
+VARIABLE_TOGGLE(p_parallelthinkers, NULL, onoff);
+CONSOLE_VARIABLE(p_parallelthinkers, p_parallelthinkers, 0) {}
+
 // haleyjd 10/09/07
 extern int wipewait;
 
@@ -59,6 +59,7 @@
 #include "p_mobjcol.h"
 #include "p_partcl.h"
 #include "p_setup.h"
+#include "p_soundgraph.h"
 #include "p_spec.h"
 #include "p_tick.h"
 #include "r_defs.h"
@@ -82,99 +83,6 @@ static Mobj *current_actor;
 // but some can be made preaware
 //
 
-//
-// P_RecursiveSound
-//
-// Called by P_NoiseAlert.
-// Recursively traverse adjacent sectors,
-// sound blocking lines cut off traversal.
-//
-// killough 5/5/98: reformatted, cleaned up
-//
-static void P_RecursiveSound(sector_t *sec, int soundblocks,
-                             Mobj *soundtarget)
-{
-   int i;
-   
-   // wake up all monsters in this sector
-   if(sec->validcount == validcount &&
-      sec->soundtraversed <= soundblocks+1)
-      return;             // already flooded
-
-   sec->validcount = validcount;
-   sec->soundtraversed = soundblocks+1;
-   P_SetTarget<Mobj>(&sec->soundtarget, soundtarget);    // killough 11/98
-
-#ifdef R_LINKEDPORTALS
-   if(sec->f_pflags & PS_PASSSOUND)
-   {
-      // Ok, because the same portal can be used on many sectors and even
-      // lines, the portal structure won't tell you what sector is on the
-      // other side of the portal. SO
-      sector_t *other;
-      line_t *check = sec->lines[0];
-
-      other = 
-         R_PointInSubsector(((check->v1->x + check->v2->x) / 2) 
-                             + R_FPLink(sec)->deltax,
-                            ((check->v1->y + check->v2->y) / 2) 
-                             + R_FPLink(sec)->deltay)->sector;
-
-      P_RecursiveSound(other, soundblocks, soundtarget);
-   }
-   
-   if(sec->c_pflags & PS_PASSSOUND)
-   {
-      // Ok, because the same portal can be used on many sectors and even 
-      // lines, the portal structure won't tell you what sector is on the 
-      // other side of the portal. SO
-      sector_t *other;
-      line_t *check = sec->lines[0];
-
-      other = 
-         R_PointInSubsector(((check->v1->x + check->v2->x) / 2) 
-                             + R_CPLink(sec)->deltax,
-                            ((check->v1->y + check->v2->y) / 2) 
-                             + R_CPLink(sec)->deltay)->sector;
-
-      P_RecursiveSound(other, soundblocks, soundtarget);
-   }
-#endif
-
-   for(i=0; i<sec->linecount; i++)
-   {
-      sector_t *other;
-      line_t *check = sec->lines[i];
-      
-#ifdef R_LINKEDPORTALS
-      if(check->pflags & PS_PASSSOUND)
-      {
-         sector_t *iother;
-
-         iother = 
-         R_PointInSubsector(((check->v1->x + check->v2->x) / 2) + check->portal->data.link.deltax,
-                            ((check->v1->y + check->v2->y) / 2) + check->portal->data.link.deltay)->sector;
-
-         P_RecursiveSound(iother, soundblocks, soundtarget);
-      }
-#endif
-      if(!(check->flags & ML_TWOSIDED))
-         continue;
-
-      P_LineOpening(check, NULL);
-      
-      if(clip.openrange <= 0)
-         continue;       // closed door
-
-      other=sides[check->sidenum[sides[check->sidenum[0]].sector==sec]].sector;
-      
-      if(!(check->flags & ML_SOUNDBLOCK))
-         P_RecursiveSound(other, soundblocks, soundtarget);
-      else if(!soundblocks)
-         P_RecursiveSound(other, 1, soundtarget);
-   }
-}
-
 //
 // P_NoiseAlert
 //
@@ -184,7 +92,7 @@ static void P_RecursiveSound(sector_t *sec, int soundblocks,
 void P_NoiseAlert(Mobj *target, Mobj *emitter)
 {
    validcount++;
-   P_RecursiveSound(emitter->subsector->sector, 0, target);
+   P_PropagateSound(emitter->subsector->sector, target);
 }
 
 //
@@ -26,6 +26,7 @@
 
 #include "z_zone.h"
 
+#include "acs_intr.h"
 #include "c_io.h"
 #include "doomstat.h"
 #include "m_argv.h"
@@ -678,6 +679,7 @@ int EV_DoFloorAndCeiling(const line_t *line, int tag, const floordata_t &fd,
       {
          sectors[secnum].ceilingdata = nullptr;
       }
+      ACS_SignalTag(ACS_TAGTYPE_SECTOR, tag);
    }
    int ceiling = EV_DoParamCeiling(line, tag, &cd);
    return floor || ceiling ? 1 : 0;
@@ -86,6 +86,9 @@ char *temp_hubfile(void)
 void P_ClearHubs(void)
 {
    int i;
+
+   // don't let a level still being saved turn up again
+   P_FinishSaveWrite();
    
    for(i=0; i<num_hub_levels; i++)
    {
@@ -174,6 +174,16 @@ void StrobeThinker::Think()
    }
 }
 
+//
+// StrobeThinker::parallelKey
+//
+// Strobe lights only change their own sector.
+//
+int StrobeThinker::parallelKey() const
+{
+   return eindex(sector - sectors);
+}
+
 //
 // StrobeThinker::serialize
 //
@@ -247,6 +257,16 @@ void GlowThinker::Think()
    }
 }
 
+//
+// GlowThinker::parallelKey
+//
+// Glowing lights only change their own sector.
+//
+int GlowThinker::parallelKey() const
+{
+   return eindex(sector - sectors);
+}
+
 //
 // GlowThinker::serialize
 //
@@ -297,6 +317,16 @@ void SlowGlowThinker::Think()
    }
 }
 
+//
+// SlowGlowThinker::parallelKey
+//
+// Glowing lights only change their own sector.
+//
+int SlowGlowThinker::parallelKey() const
+{
+   return eindex(sector - sectors);
+}
+
 //
 // SlowGlowThinker::serialize
 //
@@ -356,6 +386,17 @@ void LightFadeThinker::Think()
    }
 }
 
+//
+// LightFadeThinker::parallelKey
+//
+// A fade which will remove itself when done must run serially; looping
+// glows only change their own sector.
+//
+int LightFadeThinker::parallelKey() const
+{
+   return type == fade_once ? -1 : eindex(sector - sectors);
+}
+
 //
 // LightFadeThinker::serialize
 //
@@ -399,6 +440,16 @@ void PhasedLightThinker::Think()
    sector->lightlevel = base + phaseTable[index];
 }
 
+//
+// PhasedLightThinker::parallelKey
+//
+// Phased lights only change their own sector.
+//
+int PhasedLightThinker::parallelKey() const
+{
+   return eindex(sector - sectors);
+}
+
 //
 // PhasedLightThinker::serialize
 //
@@ -74,6 +74,7 @@
 #include "st_stuff.h"
 #include "v_misc.h"
 #include "v_video.h"
+#include "z_pool.h"
 
 // Local constants (ioanch)
 // Bounding box distance to avoid and get away from edge portals
@@ -1350,6 +1351,38 @@ bool Mobj::shouldApplyTorque()
 // Mobj RTTI Proxy Type
 IMPLEMENT_THINKER_TYPE(Mobj)
 
+// Mobjs are allocated 256 at a time, so that the ones spawned together with
+// a level stay together in memory
+static ZonePool mobjpool(sizeof(Mobj), 256, PU_LEVEL);
+
+//
+// Mobj::operator new
+//
+// Takes a zero-filled Mobj from mobjpool. A derived class which is bigger
+// than Mobj gets a zone block of its own, as other thinkers do.
+//
+void *Mobj::operator new (size_t size)
+{
+   if(size != sizeof(Mobj))
+      return Super::operator new(size);
+
+   return mobjpool.alloc();
+}
+
+//
+// Mobj::operator delete
+//
+// The size is that of the object's dynamic type, thanks to the virtual
+// destructor, so it says where the memory came from.
+//
+void Mobj::operator delete (void *p, size_t size)
+{
+   if(size != sizeof(Mobj))
+      ZoneObject::operator delete(p);
+   else
+      mobjpool.free(p);
+}
+
 //
 // Routine to check mobj projection, from wherever the coordinates might change
 //
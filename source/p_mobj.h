@@ -225,6 +225,10 @@ public:
    virtual void serialize(SaveArchive &arc) override;
    virtual void deSwizzle() override;
 
+   // Mobjs are packed together in a pool of level memory
+   void *operator new (size_t size);
+   void  operator delete (void *p, size_t size);
+
    // Methods
    void backupPosition();
    void copyPosition(const Mobj *other);
@@ -428,6 +432,7 @@ Mobj *P_SpawnPuff(fixed_t x, fixed_t y, fixed_t z, angle_t dir, int updown,
                   bool ptcl, const MetaTable *pufftype = nullptr,
                   const Mobj *hitmobj = nullptr);
 void  P_SpawnUnknownThings();
+int   P_FindDoomedNum(int type);
 Mobj *P_SpawnMapThing(mapthing_t *mt);
 bool  P_CheckMissileSpawn(Mobj *);  // killough 8/2/98
 void  P_ExplodeMissile(Mobj *, const sector_t *topedgesec);     // killough
@@ -0,0 +1,1252 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Internal BSP node builder for maps which come without nodes.
+//
+//      The builder works on the vertices and linedefs as loaded and puts
+//      out ZDoom uncompressed GL nodes, version 3, so that the result goes
+//      through the same loader as nodes read from a ZNODES lump. Every
+//      subsector is a closed convex polygon: the gaps between its segs are
+//      filled with minisegs along the edges of the region left after
+//      cutting the map by every partition line above it.
+//
+//      Partition lines are taken from the linedefs, and split points are
+//      always worked out from the whole linedef, so both sides of a line are
+//      split at exactly the same vertex no matter how often they have been
+//      split before. Choosing a partition means trying each candidate line
+//      against every seg in the node; for large nodes the candidates are
+//      handed out to a pool of threads. The choice does not depend on how
+//      many threads there are, so the output is the same on any machine.
+//
+//      Built nodes are written to the nodes directory under the user game
+//      path, named by a hash of the level geometry, and read back from there
+//      the next time the same level is loaded.
+//
+//-----------------------------------------------------------------------------
+
+#include <atomic>
+
+#include "z_zone.h"
+#include "hal/i_directory.h"
+#include "hal/i_timer.h"
+#include "c_io.h"
+#include "doomstat.h"
+#include "m_argv.h"
+#include "m_bbox.h"
+#include "m_collection.h"
+#include "m_compare.h"
+#include "m_hash.h"
+#include "m_qstr.h"
+#include "m_threadpool.h"
+#include "m_utils.h"
+#include "p_nodebuild.h"
+#include "r_defs.h"
+#include "r_state.h"
+
+// Bump whenever the builder would give different output for the same map,
+// so that cached nodes from an older builder are not used.
+#define NB_VERSION       1
+
+// Distance in map units within which a point counts as on a line
+#define NB_EPSILON       (1.0 / 256.0)
+
+// How much worse one split seg is than one seg of imbalance
+#define NB_SPLITCOST     8
+
+// Most partition lines tried first for a node
+#define NB_MAXCANDIDATES 512
+
+// Candidates times segs above which partition choice is threaded
+#define NB_THREADWORK    (1 << 18)
+
+#define NB_MAXTHREADS    8
+#define NB_VERTEXHASH    (1 << 16)
+#define NB_NOLINE        0xffffffffu
+
+enum
+{
+   NB_FRONT,
+   NB_BACK,
+   NB_SPLIT
+};
+
+struct nbvertex_t
+{
+   fixed_t fx, fy;
+   double  x, y;
+   int     next;     // hash chain; new vertices only
+};
+
+// A linedef as a partition line, running from v1 to v2
+struct nbline_t
+{
+   double x, y;
+   double dx, dy;
+   double len;
+};
+
+struct nbseg_t
+{
+   int v1, v2;
+   int linedef;
+   int side;
+};
+
+// A partition above the node being built, and the side of it we are on
+struct nbplane_t
+{
+   int    linedef;
+   double sign;
+};
+
+struct nbpoint_t
+{
+   double x, y;
+   int    vertex;   // or -1 if not a vertex yet
+};
+
+struct nboutseg_t
+{
+   uint32_t v1;
+   uint32_t linedef;
+   uint8_t  side;
+};
+
+struct nbnode_t
+{
+   fixed_t x, y, dx, dy;
+   int16_t bbox[2][4];
+   int32_t children[2];
+};
+
+struct nbedgeseg_t
+{
+   int    edge;
+   double t;
+   int    seg;
+};
+
+static ThreadPool nodepool;
+
+//
+// P_lineDist
+//
+// Signed distance of a point from a linedef's line; positive is in front.
+//
+static inline double P_lineDist(const nbline_t &line, double x, double y)
+{
+   return ((x - line.x) * line.dy - (y - line.y) * line.dx) / line.len;
+}
+
+class NodeBuilder
+{
+protected:
+   PODCollection<nbvertex_t>  vertices;
+   PODCollection<nbline_t>    nblines;
+   PODCollection<nbseg_t>     segs;
+   PODCollection<nbplane_t>   planes;
+   PODCollection<nboutseg_t>  outsegs;
+   PODCollection<uint32_t>    outsubsectors;
+   PODCollection<nbnode_t>    outnodes;
+   PODCollection<int>         linestamps;
+   int     *vertexhash;
+   int      linestamp;
+   int      numorgverts;
+   double   mapbox[4];
+
+   int  addVertex(fixed_t x, fixed_t y);
+   int  splitVertex(const nbline_t &part, int linedef);
+   int  classify(const nbseg_t &part, const nbseg_t &seg,
+                 double &d1, double &d2) const;
+   void gatherCandidates(const int *list, int count, PODCollection<int> &cands);
+   int  pickPartition(const int *list, int count, const int *cands,
+                      int numcands);
+   int  choosePartition(const int *list, int count);
+   void divide(int partseg, const int *list, int count,
+               PODCollection<int> &front, PODCollection<int> &back);
+   void addOutSeg(int v1, uint32_t linedef, int side);
+   int  vertexFor(const nbpoint_t &pt);
+   bool chainPolygon(const int *list, int count);
+   void chainFallback(const int *list, int count);
+   int  makeLeaf(const int *list, int count);
+   int  buildNode(PODCollection<int> &list, double *bbox);
+
+public:
+   NodeBuilder();
+   ~NodeBuilder();
+
+   int   evaluate(int partseg, const int *list, int count, int bestcost) const;
+   byte *build(int &length);
+};
+
+//
+// NodeBuilder Constructor
+//
+// Makes a seg for every side of every linedef.
+//
+NodeBuilder::NodeBuilder() : linestamp(0), numorgverts(numvertexes)
+{
+   vertexhash = emalloc(int *, NB_VERTEXHASH * sizeof(int));
+   for(int i = 0; i < NB_VERTEXHASH; i++)
+      vertexhash[i] = -1;
+
+   mapbox[BOXTOP]    = mapbox[BOXRIGHT] = -1e9;
+   mapbox[BOXBOTTOM] = mapbox[BOXLEFT]  =  1e9;
+
+   for(int i = 0; i < numvertexes; i++)
+   {
+      nbvertex_t &v = vertices.addNew();
+      v.fx   = vertexes[i].x;
+      v.fy   = vertexes[i].y;
+      v.x    = M_FixedToDouble(v.fx);
+      v.y    = M_FixedToDouble(v.fy);
+      v.next = -1;
+
+      mapbox[BOXTOP]    = emax(mapbox[BOXTOP],    v.y);
+      mapbox[BOXBOTTOM] = emin(mapbox[BOXBOTTOM], v.y);
+      mapbox[BOXLEFT]   = emin(mapbox[BOXLEFT],   v.x);
+      mapbox[BOXRIGHT]  = emax(mapbox[BOXRIGHT],  v.x);
+   }
+
+   for(int i = 0; i < numlines; i++)
+   {
+      const line_t &li = lines[i];
+      nbline_t &nl = nblines.addNew();
+      int v1 = eindex(li.v1 - vertexes);
+      int v2 = eindex(li.v2 - vertexes);
+
+      linestamps.add(0);
+
+      nl.x   = vertices[v1].x;
+      nl.y   = vertices[v1].y;
+      nl.dx  = vertices[v2].x - nl.x;
+      nl.dy  = vertices[v2].y - nl.y;
+      nl.len = sqrt(nl.dx * nl.dx + nl.dy * nl.dy);
+
+      // zero-length lines can't be rendered or split by
+      if(nl.len < NB_EPSILON)
+      {
+         nl.len = 1.0;
+         continue;
+      }
+
+      for(int side = 0; side < 2; side++)
+      {
+         if(li.sidenum[side] == -1)
+            continue;
+
+         nbseg_t &seg = segs.addNew();
+         seg.v1      = side ? v2 : v1;
+         seg.v2      = side ? v1 : v2;
+         seg.linedef = i;
+         seg.side    = side;
+      }
+   }
+}
+
+//
+// NodeBuilder Destructor
+//
+NodeBuilder::~NodeBuilder()
+{
+   efree(vertexhash);
+}
+
+//
+// NodeBuilder::addVertex
+//
+// Returns a new vertex, or the one already made at the same spot.
+//
+int NodeBuilder::addVertex(fixed_t x, fixed_t y)
+{
+   unsigned int h = (unsigned int)(x * 73856093 ^ y * 19349663) & (NB_VERTEXHASH - 1);
+
+   for(int i = vertexhash[h]; i != -1; i = vertices[i].next)
+   {
+      if(vertices[i].fx == x && vertices[i].fy == y)
+         return i;
+   }
+
+   nbvertex_t &v = vertices.addNew();
+   v.fx   = x;
+   v.fy   = y;
+   v.x    = M_FixedToDouble(x);
+   v.y    = M_FixedToDouble(y);
+   v.next = vertexhash[h];
+
+   return vertexhash[h] = int(vertices.getLength() - 1);
+}
+
+//
+// NodeBuilder::splitVertex
+//
+// Gets the vertex where a partition crosses a linedef. The crossing point is
+// worked out along the whole linedef, not the seg being split, so that the
+// segs on both sides of it meet at the same vertex.
+//
+int NodeBuilder::splitVertex(const nbline_t &part, int linedef)
+{
+   const nbline_t &line = nblines[linedef];
+   double a = P_lineDist(part, line.x, line.y);
+   double b = P_lineDist(part, line.x + line.dx, line.y + line.dy);
+   double t = a / (a - b);
+   double x = line.x + t * line.dx;
+   double y = line.y + t * line.dy;
+
+   return addVertex(fixed_t(floor(x * FRACUNIT + 0.5)),
+                    fixed_t(floor(y * FRACUNIT + 0.5)));
+}
+
+//
+// NodeBuilder::classify
+//
+// Says which side of a partition seg a seg lies on, or whether it must be
+// split. Segs lying along the partition go to the side they face.
+//
+int NodeBuilder::classify(const nbseg_t &part, const nbseg_t &seg,
+                          double &d1, double &d2) const
+{
+   if(seg.linedef == part.linedef)
+      return seg.side == part.side ? NB_FRONT : NB_BACK;
+
+   const nbline_t   &line = nblines[part.linedef];
+   const nbvertex_t &v1   = vertices[seg.v1];
+   const nbvertex_t &v2   = vertices[seg.v2];
+   double sign = part.side ? -1.0 : 1.0;
+
+   d1 = sign * P_lineDist(line, v1.x, v1.y);
+   d2 = sign * P_lineDist(line, v2.x, v2.y);
+
+   if(fabs(d1) <= NB_EPSILON && fabs(d2) <= NB_EPSILON)
+   {
+      double dot = (v2.x - v1.x) * line.dx + (v2.y - v1.y) * line.dy;
+      return dot * sign > 0 ? NB_FRONT : NB_BACK;
+   }
+   if(d1 >= -NB_EPSILON && d2 >= -NB_EPSILON)
+      return NB_FRONT;
+   if(d1 <= NB_EPSILON && d2 <= NB_EPSILON)
+      return NB_BACK;
+
+   return NB_SPLIT;
+}
+
+//
+// NodeBuilder::evaluate
+//
+// Scores a partition seg against a list of segs; lower is better. Gives
+// up and returns INT_MAX as soon as the score can't beat bestcost, or if
+// the partition doesn't divide the list at all.
+//
+int NodeBuilder::evaluate(int partseg, const int *list, int count,
+                          int bestcost) const
+{
+   const nbseg_t &part = segs[partseg];
+   int front = 0, back = 0, splits = 0;
+
+   for(int i = 0; i < count; i++)
+   {
+      double d1, d2;
+
+      switch(classify(part, segs[list[i]], d1, d2))
+      {
+      case NB_FRONT:
+         ++front;
+         break;
+      case NB_BACK:
+         ++back;
+         break;
+      default:
+         ++splits;
+         if(splits * NB_SPLITCOST > bestcost)
+            return INT_MAX;
+         break;
+      }
+   }
+
+   if(!splits && (!front || !back))
+      return INT_MAX;
+
+   return splits * NB_SPLITCOST + abs(front - back);
+}
+
+//
+// NodeBuilder::gatherCandidates
+//
+// Lists one seg from each linedef in the list.
+//
+void NodeBuilder::gatherCandidates(const int *list, int count,
+                                   PODCollection<int> &cands)
+{
+   ++linestamp;
+
+   for(int i = 0; i < count; i++)
+   {
+      int linedef = segs[list[i]].linedef;
+
+      if(linestamps[linedef] != linestamp)
+      {
+         linestamps[linedef] = linestamp;
+         cands.add(list[i]);
+      }
+   }
+}
+
+struct nbjob_t
+{
+   const NodeBuilder *builder;
+   const int         *list;
+   int                count;
+   const int         *cands;
+   int                numcands;
+   std::atomic<int>   next;
+   std::atomic<int>   bestcost;
+   int                threadcost[NB_MAXTHREADS];
+   int                threadcand[NB_MAXTHREADS];
+};
+
+//
+// P_partitionJob
+//
+// Thread job for NodeBuilder::pickPartition. Candidates are handed out one
+// at a time; each thread keeps its own best, preferring the earliest
+// candidate on a tie so the overall answer is the same however the work
+// was shared out.
+//
+static void P_partitionJob(int threadnum, void *data)
+{
+   nbjob_t *job = static_cast<nbjob_t *>(data);
+   int bestcost = INT_MAX;
+   int bestcand = -1;
+   int c;
+
+   while((c = job->next.fetch_add(1)) < job->numcands)
+   {
+      int cost = job->builder->evaluate(job->cands[c], job->list, job->count,
+                                        job->bestcost.load());
+
+      if(cost < bestcost || (cost == bestcost && cost != INT_MAX && c < bestcand))
+      {
+         bestcost = cost;
+         bestcand = c;
+
+         int shared = job->bestcost.load();
+         while(cost < shared && !job->bestcost.compare_exchange_weak(shared, cost))
+            ;
+      }
+   }
+
+   job->threadcost[threadnum] = bestcost;
+   job->threadcand[threadnum] = bestcand;
+}
+
+//
+// NodeBuilder::pickPartition
+//
+// Returns the best of the candidate segs to partition the list by, or -1 if
+// none of them divides it.
+//
+int NodeBuilder::pickPartition(const int *list, int count, const int *cands,
+                               int numcands)
+{
+   nbjob_t job;
+   int     numthreads = 1;
+
+   if((int64_t)numcands * count >= NB_THREADWORK)
+   {
+      if(nodepool.getNumThreads() == 1)
+         nodepool.resize(emin(ThreadPool::HardwareThreads(), NB_MAXTHREADS));
+      numthreads = nodepool.getNumThreads();
+   }
+
+   job.builder  = this;
+   job.list     = list;
+   job.count    = count;
+   job.cands    = cands;
+   job.numcands = numcands;
+   job.next     = 0;
+   job.bestcost = INT_MAX;
+
+   if(numthreads > 1)
+      nodepool.run(P_partitionJob, &job);
+   else
+      P_partitionJob(0, &job);
+
+   int bestcost = INT_MAX;
+   int bestcand = -1;
+
+   for(int i = 0; i < numthreads; i++)
+   {
+      if(job.threadcand[i] < 0)
+         continue;
+      if(job.threadcost[i] < bestcost ||
+         (job.threadcost[i] == bestcost && job.threadcand[i] < bestcand))
+      {
+         bestcost = job.threadcost[i];
+         bestcand = job.threadcand[i];
+      }
+   }
+
+   return bestcand >= 0 && bestcost != INT_MAX ? cands[bestcand] : -1;
+}
+
+//
+// NodeBuilder::choosePartition
+//
+// Returns the seg to partition the list by, or -1 if the list is convex.
+// Nodes with very many lines only try an even spread of them at first, but
+// every line is tried before deciding that a node is convex.
+//
+int NodeBuilder::choosePartition(const int *list, int count)
+{
+   PODCollection<int> cands;
+   int part;
+
+   gatherCandidates(list, count, cands);
+
+   int numcands = int(cands.getLength());
+
+   if(numcands > NB_MAXCANDIDATES)
+   {
+      PODCollection<int> some;
+
+      for(int i = 0; i < NB_MAXCANDIDATES; i++)
+         some.add(cands[size_t(int64_t(i) * numcands / NB_MAXCANDIDATES)]);
+
+      if((part = pickPartition(list, count, some.begin(), NB_MAXCANDIDATES)) >= 0)
+         return part;
+   }
+
+   return pickPartition(list, count, cands.begin(), numcands);
+}
+
+//
+// NodeBuilder::divide
+//
+// Sorts the list into the segs in front of and behind a partition,
+// splitting the ones it crosses.
+//
+void NodeBuilder::divide(int partseg, const int *list, int count,
+                         PODCollection<int> &front, PODCollection<int> &back)
+{
+   const nbseg_t  part = segs[partseg];
+   const nbline_t pline = nblines[part.linedef];
+
+   for(int i = 0; i < count; i++)
+   {
+      int     idx = list[i];
+      nbseg_t seg = segs[idx];
+      double  d1, d2;
+
+      switch(classify(part, seg, d1, d2))
+      {
+      case NB_FRONT:
+         front.add(idx);
+         break;
+      case NB_BACK:
+         back.add(idx);
+         break;
+      default:
+         {
+            int     v   = splitVertex(pline, seg.linedef);
+            nbseg_t tail = seg;
+            int     tidx = int(segs.getLength());
+
+            tail.v1 = v;
+            segs[idx].v2 = v;
+            segs.add(tail);
+
+            if(d1 > 0)
+            {
+               front.add(idx);
+               back.add(tidx);
+            }
+            else
+            {
+               back.add(idx);
+               front.add(tidx);
+            }
+         }
+         break;
+      }
+   }
+}
+
+//
+// NodeBuilder::addOutSeg
+//
+void NodeBuilder::addOutSeg(int v1, uint32_t linedef, int side)
+{
+   nboutseg_t &os = outsegs.addNew();
+
+   os.v1      = uint32_t(v1);
+   os.linedef = linedef;
+   os.side    = uint8_t(side);
+}
+
+//
+// NodeBuilder::vertexFor
+//
+// Gets a vertex for a point on a subsector's outline.
+//
+int NodeBuilder::vertexFor(const nbpoint_t &pt)
+{
+   if(pt.vertex >= 0)
+      return pt.vertex;
+
+   return addVertex(fixed_t(floor(pt.x * FRACUNIT + 0.5)),
+                    fixed_t(floor(pt.y * FRACUNIT + 0.5)));
+}
+
+//
+// P_clipPolygon
+//
+// Cuts a convex polygon down to the part in front of a line.
+//
+static void P_clipPolygon(PODCollection<nbpoint_t> &poly, const nbline_t &line,
+                          double sign)
+{
+   PODCollection<nbpoint_t> out;
+   size_t n = poly.getLength();
+
+   for(size_t i = 0; i < n; i++)
+   {
+      const nbpoint_t &a = poly[i];
+      const nbpoint_t &b = poly[(i + 1) % n];
+      double da = sign * P_lineDist(line, a.x, a.y);
+      double db = sign * P_lineDist(line, b.x, b.y);
+
+      if(da >= 0)
+         out.add(a);
+      if((da >= 0) != (db >= 0))
+      {
+         double t = da / (da - db);
+         nbpoint_t &p = out.addNew();
+         p.x      = a.x + t * (b.x - a.x);
+         p.y      = a.y + t * (b.y - a.y);
+         p.vertex = -1;
+      }
+   }
+
+   // drop corners which came out on top of each other
+   poly.makeEmpty();
+   for(size_t i = 0; i < out.getLength(); i++)
+   {
+      const nbpoint_t &p = out[i];
+      const nbpoint_t &q = out[(i + 1) % out.getLength()];
+
+      if(fabs(p.x - q.x) > NB_EPSILON || fabs(p.y - q.y) > NB_EPSILON)
+         poly.add(p);
+   }
+}
+
+//
+// P_straightenPolygon
+//
+// Removes corners lying on the line between their neighbours. A partition
+// crossing a seg's line leaves such a corner in the middle of the seg, which
+// would otherwise split it across two edges of the outline.
+//
+static void P_straightenPolygon(PODCollection<nbpoint_t> &poly)
+{
+   size_t i = 0;
+
+   while(poly.getLength() > 3 && i < poly.getLength())
+   {
+      size_t n = poly.getLength();
+      const nbpoint_t &a = poly[(i + n - 1) % n];
+      const nbpoint_t &c = poly[(i + 1) % n];
+      nbline_t line = { a.x, a.y, c.x - a.x, c.y - a.y, 0 };
+
+      line.len = sqrt(line.dx * line.dx + line.dy * line.dy);
+      if(line.len > NB_EPSILON &&
+         fabs(P_lineDist(line, poly[i].x, poly[i].y)) > NB_EPSILON)
+      {
+         ++i;
+         continue;
+      }
+
+      for(size_t j = i; j + 1 < n; j++)
+         poly[j] = poly[j + 1];
+      poly.resize(n - 1);
+      if(i)
+         --i;
+   }
+}
+
+//
+// P_compareEdgeSegs
+//
+static int P_compareEdgeSegs(const void *a, const void *b)
+{
+   const nbedgeseg_t *ea = static_cast<const nbedgeseg_t *>(a);
+   const nbedgeseg_t *eb = static_cast<const nbedgeseg_t *>(b);
+
+   if(ea->edge != eb->edge)
+      return ea->edge - eb->edge;
+   if(ea->t != eb->t)
+      return ea->t < eb->t ? -1 : 1;
+   return ea->seg - eb->seg;
+}
+
+//
+// NodeBuilder::chainPolygon
+//
+// Puts out a convex subsector's segs clockwise around its outline, with
+// minisegs wherever the outline runs between them. The outline is the map
+// cut down by every partition above the subsector and by the lines of its
+// own segs. Returns false if some seg does not lie along the outline.
+//
+bool NodeBuilder::chainPolygon(const int *list, int count)
+{
+   PODCollection<nbpoint_t>   poly;
+   PODCollection<nbedgeseg_t> edgesegs;
+   double border = 64.0;
+
+   // clockwise, so the inside is on the right of each edge
+   nbpoint_t corners[4] =
+   {
+      { mapbox[BOXLEFT]  - border, mapbox[BOXTOP]    + border, -1 },
+      { mapbox[BOXRIGHT] + border, mapbox[BOXTOP]    + border, -1 },
+      { mapbox[BOXRIGHT] + border, mapbox[BOXBOTTOM] - border, -1 },
+      { mapbox[BOXLEFT]  - border, mapbox[BOXBOTTOM] - border, -1 },
+   };
+   for(const nbpoint_t &corner : corners)
+      poly.add(corner);
+
+   for(const nbplane_t &plane : planes)
+      P_clipPolygon(poly, nblines[plane.linedef], plane.sign);
+   for(int i = 0; i < count; i++)
+   {
+      const nbseg_t &seg = segs[list[i]];
+      P_clipPolygon(poly, nblines[seg.linedef], seg.side ? -1.0 : 1.0);
+   }
+   P_straightenPolygon(poly);
+
+   int n = int(poly.getLength());
+   if(n < 3)
+      return false;
+
+   // find the edge each seg lies along
+   for(int i = 0; i < count; i++)
+   {
+      const nbseg_t    &seg = segs[list[i]];
+      const nbvertex_t &v1  = vertices[seg.v1];
+      const nbvertex_t &v2  = vertices[seg.v2];
+      double bestdist = NB_EPSILON * 4;
+      int    bestedge = -1;
+      double bestt    = 0;
+
+      for(int e = 0; e < n; e++)
+      {
+         const nbpoint_t &a = poly[e];
+         const nbpoint_t &b = poly[(e + 1) % n];
+         nbline_t edge = { a.x, a.y, b.x - a.x, b.y - a.y, 0 };
+
+         edge.len = sqrt(edge.dx * edge.dx + edge.dy * edge.dy);
+         if((v2.x - v1.x) * edge.dx + (v2.y - v1.y) * edge.dy <= 0)
+            continue;
+
+         double dist = emax(fabs(P_lineDist(edge, v1.x, v1.y)),
+                            fabs(P_lineDist(edge, v2.x, v2.y)));
+         if(dist <= bestdist)
+         {
+            bestdist = dist;
+            bestedge = e;
+            bestt    = ((v1.x - a.x) * edge.dx + (v1.y - a.y) * edge.dy) /
+                       (edge.len * edge.len);
+         }
+      }
+
+      if(bestedge < 0)
+         return false;
+
+      nbedgeseg_t &es = edgesegs.addNew();
+      es.edge = bestedge;
+      es.t    = bestt;
+      es.seg  = list[i];
+   }
+
+   qsort(edgesegs.begin(), edgesegs.getLength(), sizeof(nbedgeseg_t),
+         P_compareEdgeSegs);
+
+   nbpoint_t cursor = poly[0];
+   size_t    k      = 0;
+
+   for(int e = 0; e < n; e++)
+   {
+      for(; k < edgesegs.getLength() && edgesegs[k].edge == e; k++)
+      {
+         const nbseg_t    &seg = segs[edgesegs[k].seg];
+         const nbvertex_t &v1  = vertices[seg.v1];
+         bool gap;
+
+         if(cursor.vertex >= 0)
+         {
+            const nbvertex_t &cv = vertices[cursor.vertex];
+            gap = cursor.vertex != seg.v1 && (cv.fx != v1.fx || cv.fy != v1.fy);
+         }
+         else
+            gap = fabs(cursor.x - v1.x) > NB_EPSILON || fabs(cursor.y - v1.y) > NB_EPSILON;
+
+         if(gap)
+            addOutSeg(vertexFor(cursor), NB_NOLINE, 0);
+         addOutSeg(seg.v1, uint32_t(seg.linedef), seg.side);
+
+         cursor.x      = vertices[seg.v2].x;
+         cursor.y      = vertices[seg.v2].y;
+         cursor.vertex = seg.v2;
+      }
+
+      const nbpoint_t &end = poly[(e + 1) % n];
+      if(fabs(cursor.x - end.x) > NB_EPSILON || fabs(cursor.y - end.y) > NB_EPSILON)
+      {
+         addOutSeg(vertexFor(cursor), NB_NOLINE, 0);
+         cursor = end;
+      }
+   }
+
+   return true;
+}
+
+struct nbangleseg_t
+{
+   double angle;
+   int    seg;
+};
+
+static int P_compareAngleSegs(const void *a, const void *b)
+{
+   const nbangleseg_t *sa = static_cast<const nbangleseg_t *>(a);
+   const nbangleseg_t *sb = static_cast<const nbangleseg_t *>(b);
+
+   if(sa->angle != sb->angle)
+      return sa->angle > sb->angle ? -1 : 1;
+   return sa->seg - sb->seg;
+}
+
+//
+// NodeBuilder::chainFallback
+//
+// For subsectors too thin to get an outline for: puts the segs out clockwise
+// around their middle, joined up by minisegs.
+//
+void NodeBuilder::chainFallback(const int *list, int count)
+{
+   PODCollection<nbangleseg_t> sorted;
+   double cx = 0, cy = 0;
+
+   for(int i = 0; i < count; i++)
+   {
+      const nbseg_t &seg = segs[list[i]];
+      cx += vertices[seg.v1].x + vertices[seg.v2].x;
+      cy += vertices[seg.v1].y + vertices[seg.v2].y;
+   }
+   cx /= 2 * count;
+   cy /= 2 * count;
+
+   for(int i = 0; i < count; i++)
+   {
+      const nbseg_t &seg = segs[list[i]];
+      nbangleseg_t  &as  = sorted.addNew();
+      double mx = (vertices[seg.v1].x + vertices[seg.v2].x) / 2 - cx;
+      double my = (vertices[seg.v1].y + vertices[seg.v2].y) / 2 - cy;
+
+      as.angle = atan2(my, mx);
+      as.seg   = list[i];
+   }
+
+   qsort(sorted.begin(), sorted.getLength(), sizeof(nbangleseg_t),
+         P_compareAngleSegs);
+
+   for(int i = 0; i < count; i++)
+   {
+      const nbseg_t &seg  = segs[sorted[i].seg];
+      const nbseg_t &next = segs[sorted[(i + 1) % count].seg];
+
+      addOutSeg(seg.v1, uint32_t(seg.linedef), seg.side);
+
+      if(seg.v2 != next.v1 &&
+         (vertices[seg.v2].fx != vertices[next.v1].fx ||
+          vertices[seg.v2].fy != vertices[next.v1].fy))
+         addOutSeg(seg.v2, NB_NOLINE, 0);
+   }
+}
+
+//
+// NodeBuilder::makeLeaf
+//
+int NodeBuilder::makeLeaf(const int *list, int count)
+{
+   size_t first = outsegs.getLength();
+
+   if(!chainPolygon(list, count))
+   {
+      outsegs.resize(first);
+      chainFallback(list, count);
+   }
+
+   outsubsectors.add(uint32_t(outsegs.getLength() - first));
+
+   return int(outsubsectors.getLength() - 1) | NF_SUBSECTOR;
+}
+
+//
+// P_nodeBox
+//
+// Rounds a bounding box outward to map units.
+//
+static void P_nodeBox(const double *bbox, int16_t *out)
+{
+   out[BOXTOP]    = int16_t(eclamp(ceil(bbox[BOXTOP]),     -32768.0, 32767.0));
+   out[BOXBOTTOM] = int16_t(eclamp(floor(bbox[BOXBOTTOM]), -32768.0, 32767.0));
+   out[BOXLEFT]   = int16_t(eclamp(floor(bbox[BOXLEFT]),   -32768.0, 32767.0));
+   out[BOXRIGHT]  = int16_t(eclamp(ceil(bbox[BOXRIGHT]),   -32768.0, 32767.0));
+}
+
+//
+// NodeBuilder::buildNode
+//
+// Builds the subtree for a list of segs, returning its node or subsector
+// number and the bounding box of its segs. The list is emptied.
+//
+int NodeBuilder::buildNode(PODCollection<int> &list, double *bbox)
+{
+   int count = int(list.getLength());
+
+   bbox[BOXTOP]    = bbox[BOXRIGHT] = -1e9;
+   bbox[BOXBOTTOM] = bbox[BOXLEFT]  =  1e9;
+   for(int i = 0; i < count; i++)
+   {
+      const nbseg_t &seg = segs[list[i]];
+      for(int v : { seg.v1, seg.v2 })
+      {
+         bbox[BOXTOP]    = emax(bbox[BOXTOP],    vertices[v].y);
+         bbox[BOXBOTTOM] = emin(bbox[BOXBOTTOM], vertices[v].y);
+         bbox[BOXLEFT]   = emin(bbox[BOXLEFT],   vertices[v].x);
+         bbox[BOXRIGHT]  = emax(bbox[BOXRIGHT],  vertices[v].x);
+      }
+   }
+
+   int partseg = choosePartition(list.begin(), count);
+   if(partseg < 0)
+   {
+      int leaf = makeLeaf(list.begin(), count);
+      list.clear();
+      return leaf;
+   }
+
+   PODCollection<int> front, back;
+   nbseg_t part = segs[partseg];
+   double  frontbox[4], backbox[4];
+
+   divide(partseg, list.begin(), count, front, back);
+   list.clear();
+
+   nbplane_t plane = { part.linedef, part.side ? -1.0 : 1.0 };
+
+   planes.add(plane);
+   int frontchild = buildNode(front, frontbox);
+   planes.pop();
+
+   plane.sign = -plane.sign;
+   planes.add(plane);
+   int backchild = buildNode(back, backbox);
+   planes.pop();
+
+   const line_t &li = lines[part.linedef];
+   const vertex_t *v1 = part.side ? li.v2 : li.v1;
+   const vertex_t *v2 = part.side ? li.v1 : li.v2;
+   nbnode_t &node = outnodes.addNew();
+
+   node.x  = v1->x;
+   node.y  = v1->y;
+   node.dx = v2->x - v1->x;
+   node.dy = v2->y - v1->y;
+   P_nodeBox(frontbox, node.bbox[0]);
+   P_nodeBox(backbox,  node.bbox[1]);
+   node.children[0] = frontchild;
+   node.children[1] = backchild;
+
+   return int(outnodes.getLength() - 1);
+}
+
+//
+// P_put32 / P_put16
+//
+static void P_put32(byte *&p, uint32_t v)
+{
+   *p++ = byte(v);
+   *p++ = byte(v >> 8);
+   *p++ = byte(v >> 16);
+   *p++ = byte(v >> 24);
+}
+
+static void P_put16(byte *&p, uint16_t v)
+{
+   *p++ = byte(v);
+   *p++ = byte(v >> 8);
+}
+
+//
+// NodeBuilder::build
+//
+// Builds the tree and returns it as an XGL3 lump.
+//
+byte *NodeBuilder::build(int &length)
+{
+   PODCollection<int> all;
+   double bbox[4];
+
+   if(segs.isEmpty())
+      return nullptr;
+
+   for(size_t i = 0; i < segs.getLength(); i++)
+      all.add(int(i));
+
+   buildNode(all, bbox);
+
+   size_t numnewverts = vertices.getLength() - numorgverts;
+   size_t size = 4 + 8 + numnewverts * 8 +
+                 4 + outsubsectors.getLength() * 4 +
+                 4 + outsegs.getLength() * 13 +
+                 4 + outnodes.getLength() * 40;
+
+   byte *data = emalloc(byte *, size);
+   byte *p    = data;
+
+   memcpy(p, "XGL3", 4);
+   p += 4;
+
+   P_put32(p, uint32_t(numorgverts));
+   P_put32(p, uint32_t(numnewverts));
+   for(size_t i = numorgverts; i < vertices.getLength(); i++)
+   {
+      P_put32(p, uint32_t(vertices[i].fx));
+      P_put32(p, uint32_t(vertices[i].fy));
+   }
+
+   P_put32(p, uint32_t(outsubsectors.getLength()));
+   for(uint32_t numsegs : outsubsectors)
+      P_put32(p, numsegs);
+
+   P_put32(p, uint32_t(outsegs.getLength()));
+   for(const nboutseg_t &os : outsegs)
+   {
+      P_put32(p, os.v1);
+      P_put32(p, NB_NOLINE); // no partner
+      P_put32(p, os.linedef);
+      *p++ = os.side;
+   }
+
+   P_put32(p, uint32_t(outnodes.getLength()));
+   for(const nbnode_t &node : outnodes)
+   {
+      P_put32(p, uint32_t(node.x));
+      P_put32(p, uint32_t(node.y));
+      P_put32(p, uint32_t(node.dx));
+      P_put32(p, uint32_t(node.dy));
+      for(int j = 0; j < 2; j++)
+      {
+         for(int k = 0; k < 4; k++)
+            P_put16(p, uint16_t(node.bbox[j][k]));
+      }
+      P_put32(p, uint32_t(node.children[0]));
+      P_put32(p, uint32_t(node.children[1]));
+   }
+
+   length = int(size);
+   return data;
+}
+
+//=============================================================================
+//
+// Node Cache
+//
+
+//
+// P_hashGeometry
+//
+// Hashes everything the builder looks at.
+//
+static void P_hashGeometry(HashData &hash)
+{
+   PODCollection<uint32_t> words;
+
+   words.add(NB_VERSION);
+   words.add(uint32_t(numvertexes));
+   for(int i = 0; i < numvertexes; i++)
+   {
+      words.add(uint32_t(vertexes[i].x));
+      words.add(uint32_t(vertexes[i].y));
+   }
+   words.add(uint32_t(numlines));
+   for(int i = 0; i < numlines; i++)
+   {
+      words.add(uint32_t(lines[i].v1 - vertexes));
+      words.add(uint32_t(lines[i].v2 - vertexes));
+      words.add(uint32_t(lines[i].sidenum[0] != -1) |
+                uint32_t(lines[i].sidenum[1] != -1) << 1);
+   }
+
+   // hash a fixed byte order so caches can be shared between machines
+   for(uint32_t &w : words)
+   {
+      byte b[4] = { byte(w), byte(w >> 8), byte(w >> 16), byte(w >> 24) };
+      memcpy(&w, b, 4);
+   }
+
+   hash.addData(reinterpret_cast<const uint8_t *>(words.begin()),
+                uint32_t(words.getLength() * sizeof(uint32_t)));
+}
+
+//
+// P_BuildNodes
+//
+// Returns nodes for the level just loaded as an XGL3 lump which the caller
+// must free, either from the node cache or freshly built. Returns null if
+// the level has no lines to build from.
+//
+byte *P_BuildNodes(int &length)
+{
+   qstring cachefile;
+
+   if(usergamepath && !M_CheckParm("-nonodecache"))
+   {
+      HashData key(HashData::SHA1);
+
+      P_hashGeometry(key);
+      key.wrapUp();
+
+      char *digest = key.digestToString();
+
+      cachefile = usergamepath;
+      cachefile.pathConcatenate("nodes");
+      I_CreateDirectory(cachefile);
+      cachefile.pathConcatenate(digest);
+      cachefile << ".xgl3";
+      efree(digest);
+
+      byte *data = nullptr;
+      int   len  = M_ReadFile(cachefile.constPtr(), &data);
+
+      if(len >= 4 && !memcmp(data, "XGL3", 4))
+      {
+         C_Printf("P_BuildNodes: using cached nodes\n");
+         length = len;
+         return data;
+      }
+      if(len >= 0)
+         efree(data);
+   }
+
+   unsigned int start = i_haltimer.GetTicks();
+   NodeBuilder  builder;
+   byte        *data = builder.build(length);
+
+   if(!data)
+      return nullptr;
+
+   C_Printf("P_BuildNodes: built nodes in %u ms\n", i_haltimer.GetTicks() - start);
+
+   if(cachefile.length())
+   {
+      // write aside and move into place, so a failed write leaves nothing
+      qstring tmpfile(cachefile);
+      tmpfile << ".tmp";
+
+      if(M_WriteFile(tmpfile.constPtr(), data, size_t(length)))
+      {
+         remove(cachefile.constPtr());
+         if(rename(tmpfile.constPtr(), cachefile.constPtr()))
+            remove(tmpfile.constPtr());
+      }
+   }
+
+   return data;
+}
+
+//=============================================================================
+//
+// Reject
+//
+
+//
+// P_findGroup
+//
+static int P_findGroup(int *groups, int sec)
+{
+   while(groups[sec] != sec)
+      sec = groups[sec] = groups[groups[sec]];
+   return sec;
+}
+
+//
+// P_BuildReject
+//
+// Fills in a reject matrix for the current level, marking every pair of
+// sectors which no chain of two-sided lines joins. Must not be used on maps
+// with linked portals, which join sectors without lines.
+//
+void P_BuildReject(byte *reject)
+{
+   int *groups = emalloc(int *, emax(numsectors, 1) * sizeof(int));
+   int  i, j;
+
+   for(i = 0; i < numsectors; i++)
+      groups[i] = i;
+
+   for(i = 0; i < numlines; i++)
+   {
+      const line_t &li = lines[i];
+
+      if(!li.frontsector || !li.backsector)
+         continue;
+
+      int a = P_findGroup(groups, eindex(li.frontsector - sectors));
+      int b = P_findGroup(groups, eindex(li.backsector  - sectors));
+
+      if(a != b)
+         groups[emax(a, b)] = emin(a, b);
+   }
+
+   for(i = 0; i < numsectors; i++)
+      groups[i] = P_findGroup(groups, i);
+
+   for(i = 0; i < numsectors; i++)
+   {
+      for(j = 0; j < numsectors; j++)
+      {
+         if(groups[i] != groups[j])
+         {
+            int pnum = i * numsectors + j;
+            reject[pnum >> 3] |= 1 << (pnum & 7);
+         }
+      }
+   }
+
+   efree(groups);
+}
+
+// EOF
+
@@ -34,6 +34,7 @@
 #include "doomstat.h"
 #include "doomtype.h"
 #include "e_ttypes.h"
+#include "m_profile.h"
 #include "m_random.h"
 #include "p_chase.h"
 #include "p_info.h"
@@ -345,6 +346,7 @@ static void P_SetParticlePosition(particle_t *ptcl)
 
 void P_ParticleThinker(void)
 {
+   PROFILE_ZONE(PROF_PARTICLES);
    int i;
    particle_t *particle, *prev;
    const sector_t *psec;
@@ -35,6 +35,8 @@
 #include "p_portal.h"
 #include "p_portalblockmap.h"
 #include "p_setup.h"
+#include "p_sightcache.h"
+#include "p_soundgraph.h"
 #include "p_user.h"
 #include "r_main.h"
 #include "r_portal.h"
@@ -1053,6 +1055,12 @@ void P_SetFloorHeight(sector_t *sec, fixed_t h)
 
    // check floor portal state
    P_CheckFPortalState(sec);
+
+   // see if any lines opened or closed to sound
+   P_SoundGraphSectorChanged(sec);
+
+   // remembered sight checks may no longer hold
+   P_InvalidateSightCache();
 }
 
 //
@@ -1069,6 +1077,12 @@ void P_SetCeilingHeight(sector_t *sec, fixed_t h)
 
    // check ceiling portal state
    P_CheckCPortalState(sec);
+
+   // see if any lines opened or closed to sound
+   P_SoundGraphSectorChanged(sec);
+
+   // remembered sight checks may no longer hold
+   P_InvalidateSightCache();
 }
 
 void P_SetPortalBehavior(portal_t *portal, int newbehavior)
@@ -1091,6 +1105,9 @@ void P_SetPortalBehavior(portal_t *portal, int newbehavior)
       if(lines[i].portal == portal)
          P_CheckLPortalState(lines + i);
    }
+
+   P_SoundGraphPortalsChanged();
+   P_InvalidateSightCache();
 }
 
 void P_SetFPortalBehavior(sector_t *sec, int newbehavior)
@@ -1100,6 +1117,8 @@ void P_SetFPortalBehavior(sector_t *sec, int newbehavior)
       
    sec->f_pflags = newbehavior;
    P_CheckFPortalState(sec);
+   P_SoundGraphSectorChanged(sec);
+   P_InvalidateSightCache();
 }
 
 void P_SetCPortalBehavior(sector_t *sec, int newbehavior)
@@ -1109,6 +1128,8 @@ void P_SetCPortalBehavior(sector_t *sec, int newbehavior)
       
    sec->c_pflags = newbehavior;
    P_CheckCPortalState(sec);
+   P_SoundGraphSectorChanged(sec);
+   P_InvalidateSightCache();
 }
 
 void P_SetLPortalBehavior(line_t *line, int newbehavior)
@@ -1118,6 +1139,7 @@ void P_SetLPortalBehavior(line_t *line, int newbehavior)
       
    line->pflags = newbehavior;
    P_CheckLPortalState(line);
+   P_InvalidateSightCache();
 }
 
 //
@@ -0,0 +1,335 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Next level prefetching. While the intermission is up, the lumps of the
+//      level to come are read in the background (see w_prefetch.cpp). Once
+//      they are in, its sidedefs, sectors and things are looked over for the
+//      patches, flats and sprites it will use, and those are read in turn, so
+//      that P_SetupLevel and R_PrecacheLevel find everything in memory.
+//
+//      Only lumps are read ahead; the level itself is still built by
+//      P_SetupLevel, as all of it belongs to PU_LEVEL.
+//
+//-----------------------------------------------------------------------------
+
+#include "z_zone.h"
+#include "doomdata.h"
+#include "e_udmf.h"
+#include "info.h"
+#include "m_collection.h"
+#include "m_swap.h"
+#include "p_mobj.h"
+#include "p_prefetch.h"
+#include "p_setup.h"
+#include "r_data.h"
+#include "r_defs.h"
+#include "r_state.h"
+#include "w_prefetch.h"
+#include "w_wad.h"
+
+enum
+{
+   PLP_NONE,     // nothing being prefetched
+   PLP_MAPLUMPS, // reading the map's own lumps
+   PLP_GRAPHICS  // reading the graphics it uses
+};
+
+static int           prefetchstage;
+static WadDirectory *prefetchdir;
+static int           prefetchmaplump;
+static int           prefetchformat;
+
+//
+// P_prefetchMarkWall
+//
+static void P_prefetchMarkWall(const char *name, byte *texhit)
+{
+   char buf[9];
+   int  tex;
+
+   strncpy(buf, name, 8);
+   buf[8] = '\0';
+
+   if(*buf && (tex = R_CheckForWall(buf)) > 0)
+      texhit[tex] = 1;
+}
+
+//
+// P_prefetchMarkFlat
+//
+static void P_prefetchMarkFlat(const char *name, byte *texhit)
+{
+   char buf[9];
+   int  tex;
+
+   strncpy(buf, name, 8);
+   buf[8] = '\0';
+
+   if(*buf && (tex = R_CheckForFlat(buf)) >= 0)
+      texhit[tex] = 1;
+}
+
+//
+// P_prefetchMarkSprite
+//
+// Marks the sprite a thing of the given doomednum is spawned with. Things the
+// gamemode remaps are missed, which only costs a read in R_PrecacheLevel.
+//
+static void P_prefetchMarkSprite(int doomednum, byte *sprhit)
+{
+   int type, state, sprite;
+
+   if((type = P_FindDoomedNum(doomednum)) >= NUMMOBJTYPES)
+      return;
+   if((state = mobjinfo[type]->spawnstate) < 0 || state >= NUMSTATES)
+      return;
+   if((sprite = states[state]->sprite) >= 0 && sprite < numsprites)
+      sprhit[sprite] = 1;
+}
+
+//
+// P_prefetchLockLump
+//
+// Caches one of the map's lumps as PU_STATIC while it is looked over, and
+// returns the number of entries of the given size in it.
+//
+static const byte *P_prefetchLockLump(int lumpnum, size_t &count, size_t size)
+{
+   if(!(count = prefetchdir->lumpLength(lumpnum) / size))
+      return nullptr;
+
+   return static_cast<const byte *>(prefetchdir->cacheLumpNum(lumpnum, PU_STATIC));
+}
+
+//
+// P_prefetchUnlockLump
+//
+// Leaves a lump cached by P_prefetchLockLump as PU_CACHE for P_SetupLevel to
+// find, unless someone else had cached it more permanently beforehand.
+//
+static void P_prefetchUnlockLump(const byte *data, int oldtag)
+{
+   Z_ChangeTag(const_cast<byte *>(data), oldtag < PU_CACHE ? oldtag : PU_CACHE);
+}
+
+//
+// P_prefetchLumpTag
+//
+// Returns the tag a lump of the map is cached with, or PU_CACHE if none.
+//
+static int P_prefetchLumpTag(int lumpnum)
+{
+   const void *cached =
+      prefetchdir->getLumpInfo()[lumpnum]->cache[lumpinfo_t::fmt_default];
+
+   return cached ? Z_CheckTag(const_cast<void *>(cached)) : PU_CACHE;
+}
+
+//
+// P_prefetchGraphics
+//
+// Finds the textures and sprites a binary-format map uses, and starts reading
+// the lumps of those that are not built already.
+//
+static void P_prefetchGraphics()
+{
+   PODCollection<int> lumps;
+   const byte *data;
+   size_t      count;
+   int         oldtag;
+   byte       *texhit = ecalloc(byte *, texturecount, 1);
+   byte       *sprhit = ecalloc(byte *, numsprites, 1);
+
+   oldtag = P_prefetchLumpTag(prefetchmaplump + ML_SIDEDEFS);
+   if((data = P_prefetchLockLump(prefetchmaplump + ML_SIDEDEFS, count,
+                                 sizeof(mapsidedef_t))))
+   {
+      for(size_t i = 0; i < count; i++)
+      {
+         const mapsidedef_t *msd = reinterpret_cast<const mapsidedef_t *>(data) + i;
+
+         P_prefetchMarkWall(msd->toptexture,    texhit);
+         P_prefetchMarkWall(msd->bottomtexture, texhit);
+         P_prefetchMarkWall(msd->midtexture,    texhit);
+      }
+      P_prefetchUnlockLump(data, oldtag);
+   }
+
+   oldtag = P_prefetchLumpTag(prefetchmaplump + ML_SECTORS);
+   if((data = P_prefetchLockLump(prefetchmaplump + ML_SECTORS, count,
+                                 sizeof(mapsector_t))))
+   {
+      for(size_t i = 0; i < count; i++)
+      {
+         const mapsector_t *ms = reinterpret_cast<const mapsector_t *>(data) + i;
+
+         P_prefetchMarkFlat(ms->floorpic,   texhit);
+         P_prefetchMarkFlat(ms->ceilingpic, texhit);
+      }
+      P_prefetchUnlockLump(data, oldtag);
+   }
+
+   oldtag = P_prefetchLumpTag(prefetchmaplump + ML_THINGS);
+   if(prefetchformat == LEVEL_FORMAT_HEXEN)
+   {
+      if((data = P_prefetchLockLump(prefetchmaplump + ML_THINGS, count,
+                                    sizeof(mapthinghexen_t))))
+      {
+         for(size_t i = 0; i < count; i++)
+         {
+            const mapthinghexen_t *mt =
+               reinterpret_cast<const mapthinghexen_t *>(data) + i;
+            P_prefetchMarkSprite(SwapShort(mt->type), sprhit);
+         }
+         P_prefetchUnlockLump(data, oldtag);
+      }
+   }
+   else if((data = P_prefetchLockLump(prefetchmaplump + ML_THINGS, count,
+                                      sizeof(mapthingdoom_t))))
+   {
+      for(size_t i = 0; i < count; i++)
+      {
+         const mapthingdoom_t *mt =
+            reinterpret_cast<const mapthingdoom_t *>(data) + i;
+         P_prefetchMarkSprite(SwapShort(mt->type), sprhit);
+      }
+      P_prefetchUnlockLump(data, oldtag);
+   }
+
+   for(int i = 0; i < texturecount; i++)
+   {
+      const texture_t *tex = textures[i];
+
+      if(!texhit[i] || tex->bufferalloc)
+         continue;
+      for(int j = 0; j < tex->ccount; j++)
+         lumps.add(tex->components[j].lump);
+   }
+
+   for(int i = 0; i < numsprites; i++)
+   {
+      if(!sprhit[i])
+         continue;
+      for(int j = 0; j < sprites[i].numframes; j++)
+      {
+         const int16_t *sflump = sprites[i].spriteframes[j].lump;
+
+         for(int k = 0; k < 8; k++)
+         {
+            // rotations that aren't installed are -1
+            if(sflump[k] >= 0 && (!k || sflump[k] != sflump[k - 1]))
+               lumps.add(firstspritelump + sflump[k]);
+         }
+      }
+   }
+
+   efree(texhit);
+   efree(sprhit);
+
+   if(!lumps.isEmpty())
+   {
+      W_StartPrefetch(wGlobalDir, &lumps[0], lumps.getLength());
+      prefetchstage = PLP_GRAPHICS;
+   }
+}
+
+//
+// P_StartLevelPrefetch
+//
+// Starts reading the lumps of a level in the background. Called when the
+// intermission before it starts.
+//
+void P_StartLevelPrefetch(WadDirectory *dir, const char *mapname)
+{
+   PODCollection<int> lumps;
+   maplumpindex_t     mgla;
+   bool               isUdmf;
+   int                lumpnum;
+
+   P_FinishLevelPrefetch();
+
+   if((lumpnum = dir->checkNumForName(mapname)) < 0)
+      return;
+   if((prefetchformat = P_CheckLevel(dir, lumpnum, &mgla, &isUdmf)) ==
+      LEVEL_FORMAT_INVALID)
+      return;
+
+   int          numlumps = dir->getNumLumps();
+   lumpinfo_t **lumpinfo = dir->getLumpInfo();
+
+   // a UDMF map runs to its ENDMAP; others have BEHAVIOR last, if anything
+   for(int i = lumpnum + 1; i < numlumps; i++)
+   {
+      if(isUdmf ? !strncmp(lumpinfo[i]->name, "ENDMAP", 8) :
+                  i - lumpnum > ML_BEHAVIOR)
+         break;
+      lumps.add(i);
+   }
+
+   prefetchdir     = dir;
+   prefetchmaplump = lumpnum;
+   if(isUdmf) // only binary maps are looked over for graphics
+      prefetchformat = LEVEL_FORMAT_INVALID;
+
+   if(lumps.isEmpty())
+      return;
+
+   W_StartPrefetch(*dir, &lumps[0], lumps.getLength());
+   prefetchstage = PLP_MAPLUMPS;
+}
+
+//
+// P_LevelPrefetchTicker
+//
+// Called every tic of the intermission. Moves on to the graphics once the
+// map's lumps are in.
+//
+void P_LevelPrefetchTicker()
+{
+   if(prefetchstage != PLP_MAPLUMPS || !W_PrefetchDone())
+      return;
+
+   W_FinishPrefetch();
+   prefetchstage = PLP_NONE;
+
+   if(r_precache && (prefetchformat == LEVEL_FORMAT_DOOM ||
+                     prefetchformat == LEVEL_FORMAT_HEXEN))
+      P_prefetchGraphics();
+}
+
+//
+// P_FinishLevelPrefetch
+//
+// Waits for whatever is still being read, and hands it over to the lump
+// caches. Called by P_SetupLevel, so the level is built from what was read.
+//
+void P_FinishLevelPrefetch()
+{
+   W_FinishPrefetch();
+   prefetchstage = PLP_NONE;
+   prefetchdir   = nullptr;
+}
+
+// EOF
+
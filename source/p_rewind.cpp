@@ -0,0 +1,432 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Rewind buffer. Every rewind_interval tics the game is archived into
+//      memory the same way it is for a save, deflated, and kept in a ring
+//      which drops its oldest snapshots to stay within rewind_memory. The
+//      very first snapshot of a session is always kept, so that any tic of a
+//      demo can still be reached.
+//
+//      Going back to a tic restores the latest snapshot at or before it, and
+//      a demo being played is then run forward to the exact tic without
+//      drawing anything. Live play cannot be run forward, so rewinding it
+//      starts a new timeline and drops the snapshots past the one restored.
+//
+//      Tics are counted from the start of a new game or demo, and only tics
+//      which read commands are counted, so a paused demo doesn't move.
+//
+//-----------------------------------------------------------------------------
+
+#include "z_zone.h"
+#include "../zlib/zlib.h"
+
+#include "c_io.h"
+#include "c_runcmd.h"
+#include "d_event.h"
+#include "doomstat.h"
+#include "g_game.h"
+#include "m_buffer.h"
+#include "p_rewind.h"
+#include "p_saveg.h"
+#include "s_sound.h"
+#include "v_misc.h"
+
+#define MAXSNAPSHOTS 4096
+
+int rewind_interval = 35;
+int rewind_memory   = 64;
+
+struct snapshot_t
+{
+   int     tic;      // tic it was taken at, before that tic's commands
+   size_t  demopos;  // position of that tic in the demo being played
+   byte   *data;     // deflated archive
+   size_t  size;     // deflated size
+   size_t  fullsize; // size of the archive
+};
+
+static snapshot_t snapfirst;               // first of the session
+static snapshot_t snapring[MAXSNAPSHOTS];  // and the ones after it
+static int        snaphead;                // oldest in the ring
+static int        snapcount;
+static size_t     snapmemory;              // deflated bytes held in the ring
+
+static int        rewindtic;               // tics run in this session
+static bool       rewinding;               // restoring a snapshot
+
+static OutBuffer  snapbuffer;
+
+//
+// P_freeSnapshot
+//
+static void P_freeSnapshot(snapshot_t &snap)
+{
+   if(snap.data)
+      efree(snap.data);
+   snap.data = nullptr;
+   snap.size = snap.fullsize = 0;
+}
+
+//
+// P_ringSnapshot
+//
+// Gets the nth oldest snapshot in the ring.
+//
+static snapshot_t &P_ringSnapshot(int n)
+{
+   return snapring[(snaphead + n) % MAXSNAPSHOTS];
+}
+
+//
+// P_dropOldest
+//
+static void P_dropOldest()
+{
+   snapshot_t &snap = snapring[snaphead];
+
+   snapmemory -= snap.size;
+   P_freeSnapshot(snap);
+   snaphead = (snaphead + 1) % MAXSNAPSHOTS;
+   --snapcount;
+}
+
+//
+// P_dropNewerThan
+//
+// Drops every snapshot taken after a tic.
+//
+static void P_dropNewerThan(int tic)
+{
+   while(snapcount)
+   {
+      snapshot_t &snap = P_ringSnapshot(snapcount - 1);
+
+      if(snap.tic <= tic)
+         break;
+
+      snapmemory -= snap.size;
+      P_freeSnapshot(snap);
+      --snapcount;
+   }
+}
+
+//
+// P_ResetRewind
+//
+// Forgets all snapshots and starts counting tics anew. Called whenever a new
+// game or demo begins, unless it's only a snapshot being restored.
+//
+void P_ResetRewind()
+{
+   if(rewinding)
+      return;
+
+   while(snapcount)
+      P_dropOldest();
+   P_freeSnapshot(snapfirst);
+
+   snaphead   = 0;
+   snapmemory = 0;
+   rewindtic  = 0;
+}
+
+//
+// P_Rewinding
+//
+// True while a snapshot is being restored.
+//
+bool P_Rewinding()
+{
+   return rewinding;
+}
+
+//
+// P_rewindAllowed
+//
+// Snapshots can't be taken or restored in netgames or while recording a demo,
+// which would go out of sync.
+//
+static bool P_rewindAllowed()
+{
+   return (!netgame || demoplayback) && !demorecording;
+}
+
+//
+// P_takeSnapshot
+//
+static void P_takeSnapshot()
+{
+   snapshot_t snap;
+
+   if(!snapbuffer.getData())
+      snapbuffer.createMemory(512*1024, OutBuffer::NENDIAN);
+   snapbuffer.reset();
+
+   P_ArchiveGameState(snapbuffer);
+
+   uLongf size = compressBound(static_cast<uLong>(snapbuffer.getSize()));
+
+   snap.tic      = rewindtic;
+   snap.demopos  = demoplayback ? G_DemoPosition() : 0;
+   snap.fullsize = snapbuffer.getSize();
+   snap.data     = emalloc(byte *, size);
+
+   if(compress2(snap.data, &size, snapbuffer.getData(),
+                static_cast<uLong>(snap.fullsize), Z_BEST_SPEED) != Z_OK)
+   {
+      efree(snap.data);
+      return;
+   }
+
+   snap.size = size;
+   snap.data = erealloc(byte *, snap.data, snap.size);
+
+   if(!snapfirst.data)
+   {
+      snapfirst = snap;
+      return;
+   }
+
+   const size_t budget = static_cast<size_t>(rewind_memory) << 20;
+
+   while(snapcount && (snapcount == MAXSNAPSHOTS || snapmemory + snap.size > budget))
+      P_dropOldest();
+
+   P_ringSnapshot(snapcount++) = snap;
+   snapmemory += snap.size;
+}
+
+//
+// P_RewindTicker
+//
+// Called by G_Ticker just before the commands for a tic are read.
+//
+void P_RewindTicker()
+{
+   // benchmarks are left undisturbed
+   if(rewind_interval > 0 && P_rewindAllowed() && !timingdemo &&
+      gamestate == GS_LEVEL && gameaction == ga_nothing)
+   {
+      int last = snapcount ? P_ringSnapshot(snapcount - 1).tic : snapfirst.tic;
+
+      if(!snapfirst.data || rewindtic - last >= rewind_interval)
+         P_takeSnapshot();
+   }
+
+   ++rewindtic;
+}
+
+//
+// P_findSnapshot
+//
+// Finds the latest snapshot taken at or before a tic.
+//
+static const snapshot_t *P_findSnapshot(int tic)
+{
+   for(int i = snapcount; i--; )
+   {
+      const snapshot_t &snap = P_ringSnapshot(i);
+
+      if(snap.tic <= tic)
+         return &snap;
+   }
+
+   if(snapfirst.data && snapfirst.tic <= tic)
+      return &snapfirst;
+
+   return nullptr;
+}
+
+//
+// P_restoreSnapshot
+//
+// Puts the game back the way it was when a snapshot was taken. Loading a game
+// would end a demo being played, so what belongs to the demo is kept aside.
+//
+static bool P_restoreSnapshot(const snapshot_t &snap)
+{
+   byte  *data = emalloc(byte *, snap.fullsize);
+   uLongf size = static_cast<uLongf>(snap.fullsize);
+
+   if(uncompress(data, &size, snap.data, static_cast<uLong>(snap.size)) != Z_OK ||
+      size != snap.fullsize)
+   {
+      efree(data);
+      C_Printf(FC_ERROR "Snapshot of tic %d is damaged\n", snap.tic);
+      return false;
+   }
+
+   bool playback = demoplayback;
+   bool ngame    = netgame;
+   bool ugame    = usergame;
+   int  cplayer  = consoleplayer;
+   int  dplayer  = displayplayer;
+   int  dversion = demo_version;
+   int  dsubver  = demo_subversion;
+
+   rewinding = true;
+   P_RestoreGameState(data, size);
+   rewinding = false;
+
+   efree(data);
+
+   demoplayback    = playback;
+   netgame         = ngame;
+   usergame        = ugame;
+   consoleplayer   = cplayer;
+   displayplayer   = dplayer;
+   demo_version    = dversion;
+   demo_subversion = dsubver;
+
+   if(demoplayback)
+      G_SetDemoPosition(snap.demopos);
+
+   rewindtic = snap.tic;
+
+   return true;
+}
+
+//
+// P_runDemoTo
+//
+// Plays the demo forward to a tic without drawing. gametic is put back
+// afterward, and basetic with it, so that only the game itself has moved on.
+//
+static void P_runDemoTo(int tic)
+{
+   int startgametic = gametic;
+
+   while(rewindtic < tic && demoplayback && !(paused & 2))
+   {
+      G_Ticker();
+      ++gametic;
+   }
+
+   basetic -= gametic - startgametic;
+   gametic  = startgametic;
+
+   // nothing heard on the way should carry on
+   S_StopSounds(true);
+}
+
+//
+// P_rewindTo
+//
+// Takes the game to a tic of the session.
+//
+static void P_rewindTo(int tic)
+{
+   if(!P_rewindAllowed())
+   {
+      C_Printf(FC_ERROR "Can't rewind in netgames or while recording\n");
+      return;
+   }
+
+   if(tic < 0)
+      tic = 0;
+
+   // live play has no future to go to
+   if(!demoplayback && tic > rewindtic)
+      tic = rewindtic;
+
+   const snapshot_t *snap = P_findSnapshot(tic);
+
+   if(!snap && tic < rewindtic)
+   {
+      C_Printf(FC_ERROR "No snapshot as early as tic %d\n", tic);
+      return;
+   }
+
+   // restore unless the game is already nearer than the snapshot
+   if(snap && (tic < rewindtic || snap->tic > rewindtic))
+   {
+      if(!P_restoreSnapshot(*snap))
+         return;
+
+      if(!demoplayback)
+         P_dropNewerThan(snap->tic);
+   }
+
+   if(demoplayback)
+      P_runDemoTo(tic);
+
+   C_Printf("Now at tic %d\n", rewindtic);
+}
+
+//=============================================================================
+//
+// Console Commands
+//
+
+CONSOLE_COMMAND(rewind, cf_notnet|cf_level)
+{
+   int seconds = Console.argc ? Console.argv[0]->toInt() : 5;
+
+   P_rewindTo(rewindtic - seconds * TICRATE);
+}
+
+CONSOLE_COMMAND(seekdemo, cf_notnet|cf_level)
+{
+   if(!demoplayback)
+   {
+      C_Printf(FC_ERROR "No demo is playing\n");
+      return;
+   }
+
+   if(Console.argc < 1)
+   {
+      C_Printf("usage: seekdemo tic\n");
+      return;
+   }
+
+   P_rewindTo(Console.argv[0]->toInt());
+}
+
+CONSOLE_COMMAND(rewindinfo, 0)
+{
+   C_Printf("tic %d, %d snapshots in %u KB\n", rewindtic,
+            snapcount + (snapfirst.data ? 1 : 0),
+            static_cast<unsigned int>((snapmemory + snapfirst.size) >> 10));
+
+   if(snapfirst.data)
+   {
+      C_Printf("from tic %d to %d\n", snapfirst.tic,
+               snapcount ? P_ringSnapshot(snapcount - 1).tic : snapfirst.tic);
+   }
+}
+
+VARIABLE_INT(rewind_interval, NULL, 0, 35*60, NULL);
+CONSOLE_VARIABLE(rewind_interval, rewind_interval, 0) {}
+
+VARIABLE_INT(rewind_memory, NULL, 1, 4096, NULL);
+CONSOLE_VARIABLE(rewind_memory, rewind_memory, 0)
+{
+   const size_t budget = static_cast<size_t>(rewind_memory) << 20;
+
+   while(snapcount && snapmemory > budget)
+      P_dropOldest();
+}
+
+// EOF
+
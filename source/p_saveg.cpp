@@ -23,9 +23,14 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <atomic>
+#include <thread>
+
 #include "z_zone.h"
 #include "i_system.h"
 
+#include "../zlib/zlib.h"
+
 #include "a_small.h"
 #include "acs_intr.h"
 #include "am_map.h"
@@ -44,6 +49,9 @@
 #include "g_game.h"
 #include "m_argv.h"
 #include "m_buffer.h"
+#include "m_collection.h"
+#include "m_hash.h"
+#include "m_qstr.h"
 #include "m_random.h"
 #include "p_info.h"
 #include "p_maputl.h"
@@ -53,6 +61,7 @@
 #include "p_enemy.h"
 #include "p_xenemy.h"
 #include "p_portal.h"
+#include "p_rewind.h"
 #include "p_hubs.h"
 #include "p_skin.h"
 #include "p_setup.h"
@@ -644,6 +653,137 @@ extern int LightningFlash;
 extern int LevelSky;
 extern int LevelTempSky;
 
+//
+// World state deltas
+//
+// Most of the sectors and lines of a level are never touched during play, so
+// rather than every one of them, only those which differ from the state the
+// level was in when it was set up are saved. Loading a game sets the level up
+// the same way before reading them back, and a checksum of that state is kept
+// in the save to make sure of it.
+//
+
+struct worldstate_t
+{
+   OutBuffer             buf;     // records of all sectors, then all lines
+   PODCollection<size_t> offsets; // start of each record, plus the end
+};
+
+static worldstate_t worldbase; // as the level was set up
+static worldstate_t worldcur;  // scratch space for saving
+static uint32_t     worldbasecrc;
+
+//
+// P_archiveSectorState
+//
+// Saves dynamic properties of one sector.
+//
+static void P_archiveSectorState(SaveArchive &arc, sector_t *sec)
+{
+   // killough 10/98: save full floor & ceiling heights, including fraction
+   // haleyjd: save the friction information too
+   // haleyjd 03/04/07: save colormap indices
+   // haleyjd 12/28/08: save sector flags
+   // haleyjd 08/30/09: intflags
+   // haleyjd 03/02/09: save sector damage properties
+   // haleyjd 08/30/09: save floorpic/ceilingpic as ints
+
+   arc << sec->floorheight << sec->ceilingheight 
+       << sec->friction << sec->movefactor  
+       << sec->topmap << sec->midmap << sec->bottommap
+       << sec->flags << sec->intflags 
+       << sec->damage << sec->damageflags << sec->leakiness << sec->damagemask
+       << sec->damagemod
+       << sec->floorpic << sec->ceilingpic
+       << sec->lightlevel << sec->oldlightlevel
+       << sec->floorlightdelta << sec->ceilinglightdelta
+       << sec->special << sec->tag; // needed?   yes -- transfer types -- killough
+}
+
+//
+// P_archiveLineState
+//
+// Saves dynamic properties of one line and its sides.
+//
+static void P_archiveLineState(SaveArchive &arc, line_t *li)
+{
+   arc << li->flags << li->special << li->tag
+       << li->args[0] << li->args[1] << li->args[2] << li->args[3] << li->args[4];
+
+   for(int j = 0; j < 2; j++)
+   {
+      if(li->sidenum[j] != -1)
+      {
+         side_t *si = &sides[li->sidenum[j]];
+
+         // killough 10/98: save full sidedef offsets,
+         // preserving fractional scroll offsets
+
+         arc << si->textureoffset << si->rowoffset
+             << si->toptexture << si->bottomtexture << si->midtexture;
+      }
+   }
+}
+
+//
+// P_snapshotWorld
+//
+// Writes the records of all sectors and lines into a world state.
+//
+static void P_snapshotWorld(worldstate_t &ws)
+{
+   if(!ws.buf.getData())
+      ws.buf.createMemory(64*1024, OutBuffer::NENDIAN);
+
+   ws.buf.reset();
+   ws.offsets.makeEmpty();
+
+   SaveArchive arc(&ws.buf);
+
+   for(int i = 0; i < numsectors; i++)
+   {
+      ws.offsets.add(ws.buf.getSize());
+      P_archiveSectorState(arc, &sectors[i]);
+   }
+   for(int i = 0; i < numlines; i++)
+   {
+      ws.offsets.add(ws.buf.getSize());
+      P_archiveLineState(arc, &lines[i]);
+   }
+   ws.offsets.add(ws.buf.getSize());
+}
+
+//
+// P_SetWorldBaseline
+//
+// Remembers the state of the sectors and lines once a level is set up, for
+// saving only what changes from it.
+//
+void P_SetWorldBaseline()
+{
+   P_snapshotWorld(worldbase);
+
+   HashData crc(HashData::CRC32, worldbase.buf.getData(),
+                static_cast<uint32_t>(worldbase.buf.getSize()));
+   worldbasecrc = crc.getDigestPart(0);
+}
+
+//
+// P_recordChanged
+//
+// True if a record of the current world state differs from the baseline.
+//
+static bool P_recordChanged(size_t rec)
+{
+   size_t size = worldcur.offsets[rec + 1] - worldcur.offsets[rec];
+
+   if(worldbase.offsets[rec + 1] - worldbase.offsets[rec] != size)
+      return true;
+
+   return !!memcmp(worldcur.buf.getData()  + worldcur.offsets[rec],
+                   worldbase.buf.getData() + worldbase.offsets[rec], size);
+}
+
 //
 // P_ArchiveWorld
 //
@@ -651,35 +791,60 @@ extern int LevelTempSky;
 //
 static void P_ArchiveWorld(SaveArchive &arc)
 {
+   size_t    numrecs = size_t(numsectors) + size_t(numlines);
+   size_t    bitslen = (numrecs + 7) / 8;
+   byte     *bits    = ecalloc(byte *, 1, bitslen ? bitslen : 1);
+   uint32_t  crc     = worldbasecrc;
    int       i;
    sector_t *sec;
    line_t   *li;
-   side_t   *si;
-  
-   // do sectors
-   for(i = 0, sec = sectors; i < numsectors; ++i, ++sec)
+
+   arc << crc;
+
+   if(arc.isSaving())
    {
-      // killough 10/98: save full floor & ceiling heights, including fraction
-      // haleyjd: save the friction information too
-      // haleyjd 03/04/07: save colormap indices
-      // haleyjd 12/28/08: save sector flags
-      // haleyjd 08/30/09: intflags
-      // haleyjd 03/02/09: save sector damage properties
-      // haleyjd 08/30/09: save floorpic/ceilingpic as ints
-
-      arc << sec->floorheight << sec->ceilingheight 
-          << sec->friction << sec->movefactor  
-          << sec->topmap << sec->midmap << sec->bottommap
-          << sec->flags << sec->intflags 
-          << sec->damage << sec->damageflags << sec->leakiness << sec->damagemask
-          << sec->damagemod
-          << sec->floorpic << sec->ceilingpic
-          << sec->lightlevel << sec->oldlightlevel
-          << sec->floorlightdelta << sec->ceilinglightdelta
-          << sec->special << sec->tag; // needed?   yes -- transfer types -- killough
-
-      if(arc.isLoading())
+      OutBuffer *savefile = arc.getSaveFile();
+
+      P_snapshotWorld(worldcur);
+
+      // if there is no baseline for this level, everything is saved
+      bool havebase = (worldbase.offsets.getLength() == numrecs + 1);
+
+      for(size_t rec = 0; rec < numrecs; rec++)
       {
+         if(!havebase || P_recordChanged(rec))
+            bits[rec >> 3] |= 1 << (rec & 7);
+      }
+      savefile->write(bits, bitslen);
+
+      for(size_t rec = 0; rec < numrecs; rec++)
+      {
+         if(bits[rec >> 3] & (1 << (rec & 7)))
+         {
+            savefile->write(worldcur.buf.getData() + worldcur.offsets[rec],
+                            worldcur.offsets[rec + 1] - worldcur.offsets[rec]);
+         }
+      }
+   }
+   else
+   {
+      arc.getLoadFile()->read(bits, bitslen);
+
+      // records left out of the save must come from the same level state
+      if(crc != worldbasecrc)
+      {
+         for(size_t rec = 0; rec < numrecs; rec++)
+         {
+            if(!(bits[rec >> 3] & (1 << (rec & 7))))
+               I_Error("Bad savegame: level state does not match\n");
+         }
+      }
+
+      for(i = 0, sec = sectors; i < numsectors; ++i, ++sec)
+      {
+         if(bits[i >> 3] & (1 << (i & 7)))
+            P_archiveSectorState(arc, sec);
+
          // jff 2/22/98 now three thinker fields, not two
          sec->ceilingdata  = nullptr;
          sec->floordata    = nullptr;
@@ -690,31 +855,18 @@ static void P_ArchiveWorld(SaveArchive &arc)
          P_SetFloorHeight(sec, sec->floorheight);
          P_SetCeilingHeight(sec, sec->ceilingheight);
       }
-   }
-
-   // do lines
-   for(i = 0, li = lines; i < numlines; ++i, ++li)
-   {
-      int j;
 
-      arc << li->flags << li->special << li->tag
-          << li->args[0] << li->args[1] << li->args[2] << li->args[3] << li->args[4];
-
-      for(j = 0; j < 2; j++)
+      for(i = 0, li = lines; i < numlines; ++i, ++li)
       {
-         if(li->sidenum[j] != -1)
-         {
-            si = &sides[li->sidenum[j]];
-            
-            // killough 10/98: save full sidedef offsets,
-            // preserving fractional scroll offsets
-            
-            arc << si->textureoffset << si->rowoffset
-                << si->toptexture << si->bottomtexture << si->midtexture;
-         }
+         size_t rec = size_t(numsectors) + i;
+
+         if(bits[rec >> 3] & (1 << (rec & 7)))
+            P_archiveLineState(arc, li);
       }
    }
 
+   efree(bits);
+
    // killough 3/26/98: Save boss brain state
    arc << brain.easy;
 
@@ -1255,155 +1407,358 @@ static void P_ArchiveACS(SaveArchive &arc)
 
 //============================================================================
 //
-// Saving - Main Routine
+// Background Writing
+//
+// A game is saved by archiving it into memory, which is quick; compressing
+// it and writing it out is left to a thread of its own so that the game
+// carries on meanwhile. The file starts with the description, uncompressed so
+// that the save menus can read it, followed by a tag and the size of the rest,
+// which is a zlib stream. The file is written under a temporary name and only
+// replaces the old one once it is complete.
+//
+// The last archive stays in memory, so loading the game which was just saved,
+// as quickloads and hubs do, reads straight from it.
 //
 
 #define SAVESTRINGSIZE 24
 
-void P_SaveCurrentLevel(char *filename, char *description)
+static const char savecompressedtag[4] = { 'E', 'E', 'S', 'Z' };
+
+#define SAVE_DEFLATE_CHUNK 65536
+#define SAVE_INFLATE_CHUNK 65536
+
+struct savewrite_t
 {
-   int i;
-   char name2[VERSIONSIZE];
-   const char *fn;
-   OutBuffer savefile;
-   SaveArchive arc(&savefile);
+   qstring filename; // file being written
+   qstring tmpname;  // temporary name it's written under
+   byte   *data;     // uncompressed archive, description first
+   size_t  size;
+   int     error;    // errno of a failed write, or -1 if unknown
+   bool    ok;
+   bool    quiet;    // no message once done
+};
 
-   if(!savefile.createFile(filename, 512*1024, OutBuffer::NENDIAN))
-   {
-      const char *str =
-         errno ? strerror(errno) : FC_ERROR "Could not save game: Error unknown";
-      doom_printf("%s", str);
-      return;
-   }
+static savewrite_t        savewrite;
+static std::thread       *savethread;
+static std::atomic<bool>  savedone;
 
-   // Enable buffered IO exceptions
-   savefile.setThrowing(true);
+// the archive last written successfully
+static qstring lastsavename;
+static byte   *lastsavedata;
+static size_t  lastsavesize;
 
-   try
+//
+// P_saveDeflate
+//
+// Compresses the archive past its description into the file.
+//
+static bool P_saveDeflate(FILE *f, const byte *data, size_t size)
+{
+   z_stream zs;
+   byte     out[SAVE_DEFLATE_CHUNK];
+   int      code;
+
+   memset(&zs, 0, sizeof(zs));
+   if(deflateInit(&zs, Z_DEFAULT_COMPRESSION) != Z_OK)
+      return false;
+
+   zs.next_in  = const_cast<byte *>(data);
+   zs.avail_in = static_cast<uInt>(size);
+
+   do
    {
-      arc.archiveCString(description, SAVESTRINGSIZE);
-      
-      // killough 2/22/98: "proprietary" version string :-)
-      memset(name2, 0, sizeof(name2));
-      sprintf(name2, VERSIONID, version);
-   
-      arc.archiveCString(name2, VERSIONSIZE);
-   
-      // killough 2/14/98: save old compatibility flag:
-      // haleyjd 06/16/10: save "inmasterlevels" state
-      int tempskill = (int)gameskill;
-      
-      arc << compatibility << tempskill << inmanageddir;
-      arc << vanilla_mode;
-   
-      // sf: use string rather than episode, map
-      for(i = 0; i < 8; i++)
-      {
-         int8_t lvc = levelmapname[i];
-         arc << lvc;
-      }
+      zs.next_out  = out;
+      zs.avail_out = sizeof(out);
 
-      // haleyjd 06/16/10: support for saving/loading levels in managed wad
-      // directories.
+      code = deflate(&zs, Z_FINISH);
 
-      if((fn = W_GetManagedDirFN(g_dir))) // returns null if g_dir == &w_GlobalDir
+      size_t have = sizeof(out) - zs.avail_out;
+      if(code == Z_STREAM_ERROR || fwrite(out, 1, have, f) != have)
       {
-         // save length of managed directory filename string and
-         // managed directory filename string
-         arc.writeLString(fn);
+         deflateEnd(&zs);
+         return false;
       }
-      else
-      {
-         // just save 0; there is no name to save
-         size_t len = 0;
-         arc.archiveSize(len);
-      }
-  
-      // killough 3/16/98, 12/98: store lump name checksum
-      // FIXME/TODO: Will be simple with future save format
-      /*
-      uint64_t checksum = G_Signature(g_dir);
-      savefile.Write(&checksum, sizeof(checksum));
-
-      // killough 3/16/98: store pwad filenames in savegame  
-      for(wfileadd_t *file = wadfiles; file->filename; ++file)
-      {
-         const char *fn = file->filename;
-         savefile.Write(fn, strlen(fn));
-         savefile.WriteUint8((uint8_t)'\n');
-      }
-      savefile.WriteUint8(0);
-      */
-  
-      for(i = 0; i < MAXPLAYERS; i++)
-         arc << playeringame[i];
+   }
+   while(code != Z_STREAM_END);
+
+   deflateEnd(&zs);
+   return true;
+}
+
+//
+// P_saveWriteThread
+//
+// Worker thread which writes out one archive.
+//
+static void P_saveWriteThread()
+{
+   savewrite_t &sw = savewrite;
+   FILE *f;
+
+   sw.ok    = false;
+   sw.error = -1;
+
+   if((f = fopen(sw.tmpname.constPtr(), "wb")))
+   {
+      uint32_t rest = static_cast<uint32_t>(sw.size - SAVESTRINGSIZE);
+      byte     header[8];
 
-      for(; i < MIN_MAXPLAYERS; i++)         // killough 2/28/98
+      memcpy(header, savecompressedtag, 4);
+      for(int i = 0; i < 4; i++)
+         header[4 + i] = static_cast<byte>(rest >> (8 * i));
+
+      sw.ok = fwrite(sw.data, 1, SAVESTRINGSIZE, f) == SAVESTRINGSIZE &&
+              fwrite(header, 1, sizeof(header), f) == sizeof(header) &&
+              P_saveDeflate(f, sw.data + SAVESTRINGSIZE, rest);
+
+      if(fclose(f))
+         sw.ok = false;
+      if(!sw.ok && errno)
+         sw.error = errno;
+   }
+   else if(errno)
+      sw.error = errno;
+
+   if(sw.ok)
+   {
+      remove(sw.filename.constPtr());
+      if(rename(sw.tmpname.constPtr(), sw.filename.constPtr()))
       {
-         bool dummy = 0;
-         arc << dummy;
+         sw.ok    = false;
+         sw.error = errno ? errno : -1;
       }
+   }
 
-      // jff 3/17/98 save idmus state
-      int tempGameType = (int)GameType;
-      arc << idmusnum << tempGameType;
+   if(!sw.ok)
+      remove(sw.tmpname.constPtr());
 
-      byte options[GAME_OPTION_SIZE];
-      G_WriteOptions(options);    // killough 3/1/98: save game options
-      savefile.write(options, sizeof(options));
-   
-      //killough 11/98: save entire word
-      arc << leveltime;
-   
-      // killough 11/98: save revenant tracer state
-      uint8_t tracerState = (uint8_t)((gametic-basetic) & 255);
-      arc << tracerState;
+   savedone = true;
+}
 
-      arc << dmflags;
-   
-      // killough 3/22/98: add Z_CheckHeap after each call to ensure consistency
-      // haleyjd 07/06/09: just Z_CheckHeap after the end. This stuff works by now.
+//
+// P_FinishSaveWrite
+//
+// Waits for a save being written, if any, and reports how it went. Must be
+// called before reading a save file back.
+//
+void P_FinishSaveWrite()
+{
+   if(!savethread)
+      return;
+
+   savethread->join();
+   delete savethread;
+   savethread = nullptr;
+
+   savewrite_t &sw = savewrite;
+
+   if(lastsavedata)
+      efree(lastsavedata);
+
+   if(sw.ok)
+   {
+      lastsavename = sw.filename;
+      lastsavedata = sw.data;
+      lastsavesize = sw.size;
+
+      if(!sw.quiet)
+         doom_printf("%s", DEH_String("GGSAVED"));  // Ty 03/27/98 - externalized
+   }
+   else
+   {
+      lastsavename.clear();
+      lastsavedata = nullptr;
+      lastsavesize = 0;
+      efree(sw.data);
+
+      doom_printf("%s", sw.error > 0 ? strerror(sw.error) :
+                  FC_ERROR "Could not save game: Error unknown");
+   }
+
+   sw.data = nullptr;
+   sw.size = 0;
+}
+
+//
+// P_UpdateSaveWrite
+//
+// Called every tic; finishes up a save once its thread is done with it.
+//
+void P_UpdateSaveWrite()
+{
+   if(savethread && savedone)
+      P_FinishSaveWrite();
+}
+
+//
+// P_startSaveWrite
+//
+// Hands an archive over to the writing thread, which owns it from now on.
+//
+static void P_startSaveWrite(const char *filename, byte *data, size_t size)
+{
+   P_FinishSaveWrite();
+
+   savewrite_t &sw = savewrite;
+
+   sw.filename = filename;
+   sw.tmpname  = filename;
+   sw.tmpname += ".tmp";
+   sw.data     = data;
+   sw.size     = size;
+   sw.quiet    = hub_changelevel; // sf: no 'game saved' message for hubs
+
+   savedone   = false;
+   savethread = new std::thread(P_saveWriteThread);
+}
+
+//============================================================================
+//
+// Saving - Main Routine
+//
+
+//
+// P_archiveGame
+//
+// Writes out everything about the game in progress, save for the
+// description of a saved game.
+//
+static void P_archiveGame(SaveArchive &arc)
+{
+   int i;
+   char name2[VERSIONSIZE];
+   const char *fn;
+
+   // killough 2/22/98: "proprietary" version string :-)
+   memset(name2, 0, sizeof(name2));
+   sprintf(name2, VERSIONID, version);
+
+   arc.archiveCString(name2, VERSIONSIZE);
+
+   // killough 2/14/98: save old compatibility flag:
+   // haleyjd 06/16/10: save "inmasterlevels" state
+   int tempskill = (int)gameskill;
    
-      P_NumberThinkers();    // turn ptrs to numbers
-
-      P_ArchivePlayers(arc);
-      P_ArchiveWorld(arc);
-      P_ArchiveLevelInfo(arc);
-      P_ArchivePolyObjects(arc); // haleyjd 03/27/06
-      P_ArchiveThinkers(arc);
-      P_ArchiveRNG(arc);    // killough 1/18/98: save RNG information
-      P_ArchiveMap(arc);    // killough 1/22/98: save automap information
-      P_ArchiveSoundSequences(arc);
-      P_ArchiveButtons(arc);
-      P_ArchiveACS(arc);            // davidph 05/30/12
-
-      P_DeNumberThinkers();
-
-      uint8_t cmarker = 0xE6; // consistency marker
-      arc << cmarker; 
+   arc << compatibility << tempskill << inmanageddir;
+   arc << vanilla_mode;
+
+   // sf: use string rather than episode, map
+   for(i = 0; i < 8; i++)
+   {
+      int8_t lvc = levelmapname[i];
+      arc << lvc;
    }
-   catch(BufferedIOException)
+
+   // haleyjd 06/16/10: support for saving/loading levels in managed wad
+   // directories.
+
+   if((fn = W_GetManagedDirFN(g_dir))) // returns null if g_dir == &w_GlobalDir
    {
-      // An IO error occurred while trying to save.
-      const char *str =
-         errno ? strerror(errno) : FC_ERROR "Could not save game: Error unknown";
-      doom_printf("%s", str);
-
-      // Close the file and remove it
-      savefile.setThrowing(false);
-      savefile.close();
-      remove(filename);
-      return;
+      // save length of managed directory filename string and
+      // managed directory filename string
+      arc.writeLString(fn);
    }
+   else
+   {
+      // just save 0; there is no name to save
+      size_t len = 0;
+      arc.archiveSize(len);
+   }
+  
+   // killough 3/16/98, 12/98: store lump name checksum
+   // FIXME/TODO: Will be simple with future save format
+   /*
+   uint64_t checksum = G_Signature(g_dir);
+   savefile.Write(&checksum, sizeof(checksum));
+
+   // killough 3/16/98: store pwad filenames in savegame  
+   for(wfileadd_t *file = wadfiles; file->filename; ++file)
+   {
+      const char *fn = file->filename;
+      savefile.Write(fn, strlen(fn));
+      savefile.WriteUint8((uint8_t)'\n');
+   }
+   savefile.WriteUint8(0);
+   */
+  
+   for(i = 0; i < MAXPLAYERS; i++)
+      arc << playeringame[i];
+
+   for(; i < MIN_MAXPLAYERS; i++)         // killough 2/28/98
+   {
+      bool dummy = 0;
+      arc << dummy;
+   }
+
+   // jff 3/17/98 save idmus state
+   int tempGameType = (int)GameType;
+   arc << idmusnum << tempGameType;
+
+   byte options[GAME_OPTION_SIZE];
+   G_WriteOptions(options);    // killough 3/1/98: save game options
+   arc.getSaveFile()->write(options, sizeof(options));
+
+   //killough 11/98: save entire word
+   arc << leveltime;
+
+   // killough 11/98: save revenant tracer state
+   uint8_t tracerState = (uint8_t)((gametic-basetic) & 255);
+   arc << tracerState;
+
+   arc << dmflags;
+
+   // killough 3/22/98: add Z_CheckHeap after each call to ensure consistency
+   // haleyjd 07/06/09: just Z_CheckHeap after the end. This stuff works by now.
+
+   P_NumberThinkers();    // turn ptrs to numbers
+
+   P_ArchivePlayers(arc);
+   P_ArchiveWorld(arc);
+   P_ArchiveLevelInfo(arc);
+   P_ArchivePolyObjects(arc); // haleyjd 03/27/06
+   P_ArchiveThinkers(arc);
+   P_ArchiveRNG(arc);    // killough 1/18/98: save RNG information
+   P_ArchiveMap(arc);    // killough 1/22/98: save automap information
+   P_ArchiveSoundSequences(arc);
+   P_ArchiveButtons(arc);
+   P_ArchiveACS(arc);            // davidph 05/30/12
+
+   P_DeNumberThinkers();
+
+   uint8_t cmarker = 0xE6; // consistency marker
+   arc << cmarker;
+}
+
+//
+// P_ArchiveGameState
+//
+// Archives the game in progress into a buffer, as for a save but without its
+// description.
+//
+void P_ArchiveGameState(OutBuffer &buffer)
+{
+   SaveArchive arc(&buffer);
+
+   P_archiveGame(arc);
+}
+
+void P_SaveCurrentLevel(char *filename, char *description)
+{
+   OutBuffer savefile;
+   SaveArchive arc(&savefile);
 
-   // Close the save file
-   savefile.close();
+   savefile.createMemory(512*1024, OutBuffer::NENDIAN);
+
+   arc.archiveCString(description, SAVESTRINGSIZE);
+   P_archiveGame(arc);
 
    // Check the heap.
    Z_CheckHeap();
 
-   if(!hub_changelevel) // sf: no 'game saved' message for hubs
-      doom_printf("%s", DEH_String("GGSAVED"));  // Ty 03/27/98 - externalized
+   size_t size;
+   byte  *data = savefile.releaseData(size);
+
+   P_startSaveWrite(filename, data, size);
 }
 
 //============================================================================
@@ -1411,199 +1766,285 @@ void P_SaveCurrentLevel(char *filename, char *description)
 // Loading -- Main Routine
 //
 
-void P_LoadGame(const char *filename)
+//
+// P_unArchiveGame
+//
+// Reads back everything written by P_archiveGame, setting up the level anew
+// first. When restoring a snapshot, the demo version in use is left alone.
+//
+static void P_unArchiveGame(SaveArchive &arc, bool restoring)
 {
    int i;
    char vcheck[VERSIONSIZE], vread[VERSIONSIZE];
    //uint64_t checksum, rchecksum;
-   InBuffer loadfile;
-   SaveArchive arc(&loadfile);
 
-   if(!loadfile.openFile(filename, InBuffer::NENDIAN))
+   // killough 2/22/98: "proprietary" version string :-)
+   sprintf(vcheck, VERSIONID, version);
+
+   arc.archiveCString(vread, VERSIONSIZE);
+
+   // killough 2/22/98: Friendly savegame version difference message
+   // FIXME/TODO: restore proper version verification
+   if(strncmp(vread, vcheck, VERSIONSIZE))
+      C_Printf(FC_ERROR "Warning: save version mismatch!\a"); // blah...
+
+   // killough 2/14/98: load compatibility mode
+   // haleyjd 06/16/10: reload "inmasterlevels" state
+   int tempskill;
+   arc << compatibility << tempskill << inmanageddir;
+
+   gameskill = (skill_t)tempskill;
+  
+   arc << vanilla_mode;  // -vanilla setting
+   if(restoring)
    {
-      C_Printf(FC_ERROR "Failed to load savegame %s\n", filename);
-      C_SetConsole();
-      return;
+      // a demo being played keeps its own version
+   }
+   else if(vanilla_mode) // use UDoom version (no point for longtics now).
+   {
+      // All the other settings (save longtics) are stored in the save
+      demo_version = 109;
+      demo_subversion = 0;
+   }
+   else
+   {
+      demo_version    = version;    // killough 7/19/98: use this version's id
+      demo_subversion = subversion; // haleyjd 06/17/01
    }
 
-   // Enable buffered IO exceptions
-   loadfile.setThrowing(true);
+   // sf: use string rather than episode, map
+   for(i = 0; i < 8; i++)
+   {
+      int8_t lvc;
+      arc << lvc;
+      gamemapname[i] = (char)lvc;
+   }
+   gamemapname[8] = '\0'; // ending NULL
 
-   try
+   G_SetGameMap(); // get gameepisode, map
+
+   // start out g_dir pointing at wGlobalDir again
+   g_dir = &wGlobalDir;
+
+   // haleyjd 06/16/10: if the level was saved in a map loaded under a managed
+   // directory, we need to restore the managed directory to g_dir when loading
+   // the game here. When this is the case, the file name of the managed directory
+   // has been saved into the save game.
+   size_t len;
+   arc.archiveSize(len);
+
+   if(len)
    {
-      // skip description
-      char throwaway[SAVESTRINGSIZE];
+      WadDirectory *dir;
+
+      // read a name of len bytes 
+      char *fn = ecalloc(char *, 1, len);
+      arc.archiveCString(fn, len);
+
+      // Try to get an existing managed wad first. If none such exists, try
+      // adding it now. If that doesn't work, the normal error message appears
+      // for a missing wad.
+      // Note: set d_dir as well, so G_InitNew won't overwrite with wGlobalDir!
+      if((dir = W_GetManagedWad(fn)) || (dir = W_AddManagedWad(fn)))
+         g_dir = d_dir = dir;
+
+      // done with temporary file name
+      efree(fn);
+
+      // 11/04/12: Since we loaded a managed directory wad, initialize the
+      // mission. This will take care of any special data loading 
+      // requirements, such as metadata for NR4TL.
+      W_InitManagedMission(inmanageddir);
+   }
 
-      arc.archiveCString(throwaway, SAVESTRINGSIZE);
-      
-      // killough 2/22/98: "proprietary" version string :-)
-      sprintf(vcheck, VERSIONID, version);
+   // killough 3/16/98, 12/98: check lump name checksum
+   // FIXME/TODO: advanced savegame verification is needed
+   /*
+   checksum = G_Signature(g_dir);
 
-      arc.archiveCString(vread, VERSIONSIZE);
-   
-      // killough 2/22/98: Friendly savegame version difference message
-      // FIXME/TODO: restore proper version verification
-      if(strncmp(vread, vcheck, VERSIONSIZE))
-         C_Printf(FC_ERROR "Warning: save version mismatch!\a"); // blah...
+   loadfile.Read(&rchecksum, sizeof(rchecksum));
+
+   if(memcmp(&checksum, &rchecksum, sizeof checksum))
+   {
+      char *msg = ecalloc(char *, 1, strlen((const char *)(save_p + sizeof checksum)) + 128);
+      strcpy(msg,"Incompatible Savegame!!!\n");
+      if(save_p[sizeof checksum])
+         strcat(strcat(msg,"Wads expected:\n\n"), (char *)(save_p + sizeof checksum));
+      strcat(msg, "\nAre you sure?");
+      C_Puts(msg);
+      G_LoadGameErr(msg);
+      efree(msg);
+      return;
+   }
+   */
 
-      // killough 2/14/98: load compatibility mode
-      // haleyjd 06/16/10: reload "inmasterlevels" state
-      int tempskill;
-      arc << compatibility << tempskill << inmanageddir;
+   for(i = 0; i < MAXPLAYERS; ++i)
+      arc << playeringame[i];
 
-      gameskill = (skill_t)tempskill;
-  
-      arc << vanilla_mode;  // -vanilla setting
-      if(vanilla_mode)      // use UDoom version (no point for longtics now).
-      {
-         // All the other settings (save longtics) are stored in the save
-         demo_version = 109;
-         demo_subversion = 0;
-      }
-      else
-      {
-         demo_version    = version;    // killough 7/19/98: use this version's id
-         demo_subversion = subversion; // haleyjd 06/17/01
-      }
+   for(; i < MIN_MAXPLAYERS; i++) // killough 2/28/98
+   {
+      bool dummy = 0;
+      arc << dummy;
+   }
 
-      // sf: use string rather than episode, map
-      for(i = 0; i < 8; i++)
-      {
-         int8_t lvc;
-         arc << lvc;
-         gamemapname[i] = (char)lvc;
-      }
-      gamemapname[8] = '\0'; // ending NULL
+   // jff 3/17/98 restore idmus music
+   // jff 3/18/98 account for unsigned byte
+   // killough 11/98: simplify
+   // haleyjd 04/14/03: game type
+   // note: don't set DefaultGameType from save games
+   int tempGameType;
+   arc << idmusnum << tempGameType;
 
-      G_SetGameMap(); // get gameepisode, map
+   GameType = (gametype_t)tempGameType;
 
-      // start out g_dir pointing at wGlobalDir again
-      g_dir = &wGlobalDir;
+   /* cph 2001/05/23 - Must read options before we set up the level */
+   byte options[GAME_OPTION_SIZE];
+   arc.getLoadFile()->read(options, sizeof(options));
 
-      // haleyjd 06/16/10: if the level was saved in a map loaded under a managed
-      // directory, we need to restore the managed directory to g_dir when loading
-      // the game here. When this is the case, the file name of the managed directory
-      // has been saved into the save game.
-      size_t len;
-      arc.archiveSize(len);
+   G_ReadOptions(options);
+ 
+   // load a base level
+   // sf: in hubs, use g_doloadlevel instead of g_initnew
+   if(hub_changelevel)
+      G_DoLoadLevel();
+   else
+      G_InitNew(gameskill, gamemapname);
+
+   // killough 3/1/98: Read game options
+   // killough 11/98: move down to here
+
+   // cph - MBF needs to reread the savegame options because 
+   // G_InitNew rereads the WAD options. The demo playback code does 
+   // this too.
+   G_ReadOptions(options);
+
+   // get the times
+   arc << leveltime;
+
+   // killough 11/98: load revenant tracer state
+   uint8_t tracerState;
+   arc << tracerState;
+   basetic = gametic - tracerState;
+
+   // haleyjd 04/14/03: load dmflags
+   arc << dmflags;
+
+   // dearchive all the modifications
+   P_ArchivePlayers(arc);
+   P_ArchiveWorld(arc);
+   P_ArchiveLevelInfo(arc);
+   P_ArchivePolyObjects(arc);    // haleyjd 03/27/06
+   P_ArchiveThinkers(arc);
+   P_ArchiveRNG(arc);            // killough 1/18/98: load RNG information
+   P_ArchiveMap(arc);            // killough 1/22/98: load automap information
+   P_UnArchiveSoundSequences(arc);
+   P_ArchiveButtons(arc);
+   P_ArchiveACS(arc);            // davidph 05/30/12
+
+   P_FreeThinkerTable();
+
+   uint8_t cmarker;
+   arc << cmarker;
+   if(cmarker != 0xE6)
+      I_Error("Bad savegame: last byte is 0x%x\n", cmarker);
+
+   // haleyjd: move up Z_CheckHeap to before Z_Free (safer)
+   Z_CheckHeap(); 
+}
 
-      if(len)
-      {
-         WadDirectory *dir;
-
-         // read a name of len bytes 
-         char *fn = ecalloc(char *, 1, len);
-         arc.archiveCString(fn, len);
-
-         // Try to get an existing managed wad first. If none such exists, try
-         // adding it now. If that doesn't work, the normal error message appears
-         // for a missing wad.
-         // Note: set d_dir as well, so G_InitNew won't overwrite with wGlobalDir!
-         if((dir = W_GetManagedWad(fn)) || (dir = W_AddManagedWad(fn)))
-            g_dir = d_dir = dir;
-
-         // done with temporary file name
-         efree(fn);
-
-         // 11/04/12: Since we loaded a managed directory wad, initialize the
-         // mission. This will take care of any special data loading 
-         // requirements, such as metadata for NR4TL.
-         W_InitManagedMission(inmanageddir);
-      }
+//
+// P_finishLoad
+//
+// Gets the display going again after a game has been read back.
+//
+static void P_finishLoad()
+{
+   if (setsizeneeded)
+      R_ExecuteSetViewSize();
    
-      // killough 3/16/98, 12/98: check lump name checksum
-      // FIXME/TODO: advanced savegame verification is needed
-      /*
-      checksum = G_Signature(g_dir);
+   // draw the pattern into the back screen
+   R_FillBackScreen(scaledwindow);
 
-      loadfile.Read(&rchecksum, sizeof(rchecksum));
+   // haleyjd 02/09/10: wake up status bar again
+   ST_Start();
+}
 
-      if(memcmp(&checksum, &rchecksum, sizeof checksum))
-      {
-         char *msg = ecalloc(char *, 1, strlen((const char *)(save_p + sizeof checksum)) + 128);
-         strcpy(msg,"Incompatible Savegame!!!\n");
-         if(save_p[sizeof checksum])
-            strcat(strcat(msg,"Wads expected:\n\n"), (char *)(save_p + sizeof checksum));
-         strcat(msg, "\nAre you sure?");
-         C_Puts(msg);
-         G_LoadGameErr(msg);
-         efree(msg);
-         return;
-      }
-      */
+//
+// P_RestoreGameState
+//
+// Reads back a game archived by P_ArchiveGameState.
+//
+void P_RestoreGameState(const void *data, size_t size)
+{
+   InBuffer loadfile;
+   SaveArchive arc(&loadfile);
 
-      for(i = 0; i < MAXPLAYERS; ++i)
-         arc << playeringame[i];
+   loadfile.openMemory(data, size, InBuffer::NENDIAN);
+   loadfile.setThrowing(true);
 
-      for(; i < MIN_MAXPLAYERS; i++) // killough 2/28/98
-      {
-         bool dummy = 0;
-         arc << dummy;
-      }
+   try
+   {
+      P_unArchiveGame(arc, true);
+   }
+   catch(...)
+   {
+      I_Error("P_RestoreGameState: Archive read error\n");
+   }
 
-      // jff 3/17/98 restore idmus music
-      // jff 3/18/98 account for unsigned byte
-      // killough 11/98: simplify
-      // haleyjd 04/14/03: game type
-      // note: don't set DefaultGameType from save games
-      int tempGameType;
-      arc << idmusnum << tempGameType;
+   loadfile.close();
 
-      GameType = (gametype_t)tempGameType;
+   P_finishLoad();
+}
 
-      /* cph 2001/05/23 - Must read options before we set up the level */
-      byte options[GAME_OPTION_SIZE];
-      loadfile.read(options, sizeof(options));
+void P_LoadGame(const char *filename)
+{
+   InBuffer loadfile;
+   SaveArchive arc(&loadfile);
 
-      G_ReadOptions(options);
- 
-      // load a base level
-      // sf: in hubs, use g_doloadlevel instead of g_initnew
-      if(hub_changelevel)
-         G_DoLoadLevel();
-      else
-         G_InitNew(gameskill, gamemapname);
+   // the save may still be being written
+   P_FinishSaveWrite();
 
-      // killough 3/1/98: Read game options
-      // killough 11/98: move down to here
-   
-      // cph - MBF needs to reread the savegame options because 
-      // G_InitNew rereads the WAD options. The demo playback code does 
-      // this too.
-      G_ReadOptions(options);
-
-      // get the times
-      arc << leveltime;
-
-      // killough 11/98: load revenant tracer state
-      uint8_t tracerState;
-      arc << tracerState;
-      basetic = gametic - tracerState;
-
-      // haleyjd 04/14/03: load dmflags
-      arc << dmflags;
-
-      // dearchive all the modifications
-      P_ArchivePlayers(arc);
-      P_ArchiveWorld(arc);
-      P_ArchiveLevelInfo(arc);
-      P_ArchivePolyObjects(arc);    // haleyjd 03/27/06
-      P_ArchiveThinkers(arc);
-      P_ArchiveRNG(arc);            // killough 1/18/98: load RNG information
-      P_ArchiveMap(arc);            // killough 1/22/98: load automap information
-      P_UnArchiveSoundSequences(arc);
-      P_ArchiveButtons(arc);
-      P_ArchiveACS(arc);            // davidph 05/30/12
-
-      P_FreeThinkerTable();
-
-      uint8_t cmarker;
-      arc << cmarker;
-      if(cmarker != 0xE6)
-         I_Error("Bad savegame: last byte is 0x%x\n", cmarker);
-
-      // haleyjd: move up Z_CheckHeap to before Z_Free (safer)
-      Z_CheckHeap(); 
+   // the game just saved is read from memory
+   bool inmemory = (lastsavedata && lastsavename.compare(filename));
+
+   if(inmemory)
+      loadfile.openMemory(lastsavedata, lastsavesize, InBuffer::NENDIAN);
+   else if(!loadfile.openFile(filename, InBuffer::NENDIAN))
+   {
+      C_Printf(FC_ERROR "Failed to load savegame %s\n", filename);
+      C_SetConsole();
+      return;
+   }
+
+   // Enable buffered IO exceptions
+   loadfile.setThrowing(true);
+
+   try
+   {
+      // skip description
+      char throwaway[SAVESTRINGSIZE];
+
+      arc.archiveCString(throwaway, SAVESTRINGSIZE);
+
+      // the rest of a file is compressed, and inflated as it's read
+      if(!inmemory)
+      {
+         char tag[sizeof(savecompressedtag)];
+         uint32_t size;
+
+         if(loadfile.read(tag, sizeof(tag)) != sizeof(tag) ||
+            memcmp(tag, savecompressedtag, sizeof(tag)) ||
+            !loadfile.readUint32(size) ||
+            !loadfile.beginInflate(SAVE_INFLATE_CHUNK))
+         {
+            loadfile.close();
+            C_Printf(FC_ERROR "%s is not a compatible savegame\n", filename);
+            C_SetConsole();
+            return;
+         }
+      }
+      
+      P_unArchiveGame(arc, false);
    }
    catch(...)
    {
@@ -1613,14 +2054,7 @@ void P_LoadGame(const char *filename)
 
    loadfile.close();
 
-   if (setsizeneeded)
-      R_ExecuteSetViewSize();
-   
-   // draw the pattern into the back screen
-   R_FillBackScreen(scaledwindow);
-
-   // haleyjd 02/09/10: wake up status bar again
-   ST_Start();
+   P_finishLoad();
 
    // killough 12/98: support -recordfrom and -loadgame -playdemo
    if(!command_loadgame)
@@ -1638,6 +2072,9 @@ void P_LoadGame(const char *filename)
    //  for 'seamless' travel between levels
    if(hub_changelevel) 
       P_RestorePlayerPosition();
+
+   // a loaded game has no past to rewind to
+   P_ResetRewind();
 }
 
 //----------------------------------------------------------------------------
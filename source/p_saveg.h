@@ -117,6 +117,13 @@ void P_SetNewTarget(Mobj **mop, Mobj *targ);
 void P_SaveCurrentLevel(char *filename, char *description);
 void P_LoadGame(const char *filename);
 
+void P_ArchiveGameState(OutBuffer &buffer);
+void P_RestoreGameState(const void *data, size_t size);
+
+void P_FinishSaveWrite();
+void P_UpdateSaveWrite();
+void P_SetWorldBaseline();
+
 #endif
 
 //----------------------------------------------------------------------------
@@ -67,8 +67,9 @@ struct seclerpinfo_t
 
 static scrollerlist_t *scrollers;
 
-static PODCollection<sidelerpinfo_t> pScrolledSides;
-static PODCollection<seclerpinfo_t> pScrolledSectors;
+// One list per batch of parallel thinkers, so that batches never share one
+static PODCollection<sidelerpinfo_t> pScrolledSides[P_MAXTHINKERBATCHES];
+static PODCollection<seclerpinfo_t> pScrolledSectors[P_MAXTHINKERBATCHES];
 
 IMPLEMENT_THINKER_TYPE(ScrollThinker)
 
@@ -135,7 +136,7 @@ void ScrollThinker::Think()
       sec->floor_xoffs += dx;
       sec->floor_yoffs += dy;
       {
-         seclerpinfo_t &info = pScrolledSectors.addNew();
+         seclerpinfo_t &info = pScrolledSectors[p_thinkerbatch].addNew();
          info.sector = sec;
          info.isceiling = false;
          info.offset.x = dx;
@@ -148,7 +149,7 @@ void ScrollThinker::Think()
       sec->ceiling_xoffs += dx;
       sec->ceiling_yoffs += dy;
       {
-         seclerpinfo_t &info = pScrolledSectors.addNew();
+         seclerpinfo_t &info = pScrolledSectors[p_thinkerbatch].addNew();
          info.sector = sec;
          info.isceiling = true;
          info.offset.x = dx;
@@ -199,6 +200,27 @@ void ScrollThinker::Think()
    }
 }
 
+//
+// ScrollThinker::parallelKey
+//
+// Texture scrollers only change their own sidedef or sector, and read the
+// heights of their control sector, which no parallel thinker moves. Carriers
+// push things around, so they must run serially.
+//
+int ScrollThinker::parallelKey() const
+{
+   switch(type)
+   {
+   case sc_side:
+      return numsectors + affectee;
+   case sc_floor:
+   case sc_ceiling:
+      return affectee;
+   default:
+      return -1;
+   }
+}
+
 //
 // ScrollThinker::serialize
 //
@@ -812,8 +834,11 @@ void P_SpawnCeilingUDMF(int s, int type, double scrollx, double scrolly)
 //
 void P_TicResetLerpScrolledSides()
 {
-   pScrolledSides.makeEmpty();
-   pScrolledSectors.makeEmpty();
+   for(int i = 0; i < P_MAXTHINKERBATCHES; i++)
+   {
+      pScrolledSides[i].makeEmpty();
+      pScrolledSectors[i].makeEmpty();
+   }
 }
 
 //
@@ -821,7 +846,7 @@ void P_TicResetLerpScrolledSides()
 //
 void P_AddScrolledSide(side_t *side, fixed_t dx, fixed_t dy)
 {
-   sidelerpinfo_t &info = pScrolledSides.addNew();
+   sidelerpinfo_t &info = pScrolledSides[p_thinkerbatch].addNew();
    info.side = side;
    info.offset.x = dx;
    info.offset.y = dy;
@@ -832,14 +857,20 @@ void P_AddScrolledSide(side_t *side, fixed_t dx, fixed_t dy)
 //
 void P_ForEachScrolledSide(void (*func)(side_t *side, v2fixed_t offset))
 {
-   for(const sidelerpinfo_t &info : pScrolledSides)
-      func(info.side, info.offset);
+   for(const PODCollection<sidelerpinfo_t> &batch : pScrolledSides)
+   {
+      for(const sidelerpinfo_t &info : batch)
+         func(info.side, info.offset);
+   }
 }
 
 void P_ForEachScrolledSector(void (*func)(sector_t *sector, bool isceiling, v2fixed_t offset))
 {
-   for(const seclerpinfo_t &info : pScrolledSectors)
-      func(info.sector, info.isceiling, info.offset);
+   for(const PODCollection<seclerpinfo_t> &batch : pScrolledSectors)
+   {
+      for(const seclerpinfo_t &info : batch)
+         func(info.sector, info.isceiling, info.offset);
+   }
 }
 
 // killough 3/7/98 -- end generalized scroll effects
@@ -40,6 +40,7 @@ class ScrollThinker : public Thinker
 
 protected:
    void Think() override;
+   int parallelKey() const override;
 
 public:
    // Overridden Methods
@@ -25,6 +25,7 @@
 
 #include "z_zone.h"
 
+#include "acs_intr.h"
 #include "c_io.h"
 #include "c_runcmd.h"
 #include "doomstat.h"
@@ -80,6 +81,21 @@ void SectorThinker::serialize(SaveArchive &arc)
    }
 }
 
+//
+// SectorThinker::remove
+//
+// Scripts waiting on the sector's tag are woken when a mover lets go of it.
+//
+void SectorThinker::remove()
+{
+   attachpoint_e attach = getAttachPoint();
+
+   if(sector && attach != ATTACH_NONE && attach != ATTACH_LIGHT)
+      ACS_SignalTag(ACS_TAGTYPE_SECTOR, sector->tag);
+
+   Super::remove();
+}
+
 //=============================================================================
 //
 // Sector Actions
@@ -58,15 +58,21 @@
 #include "p_maputl.h"
 #include "p_map.h"
 #include "p_mobjcol.h"
+#include "p_nodebuild.h"
 #include "p_partcl.h"
 #include "p_portal.h"
+#include "p_prefetch.h"
+#include "p_saveg.h"
 #include "p_scroll.h"
 #include "p_setup.h"
+#include "p_sightcache.h"
 #include "p_skin.h"
 #include "p_slopes.h"
+#include "p_soundgraph.h"
 #include "p_spec.h"
 #include "p_tick.h"
 #include "polyobj.h"
+#include "r_context.h"
 #include "r_data.h"
 #include "r_defs.h"
 #include "r_dynseg.h"
@@ -1278,18 +1284,17 @@ static void P_LoadZSegs(byte *data, ZNodeType signature)
    }
 
 //
-// P_LoadZNodes
+// P_LoadZNodeData
 //
-// Loads ZDoom uncompressed nodes.
+// Loads ZDoom uncompressed nodes from a buffer, which is freed afterward.
 // IOANCH 20151217: check signature and use different gl nodes if needed
 // ioanch: 20151221: fixed some memory leaks. Also moved the bounds checks 
 // before attempting to allocate memory, so the app won't terminate.
 //
-static void P_LoadZNodes(int lump, ZNodeType signature)
+static void P_LoadZNodeData(byte *lumpptr, int len, ZNodeType signature)
 {
-   byte *data, *lumpptr;
+   byte *data = lumpptr;
    unsigned int i;
-   int len;
 
    uint32_t orgVerts, newVerts;
    uint32_t numSubs, currSeg;
@@ -1297,9 +1302,6 @@ static void P_LoadZNodes(int lump, ZNodeType signature)
    uint32_t numNodes;
    vertex_t *newvertarray = NULL;
 
-   data = lumpptr = (byte *)(setupwad->cacheLumpNum(lump, PU_STATIC));
-   len  = setupwad->lumpLength(lump);
-
    // skip header
    CheckZNodesOverflow(len, 4);
    data += 4;
@@ -1472,6 +1474,37 @@ static void P_LoadZNodes(int lump, ZNodeType signature)
    Z_Free(lumpptr);
 }
 
+//
+// P_LoadZNodes
+//
+// Loads ZDoom uncompressed nodes from a lump.
+//
+static void P_LoadZNodes(int lump, ZNodeType signature)
+{
+   P_LoadZNodeData((byte *)(setupwad->cacheLumpNum(lump, PU_STATIC)),
+                   setupwad->lumpLength(lump), signature);
+}
+
+//
+// P_LoadBuiltNodes
+//
+// Loads nodes from the internal node builder, for maps which come without
+// them.
+//
+static void P_LoadBuiltNodes()
+{
+   int   len;
+   byte *data = P_BuildNodes(len);
+
+   if(!data)
+   {
+      level_error = "no lines to build nodes from";
+      return;
+   }
+
+   P_LoadZNodeData(data, len, ZNodeType_GL3);
+}
+
 //
 // End ZDoom nodes
 //
@@ -3038,8 +3071,9 @@ static void P_padRejectArray(byte *array, unsigned int len)
 // zeroes. This is preferable to adding checks to see if a reject
 // matrix exists, in my opinion. This could be improved by actually
 // generating a meaningful reject, but that will have to wait.
+// Returns false if there was no reject data at all.
 //
-static void P_LoadReject(int lump)
+static bool P_LoadReject(int lump)
 {
    int size;
    int expectedsize;
@@ -3082,6 +3116,8 @@ static void P_LoadReject(int lump)
    // warn on too-large rejects, but do nothing special.
    if(size > expectedsize)
       C_Printf(FC_ERROR "P_LoadReject: warning - reject is too large\a\n");
+
+   return size > 0;
 }
 
 //
@@ -3189,7 +3225,8 @@ int P_CheckLevel(WadDirectory *dir, int lumpnum, maplumpindex_t *mgla,
             break;
          }
       }
-      if(!foundEndMap || (mgla && mgla->nodes < 0))
+      // a missing ZNODES is fine; nodes get built when the level loads
+      if(!foundEndMap)
          return LEVEL_FORMAT_INVALID;  // must have ENDMAP
       // Found ENDMAP. This may be a valid UDMF lump. Return it
       if(udmf)
@@ -3394,6 +3431,9 @@ static void P_PreZoneFreeLevel()
    // SoM: initialize portals
    R_InitPortals();
 
+   // render contexts rebuild their level data before next use
+   R_ContextsNewLevel();
+
    // haleyjd 05/16/08: clear dynamic segs
    R_ClearDynaSegs();
 
@@ -3539,6 +3579,9 @@ void P_SetupLevel(WadDirectory *dir, const char *mapname, int playermask,
    G_DemoLog("%d\tSetup %s\n", gametic, mapname);
    G_DemoLogSetExited(false);
 
+   // take in whatever was read ahead during the intermission
+   P_FinishLevelPrefetch();
+
    // haleyjd 07/28/10: we are no longer in GS_LEVEL during the execution of
    // this routine.
    gamestate = GS_LOADING;
@@ -3584,6 +3627,9 @@ void P_SetupLevel(WadDirectory *dir, const char *mapname, int playermask,
    // free the old level
    Z_FreeTags(PU_LEVEL, PU_LEVEL);
 
+   // pack the new one's data together
+   ZoneArenaGuard arena;
+
    // perform post-Z_FreeTags actions
    P_InitNewLevel(lumpnum, dir);
 
@@ -3690,11 +3736,19 @@ void P_SetupLevel(WadDirectory *dir, const char *mapname, int playermask,
    // If it's UDMF, vertices can have extra precision, requiring better geometry calculations.
    R_PointOnSide = R_PointOnSideClassic;  // set classic function unless otherwise set later
 
-   // IOANCH: at this point, mgla.nodes is valid. Check ZDoom node signature too
-   ZNodeType znodeSignature;
+   // IOANCH: check ZDoom node signature too. UDMF maps may have no ZNODES.
+   ZNodeType znodeSignature = ZNodeType_Invalid;
    int actualNodeLump = -1;
-   if((znodeSignature = P_CheckForZDoomUncompressedNodes(mgla.nodes, 
-      &actualNodeLump, isUdmf)) != ZNodeType_Invalid && actualNodeLump >= 0)
+   bool forceBuild = !!M_CheckParm("-buildnodes");
+   bool builtNodes = false;
+
+   if(!forceBuild && mgla.nodes >= 0)
+   {
+      znodeSignature = P_CheckForZDoomUncompressedNodes(mgla.nodes,
+                                                        &actualNodeLump, isUdmf);
+   }
+
+   if(znodeSignature != ZNodeType_Invalid && actualNodeLump >= 0)
    {
       P_LoadZNodes(actualNodeLump, znodeSignature);
       if(znodeSignature == ZNodeType_GL3)
@@ -3702,7 +3756,8 @@ void P_SetupLevel(WadDirectory *dir, const char *mapname, int playermask,
 
       CHECK_ERROR();
    }
-   else if(P_CheckForDeePBSPv4Nodes(lumpnum))   // ioanch 20160204: also DeePBSP
+   else if(!forceBuild && !isUdmf && 
+           P_CheckForDeePBSPv4Nodes(lumpnum))   // ioanch 20160204: also DeePBSP
    {
       P_LoadSubsectors_V4(lumpnum + ML_SSECTORS);
       CHECK_ERROR();
@@ -3711,16 +3766,19 @@ void P_SetupLevel(WadDirectory *dir, const char *mapname, int playermask,
       P_LoadSegs_V4(lumpnum + ML_SEGS);
       CHECK_ERROR();
    }
-   else
+   else if(forceBuild || isUdmf || !setupwad->lumpLength(mgla.ssectors) ||
+           !setupwad->lumpLength(mgla.segs))
    {
-      // IOANCH 20151215: make sure everything is valid. Can happen if UDMF has
-      // invalid ZNODES entry
-      if(mgla.ssectors < 0 || mgla.segs < 0)
-      {
-         P_SetupLevelError("UDMF levels don't support vanilla BSP", mapname);
-         return;
-      }
+      // No usable nodes in the map, so build them. The builder puts out GL
+      // nodes with fractional vertices.
+      P_LoadBuiltNodes();
+      CHECK_ERROR();
 
+      R_PointOnSide = R_PointOnSidePrecise;
+      builtNodes = true;
+   }
+   else
+   {
       // IOANCH: at this point, it's not a UDMF map so mgla will be valid
       P_LoadSubsectors(mgla.ssectors);
       P_LoadNodes     (mgla.nodes);
@@ -3737,7 +3795,7 @@ void P_SetupLevel(WadDirectory *dir, const char *mapname, int playermask,
    // ioanch 20160309: reversed P_GroupLines with P_LoadReject to fix the
    // overrun
    P_GroupLines();
-   P_LoadReject(mgla.reject); // haleyjd 01/26/04
+   bool hasReject = P_LoadReject(mgla.reject); // haleyjd 01/26/04
 
    // Create bounding boxes now
    P_createSectorBoundingBoxes();
@@ -3791,6 +3849,18 @@ void P_SetupLevel(WadDirectory *dir, const char *mapname, int playermask,
    // SoM: Deferred specials that need to be spawned after P_SpawnSpecials
    P_SpawnDeferredSpecials(setupSettings);
 
+   // maps that need their nodes built rarely have a reject either; make one
+   // now that it's known whether portals join up sectors without lines
+   if(builtNodes && !hasReject && !useportalgroups && !gMapHasSectorPortals &&
+      !gMapHasLinePortals)
+      P_BuildReject(rejectmatrix);
+
+   // build the sound propagation graph now that portals are all in place
+   P_BuildSoundGraph();
+
+   // forget sight checks from the last level and gather up sight lines
+   P_InitSightCache();
+
    // haleyjd
    P_InitLightning();
 
@@ -3821,6 +3891,9 @@ void P_SetupLevel(WadDirectory *dir, const char *mapname, int playermask,
       acslumpnum = setupwad->checkNumForNameNSG(LevelInfo.acsScriptLump, lumpinfo_t::ns_acs);
 
    ACS_LoadLevelScript(dir, acslumpnum);
+
+   // remember how the level started out, so saves need only what changes
+   P_SetWorldBaseline();
 }
 
 //
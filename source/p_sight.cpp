@@ -32,6 +32,7 @@
 #include "m_bbox.h"
 #include "p_maputl.h"
 #include "p_setup.h"
+#include "p_sightcache.h"
 #include "r_dynseg.h"
 #include "r_main.h"
 #include "r_state.h"
@@ -331,14 +332,14 @@ static bool P_CrossBSPNode(int bspnum, los_t *los)
 }
 
 //
-// P_CheckSight
+// P_checkSight
 // Returns true
 //  if a straight line between t1 and t2 is unobstructed.
 // Uses REJECT.
 //
 // killough 4/20/98: cleaned up, made to use new LOS struct
 //
-bool P_CheckSight(Mobj *t1, Mobj *t2)
+static bool P_checkSight(Mobj *t1, Mobj *t2)
 {
    if(full_demo_version >= make_full_version(340, 24))
    {
@@ -424,6 +425,63 @@ bool P_CheckSight(Mobj *t1, Mobj *t2)
    return P_CrossBSPNode(numnodes-1, &los);
 }
 
+//
+// P_CheckSight
+//
+// Returns true if t1 can see t2. Results are remembered until either of
+// them moves or something which can block sight changes, so monsters which
+// look for the same target tic after tic from the same spot only pay for it
+// once.
+//
+bool P_CheckSight(Mobj *t1, Mobj *t2)
+{
+   bool result;
+
+   if(P_LookupSight(t1, t2, result))
+      return result;
+
+   result = P_checkSight(t1, t2);
+   P_StoreSight(t1, t2, result);
+
+   return result;
+}
+
+//
+// P_CheckSightBatch
+//
+// Checks whether one looker can see each of a list of targets, writing the
+// answers to results. The looker's visibility row is only looked up once,
+// and any target in a sector it cannot see into is turned away without a
+// trace. Gives the same answers as calling P_CheckSight for each in turn.
+//
+void P_CheckSightBatch(Mobj *looker, Mobj *const *targets, int count,
+                       bool *results)
+{
+   const byte *pvs = P_SectorPVS(eindex(looker->subsector->sector - sectors));
+
+   for(int i = 0; i < count; i++)
+   {
+      Mobj *target = targets[i];
+      bool  result;
+
+      if(P_LookupSight(looker, target, result))
+      {
+         results[i] = result;
+         continue;
+      }
+
+      int secnum = eindex(target->subsector->sector - sectors);
+
+      if(pvs && !(pvs[secnum >> 3] & (1 << (secnum & 7))))
+         result = false;
+      else
+         result = P_checkSight(looker, target);
+
+      P_StoreSight(looker, target, result);
+      results[i] = result;
+   }
+}
+
 //----------------------------------------------------------------------------
 //
 // $Log: p_sight.c,v $
@@ -0,0 +1,572 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Sight check result cache and sector potentially visible sets.
+//
+//      Monsters look for their targets every few tics and most of the time
+//      neither they, their target, nor the sectors between them have moved,
+//      so the result of the last check between the same two things is kept
+//      along with where they were standing. Any change to a floor, ceiling,
+//      portal, polyobject or blocking line throws all remembered results
+//      away at once by bumping a version number.
+//
+//      Sector visibility rows are worked out the first time a sector is
+//      looked out of. Sight leaves a sector through one of its two-sided
+//      lines, and may only pass through the next line along the part of it
+//      which lies beyond the previous one and between the lines drawn from
+//      the ends of the first line through the ends of the previous one; it
+//      is the portal flow the Quake tools used, in two dimensions. Sectors
+//      no straight line can reach are not visible whatever the heights of
+//      things in them, so this can only ever turn away checks which would
+//      have failed. It is not used on maps with linked portals, and a
+//      sector whose row is too costly to work out just gets every sector it
+//      is connected to.
+//
+//-----------------------------------------------------------------------------
+
+#include "z_zone.h"
+#include "doomstat.h"
+#include "m_compare.h"
+#include "p_mobj.h"
+#include "p_portal.h"
+#include "p_sightcache.h"
+#include "r_defs.h"
+#include "r_state.h"
+
+//=============================================================================
+//
+// Sight Result Cache
+//
+
+#define SIGHTCACHE_SIZE 4096
+
+struct sightcache_t
+{
+   const Mobj *t1, *t2;
+   fixed_t x1, y1, z1, h1;
+   fixed_t x2, y2, z2, h2;
+   int     g1, g2;
+   unsigned int version;
+   bool    result;
+};
+
+static sightcache_t sightcache[SIGHTCACHE_SIZE];
+
+// Entries are only good while this matches; 0 is never valid
+static unsigned int sightversion = 1;
+
+//
+// P_sightCacheSlot
+//
+// Hashes an ordered pair of things into the cache. Sight is not symmetric,
+// as it is measured from the looker's eyes, so (t1, t2) and (t2, t1) are
+// kept apart.
+//
+static sightcache_t &P_sightCacheSlot(const Mobj *t1, const Mobj *t2)
+{
+   uintptr_t h = (uintptr_t(t1) >> 4) * 2654435761u;
+   h ^= (uintptr_t(t2) >> 4) + 0x9e3779b9u + (h << 6) + (h >> 2);
+   return sightcache[h & (SIGHTCACHE_SIZE - 1)];
+}
+
+//
+// P_InvalidateSightCache
+//
+// Forgets every remembered sight check. Called whenever something which
+// can block sight changes.
+//
+void P_InvalidateSightCache()
+{
+   if(!++sightversion)
+   {
+      // wrapped around; clear out the old versions properly
+      memset(sightcache, 0, sizeof(sightcache));
+      sightversion = 1;
+   }
+}
+
+//
+// P_LookupSight
+//
+// Returns true and sets result if t1 last checked sight of t2 with nothing
+// having moved since.
+//
+bool P_LookupSight(const Mobj *t1, const Mobj *t2, bool &result)
+{
+   const sightcache_t &sc = P_sightCacheSlot(t1, t2);
+
+   if(sc.version != sightversion || sc.t1 != t1 || sc.t2 != t2)
+      return false;
+
+   if(sc.x1 != t1->x || sc.y1 != t1->y || sc.z1 != t1->z ||
+      sc.h1 != t1->height || sc.g1 != t1->groupid ||
+      sc.x2 != t2->x || sc.y2 != t2->y || sc.z2 != t2->z ||
+      sc.h2 != t2->height || sc.g2 != t2->groupid)
+      return false;
+
+   result = sc.result;
+   return true;
+}
+
+//
+// P_StoreSight
+//
+// Remembers the result of a sight check.
+//
+void P_StoreSight(const Mobj *t1, const Mobj *t2, bool result)
+{
+   sightcache_t &sc = P_sightCacheSlot(t1, t2);
+
+   sc.t1 = t1;
+   sc.x1 = t1->x;
+   sc.y1 = t1->y;
+   sc.z1 = t1->z;
+   sc.h1 = t1->height;
+   sc.g1 = t1->groupid;
+   sc.t2 = t2;
+   sc.x2 = t2->x;
+   sc.y2 = t2->y;
+   sc.z2 = t2->z;
+   sc.h2 = t2->height;
+   sc.g2 = t2->groupid;
+   sc.version = sightversion;
+   sc.result  = result;
+}
+
+//=============================================================================
+//
+// Potentially Visible Sets
+//
+
+// Deepest chain of lines followed before giving up on a row
+#define PVS_MAXDEPTH 64
+
+// Lines looked at before giving up on a row
+#define PVS_BUDGET   32768
+
+// Tolerance in map units; windows are kept slightly wider than they are
+#define PVS_EPSILON  (1.0 / 16.0)
+
+struct pvspoint_t
+{
+   double x, y;
+};
+
+struct pvswindow_t
+{
+   pvspoint_t p1, p2;
+};
+
+struct pvsportal_t
+{
+   pvswindow_t win;     // the whole line
+   int front, back;     // sector numbers on each side
+};
+
+// plane a*x + b*y + c, with the kept side being where it is >= 0
+struct pvsplane_t
+{
+   double a, b, c;
+};
+
+static pvsportal_t *pvsportals;
+static int         *pvsportalstart; // numsectors + 1 offsets into pvsportallist
+static int         *pvsportallist;
+static byte       **pvsrows;
+static int         *pvsqueue;
+static byte        *pvsonpath;      // lines already in the chain being followed
+static int          pvsrowbytes;
+static bool         pvsusable;
+
+struct pvsflow_t
+{
+   const pvsportal_t *source;
+   pvsplane_t pastsource; // the source line, facing the way sight went
+   int   budget;
+   byte *row;
+};
+
+//
+// P_planeThrough
+//
+// Gets the plane through two points, positive on the left of p -> q.
+//
+static pvsplane_t P_planeThrough(const pvspoint_t &p, const pvspoint_t &q)
+{
+   pvsplane_t pl;
+
+   pl.a = p.y - q.y;
+   pl.b = q.x - p.x;
+   pl.c = -(pl.a * p.x + pl.b * p.y);
+
+   return pl;
+}
+
+static double P_planeDist(const pvsplane_t &pl, const pvspoint_t &p)
+{
+   return pl.a * p.x + pl.b * p.y + pl.c;
+}
+
+static double P_planeEpsilon(const pvsplane_t &pl)
+{
+   return PVS_EPSILON * sqrt(pl.a * pl.a + pl.b * pl.b);
+}
+
+static pvsplane_t P_planeFlip(const pvsplane_t &pl)
+{
+   pvsplane_t f = { -pl.a, -pl.b, -pl.c };
+   return f;
+}
+
+//
+// P_clipWindow
+//
+// Cuts a window down to the part on the kept side of a plane. Returns false
+// if nothing is left.
+//
+static bool P_clipWindow(pvswindow_t &w, const pvsplane_t &pl)
+{
+   double eps = P_planeEpsilon(pl);
+   double d1  = P_planeDist(pl, w.p1);
+   double d2  = P_planeDist(pl, w.p2);
+
+   if(d1 >= -eps && d2 >= -eps)
+      return true;
+   if(d1 < -eps && d2 < -eps)
+      return false;
+
+   // cut where the window leaves the tolerance band, not at the plane
+   double     t = (d1 + eps) / (d1 - d2);
+   pvspoint_t mid = { w.p1.x + t * (w.p2.x - w.p1.x),
+                      w.p1.y + t * (w.p2.y - w.p1.y) };
+
+   if(d1 < -eps)
+      w.p1 = mid;
+   else
+      w.p2 = mid;
+
+   return true;
+}
+
+//
+// P_portalFacing
+//
+// Gets the plane of a portal line with its kept side toward the given
+// sector. Doom lines face right, so the front sector is on the negative side.
+//
+static pvsplane_t P_portalFacing(const pvsportal_t &p, int secnum)
+{
+   pvsplane_t pl = P_planeThrough(p.win.p1, p.win.p2);
+   return secnum == p.front ? P_planeFlip(pl) : pl;
+}
+
+//
+// P_clipSeparators
+//
+// Cuts a window down to what can be seen from the source line through the
+// pass window. Each line drawn from an end of the source through an end of
+// the pass window with the rest of each on opposite sides bounds what lies
+// beyond.
+//
+static bool P_clipSeparators(const pvswindow_t &source, const pvswindow_t &pass,
+                             pvswindow_t &w)
+{
+   const pvspoint_t *sp[2] = { &source.p1, &source.p2 };
+   const pvspoint_t *pp[2] = { &pass.p1,   &pass.p2   };
+
+   for(int i = 0; i < 2; i++)
+   {
+      for(int j = 0; j < 2; j++)
+      {
+         pvsplane_t pl  = P_planeThrough(*sp[i], *pp[j]);
+         double     eps = P_planeEpsilon(pl);
+
+         if(eps < PVS_EPSILON * PVS_EPSILON)
+            continue; // ends touch; no line through them
+
+         double ds = P_planeDist(pl, *sp[i ^ 1]);
+         double dp = P_planeDist(pl, *pp[j ^ 1]);
+
+         if(ds < -eps && dp > eps)
+         {
+            if(!P_clipWindow(w, pl))
+               return false;
+         }
+         else if(ds > eps && dp < -eps)
+         {
+            if(!P_clipWindow(w, P_planeFlip(pl)))
+               return false;
+         }
+      }
+   }
+
+   return true;
+}
+
+//
+// P_pvsFlow
+//
+// Follows sight on through the lines of a sector it came into through the
+// pass window of line passid. Returns false if the row is too costly.
+//
+static bool P_pvsFlow(pvsflow_t &flow, const pvswindow_t &pass, int passid,
+                      int secnum, int depth)
+{
+   const pvsplane_t ahead = P_portalFacing(pvsportals[passid], secnum);
+
+   for(int i = pvsportalstart[secnum]; i < pvsportalstart[secnum + 1]; i++)
+   {
+      int portalid = pvsportallist[i];
+
+      // a straight line crosses any other line only once
+      if(pvsonpath[portalid])
+         continue;
+
+      if(--flow.budget < 0)
+         return false;
+
+      const pvsportal_t &p = pvsportals[portalid];
+      pvswindow_t w = p.win;
+
+      if(!P_clipWindow(w, ahead) || !P_clipWindow(w, flow.pastsource))
+         continue;
+
+      if(depth > 0 && !P_clipSeparators(flow.source->win, pass, w))
+         continue;
+
+      int next = p.front == secnum ? p.back : p.front;
+      flow.row[next >> 3] |= 1 << (next & 7);
+
+      if(depth + 1 >= PVS_MAXDEPTH)
+         return false;
+
+      pvsonpath[portalid] = 1;
+      bool ok = P_pvsFlow(flow, w, portalid, next, depth + 1);
+      pvsonpath[portalid] = 0;
+
+      if(!ok)
+         return false;
+   }
+
+   return true;
+}
+
+//
+// P_pvsConnected
+//
+// Marks every sector which can be reached from secnum at all.
+//
+static void P_pvsConnected(int secnum, byte *row)
+{
+   int head = 0, tail = 0;
+
+   memset(row, 0, pvsrowbytes);
+   row[secnum >> 3] |= 1 << (secnum & 7);
+   pvsqueue[tail++] = secnum;
+
+   while(head < tail)
+   {
+      int sec = pvsqueue[head++];
+
+      for(int i = pvsportalstart[sec]; i < pvsportalstart[sec + 1]; i++)
+      {
+         const pvsportal_t &p = pvsportals[pvsportallist[i]];
+         int next = p.front == sec ? p.back : p.front;
+
+         if(!(row[next >> 3] & (1 << (next & 7))))
+         {
+            row[next >> 3] |= 1 << (next & 7);
+            pvsqueue[tail++] = next;
+         }
+      }
+   }
+}
+
+//
+// P_buildPVSRow
+//
+static void P_buildPVSRow(int secnum)
+{
+   byte *row = ecalloctag(byte *, pvsrowbytes, 1, PU_LEVEL,
+                          (void **)&pvsrows[secnum]);
+   pvsflow_t flow;
+
+   row[secnum >> 3] |= 1 << (secnum & 7);
+
+   flow.budget = PVS_BUDGET;
+   flow.row    = row;
+
+   for(int i = pvsportalstart[secnum]; i < pvsportalstart[secnum + 1]; i++)
+   {
+      int portalid = pvsportallist[i];
+      const pvsportal_t &p = pvsportals[portalid];
+      int next = p.front == secnum ? p.back : p.front;
+
+      row[next >> 3] |= 1 << (next & 7);
+
+      flow.source     = &p;
+      flow.pastsource = P_portalFacing(p, next);
+
+      pvsonpath[portalid] = 1;
+      bool ok = P_pvsFlow(flow, p.win, portalid, next, 0);
+      pvsonpath[portalid] = 0;
+
+      if(!ok)
+      {
+         P_pvsConnected(secnum, row);
+         return;
+      }
+   }
+}
+
+//
+// P_mapIsClosed
+//
+// The rows are only right if every subsector lies wholly in the sector its
+// segs say it does; broken maps where they disagree go without.
+//
+static bool P_mapIsClosed()
+{
+   for(int i = 0; i < numsubsectors; i++)
+   {
+      const subsector_t &ss = subsectors[i];
+
+      for(int j = ss.firstline; j < ss.firstline + ss.numlines; j++)
+      {
+         if(segs[j].linedef && segs[j].frontsector != ss.sector)
+            return false;
+      }
+   }
+
+   return true;
+}
+
+//
+// P_InitSightCache
+//
+// Called at level setup. Forgets sight results from the last level and
+// gathers up the lines sight can pass through; visibility rows themselves
+// are only worked out when first needed.
+//
+void P_InitSightCache()
+{
+   int i, count = 0;
+
+   P_InvalidateSightCache();
+
+   pvsrows     = nullptr;
+   pvsusable   = P_mapIsClosed();
+   pvsrowbytes = (numsectors + 7) >> 3;
+
+   pvsportalstart = ecalloctag(int *, numsectors + 1, sizeof(int), PU_LEVEL,
+                               (void **)&pvsportalstart);
+
+   // Every two-sided line counts, even ones set to block everything, as
+   // those can be toggled at will and this must stay right regardless.
+   for(i = 0; i < numlines; i++)
+   {
+      const line_t *li = &lines[i];
+
+      if(li->sidenum[1] == -1 || !li->backsector ||
+         li->frontsector == li->backsector)
+         continue;
+
+      ++pvsportalstart[li->frontsector - sectors];
+      ++pvsportalstart[li->backsector  - sectors];
+      ++count;
+   }
+
+   for(i = 0; i < numsectors; i++)
+      pvsportalstart[i + 1] += pvsportalstart[i];
+
+   pvsportals    = ecalloctag(pvsportal_t *, emax(count, 1), sizeof(pvsportal_t),
+                              PU_LEVEL, (void **)&pvsportals);
+   pvsportallist = ecalloctag(int *, emax(count * 2, 1), sizeof(int), PU_LEVEL,
+                              (void **)&pvsportallist);
+   pvsonpath     = ecalloctag(byte *, emax(count, 1), 1, PU_LEVEL,
+                              (void **)&pvsonpath);
+
+   count = 0;
+   for(i = 0; i < numlines; i++)
+   {
+      const line_t *li = &lines[i];
+
+      if(li->sidenum[1] == -1 || !li->backsector ||
+         li->frontsector == li->backsector)
+         continue;
+
+      pvsportal_t &p = pvsportals[count];
+      p.win.p1.x = M_FixedToDouble(li->v1->x);
+      p.win.p1.y = M_FixedToDouble(li->v1->y);
+      p.win.p2.x = M_FixedToDouble(li->v2->x);
+      p.win.p2.y = M_FixedToDouble(li->v2->y);
+      p.front    = eindex(li->frontsector - sectors);
+      p.back     = eindex(li->backsector  - sectors);
+
+      // fill from the top down so the offsets end up as starts
+      pvsportallist[--pvsportalstart[p.front]] = count;
+      pvsportallist[--pvsportalstart[p.back]]  = count;
+      ++count;
+   }
+
+   pvsrows  = ecalloctag(byte **, emax(numsectors, 1), sizeof(byte *), PU_LEVEL,
+                         (void **)&pvsrows);
+   pvsqueue = ecalloctag(int *, emax(numsectors, 1), sizeof(int), PU_LEVEL,
+                         (void **)&pvsqueue);
+}
+
+//
+// P_SectorPVS
+//
+// Returns the visibility row for a sector, one bit per sector, or null if
+// rows are not in use for this level or demo.
+//
+const unsigned char *P_SectorPVS(int secnum)
+{
+   if(!pvsrows || !pvsusable || full_demo_version < make_full_version(401, 0))
+      return nullptr;
+
+   if(useportalgroups || gMapHasSectorPortals || gMapHasLinePortals)
+      return nullptr;
+
+   if(!pvsrows[secnum])
+      P_buildPVSRow(secnum);
+
+   return pvsrows[secnum];
+}
+
+//
+// P_SectorsMaySee
+//
+// Returns false if nothing in sector s1 could possibly see into sector s2.
+//
+bool P_SectorsMaySee(int s1, int s2)
+{
+   const byte *row = P_SectorPVS(s1);
+
+   return !row || (row[s2 >> 3] & (1 << (s2 & 7)));
+}
+
+// EOF
+
@@ -0,0 +1,46 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Sight check result cache and sector potentially visible sets.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef P_SIGHTCACHE_H__
+#define P_SIGHTCACHE_H__
+
+class Mobj;
+
+void P_InitSightCache();
+void P_InvalidateSightCache();
+
+bool P_LookupSight(const Mobj *t1, const Mobj *t2, bool &result);
+void P_StoreSight(const Mobj *t1, const Mobj *t2, bool result);
+
+bool P_SectorsMaySee(int s1, int s2);
+const unsigned char *P_SectorPVS(int secnum);
+
+#endif
+
+// EOF
+
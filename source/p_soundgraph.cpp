@@ -0,0 +1,471 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Sound propagation graph for monster alerts.
+//
+//      When the level is set up, each sector gets a list of the lines sound
+//      may leave it by and the sectors on their other side, and each such
+//      line gets a flag saying whether it is open. The flags are kept up to
+//      date as floors and ceilings move, looking only at the lines of the
+//      sector that moved, so an alert is a breadth-first walk of the graph
+//      which never has to work out a line opening.
+//
+//      The sectors an alert reaches, and how many sound-blocking lines it
+//      crossed to get to each, are the same P_RecursiveSound found: the
+//      walk first floods everything reachable without crossing a blocking
+//      line, then floods on from across the blocking lines it came upon.
+//
+//      Walks are remembered, so that an alert made again from the same
+//      sector, say by a chaingun firing every few tics, just marks the same
+//      sectors again if no line has opened or closed since. Walks which
+//      come upon linked portals are not remembered, as portals can be
+//      switched on and off and moved with polyobjects.
+//
+//-----------------------------------------------------------------------------
+
+#include "z_zone.h"
+#include "doomdata.h"
+#include "e_exdata.h"
+#include "m_compare.h"
+#include "p_mobj.h"
+#include "p_soundgraph.h"
+#include "p_tick.h"
+#include "r_defs.h"
+#include "r_main.h"
+#include "r_pcheck.h"
+#include "r_portal.h"
+#include "r_state.h"
+
+#define NUMSOUNDMEMOS 4
+
+struct soundedge_t
+{
+   line_t   *line;
+   sector_t *other; // nullptr for a line portal
+};
+
+struct soundmemo_t
+{
+   int          start;    // sector the alert was made from; -1 if unused
+   unsigned int version;  // soundversion when it was made
+   int          count;    // number of sectors reached
+   int          numclear; // of which, reached without a blocking line
+};
+
+static soundedge_t *soundedges;     // edges of each sector in turn
+static int         *soundedgestart; // first edge of each sector, numsectors + 1
+static int          numsoundedges;
+static int         *sounddeps;      // lines whose opening each sector affects
+static int         *sounddepstart;  // first dependent line, numsectors + 1
+static byte        *soundlineopen;  // for each line, whether sound gets past
+static byte        *soundportals;   // for each sector, if it has any portal
+static int         *soundqueue;     // sectors of a walk in the order reached
+static int         *soundblocked;   // sectors found across blocking lines
+static int         *soundmemovisits;
+
+static soundmemo_t  soundmemos[NUMSOUNDMEMOS];
+static int          nextsoundmemo;
+static unsigned int soundversion; // changes whenever a line opens or closes
+
+//
+// P_soundLineOpen
+//
+// Works out whether a line leaves a gap, the same as P_LineOpening does when
+// not given a thing. Only for lines with two sides.
+//
+static bool P_soundLineOpen(const line_t *line)
+{
+   const sector_t *front = line->frontsector;
+   const sector_t *back  = line->backsector;
+   fixed_t opentop, openbottom;
+
+   if(line->intflags & MLI_1SPORTALLINE && line->beyondportalline)
+      back = line->beyondportalline->frontsector;
+
+   if(line->extflags & EX_ML_UPPERPORTAL && back->c_pflags & PS_PASSABLE)
+      opentop = front->ceilingheight;
+   else
+      opentop = emin(front->ceilingheight, back->ceilingheight);
+
+   if(line->extflags & EX_ML_LOWERPORTAL && back->f_pflags & PS_PASSABLE)
+      openbottom = front->floorheight;
+   else
+      openbottom = emax(front->floorheight, back->floorheight);
+
+   return opentop - openbottom > 0;
+}
+
+//
+// P_soundUpdateLine
+//
+// Refreshes the open flag of a line. Bumps the version if it changed, which
+// forgets every remembered walk.
+//
+static void P_soundUpdateLine(int linenum)
+{
+   byte open = P_soundLineOpen(&lines[linenum]) ? 1 : 0;
+
+   if(soundlineopen[linenum] != open)
+   {
+      soundlineopen[linenum] = open;
+      ++soundversion;
+   }
+}
+
+//
+// P_soundGraphLine
+//
+// Lines with only one side never let sound through, so they are left out.
+//
+static bool P_soundGraphLine(const line_t *line)
+{
+   return line->sidenum[1] != -1;
+}
+
+//
+// P_BuildSoundGraph
+//
+// Builds the graph for the level. Called once the level's specials are all
+// spawned, so that the portals are in place.
+//
+void P_BuildSoundGraph()
+{
+   soundedgestart = ecalloctag(int *, numsectors + 1, sizeof(int), PU_LEVEL,
+                               (void **)&soundedgestart);
+   sounddepstart  = ecalloctag(int *, numsectors + 1, sizeof(int), PU_LEVEL,
+                               (void **)&sounddepstart);
+   soundportals   = ecalloctag(byte *, numsectors, 1, PU_LEVEL,
+                               (void **)&soundportals);
+
+   // count the edges of each sector
+   numsoundedges = 0;
+   for(int i = 0; i < numsectors; i++)
+   {
+      const sector_t *sec = &sectors[i];
+
+      soundedgestart[i] = numsoundedges;
+      if(sec->f_portal || sec->c_portal)
+         soundportals[i] = 1;
+
+      for(int j = 0; j < sec->linecount; j++)
+      {
+         const line_t *check = sec->lines[j];
+
+         if(check->portal)
+         {
+            soundportals[i] = 1;
+            ++numsoundedges;
+         }
+         if(P_soundGraphLine(check))
+            ++numsoundedges;
+      }
+   }
+   soundedgestart[numsectors] = numsoundedges;
+
+   soundedges   = ecalloctag(soundedge_t *, emax(numsoundedges, 1),
+                             sizeof(soundedge_t), PU_LEVEL, (void **)&soundedges);
+   soundblocked = ecalloctag(int *, emax(numsoundedges, 1), sizeof(int), PU_LEVEL,
+                             (void **)&soundblocked);
+
+   // fill them in
+   for(int i = 0, e = 0; i < numsectors; i++)
+   {
+      sector_t *sec = &sectors[i];
+
+      for(int j = 0; j < sec->linecount; j++)
+      {
+         line_t *check = sec->lines[j];
+
+         if(check->portal)
+         {
+            soundedges[e].line  = check;
+            soundedges[e].other = nullptr;
+            ++e;
+         }
+         if(P_soundGraphLine(check))
+         {
+            soundedges[e].line  = check;
+            soundedges[e].other =
+               sides[check->sidenum[sides[check->sidenum[0]].sector == sec]].sector;
+            ++e;
+         }
+      }
+   }
+
+   // each line depends on the sectors it opens between
+   int numdeps = 0;
+   for(int pass = 0; pass < 2; pass++)
+   {
+      for(int i = 0; i < numlines; i++)
+      {
+         const line_t *line = &lines[i];
+
+         if(!P_soundGraphLine(line))
+            continue;
+
+         const sector_t *deps[3] = { line->frontsector, line->backsector, nullptr };
+         if(line->intflags & MLI_1SPORTALLINE && line->beyondportalline)
+            deps[2] = line->beyondportalline->frontsector;
+
+         for(const sector_t *dep : deps)
+         {
+            if(!dep)
+               continue;
+            if(!pass)
+               ++sounddepstart[dep - sectors + 1];
+            else
+               sounddeps[sounddepstart[dep - sectors]++] = i;
+         }
+      }
+
+      if(!pass)
+      {
+         // turn the counts into starting positions
+         for(int i = 0; i < numsectors; i++)
+            sounddepstart[i + 1] += sounddepstart[i];
+         numdeps = sounddepstart[numsectors];
+         sounddeps = ecalloctag(int *, emax(numdeps, 1), sizeof(int), PU_LEVEL,
+                                (void **)&sounddeps);
+      }
+      else
+      {
+         // filling them in moved each start on to the next
+         for(int i = numsectors; i > 0; i--)
+            sounddepstart[i] = sounddepstart[i - 1];
+         sounddepstart[0] = 0;
+      }
+   }
+
+   soundqueue      = ecalloctag(int *, numsectors, sizeof(int), PU_LEVEL,
+                                (void **)&soundqueue);
+   soundmemovisits = ecalloctag(int *, NUMSOUNDMEMOS * numsectors, sizeof(int),
+                                PU_LEVEL, (void **)&soundmemovisits);
+   for(soundmemo_t &memo : soundmemos)
+      memo.start = -1;
+   nextsoundmemo = 0;
+
+   soundlineopen = ecalloctag(byte *, emax(numlines, 1), 1, PU_LEVEL,
+                              (void **)&soundlineopen);
+   for(int i = 0; i < numlines; i++)
+   {
+      if(P_soundGraphLine(&lines[i]))
+         soundlineopen[i] = P_soundLineOpen(&lines[i]) ? 1 : 0;
+   }
+}
+
+//
+// P_SoundGraphSectorChanged
+//
+// Called when a sector's floor or ceiling moves, or its portals change, to
+// see if any lines it borders opened or closed.
+//
+void P_SoundGraphSectorChanged(const sector_t *sec)
+{
+   if(!soundlineopen)
+      return;
+
+   const int secnum = int(sec - sectors);
+
+   for(int i = sounddepstart[secnum]; i < sounddepstart[secnum + 1]; i++)
+      P_soundUpdateLine(sounddeps[i]);
+}
+
+//
+// P_SoundGraphPortalsChanged
+//
+// Called when portals are changed in a way that may affect any number of
+// sectors, to look over every line again.
+//
+void P_SoundGraphPortalsChanged()
+{
+   if(!soundlineopen)
+      return;
+
+   for(int i = 0; i < numlines; i++)
+   {
+      if(P_soundGraphLine(&lines[i]))
+         P_soundUpdateLine(i);
+   }
+}
+
+//
+// P_soundPortalSector
+//
+// Because the same portal can be used on many sectors and even lines, the
+// portal structure won't tell you what sector is on the other side of it.
+// Look for it across the portal from the middle of a line.
+//
+static sector_t *P_soundPortalSector(const line_t *check, const linkdata_t *link)
+{
+   return R_PointInSubsector(((check->v1->x + check->v2->x) / 2) + link->deltax,
+                             ((check->v1->y + check->v2->y) / 2) + link->deltay)->sector;
+}
+
+//
+// P_soundReach
+//
+// Marks a sector as reached, if it wasn't already, and queues it up to be
+// walked from. traversed is one more than the number of sound-blocking lines
+// crossed to get there, as monsters expect.
+//
+static void P_soundReach(sector_t *sec, int traversed, Mobj *soundtarget,
+                         int &tail)
+{
+   if(sec->validcount == validcount)
+      return;
+
+   sec->validcount     = validcount;
+   sec->soundtraversed = traversed;
+   P_SetTarget<Mobj>(&sec->soundtarget, soundtarget);
+
+   soundqueue[tail++] = int(sec - sectors);
+}
+
+//
+// P_soundWalk
+//
+// Walks on from the queued sectors until there are no more. Sectors across
+// blocking lines are added to soundblocked if numblocked is given, and are
+// otherwise left alone. Sets usedportals if any sector walked from had a
+// portal.
+//
+static void P_soundWalk(int head, int &tail, int traversed, Mobj *soundtarget,
+                        int *numblocked, bool &usedportals)
+{
+   while(head < tail)
+   {
+      const int secnum = soundqueue[head++];
+      sector_t *sec    = &sectors[secnum];
+
+      if(soundportals[secnum])
+      {
+         usedportals = true;
+
+#ifdef R_LINKEDPORTALS
+         if(sec->f_pflags & PS_PASSSOUND && sec->linecount)
+         {
+            P_soundReach(P_soundPortalSector(sec->lines[0], R_FPLink(sec)),
+                         traversed, soundtarget, tail);
+         }
+         if(sec->c_pflags & PS_PASSSOUND && sec->linecount)
+         {
+            P_soundReach(P_soundPortalSector(sec->lines[0], R_CPLink(sec)),
+                         traversed, soundtarget, tail);
+         }
+#endif
+      }
+
+      for(int e = soundedgestart[secnum]; e < soundedgestart[secnum + 1]; e++)
+      {
+         const soundedge_t &edge  = soundedges[e];
+         const line_t      *check = edge.line;
+
+         if(!edge.other)
+         {
+#ifdef R_LINKEDPORTALS
+            if(check->pflags & PS_PASSSOUND)
+            {
+               P_soundReach(P_soundPortalSector(check, &check->portal->data.link),
+                            traversed, soundtarget, tail);
+            }
+#endif
+            continue;
+         }
+
+         if(!(check->flags & ML_TWOSIDED) || !soundlineopen[check - lines] ||
+            edge.other->validcount == validcount)
+            continue;
+
+         if(!(check->flags & ML_SOUNDBLOCK))
+            P_soundReach(edge.other, traversed, soundtarget, tail);
+         else if(numblocked)
+            soundblocked[(*numblocked)++] = int(edge.other - sectors);
+      }
+   }
+}
+
+//
+// P_PropagateSound
+//
+// Alerts the sectors sound from the given sector can reach to soundtarget:
+// all of those which it can get to through open two-sided lines and linked
+// portals, crossing at most one sound-blocking line. validcount must have
+// been bumped beforehand.
+//
+void P_PropagateSound(sector_t *sec, Mobj *soundtarget)
+{
+   const int secnum = int(sec - sectors);
+
+   if(!soundlineopen)
+      P_BuildSoundGraph();
+
+   // made from here before, with every line as it is now?
+   for(const soundmemo_t &memo : soundmemos)
+   {
+      if(memo.start != secnum || memo.version != soundversion)
+         continue;
+
+      const int *visits = soundmemovisits + (&memo - soundmemos) * numsectors;
+
+      for(int i = 0; i < memo.count; i++)
+      {
+         sector_t *other = &sectors[visits[i]];
+
+         other->validcount     = validcount;
+         other->soundtraversed = i < memo.numclear ? 1 : 2;
+         P_SetTarget<Mobj>(&other->soundtarget, soundtarget);
+      }
+      return;
+   }
+
+   int  tail        = 0;
+   int  numblocked  = 0;
+   bool usedportals = false;
+
+   P_soundReach(sec, 1, soundtarget, tail);
+   P_soundWalk(0, tail, 1, soundtarget, &numblocked, usedportals);
+
+   const int numclear = tail;
+
+   for(int i = 0; i < numblocked; i++)
+      P_soundReach(&sectors[soundblocked[i]], 2, soundtarget, tail);
+   P_soundWalk(numclear, tail, 2, soundtarget, nullptr, usedportals);
+
+   if(usedportals)
+      return;
+
+   soundmemo_t &memo = soundmemos[nextsoundmemo];
+
+   memo.start    = secnum;
+   memo.version  = soundversion;
+   memo.count    = tail;
+   memo.numclear = numclear;
+   memcpy(soundmemovisits + nextsoundmemo * numsectors, soundqueue,
+          tail * sizeof(int));
+
+   nextsoundmemo = (nextsoundmemo + 1) % NUMSOUNDMEMOS;
+}
+
+// EOF
+
@@ -651,6 +651,7 @@ public:
 
    // Methods
    virtual void serialize(SaveArchive &arc) override;
+   virtual void remove() override;
    virtual bool reTriggerVerticalDoor(bool player) { return false; }
 
    // Data Members
@@ -740,6 +741,7 @@ class StrobeThinker : public SectorThinker
 
 protected:
    void Think() override;
+   int parallelKey() const override;
 
 public:
    // Methods
@@ -760,6 +762,7 @@ class GlowThinker : public SectorThinker
 
 protected:
    void Think() override;
+   int parallelKey() const override;
 
 public:
    // Methods
@@ -778,6 +781,7 @@ class SlowGlowThinker : public SectorThinker
 
 protected:
    void Think() override;
+   int parallelKey() const override;
 
 public:
    // Methods
@@ -799,6 +803,7 @@ class LightFadeThinker : public SectorThinker
 
 protected:
    void Think() override;
+   int parallelKey() const override;
 
 public:
    // Methods
@@ -820,6 +825,7 @@ class PhasedLightThinker : public SectorThinker
 
 protected:
    void Think() override;
+   int parallelKey() const override;
 
    // Data members
    int base;
@@ -32,6 +32,9 @@
 #include "d_main.h"
 #include "doomstat.h"
 #include "i_system.h"
+#include "m_collection.h"
+#include "m_profile.h"
+#include "m_threadpool.h"
 #include "p_anim.h"
 #include "p_chase.h"
 #include "p_saveg.h"
@@ -148,6 +151,9 @@ void Thinker::addThinker()
 
 Thinker *Thinker::currentthinker;
 
+// Counts tics run with parallel thinkers
+static unsigned int parallelticcount;
+
 //
 // P_RemoveThinkerDelayed
 //
@@ -227,18 +233,114 @@ void Thinker::remove()
 //
 void Thinker::RunThinkers(void)
 {
+   PROFILE_ZONE(PROF_THINKERS);
+
+   // Parallel ticking changes the order in which thinkers run relative to
+   // one another, so it must never be used where demo or network sync
+   // depends on the original order.
+   bool parallel = p_parallelthinkers && !demo_compatibility && !netgame &&
+                   !demoplayback && !demorecording;
+
+   if(parallel)
+      RunParallelThinkers();
+
    for(currentthinker = thinkercap.next; 
        currentthinker != &thinkercap;
        currentthinker = currentthinker->next)
    {
       if(currentthinker->removed)
          currentthinker->removeDelayed();
-      else
+      else if(!parallel || currentthinker->paralleltic != parallelticcount)
          currentthinker->Think();
    }
    S_MusInfoUpdate();
 }
 
+//=============================================================================
+//
+// Parallel Thinkers
+//
+// Thinkers which give a parallelKey run first, split into batches by key.
+// All thinkers with the same key go in the same batch, in list order, and
+// thinkers of different keys share no data, so the outcome is the same for
+// any number of batches or threads. The remaining thinkers then run serially
+// as usual, along with any new thinkers spawned during the tic.
+//
+
+// Run parallel-safe thinkers ahead of the rest
+bool p_parallelthinkers;
+
+// Batch being run by this thread; the main thread is always 0
+thread_local int p_thinkerbatch;
+
+// Below this many parallel-safe thinkers, batches all run on the main thread
+#define P_MINPARALLELTHINKERS 256
+
+static PODCollection<Thinker *> thinkerbatches[P_MAXTHINKERBATCHES];
+static ThreadPool *thinkerpool;
+
+//
+// Thinker::RunThinkerBatch
+//
+// Thread pool job; runs one batch of parallel-safe thinkers.
+//
+void Thinker::RunThinkerBatch(int batch, void *data)
+{
+   p_thinkerbatch = batch;
+
+   for(Thinker *th : thinkerbatches[batch])
+      th->Think();
+
+   p_thinkerbatch = 0;
+}
+
+//
+// Thinker::RunParallelThinkers
+//
+// Runs every parallel-safe thinker and marks it as having run this tic.
+//
+void Thinker::RunParallelThinkers()
+{
+   int numbatches = ThreadPool::HardwareThreads();
+   int count = 0;
+
+   if(numbatches > P_MAXTHINKERBATCHES)
+      numbatches = P_MAXTHINKERBATCHES;
+
+   ++parallelticcount;
+
+   for(PODCollection<Thinker *> &batch : thinkerbatches)
+      batch.makeEmpty();
+
+   for(Thinker *th = thinkercap.next; th != &thinkercap; th = th->next)
+   {
+      int key;
+
+      if(th->removed || (key = th->parallelKey()) < 0)
+         continue;
+
+      thinkerbatches[key % numbatches].add(th);
+      th->paralleltic = parallelticcount;
+      ++count;
+   }
+
+   if(count < P_MINPARALLELTHINKERS || numbatches == 1)
+   {
+      for(int i = 0; i < numbatches; i++)
+         RunThinkerBatch(i, nullptr);
+      return;
+   }
+
+   if(!thinkerpool)
+      thinkerpool = new ThreadPool();
+   if(thinkerpool->getNumThreads() != numbatches)
+      thinkerpool->resize(numbatches);
+
+   Z_SetLocking(true);
+   thinkerpool->run(RunThinkerBatch, nullptr);
+   Z_SetLocking(false);
+}
+
 //
 // Thinker::serialize
 //
@@ -261,6 +363,8 @@ void Thinker::serialize(SaveArchive &arc)
 //
 void P_Ticker()
 {
+   PROFILE_ZONE(PROF_PTICKER);
+
    // pause if in menu and at least one tic has been run
    //
    // killough 9/29/98: note that this ties in with basetic,
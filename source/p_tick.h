@@ -26,6 +26,9 @@
 class SaveArchive;
 class Thinker;
 
+// Most batches of thinkers run in parallel at once
+#define P_MAXTHINKERBATCHES 16
+
 //
 // Thinker
 //
@@ -43,15 +46,29 @@ private:
    // killough 11/98: count of how many other objects reference
    // this one using pointers. Used for garbage collection.
    unsigned int references;
+
+   // Parallel tick on which this thinker last ran ahead of the others
+   unsigned int paralleltic;
    
    // Statics
    // Current position in list during RunThinkers
    static Thinker *currentthinker;
 
+   static void RunParallelThinkers();
+   static void RunThinkerBatch(int batch, void *data);
+
 protected:
    // Virtual methods (overridables)
    virtual void Think() {}
 
+   // Thinkers whose Think only changes data belonging to one sector or
+   // sidedef may return a key for that object here, and will then be run
+   // ahead of all other thinkers, in parallel with those of other keys.
+   // Such a Think must not use the random number generators, spawn or remove
+   // thinkers, or read anything another thinker of a different key writes.
+   // Sectors are keyed by number and sidedefs by numsectors + number.
+   virtual int parallelKey() const { return -1; }
+
    // Methods
    void addToThreadedList(int tclass);
 
@@ -64,8 +81,8 @@ protected:
 public:
    // Constructor
    Thinker() 
-      : Super(), references(0), removed(false), ordinal(0), prev(NULL),
-        next(NULL), cprev(NULL), cnext(NULL)
+      : Super(), references(0), paralleltic(0), removed(false), ordinal(0),
+        prev(NULL), next(NULL), cprev(NULL), cnext(NULL)
    {
    }
 
@@ -145,6 +162,9 @@ void P_Ticker(void);
 
 extern Thinker thinkercap;  // Both the head and tail of the thinker list
 
+extern bool p_parallelthinkers;
+extern thread_local int p_thinkerbatch;
+
 //
 // P_NextThinker
 //
@@ -31,6 +31,7 @@
 //-----------------------------------------------------------------------------
 
 #include "z_zone.h"
+#include "acs_intr.h"
 #include "cam_sight.h"
 #include "i_system.h"
 #include "doomstat.h"
@@ -48,6 +49,7 @@
 #include "p_portalblockmap.h"
 #include "p_saveg.h"
 #include "p_setup.h"
+#include "p_sightcache.h"
 #include "p_slopes.h"
 #include "p_spec.h"
 #include "p_tick.h"
@@ -768,6 +770,9 @@ static void Polyobj_linkToBlockmap(polyobj_t *po)
    // never link a bad polyobject or a polyobject already linked
    if(po->flags & (POF_ISBAD | POF_LINKED))
       return;
+
+   // it has moved or turned, so may block sight differently
+   P_InvalidateSightCache();
    
    // 2/26/06: start line box with values of first vertex, not MININT/MAXINT
    blockbox[BOXLEFT]   = blockbox[BOXRIGHT] = po->vertices[0]->x;
@@ -1593,7 +1598,7 @@ void PolyRotateThinker::Think()
          }
          this->remove();
 
-         // TODO: notify scripts
+         ACS_SignalTag(ACS_TAGTYPE_POLYOBJ, po->id);
          S_StopPolySequence(po);
       }
       else if(this->distance < avel && this->distance > 0)
@@ -1675,7 +1680,7 @@ void PolyMoveThinker::Think()
          }
          this->remove();
 
-         // TODO: notify scripts
+         ACS_SignalTag(ACS_TAGTYPE_POLYOBJ, po->id);
          S_StopPolySequence(po);
       }
       else if(this->distance < avel)
@@ -1737,6 +1742,7 @@ void PolyMoveXYThinker::Think()
          }
          remove();
 
+         ACS_SignalTag(ACS_TAGTYPE_POLYOBJ, po->id);
          S_StopPolySequence(po);
       }
       else
@@ -1837,7 +1843,7 @@ void PolySlideDoorThinker::Think()
                po->thrust = FRACUNIT;
             }
             this->remove();
-            // TODO: notify scripts
+            ACS_SignalTag(ACS_TAGTYPE_POLYOBJ, po->id);
          }
          S_StopPolySequence(po);
       }
@@ -1949,7 +1955,7 @@ void PolySwingDoorThinker::Think()
                po->thrust = FRACUNIT;
             }
             this->remove();
-            // TODO: notify scripts
+            ACS_SignalTag(ACS_TAGTYPE_POLYOBJ, po->id);
          }
          S_StopPolySequence(po);
       }
@@ -2191,6 +2197,7 @@ int EV_DoPolyObjStop(int polyObjNum)
    {
       po->thinker->remove();
       po->thinker = nullptr;
+      ACS_SignalTag(ACS_TAGTYPE_POLYOBJ, po->id);
       S_StopPolySequence(po);
    }
 
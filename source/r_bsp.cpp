@@ -29,10 +29,12 @@
 #include "doomstat.h"
 #include "e_exdata.h"
 #include "m_bbox.h"
+#include "m_profile.h"
 #include "p_chase.h"
 #include "p_maputl.h"   // ioanch 20160125
 #include "p_portal.h"
 #include "p_slopes.h"
+#include "r_context.h"
 #include "r_data.h"
 #include "r_draw.h"
 #include "r_main.h"
@@ -52,14 +54,14 @@
 // on line overlaps.
 static const float kPortalSegRejectionFudge = 1.f / 256;
 
-drawseg_t *ds_p;
+thread_local drawseg_t *ds_p;
 
 // killough 4/7/98: indicates doors closed wrt automap bugfix:
-int      doorclosed;
+thread_local int doorclosed;
 
 // killough: New code which removes 2s linedef limit
-drawseg_t *drawsegs = NULL;
-unsigned int maxdrawsegs;
+thread_local drawseg_t *drawsegs = NULL;
+thread_local unsigned int maxdrawsegs;
 // drawseg_t drawsegs[MAXDRAWSEGS];       // old code -- killough
 
 
@@ -111,14 +113,14 @@ typedef struct cliprange_s
 #define MAXSEGS (w/2+1)   /* killough 1/11/98, 2/8/98 */
 
 // newend is one past the last valid seg
-static cliprange_t *newend;
-static cliprange_t *solidsegs;
+static thread_local cliprange_t *newend;
+static thread_local cliprange_t *solidsegs;
 
 // addend is one past the last valid added seg.
-static cliprange_t *addedsegs;
-static cliprange_t *addend;
+static thread_local cliprange_t *addedsegs;
+static thread_local cliprange_t *addend;
 
-VALLOCATION(solidsegs)
+VCTXALLOCATION(solidsegs)
 {
    cliprange_t *buf = 
       ecalloctag(cliprange_t *, MAXSEGS*2, sizeof(cliprange_t), PU_VALLOC, NULL);
@@ -351,9 +353,10 @@ static void R_ClipPassWallSegment(int x1, int x2)
 //
 void R_ClearClipSegs()
 {
+   // everything outside the render context's slice starts out solid
    solidsegs[0].first = D_MININT + 1;
-   solidsegs[0].last  = -1;
-   solidsegs[1].first = viewwindow.width;
+   solidsegs[0].last  = r_context->startcolumn - 1;
+   solidsegs[1].first = r_context->endcolumn + 1;
    solidsegs[1].last  = D_MAXINT - 1;
    newend = solidsegs+2;
    addend = addedsegs;
@@ -720,9 +723,9 @@ const sector_t *R_FakeFlat(const sector_t *sec, sector_t *tempsec,
 // to be clipped. This is done so visplanes will still be rendered 
 // fully.
 
-static float *slopemark;
+static thread_local float *slopemark;
 
-VALLOCATION(slopemark)
+VCTXALLOCATION(slopemark)
 {
    slopemark = ecalloctag(float *, w, sizeof(float), PU_VALLOC, NULL);
 }
@@ -2092,7 +2095,7 @@ static bool R_allowBehindSectorPortal(const fixed_t bbox[4], const seg_t &tryseg
 //
 static void R_AddLine(const seg_t *line, bool dynasegs)
 {
-   static sector_t tempsec;
+   static thread_local sector_t tempsec;
 
    float x1, x2;
    float i1, i2, pstep;
@@ -2493,15 +2496,17 @@ static void R_AddLine(const seg_t *line, bool dynasegs)
    // Add new solid segs when it is safe to do so...
    R_AddMarkedSegs();
 
-   sectorbox_t &box = pSectorBoxes[seg.line->frontsector - sectors];
-   if(seg.f_window && box.fframeid != frameid)
+   const int secnum = int(seg.line->frontsector - sectors);
+   const sectorbox_t &box = pSectorBoxes[secnum];
+   rcsectorstamp_t &stamp = r_context->sectorstamps[secnum];
+   if(seg.f_window && stamp.fframeid != frameid)
    {
-      box.fframeid = frameid;
+      stamp.fframeid = frameid;
       R_CalcRenderBarrier(*seg.f_window, box);
    }
-   if(seg.c_window && box.cframeid != frameid)
+   if(seg.c_window && stamp.cframeid != frameid)
    {
-      box.cframeid = frameid;
+      stamp.cframeid = frameid;
       R_CalcRenderBarrier(*seg.c_window, box);
    }
 }
@@ -2694,6 +2699,10 @@ static void R_RenderPolyNode(const rpolynode_t *node)
 //
 static void R_AddDynaSegs(subsector_t *sub)
 {
+   // The dynamic BSP is built lazily and R_RenderPolyNode temporarily edits
+   // its segs' vertices, so render contexts must take turns here.
+   ZoneLockGuard lock;
+
    bool needbsp = (!sub->bsp || sub->bsp->dirty);
 
    if(needbsp)
@@ -2812,7 +2821,7 @@ static void R_Subsector(int num)
                     floorangle, seg.frontsec->f_slope, 
                     seg.frontsec->f_pflags,
                     fpalpha,
-                    seg.f_portal->poverlay) : NULL;
+                    R_GetPortalOverlay(seg.f_portal)) : NULL;
    }
    else
    {
@@ -2864,7 +2873,7 @@ static void R_Subsector(int num)
                     ceilingangle, seg.frontsec->c_slope, 
                     seg.frontsec->c_pflags,
                     cpalpha,
-                    seg.c_portal->poverlay) : NULL;
+                    R_GetPortalOverlay(seg.c_portal)) : NULL;
    }
    else
    {
@@ -2910,15 +2919,14 @@ static void R_Subsector(int num)
 }
 
 //
-// R_RenderBSPNode
+// R_renderBSPNode
 //
 // Renders all subsectors below a given node,
 //  traversing subtree recursively.
-// Just call with BSP root.
 //
 // killough 5/2/98: reformatted, removed tail recursion
 //
-void R_RenderBSPNode(int bspnum)
+static void R_renderBSPNode(int bspnum)
 {
    while(!(bspnum & NF_SUBSECTOR))  // Found a subsector?
    {
@@ -2928,7 +2936,7 @@ void R_RenderBSPNode(int bspnum)
       int side = R_PointOnSide(viewx, viewy, bsp);
       
       // Recursively divide front space.
-      R_RenderBSPNode(bsp->children[side]);
+      R_renderBSPNode(bsp->children[side]);
       
       // Possibly divide back space.
       
@@ -2940,6 +2948,19 @@ void R_RenderBSPNode(int bspnum)
    R_Subsector(bspnum == -1 ? 0 : bspnum & ~NF_SUBSECTOR);
 }
 
+//
+// R_RenderBSPNode
+//
+// Renders all subsectors below a given node. Just call with BSP root; the
+// walk is timed as one profiler zone.
+//
+void R_RenderBSPNode(int bspnum)
+{
+   PROFILE_ZONE(PROF_BSP);
+
+   R_renderBSPNode(bspnum);
+}
+
 //----------------------------------------------------------------------------
 //
 // $Log: r_bsp.c,v $
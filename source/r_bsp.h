@@ -42,10 +42,10 @@ extern sector_t *backsector;
 // old code -- killough:
 // extern drawseg_t drawsegs[MAXDRAWSEGS];
 // new code -- killough:
-extern drawseg_t *drawsegs;
-extern unsigned int maxdrawsegs;
+extern thread_local drawseg_t *drawsegs;
+extern thread_local unsigned int maxdrawsegs;
 
-extern drawseg_t *ds_p;
+extern thread_local drawseg_t *ds_p;
 
 // SoM: mark a range of the screen as being solid (closed).
 // these marks are then added to the solidsegs list by R_AddLine after all segments
@@ -0,0 +1,240 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Render contexts. The view can be split into vertical screen slices
+//      which are each rendered by their own thread, using thread_local
+//      copies of all the renderer's working state.
+//
+//      Each context clips its BSP walk to its own slice of columns, so the
+//      clip segs, drawsegs, visplanes, portal windows, vissprites and
+//      column/span drawer state it builds never leave its thread. Level data
+//      is only read while contexts run; the few per-frame marks the renderer
+//      used to keep in the level structures now live in each context. Heap
+//      allocation and lazily-built caches are serialized by the zone lock.
+//
+//-----------------------------------------------------------------------------
+
+#include "z_zone.h"
+#include "c_io.h"
+#include "c_runcmd.h"
+#include "m_threadpool.h"
+#include "r_context.h"
+#include "r_defs.h"
+#include "r_main.h"
+#include "r_plane.h"
+#include "r_portal.h"
+#include "r_state.h"
+#include "r_draw.h"
+#include "v_alloc.h"
+
+// Number of render contexts wanted by the user; 1 renders on the main thread
+int r_numcontexts = 1;
+
+static rendercontext_t contexts[R_MAXCONTEXTS];
+static int             numactivecontexts = 1;
+static int             levelgeneration = 1;
+
+static ThreadPool     *contextpool;
+static void          (*contextrender)();
+
+// Each thread's own context. Worker threads are pointed at theirs when they
+// start a job; the main thread always uses context 0.
+thread_local rendercontext_t *r_context = &contexts[0];
+
+//
+// R_NumContexts
+//
+// Returns the number of contexts rendering the current frame.
+//
+int R_NumContexts()
+{
+   return numactivecontexts;
+}
+
+//
+// R_ContextsNewLevel
+//
+// Called when a new level is set up. Level data belonging to every context
+// is rebuilt the next time that context renders.
+//
+void R_ContextsNewLevel()
+{
+   ++levelgeneration;
+}
+
+//
+// R_ResetContextStamps
+//
+// Clears the current context's frameid marks, after the frameid wraps.
+//
+void R_ResetContextStamps()
+{
+   rcsectorstamp_t *stamps = r_context->sectorstamps;
+
+   if(!stamps)
+      return;
+
+   for(int i = 0; i < numsectors; i++)
+      stamps[i].fframeid = stamps[i].cframeid = 0;
+}
+
+//
+// R_prepareContext
+//
+// Makes sure the current thread's context has buffers for the current video
+// mode and level data for the current level. Level data must be rebuilt
+// first, since the per-context VALLOCATIONs walk the portal window lists.
+//
+static void R_prepareContext(rendercontext_t *ctx)
+{
+   if(ctx->levelgeneration != levelgeneration)
+   {
+      ctx->sectorstamps =
+         estructalloctag(rcsectorstamp_t, numsectors > 0 ? numsectors : 1, PU_LEVEL);
+      ctx->validcount = 1;
+
+      // worker threads keep their own portal window and overlay set lists
+      if(ctx->index)
+      {
+         R_InitPortalWindows();
+         R_MapInitOverlaySets();
+      }
+
+      ctx->levelgeneration = levelgeneration;
+   }
+
+   if(ctx->vallocgeneration != VAllocItem::GetGeneration())
+   {
+      // the main thread's buffers are remade by VAllocItem::SetNewMode
+      if(ctx->index)
+         VAllocItem::SetNewContextMode();
+      ctx->vallocgeneration = VAllocItem::GetGeneration();
+   }
+}
+
+//
+// R_SetupContexts
+//
+// Called on the main thread at the start of each frame. Sizes the worker pool
+// and divides the view into one slice per context. Slice edges are kept on
+// multiples of four columns so the quad column drawer never shares a block of
+// columns between two threads.
+//
+void R_SetupContexts()
+{
+   int width = viewwindow.width;
+   int count = r_numcontexts;
+
+   // keep slices at least 16 columns wide
+   if(count > width / 16)
+      count = width / 16;
+   if(count < 1)
+      count = 1;
+   if(count > R_MAXCONTEXTS)
+      count = R_MAXCONTEXTS;
+
+   if(count > 1)
+   {
+      if(!contextpool)
+         contextpool = new ThreadPool();
+      if(contextpool->getNumThreads() < count)
+         contextpool->resize(count);
+   }
+
+   for(int i = 0; i < count; i++)
+   {
+      rendercontext_t &ctx = contexts[i];
+
+      ctx.index       = i;
+      ctx.startcolumn = i ? ((width * i / count) & ~3) : 0;
+      ctx.endcolumn   = (i == count - 1) ? width - 1 :
+                        ((width * (i + 1) / count) & ~3) - 1;
+   }
+
+   numactivecontexts = count;
+}
+
+//
+// R_contextJob
+//
+// Thread pool job; renders one slice on whichever thread runs it.
+//
+static void R_contextJob(int threadnum, void *)
+{
+   if(threadnum >= numactivecontexts)
+      return;
+
+   rendercontext_t *ctx = &contexts[threadnum];
+
+   r_context = ctx;
+   R_prepareContext(ctx);
+
+   contextrender();
+}
+
+//
+// R_RunContexts
+//
+// Calls the render function once for each active context, on that context's
+// thread, and waits for all of them to finish. With a single context this
+// just renders the whole view on the calling thread.
+//
+void R_RunContexts(void (*render)())
+{
+   if(numactivecontexts <= 1)
+   {
+      R_prepareContext(r_context);
+      render();
+      return;
+   }
+
+   contextrender = render;
+
+   Z_SetLocking(true);
+   contextpool->run(R_contextJob, nullptr);
+   Z_SetLocking(false);
+}
+
+//=============================================================================
+//
+// Console Commands
+//
+
+VARIABLE_INT(r_numcontexts, NULL, 1, R_MAXCONTEXTS, NULL);
+CONSOLE_VARIABLE(r_numcontexts, r_numcontexts, 0) {}
+
+CONSOLE_COMMAND(r_contextinfo, 0)
+{
+   C_Printf("%d of %d render contexts active, %d hardware threads\n",
+            numactivecontexts, r_numcontexts, ThreadPool::HardwareThreads());
+
+   for(int i = 0; i < numactivecontexts; i++)
+   {
+      C_Printf("%2d: columns %d to %d\n", i, contexts[i].startcolumn,
+               contexts[i].endcolumn);
+   }
+}
+
+// EOF
+
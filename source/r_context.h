@@ -0,0 +1,70 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Render contexts. The view can be split into vertical screen slices
+//      which are each rendered by their own thread, using thread_local
+//      copies of all the renderer's working state.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef R_CONTEXT_H__
+#define R_CONTEXT_H__
+
+// Maximum number of render contexts (and therefore threads) in use at once
+#define R_MAXCONTEXTS 16
+
+// Per-sector marks which used to live in the shared level data
+struct rcsectorstamp_t
+{
+   int      validcount; // sprite list already added this pass
+   unsigned fframeid;   // floor portal window barrier updated this frame
+   unsigned cframeid;   // ceiling portal window barrier updated this frame
+};
+
+struct rendercontext_t
+{
+   int index;        // 0 is always the main thread
+   int startcolumn;  // first screen column of this context's slice
+   int endcolumn;    // last screen column of this context's slice
+
+   int validcount;                 // replaces global validcount in renderer
+   rcsectorstamp_t *sectorstamps;  // numsectors entries, PU_LEVEL
+
+   int vallocgeneration; // mode generation of this context's VALLOCATIONs
+   int levelgeneration;  // level generation of this context's level data
+};
+
+extern thread_local rendercontext_t *r_context;
+extern int r_numcontexts;
+
+int  R_NumContexts();
+void R_SetupContexts();
+void R_RunContexts(void (*render)());
+void R_ContextsNewLevel();
+void R_ResetContextStamps();
+
+#endif
+
+// EOF
+
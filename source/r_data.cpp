@@ -33,6 +33,7 @@
 #include "d_main.h"
 #include "doomstat.h"
 #include "e_hash.h"
+#include "m_collection.h"
 #include "m_compare.h"
 #include "m_swap.h"
 #include "p_info.h"   // haleyjd
@@ -610,12 +611,30 @@ void R_PrecacheLevel(void)
       ++sky;
    }
 
+   // Inflate the lumps of textures still to be built all at once, in case
+   // they are in a zip
+   PODCollection<int> lumps;
+   for(i = texturecount; --i >= 0; )
+   {
+      const texture_t *tex = textures[i];
+
+      if(!hitlist[i] || tex->bufferalloc)
+         continue;
+      for(int j = 0; j < tex->ccount; j++)
+         lumps.add(tex->components[j].lump);
+   }
+   if(!lumps.isEmpty())
+      wGlobalDir.prefetchLumps(&lumps[0], lumps.getLength());
+
    // Precache textures.
+   PODCollection<int> nums;
    for(i = texturecount; --i >= 0; )
    {
       if(hitlist[i])
-         R_CacheTexture(i);
+         nums.add(i);
    }
+   if(!nums.isEmpty())
+      R_CacheTextures(&nums[0], static_cast<int>(nums.getLength()));
 
 
    // Precache sprites.
@@ -631,6 +650,21 @@ void R_PrecacheLevel(void)
       }
    }
 
+   lumps.makeEmpty();
+   for(i = numsprites; --i >= 0; )
+   {
+      if(hitlist[i])
+      {
+         for(int j = 0; j < sprites[i].numframes; j++)
+         {
+            for(int16_t sflump : sprites[i].spriteframes[j].lump)
+               lumps.add(firstspritelump + sflump);
+         }
+      }
+   }
+   if(!lumps.isEmpty())
+      wGlobalDir.prefetchLumps(&lumps[0], lumps.getLength());
+
    for(i = numsprites; --i >= 0; )
    {
       if (hitlist[i])
@@ -658,6 +692,9 @@ void R_PrecacheLevel(void)
 //
 void R_FreeData(void)
 {
+   // texture buffers aren't PU_RENDERER, but are held by the textures
+   R_FlushTextureCache();
+
    // haleyjd: let's harness the power of the zone heap and make this simple.
    Z_FreeTags(PU_RENDERER, PU_RENDERER);
 }
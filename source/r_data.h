@@ -27,6 +27,8 @@
 #ifndef R_DATA_H__
 #define R_DATA_H__
 
+#include <atomic>
+
 // Required for: DLListItem
 #include "m_dllist.h"
 
@@ -113,6 +115,10 @@ struct texture_t
    texcol_t   **columns;     // SoM: width length list of columns
    byte       *bufferalloc;   // ioanch: allocate this one with a leading padding for safety
    byte       *bufferdata;    // SoM: Linear buffer the texture occupies (ioanch: points to real data)
+   size_t     cachesize;     // bytes of buffer held in the texture cache
+   // View it was last drawn in. Render threads stamp it as they draw, so it's
+   // atomic; relaxed ordering is enough, as it's only read between views.
+   std::atomic<uint32_t> cachestamp;
    
    // New texture system can put either textures or flats (or anything, really)
    // into a texture, so the old patches idea has been scrapped for 'graphics'
@@ -136,6 +142,11 @@ byte *R_GetLinearBuffer(int tex);
 // Cache a given texture
 // Returns the texture for chaining.
 texture_t *R_CacheTexture(int num);
+void       R_CacheTextures(const int *nums, int count);
+void       R_UpdateTextureCache();
+void       R_FlushTextureCache();
+
+extern int r_texcachesize; // megabytes of texture buffers to keep
 
 // SoM: all textures/flats are now stored in a single array (textures)
 // Walls start from wallstart to (wallstop - 1) and flats go from flatstart 
@@ -184,7 +195,8 @@ int  R_ColormapNumForName(const char *name);      // killough 4/4/98
 // haleyjd: new global colormap method
 void R_SetGlobalLevelColormap(void);
 
-extern byte *main_tranmap, *main_submap, *tranmap;
+extern byte *main_tranmap, *main_submap;
+extern thread_local byte *tranmap;
 
 extern int r_precache;
 
@@ -50,27 +50,27 @@ typedef enum
    COL_FLEXADD
 } columntype_e;
 
-static int    temp_x = 0;
-static int    tempyl[4], tempyh[4];
-static int    startx = 0;
-static int    temptype = COL_NONE;
-static int    commontop, commonbot;
-static const byte *temptranmap = NULL;
-static fixed_t temptranslevel;
+static thread_local int    temp_x = 0;
+static thread_local int    tempyl[4], tempyh[4];
+static thread_local int    startx = 0;
+static thread_local int    temptype = COL_NONE;
+static thread_local int    commontop, commonbot;
+static thread_local const byte *temptranmap = NULL;
+static thread_local fixed_t temptranslevel;
 // haleyjd 09/12/04: optimization -- precalculate flex tran lookups
-static const unsigned int *temp_fg2rgb;
-static const unsigned int *temp_bg2rgb;
+static thread_local const unsigned int *temp_fg2rgb;
+static thread_local const unsigned int *temp_bg2rgb;
 // SoM 7-28-04: Fix the fuzz problem.
-static const byte *tempfuzzmap;
-static byte   *tempbuf;
-static byte   *newskymask;
+static thread_local const byte *tempfuzzmap;
+static thread_local byte   *tempbuf;
+static thread_local byte   *newskymask;
 
-VALLOCATION(tempbuf)
+VCTXALLOCATION(tempbuf)
 {
    tempbuf = ecalloctag(byte *, h*4, sizeof(byte), PU_VALLOC, NULL);
 }
 
-VALLOCATION(newskymask)
+VCTXALLOCATION(newskymask)
 {
    newskymask = ecalloctag(byte *, h*4, sizeof(byte), PU_VALLOC, nullptr);
 }
@@ -609,8 +609,8 @@ static void R_FlushHTFlexAdd()
    }
 }
 
-static void (*R_FlushWholeColumns)() = R_FlushWholeNil;
-static void (*R_FlushHTColumns)()    = R_FlushHTNil;
+static thread_local void (*R_FlushWholeColumns)() = R_FlushWholeNil;
+static thread_local void (*R_FlushHTColumns)()    = R_FlushHTNil;
 
 // Begin: Quad column flushing functions.
 static void R_FlushQuadOpaque()
@@ -800,7 +800,7 @@ static void R_FlushQuadFlexAdd()
    }
 }
 
-static void (*R_FlushQuadColumn)(void) = R_QuadFlushNil;
+static thread_local void (*R_FlushQuadColumn)(void) = R_QuadFlushNil;
 
 static void R_FlushColumns(void)
 {
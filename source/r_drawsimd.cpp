@@ -0,0 +1,643 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Vectorized column and span drawers.
+//
+//      Pixels are drawn in batches of eight. The texture coordinates of a
+//      whole batch are stepped at once, and for the flex and additive
+//      translucency styles the RGB blending is done across the batch as
+//      well; AVX2 also gathers the Col2RGB8 lookups. Texel and colormap
+//      lookups remain one byte at a time, as there is no way to gather
+//      bytes. Spans are stored a batch at a time; columns still have to be
+//      stored one pixel per row.
+//
+//      Which instruction set is used is decided once at startup, from what
+//      the CPU supports. Non-x86 builds get the same drawers built on plain
+//      C++ kernels.
+//
+//-----------------------------------------------------------------------------
+
+#include "z_zone.h"
+#include "i_system.h"
+
+#include "doomstat.h"
+#include "r_draw.h"
+#include "r_drawsimd.h"
+#include "r_main.h"
+#include "r_plane.h"
+#include "v_misc.h"
+#include "v_video.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define R_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only allow AVX2 intrinsics in functions built for AVX2
+#if defined(R_SIMD_X86) && defined(__GNUC__)
+#define R_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define R_TARGET_AVX2
+#endif
+
+// Pixels per batch
+#define SIMD_BATCH 8
+
+//=============================================================================
+//
+// Kernels
+//
+// Each kernel set provides the same four operations on a batch of pixels:
+//
+// ColumnIndices: texel offsets down a power-of-two tall column
+// SpanIndices:   texel offsets along a span
+// BlendFlex:     zdoom-style translucency of fg over bg, through RGB32k
+// BlendAdd:      additive translucency of fg onto bg, through RGB32k
+//
+// out may be the same buffer as bg.
+//
+
+//
+// R_blendFlexPixel
+//
+inline static byte R_blendFlexPixel(unsigned int fg, unsigned int bg)
+{
+   unsigned int t = (fg + bg) | 0x01f07c1f;
+   return RGB32k[0][0][t & (t >> 15)];
+}
+
+//
+// R_blendAddPixel
+//
+inline static byte R_blendAddPixel(unsigned int fg, unsigned int bg)
+{
+   unsigned int a = fg + bg;
+   unsigned int b = a;
+
+   // mask out LSBs in green and red to allow overflow
+   a |= 0x01f07c1f;
+   b &= 0x40100400;
+   a &= 0x3fffffff;
+   b  = b - (b >> 5);
+   a |= b;
+
+   return RGB32k[0][0][a & (a >> 15)];
+}
+
+//
+// Plain C++ kernels, for CPUs without SSE2
+//
+struct simdscalar_t
+{
+   static void ColumnIndices(fixed_t frac, fixed_t step, int heightmask, int *idx)
+   {
+      unsigned int f = frac;
+
+      for(int i = 0; i < SIMD_BATCH; i++, f += step)
+         idx[i] = (int(f) >> FRACBITS) & heightmask;
+   }
+
+   static void SpanIndices(unsigned int xf, unsigned int yf,
+                           unsigned int xs, unsigned int ys,
+                           unsigned int xshift, unsigned int xmask,
+                           unsigned int yshift, int *idx)
+   {
+      for(int i = 0; i < SIMD_BATCH; i++, xf += xs, yf += ys)
+         idx[i] = ((xf >> xshift) & xmask) | (yf >> yshift);
+   }
+
+   static void BlendFlex(const byte *fg, const byte *bg,
+                         const unsigned int *fg2rgb, const unsigned int *bg2rgb,
+                         byte *out)
+   {
+      for(int i = 0; i < SIMD_BATCH; i++)
+         out[i] = R_blendFlexPixel(fg2rgb[fg[i]], bg2rgb[bg[i]]);
+   }
+
+   static void BlendAdd(const byte *fg, const byte *bg,
+                        const unsigned int *fg2rgb, const unsigned int *bg2rgb,
+                        byte *out)
+   {
+      for(int i = 0; i < SIMD_BATCH; i++)
+         out[i] = R_blendAddPixel(fg2rgb[fg[i]], bg2rgb[bg[i]]);
+   }
+};
+
+#ifdef R_SIMD_X86
+
+//
+// SSE2 kernels. Each batch is handled as two vectors of four.
+//
+struct simdsse2_t
+{
+   static void ColumnIndices(fixed_t frac, fixed_t step, int heightmask, int *idx)
+   {
+      const unsigned int f = frac, s = step;
+      const __m128i mask = _mm_set1_epi32(heightmask);
+      const __m128i f0   = _mm_setr_epi32(int(f), int(f + s), int(f + 2*s),
+                                          int(f + 3*s));
+      const __m128i f1   = _mm_add_epi32(f0, _mm_set1_epi32(int(4*s)));
+
+      _mm_storeu_si128((__m128i *)idx,
+                       _mm_and_si128(_mm_srai_epi32(f0, FRACBITS), mask));
+      _mm_storeu_si128((__m128i *)(idx + 4),
+                       _mm_and_si128(_mm_srai_epi32(f1, FRACBITS), mask));
+   }
+
+   static void SpanIndices(unsigned int xf, unsigned int yf,
+                           unsigned int xs, unsigned int ys,
+                           unsigned int xshift, unsigned int xmask,
+                           unsigned int yshift, int *idx)
+   {
+      const __m128i xsh  = _mm_cvtsi32_si128(int(xshift));
+      const __m128i ysh  = _mm_cvtsi32_si128(int(yshift));
+      const __m128i mask = _mm_set1_epi32(int(xmask));
+      const __m128i xs4  = _mm_set1_epi32(int(4*xs));
+      const __m128i ys4  = _mm_set1_epi32(int(4*ys));
+
+      __m128i x = _mm_setr_epi32(int(xf), int(xf + xs), int(xf + 2*xs),
+                                 int(xf + 3*xs));
+      __m128i y = _mm_setr_epi32(int(yf), int(yf + ys), int(yf + 2*ys),
+                                 int(yf + 3*ys));
+
+      for(int i = 0; i < SIMD_BATCH; i += 4)
+      {
+         __m128i v = _mm_or_si128(_mm_and_si128(_mm_srl_epi32(x, xsh), mask),
+                                  _mm_srl_epi32(y, ysh));
+         _mm_storeu_si128((__m128i *)(idx + i), v);
+         x = _mm_add_epi32(x, xs4);
+         y = _mm_add_epi32(y, ys4);
+      }
+   }
+
+   //
+   // Without a gather instruction the RGB values have to be looked up one at
+   // a time; the blend itself is done four at a time.
+   //
+   static void BlendFlex(const byte *fg, const byte *bg,
+                         const unsigned int *fg2rgb, const unsigned int *bg2rgb,
+                         byte *out)
+   {
+      unsigned int fgc[SIMD_BATCH], bgc[SIMD_BATCH], t[SIMD_BATCH];
+      const __m128i bits = _mm_set1_epi32(0x01f07c1f);
+
+      for(int i = 0; i < SIMD_BATCH; i++)
+      {
+         fgc[i] = fg2rgb[fg[i]];
+         bgc[i] = bg2rgb[bg[i]];
+      }
+
+      for(int i = 0; i < SIMD_BATCH; i += 4)
+      {
+         __m128i v = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(fgc + i)),
+                                   _mm_loadu_si128((const __m128i *)(bgc + i)));
+         v = _mm_or_si128(v, bits);
+         v = _mm_and_si128(v, _mm_srli_epi32(v, 15));
+         _mm_storeu_si128((__m128i *)(t + i), v);
+      }
+
+      for(int i = 0; i < SIMD_BATCH; i++)
+         out[i] = RGB32k[0][0][t[i]];
+   }
+
+   static void BlendAdd(const byte *fg, const byte *bg,
+                        const unsigned int *fg2rgb, const unsigned int *bg2rgb,
+                        byte *out)
+   {
+      unsigned int fgc[SIMD_BATCH], bgc[SIMD_BATCH], t[SIMD_BATCH];
+      const __m128i bits  = _mm_set1_epi32(0x01f07c1f);
+      const __m128i carry = _mm_set1_epi32(0x40100400);
+      const __m128i clamp = _mm_set1_epi32(0x3fffffff);
+
+      for(int i = 0; i < SIMD_BATCH; i++)
+      {
+         fgc[i] = fg2rgb[fg[i]];
+         bgc[i] = bg2rgb[bg[i]];
+      }
+
+      for(int i = 0; i < SIMD_BATCH; i += 4)
+      {
+         __m128i a = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(fgc + i)),
+                                   _mm_loadu_si128((const __m128i *)(bgc + i)));
+         __m128i b = _mm_and_si128(a, carry);
+         a = _mm_and_si128(_mm_or_si128(a, bits), clamp);
+         b = _mm_sub_epi32(b, _mm_srli_epi32(b, 5));
+         a = _mm_or_si128(a, b);
+         a = _mm_and_si128(a, _mm_srli_epi32(a, 15));
+         _mm_storeu_si128((__m128i *)(t + i), a);
+      }
+
+      for(int i = 0; i < SIMD_BATCH; i++)
+         out[i] = RGB32k[0][0][t[i]];
+   }
+};
+
+//
+// AVX2 kernels. A batch is one vector, and the Col2RGB8 tables are read with
+// gathers. These are only called once R_InitSIMDDrawers has made sure the CPU
+// supports AVX2.
+//
+struct simdavx2_t
+{
+   R_TARGET_AVX2
+   static void ColumnIndices(fixed_t frac, fixed_t step, int heightmask, int *idx)
+   {
+      const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+      __m256i f = _mm256_add_epi32(_mm256_set1_epi32(frac),
+                                   _mm256_mullo_epi32(lane, _mm256_set1_epi32(step)));
+
+      f = _mm256_and_si256(_mm256_srai_epi32(f, FRACBITS),
+                           _mm256_set1_epi32(heightmask));
+      _mm256_storeu_si256((__m256i *)idx, f);
+   }
+
+   R_TARGET_AVX2
+   static void SpanIndices(unsigned int xf, unsigned int yf,
+                           unsigned int xs, unsigned int ys,
+                           unsigned int xshift, unsigned int xmask,
+                           unsigned int yshift, int *idx)
+   {
+      const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+      __m256i x = _mm256_add_epi32(_mm256_set1_epi32(int(xf)),
+                                   _mm256_mullo_epi32(lane, _mm256_set1_epi32(int(xs))));
+      __m256i y = _mm256_add_epi32(_mm256_set1_epi32(int(yf)),
+                                   _mm256_mullo_epi32(lane, _mm256_set1_epi32(int(ys))));
+
+      x = _mm256_and_si256(_mm256_srl_epi32(x, _mm_cvtsi32_si128(int(xshift))),
+                           _mm256_set1_epi32(int(xmask)));
+      y = _mm256_srl_epi32(y, _mm_cvtsi32_si128(int(yshift)));
+      _mm256_storeu_si256((__m256i *)idx, _mm256_or_si256(x, y));
+   }
+
+   R_TARGET_AVX2
+   static __m256i Gather(const byte *index, const unsigned int *table)
+   {
+      __m256i i = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)index));
+      return _mm256_i32gather_epi32((const int *)table, i, 4);
+   }
+
+   R_TARGET_AVX2
+   static void BlendFlex(const byte *fg, const byte *bg,
+                         const unsigned int *fg2rgb, const unsigned int *bg2rgb,
+                         byte *out)
+   {
+      alignas(32) unsigned int t[SIMD_BATCH];
+
+      __m256i v = _mm256_add_epi32(Gather(fg, fg2rgb), Gather(bg, bg2rgb));
+      v = _mm256_or_si256(v, _mm256_set1_epi32(0x01f07c1f));
+      v = _mm256_and_si256(v, _mm256_srli_epi32(v, 15));
+      _mm256_store_si256((__m256i *)t, v);
+
+      for(int i = 0; i < SIMD_BATCH; i++)
+         out[i] = RGB32k[0][0][t[i]];
+   }
+
+   R_TARGET_AVX2
+   static void BlendAdd(const byte *fg, const byte *bg,
+                        const unsigned int *fg2rgb, const unsigned int *bg2rgb,
+                        byte *out)
+   {
+      alignas(32) unsigned int t[SIMD_BATCH];
+
+      __m256i a = _mm256_add_epi32(Gather(fg, fg2rgb), Gather(bg, bg2rgb));
+      __m256i b = _mm256_and_si256(a, _mm256_set1_epi32(0x40100400));
+      a = _mm256_or_si256(a, _mm256_set1_epi32(0x01f07c1f));
+      a = _mm256_and_si256(a, _mm256_set1_epi32(0x3fffffff));
+      b = _mm256_sub_epi32(b, _mm256_srli_epi32(b, 5));
+      a = _mm256_or_si256(a, b);
+      a = _mm256_and_si256(a, _mm256_srli_epi32(a, 15));
+      _mm256_store_si256((__m256i *)t, a);
+
+      for(int i = 0; i < SIMD_BATCH; i++)
+         out[i] = RGB32k[0][0][t[i]];
+   }
+};
+
+#endif // R_SIMD_X86
+
+//=============================================================================
+//
+// Column Drawers
+//
+
+enum
+{
+   SIMD_OPAQUE,  // plain colormapped
+   SIMD_TRANMAP, // BOOM tranmap translucency
+   SIMD_FLEX,    // zdoom-style translucency
+   SIMD_ADD,     // additive translucency
+};
+
+//
+// R_drawColumnSIMD
+//
+// One template covers every column style; the style and translation tests
+// are resolved at compile time.
+//
+template<typename K, int style, bool translated>
+static void R_drawColumnSIMD()
+{
+   int count = column.y2 - column.y1 + 1;
+   if(count <= 0)
+      return;
+
+#ifdef RANGECHECK
+   if(column.x  < 0 || column.x  >= video.width ||
+      column.y1 < 0 || column.y2 >= video.height)
+      I_Error("R_drawColumnSIMD: %i to %i at %i\n", column.y1, column.y2, column.x);
+#endif
+
+   byte   *dest     = R_ADDRESS(column.x, column.y1);
+   fixed_t fracstep = column.step;
+   fixed_t frac     = column.texmid + (int)((column.y1 - view.ycenter + 1) * fracstep);
+
+   const byte         *source      = static_cast<const byte *>(column.source);
+   const lighttable_t *colormap    = column.colormap;
+   const byte         *translation = column.translation;
+   const unsigned int *fg2rgb      = nullptr;
+   const unsigned int *bg2rgb      = nullptr;
+
+   int  heightmask = column.texheight - 1;
+   bool pow2       = !(column.texheight & heightmask);
+
+   if(style == SIMD_FLEX)
+   {
+      unsigned int fglevel = column.translevel & ~0x3ff;
+      unsigned int bglevel = FRACUNIT - fglevel;
+      fg2rgb = Col2RGB8[fglevel >> 10];
+      bg2rgb = Col2RGB8[bglevel >> 10];
+   }
+   else if(style == SIMD_ADD)
+   {
+      unsigned int fglevel = column.translevel & ~0x3ff;
+      fg2rgb = Col2RGB8_LessPrecision[fglevel >> 10];
+      bg2rgb = Col2RGB8_LessPrecision[FRACUNIT >> 10];
+   }
+
+   if(!pow2)
+   {
+      heightmask++;
+      heightmask <<= FRACBITS;
+
+      if(frac < 0)
+         while((frac += heightmask) <  0);
+      else
+         while(frac >= heightmask)
+            frac -= heightmask;
+   }
+
+   int  idx[SIMD_BATCH];
+   byte fg[SIMD_BATCH] = { 0 }, bg[SIMD_BATCH] = { 0 }, out[SIMD_BATCH];
+
+   while(count > 0)
+   {
+      const int n = count < SIMD_BATCH ? count : SIMD_BATCH;
+
+      if(pow2)
+      {
+         K::ColumnIndices(frac, fracstep, heightmask, idx);
+         frac = fixed_t(unsigned(frac) + unsigned(fracstep) * SIMD_BATCH);
+      }
+      else
+      {
+         // killough's Tutti-Frutti fix has to be applied per pixel
+         for(int i = 0; i < n; i++)
+         {
+            idx[i] = frac >> FRACBITS;
+            if((frac += fracstep) >= heightmask)
+               frac -= heightmask;
+         }
+      }
+
+      for(int i = 0; i < n; i++)
+      {
+         byte texel = source[idx[i]];
+         fg[i] = colormap[translated ? translation[texel] : texel];
+      }
+
+      if(style == SIMD_OPAQUE)
+      {
+         for(int i = 0; i < n; i++, dest += linesize)
+            *dest = fg[i];
+      }
+      else if(style == SIMD_TRANMAP)
+      {
+         for(int i = 0; i < n; i++, dest += linesize)
+            *dest = tranmap[(*dest << 8) + fg[i]];
+      }
+      else
+      {
+         byte *src = dest;
+         for(int i = 0; i < n; i++, src += linesize)
+            bg[i] = *src;
+
+         if(style == SIMD_FLEX)
+            K::BlendFlex(fg, bg, fg2rgb, bg2rgb, out);
+         else
+            K::BlendAdd(fg, bg, fg2rgb, bg2rgb, out);
+
+         for(int i = 0; i < n; i++, dest += linesize)
+            *dest = out[i];
+      }
+
+      count -= n;
+   }
+}
+
+//=============================================================================
+//
+// Span Drawers
+//
+// Only orthogonal spans are vectorized. Every flat size uses the generalized
+// shifts and masks set up by R_DrawPlane, which are the same values the
+// fixed-size scalar drawers have built in.
+//
+
+//
+// R_drawSpanSIMD
+//
+template<typename K, int style>
+static void R_drawSpanSIMD()
+{
+   unsigned int xf = span.xfrac, xs = span.xstep;
+   unsigned int yf = span.yfrac, ys = span.ystep;
+   const lighttable_t *colormap = span.colormap;
+   int count = span.x2 - span.x1 + 1;
+
+   const byte *source = static_cast<const byte *>(span.source);
+   byte       *dest   = R_ADDRESS(span.x1, span.y);
+
+   const unsigned int xshift = span.xshift;
+   const unsigned int xmask  = span.xmask;
+   const unsigned int yshift = span.yshift;
+
+   int  idx[SIMD_BATCH];
+   byte fg[SIMD_BATCH];
+
+   while(count >= SIMD_BATCH)
+   {
+      K::SpanIndices(xf, yf, xs, ys, xshift, xmask, yshift, idx);
+
+      for(int i = 0; i < SIMD_BATCH; i++)
+         fg[i] = colormap[source[idx[i]]];
+
+      if(style == SIMD_OPAQUE)
+         memcpy(dest, fg, SIMD_BATCH);
+      else if(style == SIMD_FLEX)
+         K::BlendFlex(fg, dest, span.fg2rgb, span.bg2rgb, dest);
+      else
+         K::BlendAdd(fg, dest, span.fg2rgb, span.bg2rgb, dest);
+
+      xf    += xs * SIMD_BATCH;
+      yf    += ys * SIMD_BATCH;
+      dest  += SIMD_BATCH;
+      count -= SIMD_BATCH;
+   }
+
+   // finish off the remainder a pixel at a time
+   while(count-- > 0)
+   {
+      byte c = colormap[source[((xf >> xshift) & xmask) | (yf >> yshift)]];
+
+      if(style == SIMD_OPAQUE)
+         *dest = c;
+      else if(style == SIMD_FLEX)
+         *dest = R_blendFlexPixel(span.fg2rgb[c], span.bg2rgb[*dest]);
+      else
+         *dest = R_blendAddPixel(span.fg2rgb[c], span.bg2rgb[*dest]);
+
+      ++dest;
+      xf += xs;
+      yf += ys;
+   }
+}
+
+//=============================================================================
+//
+// Engine Objects
+//
+// Filled in by R_InitSIMDDrawers. Drawers which don't benefit from batching
+// (fuzz, the masked sky, masked and sloped spans) are shared with the normal
+// engines.
+//
+
+columndrawer_t r_simd_drawer;
+spandrawer_t   r_simdspandrawer;
+
+//
+// R_setupSIMDDrawers
+//
+template<typename K>
+static void R_setupSIMDDrawers()
+{
+   columndrawer_t &c = r_simd_drawer;
+
+   c = r_normal_drawer;
+
+   c.DrawColumn       = R_drawColumnSIMD<K, SIMD_OPAQUE,  false>;
+   c.DrawTLColumn     = R_drawColumnSIMD<K, SIMD_TRANMAP, false>;
+   c.DrawTRColumn     = R_drawColumnSIMD<K, SIMD_OPAQUE,  true >;
+   c.DrawTLTRColumn   = R_drawColumnSIMD<K, SIMD_TRANMAP, true >;
+   c.DrawFlexColumn   = R_drawColumnSIMD<K, SIMD_FLEX,    false>;
+   c.DrawFlexTRColumn = R_drawColumnSIMD<K, SIMD_FLEX,    true >;
+   c.DrawAddColumn    = R_drawColumnSIMD<K, SIMD_ADD,     false>;
+   c.DrawAddTRColumn  = R_drawColumnSIMD<K, SIMD_ADD,     true >;
+   c.ResetBuffer      = NULL;
+
+   c.ByVisSpriteStyle[VS_DRAWSTYLE_NORMAL ][0] = c.DrawColumn;
+   c.ByVisSpriteStyle[VS_DRAWSTYLE_NORMAL ][1] = c.DrawTRColumn;
+   c.ByVisSpriteStyle[VS_DRAWSTYLE_ALPHA  ][0] = c.DrawFlexColumn;
+   c.ByVisSpriteStyle[VS_DRAWSTYLE_ALPHA  ][1] = c.DrawFlexTRColumn;
+   c.ByVisSpriteStyle[VS_DRAWSTYLE_ADD    ][0] = c.DrawAddColumn;
+   c.ByVisSpriteStyle[VS_DRAWSTYLE_ADD    ][1] = c.DrawAddTRColumn;
+   c.ByVisSpriteStyle[VS_DRAWSTYLE_SUB    ][0] = c.DrawTLColumn;
+   c.ByVisSpriteStyle[VS_DRAWSTYLE_SUB    ][1] = c.DrawTLTRColumn;
+   c.ByVisSpriteStyle[VS_DRAWSTYLE_TRANMAP][0] = c.DrawTLColumn;
+   c.ByVisSpriteStyle[VS_DRAWSTYLE_TRANMAP][1] = c.DrawTLTRColumn;
+
+   spandrawer_t &s = r_simdspandrawer;
+
+   s = r_spandrawer;
+
+   for(int i = 0; i < FLAT_NUMSIZES; i++)
+   {
+      s.DrawSpan[SPAN_STYLE_NORMAL][i] = R_drawSpanSIMD<K, SIMD_OPAQUE>;
+      s.DrawSpan[SPAN_STYLE_TL    ][i] = R_drawSpanSIMD<K, SIMD_FLEX>;
+      s.DrawSpan[SPAN_STYLE_ADD   ][i] = R_drawSpanSIMD<K, SIMD_ADD>;
+   }
+}
+
+//
+// R_cpuHasAVX2
+//
+static bool R_cpuHasAVX2()
+{
+#if defined(R_SIMD_X86) && defined(_MSC_VER)
+   int info[4];
+
+   __cpuid(info, 0);
+   if(info[0] < 7)
+      return false;
+
+   // AVX, and the OS saves the YMM registers
+   __cpuid(info, 1);
+   if(!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)))
+      return false;
+   if((_xgetbv(0) & 6) != 6)
+      return false;
+
+   __cpuidex(info, 7, 0);
+   return !!(info[1] & (1 << 5));
+#elif defined(R_SIMD_X86) && defined(__GNUC__)
+   __builtin_cpu_init();
+   return !!__builtin_cpu_supports("avx2");
+#else
+   return false;
+#endif
+}
+
+//
+// R_InitSIMDDrawers
+//
+// Picks the best kernels for this CPU and builds the SIMD column and span
+// engines from them. Must be called before either engine is selected.
+//
+void R_InitSIMDDrawers()
+{
+#ifdef R_SIMD_X86
+   if(R_cpuHasAVX2())
+      R_setupSIMDDrawers<simdavx2_t>();
+   else
+      R_setupSIMDDrawers<simdsse2_t>();
+#else
+   R_setupSIMDDrawers<simdscalar_t>();
+#endif
+}
+
+// EOF
+
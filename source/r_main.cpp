@@ -29,6 +29,7 @@
 
 #include "c_io.h"
 #include "c_runcmd.h"
+#include "d_bench.h"
 #include "d_deh.h"
 #include "d_dehtbl.h"
 #include "d_gi.h"
@@ -49,8 +50,10 @@
 #include "p_scroll.h"
 #include "p_xenemy.h"
 #include "r_bsp.h"
+#include "r_context.h"
 #include "r_draw.h"
 #include "r_drawq.h"
+#include "r_drawsimd.h"
 #include "r_dynseg.h"
 #include "r_interpolate.h"
 #include "r_main.h"
@@ -70,7 +73,7 @@
 
 // SoM: Cardboard
 const float PI = 3.14159265f;
-cb_view_t view;
+thread_local cb_view_t view;
 
 // haleyjd 04/03/05: focal lengths made global, y len added
 fixed_t focallen_x;
@@ -83,15 +86,15 @@ fixed_t focallen_y;
 int viewdir;    // 0 = forward, 1 = left, 2 = right
 int viewangleoffset;
 int validcount = 1;         // increment every time a check is made
-lighttable_t *fixedcolormap;
+thread_local lighttable_t *fixedcolormap;
 int      centerx, centery;
 fixed_t  centerxfrac, centeryfrac;
-fixed_t  viewx, viewy, viewz;
-angle_t  viewangle;
-fixed_t  viewcos, viewsin;
+thread_local fixed_t  viewx, viewy, viewz;
+thread_local angle_t  viewangle;
+thread_local fixed_t  viewcos, viewsin;
 fixed_t  viewpitch;
 const player_t *viewplayer;
-extern lighttable_t **walllights;
+extern thread_local lighttable_t **walllights;
 bool     showpsprites = 1; //sf
 camera_t *viewcamera;
 
@@ -137,16 +140,16 @@ VALLOCATION(xtoviewangle)
 int numcolormaps;
 lighttable_t *(*c_scalelight)[LIGHTLEVELS][MAXLIGHTSCALE];
 lighttable_t *(*c_zlight)[LIGHTLEVELS][MAXLIGHTZ];
-lighttable_t *(*scalelight)[MAXLIGHTSCALE];
-lighttable_t *(*zlight)[MAXLIGHTZ];
-lighttable_t *fullcolormap;
+thread_local lighttable_t *(*scalelight)[MAXLIGHTSCALE];
+thread_local lighttable_t *(*zlight)[MAXLIGHTZ];
+thread_local lighttable_t *fullcolormap;
 lighttable_t **colormaps;
 
 // killough 3/20/98, 4/4/98: end dynamic colormaps
 
 int extralight;                           // bumped light from gun blasts
 
-void (*colfunc)(void);                    // current column draw function
+thread_local void (*colfunc)(void);                  // current column draw function
 
 // haleyjd 09/04/06: column drawing engines
 columndrawer_t *r_column_engine;
@@ -156,6 +159,7 @@ static columndrawer_t *r_column_engines[NUMCOLUMNENGINES] =
 {
    &r_normal_drawer, // normal engine
    &r_quad_drawer,   // quad cache engine
+   &r_simd_drawer,   // SSE2/AVX2 engine
 };
 
 //
@@ -174,7 +178,8 @@ int r_span_engine_num;
 
 static spandrawer_t *r_span_engines[NUMSPANENGINES] =
 {
-   &r_spandrawer,    // normal engine
+   &r_spandrawer,     // normal engine
+   &r_simdspandrawer, // SSE2/AVX2 engine
 };
 
 //
@@ -422,7 +427,7 @@ void R_ResetFOV(int width, int height)
       fov = 179;
 }
 
-extern float slopevis; // SoM: used in slope lighting
+extern thread_local float slopevis; // SoM: used in slope lighting
 
 //
 // R_InitTextureMapping
@@ -730,6 +735,7 @@ void R_Init()
    R_SetViewSize(screenSize+3);
    R_InitLightTables();
    R_InitTranslationTables();
+   R_InitSIMDDrawers();
    R_InitParticles(); // haleyjd
 }
 
@@ -749,7 +755,7 @@ subsector_t *R_PointInSubsector(fixed_t x, fixed_t y)
 
 int autodetect_hom = 0;       // killough 2/7/98: HOM autodetection flag
 
-unsigned int frameid = 0;
+thread_local unsigned int frameid = 0;
 
 //
 // R_IncrementFrameid
@@ -768,16 +774,16 @@ void R_IncrementFrameid()
    if(!frameid)
    {
       // it wrapped!
-      C_Printf("Congratulations! You have just played through 4,294,967,295 "
-               "rendered frames of Doom. At a constant rate of 35 frames per "
-               "second you have spent at least 1,420 days playing DOOM.\n"
-               "GET A LIFE.\a\n");
+      if(!r_context->index)
+         C_Printf("Congratulations! You have just played through 4,294,967,295 "
+                  "rendered frames of Doom. At a constant rate of 35 frames per "
+                  "second you have spent at least 1,420 days playing DOOM.\n"
+                  "GET A LIFE.\a\n");
 
       frameid = 1;
 
       // Do as the description says...
-      for(int i = 0; i < numsectors; ++i)
-         pSectorBoxes[i].fframeid = pSectorBoxes[i].cframeid = 0;
+      R_ResetContextStamps();
    }
 }
 
@@ -1178,7 +1184,7 @@ void R_SectorColormap(const sector_t *s)
    if(viewplayer->fixedcolormap)
    {
       // killough 3/20/98: localize scalelightfixed (readability/optimization)
-      static lighttable_t *scalelightfixed[MAXLIGHTSCALE];
+      static thread_local lighttable_t *scalelightfixed[MAXLIGHTSCALE];
 
       fixedcolormap = fullcolormap   // killough 3/20/98: use fullcolormap
         + viewplayer->fixedcolormap*256*sizeof(lighttable_t);
@@ -1209,17 +1215,71 @@ static int render_ticker = 0;
 extern void R_UntaintPortals();
 
 //
-// R_RenderPlayerView
+// View snapshot
 //
-// Primary renderer entry point.
+// The view is set up once per frame on the main thread. Render contexts on
+// other threads take a copy of it before they start on their slice.
 //
-void R_RenderPlayerView(player_t* player, camera_t *camerapoint)
+struct viewsnapshot_t
 {
-   bool quake = false;
-   unsigned int savedflags = 0;
+   fixed_t  viewx, viewy, viewz;
+   angle_t  viewangle;
+   fixed_t  viewsin, viewcos;
+   cb_view_t view;
+   void   (*colfunc)();
+};
+
+static viewsnapshot_t viewsnapshot;
+
+//
+// R_takeViewSnapshot
+//
+static void R_takeViewSnapshot()
+{
+   viewsnapshot.viewx     = viewx;
+   viewsnapshot.viewy     = viewy;
+   viewsnapshot.viewz     = viewz;
+   viewsnapshot.viewangle = viewangle;
+   viewsnapshot.viewsin   = viewsin;
+   viewsnapshot.viewcos   = viewcos;
+   viewsnapshot.view      = view;
+   viewsnapshot.colfunc   = colfunc;
+}
+
+//
+// R_applyViewSnapshot
+//
+static void R_applyViewSnapshot()
+{
+   viewx     = viewsnapshot.viewx;
+   viewy     = viewsnapshot.viewy;
+   viewz     = viewsnapshot.viewz;
+   viewangle = viewsnapshot.viewangle;
+   viewsin   = viewsnapshot.viewsin;
+   viewcos   = viewsnapshot.viewcos;
+   view      = viewsnapshot.view;
+   colfunc   = viewsnapshot.colfunc;
+
+   R_IncrementFrameid();
+   R_SectorColormap(view.sector);
+}
+
+//
+// R_renderContextView
+//
+// Renders the current render context's slice of the view. Runs on the
+// context's own thread.
+//
+static void R_renderContextView()
+{
+   const bool singlecontext = (R_NumContexts() == 1);
+   uint64_t   phasestart;
+
+   if(r_context->index)
+      R_applyViewSnapshot();
+
+   ++r_context->validcount;
 
-   R_SetupFrame(player, camerapoint);
-   
    // haleyjd: untaint portals
    R_UntaintPortals();
 
@@ -1230,31 +1290,14 @@ void R_RenderPlayerView(player_t* player, camera_t *camerapoint)
    R_ClearPortals();
    R_ClearSprites();
 
-   if(autodetect_hom)
-      R_HOMdrawer();
-   
-   // check for new console commands.
-   NetUpdate();
-
-   // haleyjd 01/21/07: earthquakes -- make player invisible to himself
-   if(player->quake && !camerapoint)
-   {
-      quake = true;
-      savedflags = player->mo->flags2;
-      player->mo->flags2 |= MF2_DONTDRAW;
-      player->mo->intflags |= MIF_HIDDENBYQUAKE;   // keep track
-   }
-   else
-      player->mo->intflags &= ~MIF_HIDDENBYQUAKE;  // zero it otherwise
-
    // The head node is the last node output.
+   phasestart = D_BenchClock();
    R_RenderBSPNode(numnodes - 1);
+   D_BenchAddPhase(BENCH_BSP, phasestart);
 
-   if(quake)
-      player->mo->flags2 = savedflags;
-   
    // Check for new console commands.
-   NetUpdate();
+   if(singlecontext)
+      NetUpdate();
 
    R_SetMaskedSilhouette(NULL, NULL);
    
@@ -1262,20 +1305,68 @@ void R_RenderPlayerView(player_t* player, camera_t *camerapoint)
    R_PushPost(true, NULL);
    
    // SoM 12/9/03: render the portals.
+   phasestart = D_BenchClock();
    R_RenderPortals();
+   D_BenchAddPhase(BENCH_PORTALS, phasestart);
 
+   phasestart = D_BenchClock();
    R_DrawPlanes(NULL);
+   D_BenchAddPhase(BENCH_PLANES, phasestart);
    
    // Check for new console commands.
-   NetUpdate();
+   if(singlecontext)
+      NetUpdate();
 
    // Draw Post-BSP elements such as sprites, masked textures, and portal 
    // overlays
+   phasestart = D_BenchClock();
    R_DrawPostBSP();
+   D_BenchAddPhase(BENCH_MASKED, phasestart);
    
    // haleyjd 09/04/06: handle through column engine
    if(r_column_engine->ResetBuffer)
       r_column_engine->ResetBuffer();
+}
+
+//
+// R_RenderPlayerView
+//
+// Primary renderer entry point.
+//
+void R_RenderPlayerView(player_t* player, camera_t *camerapoint)
+{
+   bool quake = false;
+   unsigned int savedflags = 0;
+
+   R_UpdateTextureCache();
+   R_SetupFrame(player, camerapoint);
+   R_SetupContexts();
+
+   if(R_NumContexts() > 1)
+      R_takeViewSnapshot();
+   
+   if(autodetect_hom)
+      R_HOMdrawer();
+   
+   // check for new console commands.
+   NetUpdate();
+
+   // haleyjd 01/21/07: earthquakes -- make player invisible to himself
+   if(player->quake && !camerapoint)
+   {
+      quake = true;
+      savedflags = player->mo->flags2;
+      player->mo->flags2 |= MF2_DONTDRAW;
+      player->mo->intflags |= MIF_HIDDENBYQUAKE;   // keep track
+   }
+   else
+      player->mo->intflags &= ~MIF_HIDDENBYQUAKE;  // zero it otherwise
+
+   // Render the view, split between the render contexts
+   R_RunContexts(R_renderContextView);
+
+   if(quake)
+      player->mo->flags2 = savedflags;
 
    // haleyjd: remove sector interpolations
    if(view.lerp != FRACUNIT)
@@ -1459,8 +1550,8 @@ void R_DoomTLStyle()
 
 static const char *handedstr[]  = { "right", "left" };
 static const char *ptranstr[]   = { "none", "smooth", "general" };
-static const char *coleng[]     = { "normal", "quad" };
-static const char *spaneng[]    = { "highprecision" };
+static const char *coleng[]     = { "normal", "quad", "simd" };
+static const char *spaneng[]    = { "highprecision", "simd" };
 static const char *tlstylestr[] = { "none", "boom", "new" };
 
 VARIABLE_BOOLEAN(lefthanded, NULL,                  handedstr);
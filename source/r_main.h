@@ -39,8 +39,8 @@ struct spandrawer_t;
 // POV related.
 //
 
-extern fixed_t  viewcos;
-extern fixed_t  viewsin;
+extern thread_local fixed_t  viewcos;
+extern thread_local fixed_t  viewsin;
 
 extern int      centerx;
 extern int      centery;
@@ -73,7 +73,7 @@ void R_ResetTrans();
 // Function pointer to switch refresh/drawing functions.
 //
 
-extern void (*colfunc)();
+extern thread_local void (*colfunc)();
 
 //
 // Utility functions.
@@ -136,8 +136,8 @@ angle_t R_WadToAngle(int wadangle);
 extern int viewdir;
 
 // haleyjd 09/04/06
-#define NUMCOLUMNENGINES 2
-#define NUMSPANENGINES 1
+#define NUMCOLUMNENGINES 3
+#define NUMSPANENGINES 2
 extern int r_column_engine_num;
 extern int r_span_engine_num;
 extern columndrawer_t *r_column_engine;
@@ -237,13 +237,13 @@ struct cb_seg_t
 };
 
 
-extern cb_view_t  view;
-extern cb_seg_t   seg;
-extern cb_seg_t   segclip;
+extern thread_local cb_view_t  view;
+extern thread_local cb_seg_t   seg;
+extern thread_local cb_seg_t   segclip;
 
 // SoM: frameid frame counter.
 void R_IncrementFrameid(); // Needed by the portal functions... 
-extern unsigned   frameid;
+extern thread_local unsigned frameid;
 
 #endif
 
@@ -36,6 +36,8 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <algorithm>
+
 #include "z_zone.h"    /* memory allocation wrappers -- killough */
 #include "i_system.h"
 
@@ -43,6 +45,7 @@
 #include "d_gi.h"
 #include "doomstat.h"
 #include "ev_specials.h"
+#include "m_profile.h"
 #include "p_anim.h"
 #include "p_info.h"
 #include "p_slopes.h"
@@ -66,18 +69,18 @@
 
 #define MAINHASHCHAINS 257 // prime numbers are good for hashes with modulo-based functions
 
-static visplane_t *freetail;                   // killough
-static visplane_t **freehead = &freetail;      // killough
-visplane_t *floorplane, *ceilingplane;
+static thread_local visplane_t *freetail;              // killough
+static thread_local visplane_t **freehead = &freetail; // killough
+thread_local visplane_t *floorplane, *ceilingplane;
 
 
 // SoM: New visplane hash
 // This is the main hash object used by the normal scene.
-static visplane_t *mainchains[MAINHASHCHAINS];   // killough
-static planehash_t  mainhash = { MAINHASHCHAINS,  mainchains, nullptr };
+static thread_local visplane_t *mainchains[MAINHASHCHAINS];   // killough
+static thread_local planehash_t  mainhash = { MAINHASHCHAINS,  mainchains, nullptr };
 
 // Free list of overlay portals. Used by portal windows and the post-BSP stack.
-static planehash_t *r_overlayfreesets;
+static thread_local planehash_t *r_overlayfreesets;
 
 //
 // VALLOCATION(mainhash)
@@ -87,13 +90,14 @@ static planehash_t *r_overlayfreesets;
 // because all visplanes have been destroyed on account of being 
 // allocated with a PU_VALLOC tag.
 //
-VALLOCATION(mainhash)
+VCTXALLOCATION(mainhash)
 {
    freetail = NULL;
    freehead = &freetail;
    floorplane = ceilingplane = NULL;
 
    memset(mainchains, 0, sizeof(mainchains));
+   mainhash.chains = mainchains;
 }
 
 // killough -- hash function for visplanes
@@ -104,9 +108,9 @@ VALLOCATION(mainhash)
 
 // killough 8/1/98: set static number of openings to be large enough
 // (a static limit is okay in this case and avoids difficulties in r_segs.c)
-float *openings, *lastopening;
+thread_local float *openings, *lastopening;
 
-VALLOCATION(openings)
+VCTXALLOCATION(openings)
 {
    openings = ecalloctag(float *, w*h, sizeof(float), PU_VALLOC, NULL);
    lastopening = openings;
@@ -119,10 +123,10 @@ VALLOCATION(openings)
 
 // SoM 12/8/03: floorclip and ceilingclip changed to pointers so they can be set
 // to the clipping arrays of portals.
-float *floorcliparray, *ceilingcliparray;
-float *floorclip, *ceilingclip;
+thread_local float *floorcliparray, *ceilingcliparray;
+thread_local float *floorclip, *ceilingclip;
 
-VALLOCATION(floorcliparray)
+VCTXALLOCATION(floorcliparray)
 {
    float *buffer = ecalloctag(float *, w*2, sizeof(float), PU_VALLOC, NULL);
 
@@ -131,9 +135,9 @@ VALLOCATION(floorcliparray)
 }
 
 // SoM: We have to use secondary clipping arrays for portal overlays
-float *overlayfclip, *overlaycclip;
+thread_local float *overlayfclip, *overlaycclip;
 
-VALLOCATION(overlayfclip)
+VCTXALLOCATION(overlayfclip)
 {
    float *buffer = ecalloctag(float *, w*2, sizeof(float), PU_VALLOC, NULL);
    overlayfclip = buffer;
@@ -141,9 +145,9 @@ VALLOCATION(overlayfclip)
 }
 
 // spanstart holds the start of a plane span; initialized to 0 at start
-static int *spanstart;
+static thread_local int *spanstart;
 
-VALLOCATION(spanstart)
+VCTXALLOCATION(spanstart)
 {
    spanstart = ecalloctag(int *, h, sizeof(int), PU_VALLOC, NULL);
 }
@@ -152,17 +156,17 @@ VALLOCATION(spanstart)
 // texture mapping
 //
 
-cb_span_t      span;
-cb_plane_t     plane;
-cb_slopespan_t slopespan;
+thread_local cb_span_t      span;
+thread_local cb_plane_t     plane;
+thread_local cb_slopespan_t slopespan;
 
-VALLOCATION(slopespan)
+VCTXALLOCATION(slopespan)
 {
    size_t size = sizeof(lighttable_t *) * w;
    slopespan.colormap = ecalloctag(lighttable_t **, 1, size, PU_VALLOC, NULL);
 }
 
-float slopevis; // SoM: used in slope lighting
+thread_local float slopevis; // SoM: used in slope lighting
 
 // BIG FLATS
 static void R_Throw()
@@ -170,8 +174,8 @@ static void R_Throw()
    I_Error("R_Throw called.\n");
 }
 
-void (*flatfunc)()  = R_Throw;
-void (*slopefunc)() = R_Throw;
+static thread_local void (*flatfunc)()  = R_Throw;
+static thread_local void (*slopefunc)() = R_Throw;
 
 //
 // R_SpanLight
@@ -253,65 +257,170 @@ static inline uint32_t R_doubleToUint32(double d)
 }
 
 //
-// R_MapPlane
+// Plane rows
 //
-// BASIC PRIMITIVE
+// Everything about a span of a flat plane but where it starts along its row
+// depends only on the row. Spans are therefore queued up for a whole batch of
+// planes sharing the same flat, light and offsets, then sorted by row and
+// drawn top to bottom, working out each row once however many spans and
+// planes it is shared between.
 //
-static void R_MapPlane(int y, int x1, int x2)
+struct planespan_t
 {
-   float dy, xstep, ystep, realy, slope;
+   int y, x1, x2;
+};
+
+struct planerow_t
+{
+   double xbase, ybase;   // texture position at x = 0
+   double xstep, ystep;   // and its step per pixel
+   lighttable_t *colormap;
+};
+
+static thread_local planespan_t *planespans;
+static thread_local int          numplanespans;
+static thread_local int          maxplanespans;
+
+// 1 / distance of each row from the center row, in rows; these depend only
+// on view.ycenter and are kept between views
+static thread_local float *planerowscale;
+static thread_local float  planerowycenter;
+static thread_local int    planerowcount;
+
+VCTXALLOCATION(planerowscale)
+{
+   planerowscale = ecalloctag(float *, h, sizeof(float), PU_VALLOC, NULL);
+   planerowcount = 0;
+}
+
+//
+// R_setupPlaneRows
+//
+// Redoes the row scales when the view's center has moved.
+//
+static void R_setupPlaneRows()
+{
+   if(planerowcount == viewwindow.height && planerowycenter == view.ycenter)
+      return;
 
-#ifdef RANGECHECK
-   if(x2 < x1 || x1 < 0 || x2 >= viewwindow.width || y < 0 || y >= viewwindow.height)
-      I_Error("R_MapPlane: %i, %i at %i\n", x1, x2, y);
-#endif
-  
    // SoM: because ycenter is an actual row of pixels (and it isn't really the 
    // center row because there are an even number of rows) some corrections need
    // to be made depending on where the row lies relative to the ycenter row.
-   if(view.ycenter == y)
-      dy = 0.01f;
-   else if(y < view.ycenter)
-      dy = (float)fabs(view.ycenter - y) - 1;
-   else
-      dy = (float)fabs(view.ycenter - y) + 1;
+   for(int y = 0; y < viewwindow.height; y++)
+   {
+      float dy;
+
+      if(view.ycenter == y)
+         dy = 0.01f;
+      else if(y < view.ycenter)
+         dy = (float)fabs(view.ycenter - y) - 1;
+      else
+         dy = (float)fabs(view.ycenter - y) + 1;
+
+      planerowscale[y] = 1.0f / dy;
+   }
 
-   slope = (float)fabs(plane.height / dy);
+   planerowycenter = view.ycenter;
+   planerowcount   = viewwindow.height;
+}
+
+//
+// R_planeRow
+//
+// Works out a row of the current plane.
+//
+static void R_planeRow(int y, planerow_t &row)
+{
+   float xstep, ystep, realy, slope;
+
+   slope = (float)fabs(plane.height * planerowscale[y]);
    realy = slope * view.yfoc;
 
    xstep = plane.pviewcos * slope * view.focratio * plane.xscale;
    ystep = plane.pviewsin * slope * view.focratio * plane.yscale;
 
-   // Use fast hack routine for portable double->uint32 conversion
-   // iff we know host endianness, otherwise use Mozilla routine
+   row.xbase = (((plane.pviewx + plane.xoffset) * plane.xscale) + (plane.pviewsin * realy * plane.xscale) -
+                (view.xcenter * xstep)) * plane.fixedunitx;
+   row.ybase = (((-plane.pviewy + plane.yoffset) * plane.yscale) + (-plane.pviewcos * realy * plane.yscale) -
+                (view.xcenter * ystep)) * plane.fixedunity;
+
+   row.xstep = xstep * plane.fixedunitx;
+   row.ystep = ystep * plane.fixedunity;
+
+   // killough 2/28/98: Add offsets
+   if((row.colormap = plane.fixedcolormap) == NULL) // haleyjd 10/16/06
+      row.colormap = plane.colormap + R_SpanLight(realy) * 256;
+}
+
+//
+// R_MapPlane
+//
+// BASIC PRIMITIVE
+//
+// Queues a span of the current batch of planes.
+//
+static void R_MapPlane(int y, int x1, int x2)
+{
+#ifdef RANGECHECK
+   if(x2 < x1 || x1 < 0 || x2 >= viewwindow.width || y < 0 || y >= viewwindow.height)
+      I_Error("R_MapPlane: %i, %i at %i\n", x1, x2, y);
+#endif
+
+   if(numplanespans == maxplanespans)
    {
-      double value;
+      maxplanespans = maxplanespans ? maxplanespans * 2 : 1024;
+      planespans = erealloc(planespan_t *, planespans, maxplanespans * sizeof(planespan_t));
+   }
+
+   planespan_t &ps = planespans[numplanespans++];
+   ps.y  = y;
+   ps.x1 = x1;
+   ps.x2 = x2;
+}
+
+//
+// R_flushPlaneSpans
+//
+// Draws the queued spans row by row.
+//
+static void R_flushPlaneSpans()
+{
+   planerow_t row;
+
+   std::sort(planespans, planespans + numplanespans,
+             [](const planespan_t &a, const planespan_t &b) {
+                return a.y < b.y || (a.y == b.y && a.x1 < b.x1);
+             });
+
+   span.source = plane.source;
 
-      value = (((plane.pviewx + plane.xoffset) * plane.xscale) + (plane.pviewsin * realy * plane.xscale) +
-               (((double)x1 - view.xcenter) * xstep)) * plane.fixedunitx;
+   for(int i = 0; i < numplanespans; i++)
+   {
+      const planespan_t &ps = planespans[i];
 
-      span.xfrac = R_doubleToUint32(value);
+      if(!i || ps.y != planespans[i - 1].y)
+      {
+         R_planeRow(ps.y, row);
+         span.colormap = row.colormap;
+         span.y        = ps.y;
+
+         // Use fast hack routine for portable double->uint32 conversion
+         // iff we know host endianness, otherwise use Mozilla routine
+         span.xstep = R_doubleToUint32(row.xstep);
+         span.ystep = R_doubleToUint32(row.ystep);
+      }
 
-      value = (((-plane.pviewy + plane.yoffset) * plane.yscale) + (-plane.pviewcos * realy * plane.yscale) +
-               (((double)x1 - view.xcenter) * ystep)) * plane.fixedunity;
+      span.xfrac = R_doubleToUint32(row.xbase + ps.x1 * row.xstep);
+      span.yfrac = R_doubleToUint32(row.ybase + ps.x1 * row.ystep);
 
-      span.yfrac = R_doubleToUint32(value);
+      span.x1 = ps.x1;
+      span.x2 = ps.x2;
 
-      span.xstep = R_doubleToUint32(xstep * plane.fixedunitx);
-      span.ystep = R_doubleToUint32(ystep * plane.fixedunity);
+      // BIG FLATS
+      flatfunc();
    }
 
-   // killough 2/28/98: Add offsets
-   if((span.colormap = plane.fixedcolormap) == NULL) // haleyjd 10/16/06
-      span.colormap = plane.colormap + R_SpanLight(realy) * 256;
-   
-   span.y  = y;
-   span.x1 = x1;
-   span.x2 = x2;
-   span.source = plane.source;
-   
-   // BIG FLATS
-   flatfunc();
+   numplanespans = 0;
 }
 
 //
@@ -958,6 +1067,175 @@ static const int MultiplyDeBruijnBitPosition2[32] =
   31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
 };
 
+//
+// R_setupFlat
+//
+// Sets up the span drawer for a flat plane, or a batch of them.
+//
+static void R_setupFlat(visplane_t *pl)
+{
+   texture_t *tex;
+   int        light;
+   int        stylenum;
+
+   int picnum = texturetranslation[pl->picnum];
+
+   // haleyjd 05/19/06: rewritten to avoid crashes
+   // ioanch: apply swirly if original (pl->picnum) has the flag. This is so
+   // Hexen animations can control only their own sequence swirling.
+   if((r_swirl && textures[picnum]->flags & TF_ANIMATED)
+      || textures[pl->picnum]->flags & TF_SWIRLY)
+   {
+      plane.source = R_DistortedFlat(picnum);
+      tex = plane.tex = textures[picnum];
+   }
+   else
+   {
+      // SoM: Handled outside
+      tex = plane.tex = R_CacheTexture(picnum);
+      plane.source = tex->bufferdata;
+   }
+
+   // haleyjd: TODO: feed pl->drawstyle to the first dimension to enable
+   // span drawstyles (ie. translucency)
+
+   stylenum = (pl->bflags & PS_ADDITIVE) ? SPAN_STYLE_ADD : 
+              (pl->opacity < 255)  ? SPAN_STYLE_TL :
+              SPAN_STYLE_NORMAL;
+
+   if(plane.tex->flags & TF_MASKED && pl->bflags & PS_OVERLAY)
+   {
+      switch(stylenum)
+      {
+         case SPAN_STYLE_TL:
+            stylenum = SPAN_STYLE_TL_MASKED;
+            break;
+         case SPAN_STYLE_ADD:
+            stylenum = SPAN_STYLE_ADD_MASKED;
+            break;
+         default:
+            stylenum = SPAN_STYLE_NORMAL_MASKED;
+      }
+      span.alphamask = static_cast<const byte *>(plane.source) + tex->width * tex->height;
+   }
+             
+   flatfunc  = r_span_engine->DrawSpan[stylenum][tex->flatsize];
+   slopefunc = r_span_engine->DrawSlope[stylenum][tex->flatsize];
+   
+   if(stylenum == SPAN_STYLE_TL || stylenum == SPAN_STYLE_TL_MASKED)
+   {
+      int level = (pl->opacity + 1) >> 2;
+      
+      span.fg2rgb = Col2RGB8[level];
+      span.bg2rgb = Col2RGB8[64 - level];
+   }
+   else if(stylenum == SPAN_STYLE_ADD || stylenum == SPAN_STYLE_ADD_MASKED)
+   {
+      int level = (pl->opacity + 1) >> 2;
+      
+      span.fg2rgb = Col2RGB8_LessPrecision[level];
+      span.bg2rgb = Col2RGB8_LessPrecision[64];
+   }
+   else
+      span.fg2rgb = span.bg2rgb = NULL;
+
+   if(pl->pslope)
+      plane.slope = &pl->rslope;
+   else
+      plane.slope = NULL;
+      
+   {
+      int rw, rh;
+      
+      rh = MultiplyDeBruijnBitPosition2[(uint32_t)(tex->height * 0x077CB531U) >> 27];
+      rw = MultiplyDeBruijnBitPosition2[(uint32_t)(tex->width  * 0x077CB531U) >> 27];
+
+      if(plane.slope)
+      {
+         span.ymask = tex->height - 1;
+         
+         span.xshift = 16 - rh;
+         span.xmask = (tex->width - 1) << (16 - span.xshift);
+      }
+      else
+      {
+         span.yshift = 32 - rh;
+         
+         span.xshift = span.yshift - rw;
+         span.xmask = (tex->width - 1) << (32 - rw - span.xshift);
+         
+         plane.fixedunitx = (float)(1 << (32 - rw));
+         plane.fixedunity = (float)(1 << span.yshift);
+      }
+   }
+    
+     
+   plane.xoffset = pl->xoffsf;  // killough 2/28/98: Add offsets
+   plane.yoffset = pl->yoffsf;
+
+   plane.xscale = pl->xscale;
+   plane.yscale = pl->yscale;
+
+   plane.pviewx   = pl->viewxf;
+   plane.pviewy   = pl->viewyf;
+   plane.pviewz   = pl->viewzf;
+   plane.pviewsin = pl->viewsin; // haleyjd 01/05/08: Add angle
+   plane.pviewcos = pl->viewcos;
+   plane.height   = pl->heightf - pl->viewzf;
+   
+   // SoM 10/19/02: deep water colormap fix
+   if(fixedcolormap)
+      light = (255  >> LIGHTSEGSHIFT);
+   else
+      light = (pl->lightlevel >> LIGHTSEGSHIFT) + (extralight * LIGHTBRIGHT);
+
+   if(light >= LIGHTLEVELS)
+      light = LIGHTLEVELS-1;
+
+   if(light < 0)
+      light = 0;
+
+   plane.planezlight   = pl->colormap[light]; //zlight[light];
+   plane.colormap      = pl->fullcolormap;
+   plane.fixedcolormap = pl->fixedcolormap; // haleyjd 10/16/06
+   plane.lightlevel    = pl->lightlevel;
+
+   R_PlaneLight();
+
+   plane.MapFunc = (plane.slope == NULL ? R_MapPlane : R_MapSlope);
+}
+
+//
+// R_planeSpans
+//
+// Sweeps a plane from left to right, mapping its spans.
+//
+static void R_planeSpans(visplane_t *pl)
+{
+   int stop = pl->maxx + 1;
+
+   pl->top[pl->minx-1] = pl->top[stop] = 0x7FFFFFFF;
+
+   for(int x = pl->minx ; x <= stop ; x++)
+      R_MakeSpans(x, pl->top[x-1], pl->bottom[x-1], pl->top[x], pl->bottom[x]);
+}
+
+//
+// R_drawFlats
+//
+// Draws flat planes that differ only in where they are on the screen.
+//
+static void R_drawFlats(visplane_t *const *pls, int count)
+{
+   R_setupFlat(pls[0]);
+
+   for(int i = 0; i < count; i++)
+      R_planeSpans(pls[i]);
+
+   if(!plane.slope)
+      R_flushPlaneSpans();
+}
+
 //
 // do_draw_plane
 //
@@ -1078,145 +1356,54 @@ static void do_draw_plane(visplane_t *pl)
       }
    }
    else // regular flat
-   {  
-      texture_t *tex;
-      int        stop, light;
-      int        stylenum;
-
-      int picnum = texturetranslation[pl->picnum];
-
-      // haleyjd 05/19/06: rewritten to avoid crashes
-      // ioanch: apply swirly if original (pl->picnum) has the flag. This is so
-      // Hexen animations can control only their own sequence swirling.
-      if((r_swirl && textures[picnum]->flags & TF_ANIMATED)
-         || textures[pl->picnum]->flags & TF_SWIRLY)
-      {
-         plane.source = R_DistortedFlat(picnum);
-         tex = plane.tex = textures[picnum];
-      }
-      else
-      {
-         // SoM: Handled outside
-         tex = plane.tex = R_CacheTexture(picnum);
-         plane.source = tex->bufferdata;
-      }
-
-      // haleyjd: TODO: feed pl->drawstyle to the first dimension to enable
-      // span drawstyles (ie. translucency)
-
-      stylenum = (pl->bflags & PS_ADDITIVE) ? SPAN_STYLE_ADD : 
-                 (pl->opacity < 255)  ? SPAN_STYLE_TL :
-                 SPAN_STYLE_NORMAL;
-
-      if(plane.tex->flags & TF_MASKED && pl->bflags & PS_OVERLAY)
-      {
-         switch(stylenum)
-         {
-            case SPAN_STYLE_TL:
-               stylenum = SPAN_STYLE_TL_MASKED;
-               break;
-            case SPAN_STYLE_ADD:
-               stylenum = SPAN_STYLE_ADD_MASKED;
-               break;
-            default:
-               stylenum = SPAN_STYLE_NORMAL_MASKED;
-         }
-         span.alphamask = static_cast<const byte *>(plane.source) + tex->width * tex->height;
-      }
-                
-      flatfunc  = r_span_engine->DrawSpan[stylenum][tex->flatsize];
-      slopefunc = r_span_engine->DrawSlope[stylenum][tex->flatsize];
-      
-      if(stylenum == SPAN_STYLE_TL || stylenum == SPAN_STYLE_TL_MASKED)
-      {
-         int level = (pl->opacity + 1) >> 2;
-         
-         span.fg2rgb = Col2RGB8[level];
-         span.bg2rgb = Col2RGB8[64 - level];
-      }
-      else if(stylenum == SPAN_STYLE_ADD || stylenum == SPAN_STYLE_ADD_MASKED)
-      {
-         int level = (pl->opacity + 1) >> 2;
-         
-         span.fg2rgb = Col2RGB8_LessPrecision[level];
-         span.bg2rgb = Col2RGB8_LessPrecision[64];
-      }
-      else
-         span.fg2rgb = span.bg2rgb = NULL;
-
-      if(pl->pslope)
-         plane.slope = &pl->rslope;
-      else
-         plane.slope = NULL;
-         
-      {
-         int rw, rh;
-         
-         rh = MultiplyDeBruijnBitPosition2[(uint32_t)(tex->height * 0x077CB531U) >> 27];
-         rw = MultiplyDeBruijnBitPosition2[(uint32_t)(tex->width  * 0x077CB531U) >> 27];
-
-         if(plane.slope)
-         {
-            span.ymask = tex->height - 1;
-            
-            span.xshift = 16 - rh;
-            span.xmask = (tex->width - 1) << (16 - span.xshift);
-         }
-         else
-         {
-            span.yshift = 32 - rh;
-            
-            span.xshift = span.yshift - rw;
-            span.xmask = (tex->width - 1) << (32 - rw - span.xshift);
-            
-            plane.fixedunitx = (float)(1 << (32 - rw));
-            plane.fixedunity = (float)(1 << span.yshift);
-         }
-      }
-       
-        
-      plane.xoffset = pl->xoffsf;  // killough 2/28/98: Add offsets
-      plane.yoffset = pl->yoffsf;
-
-      plane.xscale = pl->xscale;
-      plane.yscale = pl->yscale;
-
-      plane.pviewx   = pl->viewxf;
-      plane.pviewy   = pl->viewyf;
-      plane.pviewz   = pl->viewzf;
-      plane.pviewsin = pl->viewsin; // haleyjd 01/05/08: Add angle
-      plane.pviewcos = pl->viewcos;
-      plane.height   = pl->heightf - pl->viewzf;
-      
-      // SoM 10/19/02: deep water colormap fix
-      if(fixedcolormap)
-         light = (255  >> LIGHTSEGSHIFT);
-      else
-         light = (pl->lightlevel >> LIGHTSEGSHIFT) + (extralight * LIGHTBRIGHT);
-
-      if(light >= LIGHTLEVELS)
-         light = LIGHTLEVELS-1;
-
-      if(light < 0)
-         light = 0;
-
-      stop = pl->maxx + 1;
-      pl->top[pl->minx-1] = pl->top[stop] = 0x7FFFFFFF;
-
-      plane.planezlight   = pl->colormap[light]; //zlight[light];
-      plane.colormap      = pl->fullcolormap;
-      plane.fixedcolormap = pl->fixedcolormap; // haleyjd 10/16/06
-      plane.lightlevel    = pl->lightlevel;
-
-      R_PlaneLight();
+      R_drawFlats(&pl, 1);
+}
 
-      plane.MapFunc = (plane.slope == NULL ? R_MapPlane : R_MapSlope);
+//
+// R_isFlatPlane
+//
+// True if a plane is neither sky nor sloped, so that it can be drawn along
+// with others like it.
+//
+static bool R_isFlatPlane(const visplane_t *pl)
+{
+   return !pl->pslope && !(pl->picnum & PL_SKYFLAT) && !R_IsSkyFlat(pl->picnum);
+}
 
-      for(x = pl->minx ; x <= stop ; x++)
-         R_MakeSpans(x, pl->top[x-1], pl->bottom[x-1], pl->top[x], pl->bottom[x]);
-   }
+//
+// R_samePlaneState
+//
+// True if two flat planes only differ in what part of the screen they cover.
+//
+static bool R_samePlaneState(const visplane_t *a, const visplane_t *b)
+{
+   return
+      a->picnum == b->picnum &&
+      a->lightlevel == b->lightlevel &&
+      a->height == b->height &&
+      a->xoffs == b->xoffs &&
+      a->yoffs == b->yoffs &&
+      a->xscale == b->xscale &&
+      a->yscale == b->yscale &&
+      a->angle == b->angle &&
+      a->colormap == b->colormap &&
+      a->fullcolormap == b->fullcolormap &&
+      a->fixedcolormap == b->fixedcolormap &&
+      a->viewxf == b->viewxf &&
+      a->viewyf == b->viewyf &&
+      a->viewzf == b->viewzf &&
+      a->viewsin == b->viewsin &&
+      a->viewcos == b->viewcos &&
+      a->bflags == b->bflags &&
+      a->opacity == b->opacity &&
+      !b->pslope;
 }
 
+// Planes of the set being drawn, in the order they are drawn in
+static thread_local visplane_t **drawplanes;
+static thread_local int          numdrawplanes;
+static thread_local int          maxdrawplanes;
+
 //
 // R_DrawPlanes
 //
@@ -1225,20 +1412,62 @@ static void do_draw_plane(visplane_t *pl)
 //
 void R_DrawPlanes(planehash_t *table)
 {
+   PROFILE_ZONE(PROF_PLANES);
    visplane_t *pl;
-   int i;
+   int i, j;
    
    if(!table)
       table = &mainhash;
-   
+
+   R_setupPlaneRows();
+
+   numdrawplanes = 0;
    for(i = 0; i < table->chaincount; ++i)
    {
       for(pl = table->chains[i]; pl; pl = pl->next)
+      {
+         if(pl->minx > pl->maxx)
+            continue;
+
+         if(numdrawplanes == maxdrawplanes)
+         {
+            maxdrawplanes = maxdrawplanes ? maxdrawplanes * 2 : 256;
+            drawplanes = erealloc(visplane_t **, drawplanes, 
+                                  maxdrawplanes * sizeof(visplane_t *));
+         }
+         drawplanes[numdrawplanes++] = pl;
+      }
+   }
+
+   // Bring planes which can be drawn together next to each other
+   std::sort(drawplanes, drawplanes + numdrawplanes,
+             [](const visplane_t *a, const visplane_t *b) {
+                if(a->picnum != b->picnum)
+                   return a->picnum < b->picnum;
+                if(a->lightlevel != b->lightlevel)
+                   return a->lightlevel < b->lightlevel;
+                return a->height < b->height;
+             });
+
+   for(i = 0; i < numdrawplanes; i = j)
+   {
+      pl = drawplanes[i];
+      j  = i + 1;
+
+      if(!R_isFlatPlane(pl))
+      {
          do_draw_plane(pl);
+         continue;
+      }
+
+      while(j < numdrawplanes && R_samePlaneState(pl, drawplanes[j]))
+         ++j;
+
+      R_drawFlats(drawplanes + i, j - i);
    }
 }
 
-VALLOCATION(overlaySets)
+VCTXALLOCATION(overlaySets)
 {
    for(planehash_t *set = r_overlayfreesets; set; set = set->next)
       memset(set->chains, 0, set->chaincount * sizeof(*set->chains));
@@ -35,14 +35,14 @@ struct texture_t;
 
 // Visplane related.
 
-extern float *lastopening;
+extern thread_local float *lastopening;
 
 // SoM 12/8/03
-extern float *floorclip, *ceilingclip;
-extern float *floorcliparray, *ceilingcliparray;
+extern thread_local float *floorclip, *ceilingclip;
+extern thread_local float *floorcliparray, *ceilingcliparray;
 
 // SoM: We have to use secondary clipping arrays for portal overlays
-extern float *overlayfclip, *overlaycclip;
+extern thread_local float *overlayfclip, *overlaycclip;
 
 void R_ClearPlanes(void);
 void R_ClearOverlayClips(void);
@@ -125,10 +125,10 @@ struct cb_slopespan_t
 };
 
 
-extern cb_span_t  span;
-extern cb_plane_t plane;
+extern thread_local cb_span_t  span;
+extern thread_local cb_plane_t plane;
 
-extern cb_slopespan_t slopespan;
+extern thread_local cb_slopespan_t slopespan;
 
 planehash_t *R_NewOverlaySet();
 void R_FreeOverlaySet(planehash_t *set);
@@ -36,9 +36,11 @@
 #include "e_things.h"
 #include "m_bbox.h"
 #include "m_collection.h"
+#include "m_profile.h"
 #include "p_setup.h"
 #include "p_spec.h"
 #include "r_bsp.h"
+#include "r_context.h"
 #include "r_draw.h"
 #include "r_main.h"
 #include "r_plane.h"
@@ -86,20 +88,21 @@ static PODCollection<portalentry_t> gPortals;   // defined portals
 //
 
 static portal_t *portals = NULL, *last = NULL;
-static pwindow_t *unusedhead = NULL, *windowhead = NULL, *windowlast = NULL;
+static thread_local pwindow_t *unusedhead = NULL, *windowhead = NULL, *windowlast = NULL;
 
 //
 // VALLOCATION(portals)
 //
 // haleyjd 04/30/13: when the resolution changes, all portals need notification.
+// Each render context has its own windows and overlays to reset.
 //
-VALLOCATION(portals)
+VCTXALLOCATION(portals)
 {
    planehash_t *hash;
    for(portal_t *p = portals; p; p = p->next)
    {
       // clear portal overlay visplane hash tables
-      if((hash = p->poverlay))
+      if((hash = p->poverlay[r_context->index]))
       {
          for(int i = 0; i < hash->chaincount; i++)
             hash->chains[i] = NULL;
@@ -156,7 +159,7 @@ VALLOCATION(portals)
 // extra function (R_ClipSegToPortal) is called to prevent certain types of HOM
 // in portals.
 
-portalrender_t portalrender = { false, MAX_SCREENWIDTH, 0 };
+thread_local portalrender_t portalrender = { false, MAX_SCREENWIDTH, 0 };
 
 static void R_RenderPortalNOP(pwindow_t *window)
 {
@@ -471,8 +474,10 @@ static portal_t *R_CreatePortal()
       last = ret;
    }
    
-   ret->poverlay  = R_NewPlaneHash(31);
-   ret->globaltex = 1;
+   // the main context's overlay is made now; other contexts make theirs as
+   // they first need them
+   ret->poverlay[0] = R_NewPlaneHash(31);
+   ret->globaltex   = 1;
 
    return ret;
 }
@@ -539,9 +544,6 @@ portal_t *R_GetAnchoredPortal(int markerlinenum, int anchorlinenum,
    ret->type = R_ANCHORED;
    ret->data.anchor = adata;
 
-   // haleyjd: temporary debug
-   ret->tainted = 0;
-
    return ret;
 }
 
@@ -577,9 +579,6 @@ portal_t *R_GetTwoWayPortal(int markerlinenum, int anchorlinenum,
    ret->type = R_TWOWAY;
    ret->data.anchor = adata;
 
-   // haleyjd: temporary debug
-   ret->tainted = 0;
-
    return ret;
 }
 
@@ -719,6 +718,34 @@ portal_t *R_GetPlanePortal(int *pic, fixed_t *delta,
    return ret;
 }
 
+//
+// R_GetPortalOverlay
+//
+// Returns the current render context's overlay plane hash for a portal,
+// creating it if this context hasn't needed it before.
+//
+planehash_t *R_GetPortalOverlay(const portal_t *portal)
+{
+   planehash_t *&overlay =
+      const_cast<portal_t *>(portal)->poverlay[r_context->index];
+
+   if(!overlay)
+      overlay = R_NewPlaneHash(31);
+
+   return overlay;
+}
+
+//
+// R_InitPortalWindows
+//
+// Resets the calling thread's portal window lists. Windows are allocated at
+// PU_LEVEL cache level, so they'll be implicitly freed.
+//
+void R_InitPortalWindows()
+{
+   windowhead = unusedhead = windowlast = NULL;
+}
+
 //
 // R_InitPortals
 //
@@ -729,7 +756,7 @@ portal_t *R_GetPlanePortal(int *pic, fixed_t *delta,
 void R_InitPortals()
 {
    portals = last = NULL;
-   windowhead = unusedhead = windowlast = NULL;
+   R_InitPortalWindows();
    R_MapInitOverlaySets();
 
    gPortals.clear(); // clear the portal list
@@ -991,7 +1018,7 @@ static void R_RenderSkyboxPortal(pwindow_t *window)
    portalrender.minx = window->minx;
    portalrender.maxx = window->maxx;
 
-   ++validcount;
+   ++r_context->validcount;
    R_SetMaskedSilhouette(ceilingclip, floorclip);
 
    lastx = viewx;
@@ -1140,13 +1167,13 @@ static void R_RenderAnchoredPortal(pwindow_t *window)
       return;
 
    // haleyjd: temporary debug
-   if(portal->tainted > PORTAL_RECURSION_LIMIT)
+   if(portal->tainted[r_context->index] > PORTAL_RECURSION_LIMIT)
    {
       R_ShowTainted(window);         
 
-      portal->tainted++;
+      portal->tainted[r_context->index]++;
       doom_warningf("Refused to draw portal (line=%i) (t=%d)", portal->data.anchor.maker,
-                    portal->tainted);
+                    portal->tainted[r_context->index]);
       return;
    } 
 
@@ -1171,7 +1198,7 @@ static void R_RenderAnchoredPortal(pwindow_t *window)
    R_ClearSlopeMark(window->minx, window->maxx, window->type);
 
    // haleyjd: temporary debug
-   portal->tainted++;
+   portal->tainted[r_context->index]++;
 
    floorclip   = window->bottom;
    ceilingclip = window->top;
@@ -1181,7 +1208,7 @@ static void R_RenderAnchoredPortal(pwindow_t *window)
    portalrender.minx = window->minx;
    portalrender.maxx = window->maxx;
 
-   ++validcount;
+   ++r_context->validcount;
    R_SetMaskedSilhouette(ceilingclip, floorclip);
 
    lastx = viewx;
@@ -1248,13 +1275,13 @@ static void R_RenderLinkedPortal(pwindow_t *window)
       return;
 
    // haleyjd: temporary debug
-   if(portal->tainted > PORTAL_RECURSION_LIMIT)
+   if(portal->tainted[r_context->index] > PORTAL_RECURSION_LIMIT)
    {
       R_ShowTainted(window);         
 
-      portal->tainted++;
+      portal->tainted[r_context->index]++;
       doom_warningf("Refused to draw portal (line=%i) (t=%d)", portal->data.link.maker,
-                    portal->tainted);
+                    portal->tainted[r_context->index]);
       return;
    } 
 
@@ -1279,7 +1306,7 @@ static void R_RenderLinkedPortal(pwindow_t *window)
    R_ClearSlopeMark(window->minx, window->maxx, window->type);
 
    // haleyjd: temporary debug
-   portal->tainted++;
+   portal->tainted[r_context->index]++;
 
    floorclip   = window->bottom;
    ceilingclip = window->top;
@@ -1289,7 +1316,7 @@ static void R_RenderLinkedPortal(pwindow_t *window)
    portalrender.minx = window->minx;
    portalrender.maxx = window->maxx;
 
-   ++validcount;
+   ++r_context->validcount;
    R_SetMaskedSilhouette(ceilingclip, floorclip);
 
    lastx  = viewx;
@@ -1365,7 +1392,7 @@ void R_UntaintPortals()
 
    for(r = portals; r; r = r->next)
    {
-      r->tainted = 0;
+      r->tainted[r_context->index] = 0;
    }
 }
 
@@ -1501,7 +1528,8 @@ void R_ClearPortals()
    
    while(r)
    {
-      R_ClearPlaneHash(r->poverlay);
+      if(r->poverlay[r_context->index])
+         R_ClearPlaneHash(r->poverlay[r_context->index]);
       r = r->next;
    }
 }
@@ -1513,6 +1541,7 @@ void R_ClearPortals()
 //
 void R_RenderPortals()
 {
+   PROFILE_ZONE(PROF_PORTALS);
    pwindow_t *w;
 
    while(windowhead)
@@ -1668,9 +1697,6 @@ portal_t *R_GetLinkedPortal(int markerlinenum, int anchorlinenum,
    ret->type = R_LINKED;
    ret->data.link = ldata;
 
-   // haleyjd: temporary debug
-   ret->tainted = 0;
-
    return ret;
 }
 
@@ -29,6 +29,7 @@
 
 #include "doomdef.h"
 #include "p_maputl.h"
+#include "r_context.h"
 
 #define SECTOR_PORTAL_LOOP_PROTECTION 128
 
@@ -211,14 +212,15 @@ struct portal_t
    // See: portalflag_e
    int    flags;
    
-   // Planes that makeup a blended overlay
+   // Planes that makeup a blended overlay, one set per render context.
+   // Use R_GetPortalOverlay to access them.
    int          globaltex;
-   planehash_t *poverlay;
+   planehash_t *poverlay[R_MAXCONTEXTS];
 
    portal_t *next;
 
    // haleyjd: temporary debug
-   int16_t tainted;
+   int16_t tainted[R_MAXCONTEXTS];
 };
 
 //
@@ -231,6 +233,7 @@ inline static bool R_portalIsAnchored(const portal_t *portal)
 }
 
 const portal_t *R_GetPortalHead();
+planehash_t *R_GetPortalOverlay(const portal_t *portal);
 
 portal_t *R_GetSkyBoxPortal(Mobj *camera);
 portal_t *R_GetAnchoredPortal(int markerlinenum, int anchorlinenum,
@@ -253,6 +256,7 @@ portal_t *R_GetPlanePortal(int *pic, fixed_t *delta, int16_t *lightlevel,
                            float *angle, const float *xscale, const float *yscale);
 
 void R_MovePortalOverlayToWindow(bool isceiling);
+void R_InitPortalWindows();
 void R_ClearPortals();
 void R_RenderPortals();
 
@@ -362,7 +366,7 @@ struct portalrender_t
 //   planehash_t *overlay;
 };
 
-extern portalrender_t  portalrender;
+extern thread_local portalrender_t portalrender;
 #endif
 
 //----------------------------------------------------------------------------
@@ -47,7 +47,7 @@
 // 1 cycle per 32 units (2 in 64)
 #define SWIRLFACTOR2 (8192/32)
 
-static byte *normalflat;
+static thread_local byte *normalflat;
 int r_swirl;       // hack
 
 #if 0
@@ -76,12 +76,12 @@ static void R_DrawLines(void)
 //
 byte *R_DistortedFlat(int texnum, bool usegametic)
 {
-   static int lasttex = -1;
-   static int swirltic = -1;
-   static int *offset;
-   static int offsetSize;
-   static byte *distortedflat;
-   static int lastsize;
+   static thread_local int lasttex = -1;
+   static thread_local int swirltic = -1;
+   static thread_local int *offset;
+   static thread_local int offsetSize;
+   static thread_local byte *distortedflat;
+   static thread_local int lastsize;
 
    int i;
    int reftime = usegametic ? gametic : leveltime;
@@ -46,13 +46,13 @@
 // OPTIMIZE: closed two sided lines as single sided
 // SoM: Done.
 // SoM: Cardboard globals
-cb_column_t column;
-cb_seg_t    seg;
-cb_seg_t    segclip;
+thread_local cb_column_t column;
+thread_local cb_seg_t    seg;
+thread_local cb_seg_t    segclip;
 
 // killough 1/6/98: replaced globals with statics where appropriate
-lighttable_t **walllights;
-static float  *maskedtexturecol;
+thread_local lighttable_t **walllights;
+static thread_local float *maskedtexturecol;
 
 //
 // R_RenderMaskedSegRange
@@ -145,6 +145,9 @@ skytexture_t *R_GetSkyTexture(int texturenum)
    int key;
    skytexture_t *target = NULL;
 
+   // render contexts may look up and add skies at the same time
+   ZoneLockGuard lock;
+
    key = skytexturekey(texturenum);
 
    if(skytextures[key])
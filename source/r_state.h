@@ -68,7 +68,7 @@ struct spritespan_t
 extern spritespan_t **r_spritespan;
 
 extern lighttable_t **colormaps;         // killough 3/20/98, 4/4/98
-extern lighttable_t  *fullcolormap;      // killough 3/20/98
+extern thread_local lighttable_t *fullcolormap;     // killough 3/20/98
 
 extern int firstflat;
 
@@ -120,18 +120,18 @@ extern int              numthings;
 //
 // POV data.
 //
-extern fixed_t          viewx;
-extern fixed_t          viewy;
-extern fixed_t          viewz;
-extern angle_t          viewangle;
+extern thread_local fixed_t viewx;
+extern thread_local fixed_t viewy;
+extern thread_local fixed_t viewz;
+extern thread_local angle_t viewangle;
 extern const player_t   *viewplayer;
 extern camera_t         *viewcamera;
 extern angle_t          clipangle;
 extern int              viewangletox[FINEANGLES/2];
 extern angle_t          *xtoviewangle;  // killough 2/8/98
 
-extern visplane_t       *floorplane;
-extern visplane_t       *ceilingplane;
+extern thread_local visplane_t *floorplane;
+extern thread_local visplane_t *ceilingplane;
 
 #endif
 
@@ -23,17 +23,23 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <algorithm>
+#include <atomic>
+
 #include "z_zone.h"
 #include "i_system.h"
 
 #include "c_io.h"
+#include "c_runcmd.h"
 #include "doomstat.h"
 #include "d_gi.h"
 #include "d_io.h"
 #include "d_main.h"
 #include "e_hash.h"
+#include "m_collection.h"
 #include "m_compare.h"
 #include "m_swap.h"
+#include "m_threadpool.h"
 #include "p_setup.h"
 #include "p_skin.h"
 #include "r_data.h"
@@ -616,61 +622,70 @@ static int R_ReadTextureNamespace(int texnum)
 
 
 // This struct holds the temporary structure of a masked texture while it is
-// build assembled. When a texture is complete, new col structs are allocated 
-// in a single block to ensure linearity within memory.
-struct tempmask_s
+// being assembled. When a texture is complete, new col structs are allocated 
+// in a single block to ensure linearity within memory. Textures built at the
+// same time each need a builder of their own.
+struct texbuilder_t
 {
+   texture_t *tex;
+
    // This is the buffer used for masking
-   bool       mask;       // If set to true, FinishTexture should create columns
+   bool       mask;       // If set to true, FinishTexture should use the mask
    int        buffermax;  // size of allocated buffer
    byte      *buffer;     // mask buffer.
-   texture_t *tex;
    
    texcol_t  *tempcols;
-} tempmask = { false, 0, NULL, NULL, NULL };
+
+   PODCollection<void *> sources; // cached graphic of each component
+};
+
+static texbuilder_t tempmask; // for textures built on demand
+
+//
+// Composed texture cache
+//
+// Finished texture buffers belong to this cache rather than to the zone's
+// PU_CACHE purging, which would only ever throw all of them out at once when
+// the heap runs dry. Their memory is counted, and once it goes past
+// r_texcachesize the textures drawn least recently are let go first.
+//
+int r_texcachesize = 64; // megabytes of texture buffers to keep
+
+static size_t       texcachebytes;     // bytes held in texture buffers
+static uint32_t     texcacheclock = 1; // views rendered so far
 
 //
 // AddTexColumn
 //
 // Copies from src to the tex buffer and optionally marks the temporary mask
 //
-static void AddTexColumn(texture_t *tex, const byte *src, int srcstep, 
+static void AddTexColumn(texbuilder_t &tb, const byte *src, int srcstep, 
                          int ptroff, int len)
 {
-   byte *dest = tex->bufferdata + ptroff;
+   texture_t *tex  = tb.tex;
+   byte      *dest = tex->bufferdata + ptroff;
    
 #ifdef RANGECHECK
    if(ptroff < 0 || ptroff + len > tex->width * tex->height ||
-      ptroff + len > tempmask.buffermax)
+      (tb.mask && ptroff + len > tb.buffermax))
    {
       I_Error("AddTexColumn(%s) invalid ptroff: %i / (%i, %i)\n", 
               (const char *)(tex->name), 
-              ptroff + len, tex->width * tex->height, tempmask.buffermax);
+              ptroff + len, tex->width * tex->height, tb.buffermax);
    }
 #endif
 
-   if(tempmask.mask && tex == tempmask.tex)
-   {
-      byte *mask = tempmask.buffer + ptroff;
-      
-      while(len > 0)
-      {
-         *dest = *src;
-         dest++; src += srcstep; 
-         
-         *mask = 255; mask++;
-         len--;
-      }
-   }
+   // Patch posts are contiguous; only flats are stepped through
+   if(srcstep == 1)
+      memcpy(dest, src, len);
    else
    {
-      while(len > 0)
-      {
-         *dest = *src;
-         dest++; src++;
-         len--;
-      }
+      for(int i = 0; i < len; i++, src += srcstep)
+         dest[i] = *src;
    }
+
+   if(tb.mask)
+      memset(tb.buffer + ptroff, 255, len);
 }
 
 //
@@ -678,9 +693,10 @@ static void AddTexColumn(texture_t *tex, const byte *src, int srcstep,
 // 
 // Paints the given flat-based component to the texture and marks mask info
 //
-static void AddTexFlat(texture_t *tex, tcomponent_t *component)
+static void AddTexFlat(texbuilder_t &tb, const tcomponent_t *component,
+                       const byte *src)
 {
-   byte      *src = (byte *)(wGlobalDir.cacheLumpNum(component->lump, PU_CACHE));
+   texture_t *tex = tb.tex;
    int       destoff, srcoff, deststep, srcxstep, srcystep;
    int       xstart, ystart, xstop, ystop;
    int       width, height, wcount, hcount;
@@ -740,7 +756,7 @@ static void AddTexFlat(texture_t *tex, tcomponent_t *component)
          I_Error("AddTexFlat(%s): Invalid srcoff %i / %i\n", 
                  (const char *)(tex->name), srcoff, tex->width * tex->height);
 #endif
-      AddTexColumn(tex, src + srcoff, srcystep, destoff, hcount);
+      AddTexColumn(tb, src + srcoff, srcystep, destoff, hcount);
       srcoff += srcxstep;
       destoff += deststep;
       wcount--;
@@ -752,9 +768,10 @@ static void AddTexFlat(texture_t *tex, tcomponent_t *component)
 // 
 // Paints the given flat-based component to the texture and marks mask info
 //
-static void AddTexPatch(texture_t *tex, tcomponent_t *component)
+static void AddTexPatch(texbuilder_t &tb, const tcomponent_t *component,
+                        const patch_t *patch)
 {
-   patch_t *patch = PatchLoader::CacheNum(wGlobalDir, component->lump, PU_CACHE);
+   texture_t *tex = tb.tex;
    int      destoff;
    int      xstart, ystart, xstop;
    int      colindex, colstep;
@@ -786,7 +803,7 @@ static void AddTexPatch(texture_t *tex, tcomponent_t *component)
    {
       int top, y1, y2, destbase;
       const column_t *column = 
-         (const column_t *)((byte *)patch + patch->columnofs[colindex]);
+         (const column_t *)((const byte *)patch + patch->columnofs[colindex]);
          
       destbase = x * tex->height;
       top = 0;
@@ -832,21 +849,75 @@ static void AddTexPatch(texture_t *tex, tcomponent_t *component)
 #endif
             
          if(y2 - y1 > 0)
-            AddTexColumn(tex, src + srcoff, 1, destoff, y2 - y1);
+            AddTexColumn(tb, src + srcoff, 1, destoff, y2 - y1);
             
          column = reinterpret_cast<const column_t *>(src + column->length + 1);
       }
    }
 }
 
+//
+// R_cacheComponent
+//
+// Caches the graphic a texture component is drawn from.
+//
+static void *R_cacheComponent(const tcomponent_t *component)
+{
+   // SoM: Do NOT add lumps with a -1 lumpnum
+   if(component->lump == -1)
+      return nullptr;
+
+   switch(component->type)
+   {
+   case TC_FLAT:
+      return wGlobalDir.cacheLumpNum(component->lump, PU_CACHE);
+   case TC_PATCH:
+      return PatchLoader::CacheNum(wGlobalDir, component->lump, PU_CACHE);
+   default:
+      return nullptr;
+   }
+}
+
+//
+// R_drawComponent
+//
+// Paints a component from its cached graphic. Touches nothing but the
+// builder and its texture, so textures may be drawn on several threads.
+//
+static void R_drawComponent(texbuilder_t &tb, const tcomponent_t *component,
+                            const void *source)
+{
+   if(!source)
+      return;
+
+   switch(component->type)
+   {
+   case TC_FLAT:
+      AddTexFlat(tb, component, static_cast<const byte *>(source));
+      break;
+   case TC_PATCH:
+      AddTexPatch(tb, component, static_cast<const patch_t *>(source));
+      break;
+   default:
+      break;
+   }
+}
+
 //
 // StartTexture
 //
 // Allocates the texture buffer, as well as managing the temporary structs and
 // the mask buffer.
 //
-static void StartTexture(texture_t *tex, bool mask)
+static void StartTexture(texbuilder_t &tb, texture_t *tex)
 {
+   // SoM: This situation would most certainly require an abort.
+   if(tex->ccount == 0)
+   {
+      I_Error("R_CacheTexture: texture %s cached with no buffer and no components.\n",
+              (const char *)(tex->name));
+   }
+
    // haleyjd 11/18/12: We *must* allocate some pad space in the texture buffer.
    // Due to intermixed use of float and fixed_t in Cardboard, it is impossible
    // to make sure that fracstep is perfectly in sync with y1/y2 values in the
@@ -855,22 +926,24 @@ static void StartTexture(texture_t *tex, bool mask)
 
    int bufferlen = tex->width * tex->height + 4;
    
-   // Static for now
-   tex->bufferalloc = ecalloctag(byte *, 1, bufferlen + 8, PU_STATIC, (void **)&tex->bufferalloc);
-   tex->bufferdata = tex->bufferalloc + 8;
+   // Static for now. The buffer has no owner until R_CacheTexture is done
+   // with it, so that other render threads never see a half-built texture.
+   byte *buffer = ecalloctag(byte *, 1, bufferlen + 8, PU_STATIC, nullptr);
+   tex->bufferdata = buffer + 8;
+   tb.tex = tex;
    
-   if((tempmask.mask = mask))
+   // The mask is needed to build the columns, and to rebuild the alpha mask
+   // of a texture with holes whenever its buffer is rebuilt.
+   if((tb.mask = (!tex->columns || (tex->flags & TF_MASKED))))
    {
-      tempmask.tex = tex;
-      
       // Setup the temporary mask
-      if(bufferlen > tempmask.buffermax || !tempmask.buffer)
+      if(bufferlen > tb.buffermax || !tb.buffer)
       {
-         tempmask.buffermax = bufferlen;
-         tempmask.buffer = (byte *)(Z_Realloc(tempmask.buffer, bufferlen, 
-                                        PU_RENDERER, (void **)&tempmask.buffer));
+         tb.buffermax = bufferlen;
+         tb.buffer = (byte *)(Z_Realloc(tb.buffer, bufferlen, 
+                                        PU_RENDERER, (void **)&tb.buffer));
       }
-      memset(tempmask.buffer, 0, bufferlen);
+      memset(tb.buffer, 0, bufferlen);
    }
 }
 
@@ -880,14 +953,14 @@ static void StartTexture(texture_t *tex, bool mask)
 // Returns either the next element in the chain or a new element which is
 // then added to the chain.
 //
-static texcol_t *NextTempCol(texcol_t *current)
+static texcol_t *NextTempCol(texbuilder_t &tb, texcol_t *current)
 {
    if(!current)
    {
-      if(!tempmask.tempcols)
-         return tempmask.tempcols = estructalloc(texcol_t, 1);
+      if(!tb.tempcols)
+         return tb.tempcols = estructalloc(texcol_t, 1);
       else
-         return tempmask.tempcols;
+         return tb.tempcols;
    }
    
    if(!current->next)
@@ -900,15 +973,16 @@ static texcol_t *NextTempCol(texcol_t *current)
 // Appends alpha mask to the buffer (by reallocating it as necessary). Needed for masked texture
 // portal overlays (visplanes)
 //
-static void R_appendAlphaMask(texture_t *tex)
+static void R_appendAlphaMask(texbuilder_t &tb)
 {
+   texture_t *tex = tb.tex;
    int size = tex->width * tex->height;
    // Add space for the mask
-   tex->bufferalloc = (byte*)Z_Realloc(tex->bufferalloc, 8 + size + (size + 7) / 8 + 4, PU_STATIC,
-                                       (void**)&tex->bufferalloc);
-   tex->bufferdata = tex->bufferalloc + 8;
+   byte *buffer = (byte*)Z_Realloc(tex->bufferdata - 8, 8 + size + (size + 7) / 8 + 4, PU_STATIC,
+                                   nullptr);
+   tex->bufferdata = buffer + 8;
 
-   const byte *tempmaskp = tempmask.buffer;
+   const byte *tempmaskp = tb.buffer;
    byte *maskplane = tex->bufferdata + size;
    memset(maskplane, 0, (size + 7) / 8);
 
@@ -926,31 +1000,23 @@ static void R_appendAlphaMask(texture_t *tex)
 }
 
 //
-// FinishTexture
+// R_buildColumns
 //
-// Called after R_CacheTexture is finished drawing a texture. This function
-// builds the columns (if needed) of a texture from the temporary mask buffer.
+// Builds the columns of a texture from the temporary mask buffer. Returns
+// true if the texture has holes.
 //
-static void FinishTexture(texture_t *tex)
+static bool R_buildColumns(texbuilder_t &tb)
 {
+   texture_t  *tex = tb.tex;
    int        x, y, i, colcount;
    texcol_t   *col, *tcol;
    const byte *maskp;
 
-   if(!tempmask.mask)
-      return;
-      
-   if(tempmask.tex != tex)
-   {
-      // SoM: ERROR?
-      return;
-   }
-   
    // Allocate column pointers
    tex->columns = ecalloctag(texcol_t **, sizeof(texcol_t **), tex->width, PU_RENDERER, NULL);
    
    // Build the columns based on mask info
-   maskp = tempmask.buffer;
+   maskp = tb.buffer;
 
    bool masked = false; // true if texture has holes (more processing needed for portal overlays)
 
@@ -974,10 +1040,10 @@ static void FinishTexture(texture_t *tex)
          if(y < tex->height && *maskp > 0)
          {
             colcount++;
-            col = NextTempCol(col);
+            col = NextTempCol(tb, col);
             
             col->yoff = y;
-            col->ptroff = uint32_t(maskp - tempmask.buffer);
+            col->ptroff = uint32_t(maskp - tb.buffer);
             
             while(y < tex->height && *maskp > 0)
             {
@@ -1001,7 +1067,7 @@ static void FinishTexture(texture_t *tex)
       col = NULL;
       for(i = 0; i < colcount; i++)
       {
-         col = NextTempCol(col);
+         col = NextTempCol(tb, col);
          memcpy(tcol, col, sizeof(texcol_t));
          
          tcol->next = i + 1 < colcount ? tcol + 1 : NULL;
@@ -1009,8 +1075,39 @@ static void FinishTexture(texture_t *tex)
       }
    }
 
-   if(masked)
-      R_appendAlphaMask(tex);
+   return masked;
+}
+
+//
+// FinishTexture
+//
+// Called after R_CacheTexture is finished drawing a texture. This function
+// builds the columns (if needed) of a texture from the temporary mask buffer,
+// and the alpha mask if it has holes, then hands the buffer to the cache.
+//
+static void FinishTexture(texbuilder_t &tb)
+{
+   texture_t *tex = tb.tex;
+
+   if(tb.mask)
+   {
+      // Columns outlive the buffer; the alpha mask goes with it
+      bool masked = tex->columns ? true : R_buildColumns(tb);
+
+      if(masked)
+         R_appendAlphaMask(tb);
+   }
+
+   int size = tex->width * tex->height;
+
+   tex->cachesize = 8 + size + 4;
+   if(tex->flags & TF_MASKED)
+      tex->cachesize += (size + 7) / 8;
+   tex->cachestamp.store(texcacheclock, std::memory_order_relaxed);
+   texcachebytes += tex->cachesize;
+
+   // Publish the finished buffer
+   Z_ChangeUser(tex->bufferdata - 8, (void **)&tex->bufferalloc);
 }
 
 //
@@ -1030,54 +1127,209 @@ texture_t *R_CacheTexture(int num)
 
    tex = textures[num];
    if(tex->bufferalloc)
-      return tex;
-   
-   // SoM: This situation would most certainly require an abort.
-   if(tex->ccount == 0)
    {
-      I_Error("R_CacheTexture: texture %s cached with no buffer and no components.\n",
-              (const char *)(tex->name));
+      tex->cachestamp.store(texcacheclock, std::memory_order_relaxed);
+      return tex;
    }
 
+   // Only one thread may build a texture at a time; the one that waited may
+   // find it has been built for it in the meantime.
+   ZoneLockGuard lock;
+
+   if(tex->bufferalloc)
+      return tex;
+
    // This function has two primary branches:
    // 1. There is no buffer, and there are no columns which means the texture
    //    has never been built before and needs a full treatment
    // 2. There is no buffer, but there are columns which means that the buffer
-   //    (PU_CACHE) has been freed but the columns (PU_RENDERER) have not. 
-   //    This case means we only have to rebuilt the buffer.
+   //    has been evicted from the cache but the columns (PU_RENDERER) have
+   //    not. This case means we only have to rebuilt the buffer, and its
+   //    alpha mask if it has one.
 
    // Start the texture. Check the size of the mask buffer if needed.   
-   StartTexture(tex, tex->columns == NULL);
+   StartTexture(tempmask, tex);
    
    // Add the components to the buffer/mask
    for(i = 0; i < tex->ccount; i++)
    {
       tcomponent_t *component = tex->components + i;
-      
-      // SoM: Do NOT add lumps with a -1 lumpnum
-      if(component->lump == -1)
-         continue;
-         
-      switch(component->type)
-      {
-      case TC_FLAT:
-         AddTexFlat(tex, component);
-         break;
-      case TC_PATCH:
-         AddTexPatch(tex, component);
-         break;
-      default:
-         break;
-      }
+
+      R_drawComponent(tempmask, component, R_cacheComponent(component));
    }
 
    // Finish texture
-   FinishTexture(tex);
-   Z_ChangeTag(tex->bufferalloc, PU_CACHE);
+   FinishTexture(tempmask);
 
    return tex;
 }
 
+#define TEXBUILD_BATCH 64
+
+struct texbuildjob_t
+{
+   int              count;
+   std::atomic<int> next;
+};
+
+static texbuilder_t  texbuilders[TEXBUILD_BATCH];
+static ThreadPool   *texbuildpool;
+
+//
+// R_texBuildJob
+//
+// Thread job for R_CacheTextures. Draws the components of each texture of
+// the batch, taking them one at a time.
+//
+static void R_texBuildJob(int threadnum, void *data)
+{
+   texbuildjob_t *job = static_cast<texbuildjob_t *>(data);
+   int i;
+
+   while((i = job->next.fetch_add(1)) < job->count)
+   {
+      texbuilder_t &tb  = texbuilders[i];
+      texture_t    *tex = tb.tex;
+
+      for(int j = 0; j < tex->ccount; j++)
+         R_drawComponent(tb, tex->components + j, tb.sources[j]);
+   }
+}
+
+//
+// R_CacheTextures
+//
+// Builds a list of textures at once, during level precaching. Textures are
+// taken in batches: buffers are allocated and the graphics they need are
+// cached and held as static on this thread, the drawing itself is shared out
+// between threads, and the columns are built back on this thread.
+//
+void R_CacheTextures(const int *nums, int count)
+{
+   PODCollection<void *> held;
+   texbuildjob_t job;
+
+   if(!texbuildpool)
+   {
+      texbuildpool = new ThreadPool();
+      texbuildpool->resize(ThreadPool::HardwareThreads());
+   }
+
+   while(count > 0)
+   {
+      job.count = 0;
+      job.next  = 0;
+
+      for(; count > 0 && job.count < TEXBUILD_BATCH; ++nums, --count)
+      {
+         texture_t *tex = textures[*nums];
+
+         if(tex->bufferalloc)
+            continue;
+
+         texbuilder_t &tb = texbuilders[job.count++];
+
+         StartTexture(tb, tex);
+
+         tb.sources.makeEmpty();
+         for(int i = 0; i < tex->ccount; i++)
+         {
+            void *source = R_cacheComponent(tex->components + i);
+
+            // keep it from being purged to make room for the rest
+            if(source && Z_CheckTag(source) == PU_CACHE)
+            {
+               Z_ChangeTag(source, PU_STATIC);
+               held.add(source);
+            }
+            tb.sources.add(source);
+         }
+      }
+
+      if(job.count > 1)
+         texbuildpool->run(R_texBuildJob, &job);
+      else
+         R_texBuildJob(0, &job);
+
+      for(int i = 0; i < job.count; i++)
+         FinishTexture(texbuilders[i]);
+
+      for(void *source : held)
+         Z_ChangeTag(source, PU_CACHE);
+      held.makeEmpty();
+   }
+}
+
+//
+// R_evictTexture
+//
+// Frees the buffer of a texture held in the cache.
+//
+static void R_evictTexture(texture_t *tex)
+{
+   texcachebytes -= tex->cachesize;
+   tex->cachesize = 0;
+
+   Z_Free(tex->bufferalloc); // sets bufferalloc to null
+   tex->bufferdata = nullptr;
+}
+
+//
+// R_UpdateTextureCache
+//
+// Called before each view is rendered, while no render thread can be using a
+// texture. Once the cache has grown past r_texcachesize, textures not drawn
+// in the last view are evicted, oldest first, until it's back under 7/8 of
+// the limit, so that this isn't all done over again on the next view.
+//
+void R_UpdateTextureCache()
+{
+   const size_t budget = static_cast<size_t>(r_texcachesize) << 20;
+
+   ++texcacheclock;
+
+   if(texcachebytes <= budget)
+      return;
+
+   PODCollection<texture_t *> unused;
+
+   for(int i = 0; i < texturecount; i++)
+   {
+      texture_t *tex = textures[i];
+
+      if(tex->cachesize &&
+         texcacheclock - tex->cachestamp.load(std::memory_order_relaxed) > 1)
+         unused.add(tex);
+   }
+
+   std::sort(unused.begin(), unused.end(),
+             [](const texture_t *a, const texture_t *b) {
+                return texcacheclock - a->cachestamp.load(std::memory_order_relaxed) >
+                       texcacheclock - b->cachestamp.load(std::memory_order_relaxed);
+             });
+
+   for(texture_t *tex : unused)
+   {
+      if(texcachebytes <= budget - budget / 8)
+         break;
+      R_evictTexture(tex);
+   }
+}
+
+//
+// R_FlushTextureCache
+//
+// Frees every texture buffer held in the cache.
+//
+void R_FlushTextureCache()
+{
+   for(int i = 0; i < texturecount; i++)
+   {
+      if(textures[i]->cachesize)
+         R_evictTexture(textures[i]);
+   }
+}
+
 //
 // R_checkerBoardTexture
 //
@@ -1532,6 +1784,8 @@ byte *R_GetRawColumn(int tex, int32_t col)
    else
       col = (col & t->widthmask) * t->height;
 
+   t->cachestamp.store(texcacheclock, std::memory_order_relaxed);
+
    // Lee Killough, eat your heart out! ... well this isn't really THAT bad...
    return (t->flags & TF_SWIRLY) ?
           R_DistortedFlat(tex) + col :
@@ -1548,6 +1802,7 @@ texcol_t *R_GetMaskedColumn(int tex, int32_t col)
    
    if(!t->bufferalloc)
       R_CacheTexture(tex);
+   t->cachestamp.store(texcacheclock, std::memory_order_relaxed);
 
    // haleyjd 05/28/14: support non-power-of-two widths
    return t->columns[(t->flags & TF_WIDTHNP2) ? col % t->width : col & t->widthmask];
@@ -1562,6 +1817,7 @@ byte *R_GetLinearBuffer(int tex)
    
    if(!t->bufferalloc)
       R_CacheTexture(tex);
+   t->cachestamp.store(texcacheclock, std::memory_order_relaxed);
 
    return t->bufferdata;
 }
@@ -1828,5 +2084,27 @@ static int R_Doom1Texture(const char *name)
    return -1;
 }
 
+//=============================================================================
+//
+// Console Commands
+//
+
+VARIABLE_INT(r_texcachesize, NULL, 1, 4096, NULL);
+CONSOLE_VARIABLE(r_texcachesize, r_texcachesize, 0) {}
+
+CONSOLE_COMMAND(r_texcacheinfo, 0)
+{
+   int count = 0;
+
+   for(int i = 0; i < texturecount; i++)
+   {
+      if(textures[i]->cachesize)
+         ++count;
+   }
+
+   C_Printf("%d textures cached in %u KB of %d MB\n", count,
+            static_cast<unsigned int>(texcachebytes >> 10), r_texcachesize);
+}
+
 // EOF
 
@@ -35,6 +35,7 @@
 #include "m_argv.h"
 #include "m_bbox.h"
 #include "m_compare.h"
+#include "m_profile.h"
 #include "m_swap.h"
 #include "p_chase.h"
 #include "p_info.h"
@@ -46,6 +47,7 @@
 #include "p_skin.h"
 #include "p_user.h"
 #include "r_bsp.h"
+#include "r_context.h"
 #include "r_draw.h"
 #include "r_interpolate.h"
 #include "r_main.h"
@@ -118,9 +120,9 @@ int        inactiveParticles;
 particle_t *Particles;
 int        particle_trans;
 
-float *mfloorclip, *mceilingclip;
+thread_local float *mfloorclip, *mceilingclip;
 
-cb_maskedcolumn_t maskedcolumn;
+thread_local cb_maskedcolumn_t maskedcolumn;
 
 //=============================================================================
 //
@@ -186,10 +188,10 @@ struct drawsegs_xrange_t
 //
 
 // top and bottom of portal silhouette
-static float *portaltop;
-static float *portalbottom;
+static thread_local float *portaltop;
+static thread_local float *portalbottom;
 
-VALLOCATION(portaltop)
+VCTXALLOCATION(portaltop)
 {
    float *buf = emalloctag(float *, 2 * w * sizeof(*portaltop), PU_VALLOC, NULL);
 
@@ -200,21 +202,21 @@ VALLOCATION(portaltop)
    portalbottom = buf + w;
 }
 
-static float *ptop, *pbottom;
+static thread_local float *ptop, *pbottom;
 
 // haleyjd 04/25/10: drawsegs optimization
-static drawsegs_xrange_t *drawsegs_xrange;
-static unsigned int drawsegs_xrange_size = 0;
-static int drawsegs_xrange_count = 0;
+static thread_local drawsegs_xrange_t *drawsegs_xrange;
+static thread_local unsigned int drawsegs_xrange_size = 0;
+static thread_local int drawsegs_xrange_count = 0;
 
-static float *pscreenheightarray; // for psprites
+static thread_local float *pscreenheightarray; // for psprites
 
-VALLOCATION(pscreenheightarray)
+VCTXALLOCATION(pscreenheightarray)
 {
    pscreenheightarray = ecalloctag(float *, w, sizeof(float), PU_VALLOC, NULL);
 }
 
-static lighttable_t **spritelights; // killough 1/25/98 made static
+static thread_local lighttable_t **spritelights; // killough 1/25/98 made static
 
 static spriteframe_t sprtemp[MAX_SPRITE_FRAMES];
 static int maxframe;
@@ -222,19 +224,19 @@ static int maxframe;
 // Max number of particles
 static int numParticles;
 
-static vissprite_t *vissprites, **vissprite_ptrs;  // killough
-static size_t num_vissprite, num_vissprite_alloc, num_vissprite_ptrs;
+static thread_local vissprite_t *vissprites, **vissprite_ptrs;  // killough
+static thread_local size_t num_vissprite, num_vissprite_alloc, num_vissprite_ptrs;
 
 // SoM 12/13/03: the post-BSP stack
-static poststack_t   *pstack       = NULL;
-static int            pstacksize   = 0;
-static int            pstackmax    = 0;
-static maskedrange_t *unusedmasked = NULL;
+static thread_local poststack_t   *pstack       = NULL;
+static thread_local int            pstacksize   = 0;
+static thread_local int            pstackmax    = 0;
+static thread_local maskedrange_t *unusedmasked = NULL;
 
 // MaxW: 2018/07/01: Whether or not to draw psprites
 static bool r_drawplayersprites = true;
 
-VALLOCATION(pstack)
+VCTXALLOCATION(pstack)
 {
    if(pstack)
    {
@@ -269,10 +271,10 @@ VALLOCATION(pstack)
 }
 
 // haleyjd: made static global
-static float *clipbot;
-static float *cliptop;
+static thread_local float *clipbot;
+static thread_local float *cliptop;
 
-VALLOCATION(clipbot)
+VCTXALLOCATION(clipbot)
 {
    float *buffer = ecalloctag(float *, w*2, sizeof(float), PU_VALLOC, NULL);
    clipbot = buffer;
@@ -669,13 +671,17 @@ static void R_DrawMaskedColumn(column_t *tcolumn)
 //
 void R_DrawNewMaskedColumn(texture_t *tex, texcol_t *tcol)
 {
+   // Posts are copied here with their first and last pixels repeated at
+   // either end, for the column drawers' filtering. Other render contexts
+   // may be drawing from the same texture, so it can't be edited in place.
+   static thread_local byte *scratch;
+   static thread_local int   scratchsize;
+
    float y1, y2;
    fixed_t basetexturemid = column.texmid;
    
    column.texheight = 0; // killough 11/98
 
-   const byte *texend = tex->bufferdata + tex->width * tex->height + 1;
-
    while(tcol)
    {
       // calculate unclipped screen coordinates for post
@@ -688,27 +694,23 @@ void R_DrawNewMaskedColumn(texture_t *tex, texcol_t *tcol)
       // killough 3/2/98, 3/27/98: Failsafe against overflow/crash:
       if(column.y1 <= column.y2 && column.y2 < viewwindow.height)
       {
-         byte *localstart = tex->bufferdata + tcol->ptroff;
-         column.source = localstart;
-         column.texmid = basetexturemid - (tcol->yoff << FRACBITS);
+         const byte *localstart = tex->bufferdata + tcol->ptroff;
 
-         byte *last = localstart + tcol->len;
-         byte orig;
-         if(last < texend && last > tex->bufferdata)
+         if(tcol->len + 2 > scratchsize)
          {
-            orig = *last;
-            *last = last[-1];
+            scratchsize = tcol->len + 2;
+            scratch = erealloc(byte *, scratch, scratchsize);
          }
+         scratch[0] = localstart[0];
+         memcpy(scratch + 1, localstart, tcol->len);
+         scratch[tcol->len + 1] = localstart[tcol->len - 1];
 
-         byte origstart = localstart[-1];
-         localstart[-1] = *localstart;
+         column.source = scratch + 1;
+         column.texmid = basetexturemid - (tcol->yoff << FRACBITS);
 
          // Drawn by either R_DrawColumn
          //  or (SHADOW) R_DrawFuzzColumn.
          colfunc();
-         if(last < texend && last > tex->bufferdata)
-            *last = orig;
-         localstart[-1] = origstart;
       }
 
       tcol = tcol->next;
@@ -1021,12 +1023,13 @@ static void R_ProjectSprite(Mobj *thing, v3fixed_t *delta = nullptr,
    idist = 1.0f / roty;
    distxscale = idist * view.xfoc;
 
+   // off either side of this render context's slice?
    x1 = view.xcenter + (tx1 * distxscale);
-   if(x1 >= view.width)
+   if(x1 >= r_context->endcolumn + 1)
       return;
 
    x2 = view.xcenter + (tx2 * distxscale);
-   if(x2 < 0.0f)
+   if(x2 < r_context->startcolumn)
       return;
 
    intx1 = (int)(x1 + 0.999f);
@@ -1087,8 +1090,8 @@ static void R_ProjectSprite(Mobj *thing, v3fixed_t *delta = nullptr,
    vis->gzt    = gzt;                          // killough 3/27/98
 
    // Cardboard
-   vis->x1 = x1 < 0.0f ? 0 : intx1;
-   vis->x2 = x2 >= view.width ? viewwindow.width - 1 : intx2;
+   vis->x1 = x1 < r_context->startcolumn ? r_context->startcolumn : intx1;
+   vis->x2 = x2 > r_context->endcolumn ? r_context->endcolumn : intx2;
 
    vis->xstep = flip ? -(swidth * pstep) : swidth * pstep;
    vis->startx = flip ? swidth - 1.0f : 0.0f;
@@ -1176,11 +1179,15 @@ void R_AddSprites(sector_t* sec, int lightlevel)
    //  subsectors during BSP building.
    // Thus we check whether its already added.
 
-   if(sec->validcount == validcount)
+   // The mark is kept per render context, as other contexts may be adding
+   // the same sector's sprites to their own slices at the same time.
+   rcsectorstamp_t &stamp = r_context->sectorstamps[sec - sectors];
+
+   if(stamp.validcount == r_context->validcount)
       return;
    
    // Well, now it will be done.
-   sec->validcount = validcount;
+   stamp.validcount = r_context->validcount;
    
    lightnum = (lightlevel >> LIGHTSEGSHIFT)+(extralight * LIGHTBRIGHT);
    
@@ -1295,6 +1302,10 @@ static void R_DrawPSprite(const pspdef_t *psp)
       x1 = view.width - x2;
       x2 = view.width - tmpx;    // viewwindow.width-x1
    }
+
+   // outside this render context's slice?
+   if(x1 > r_context->endcolumn || x2 < r_context->startcolumn)
+      return;
    
    // store information in a vissprite
    vis = &avis;
@@ -1306,8 +1317,8 @@ static void R_DrawPSprite(const pspdef_t *psp)
    if(scaledwindow.height == SCREENHEIGHT)
       vis->texturemid -= viewplayer->readyweapon->fullscreenoffset;
 
-   vis->x1           = x1 < 0.0f ? 0 : (int)x1;
-   vis->x2           = x2 >= view.width ? viewwindow.width - 1 : (int)x2;
+   vis->x1           = x1 < r_context->startcolumn ? r_context->startcolumn : (int)x1;
+   vis->x2           = x2 > r_context->endcolumn ? r_context->endcolumn : (int)x2;
    vis->colour       = 0;      // sf: default colourmap
    vis->translucency = FRACUNIT - 1; // haleyjd: default zdoom trans.
    vis->tranmaplump  = -1;
@@ -1788,6 +1799,7 @@ static void R_DrawSpriteInDSRange(vissprite_t *spr, int firstds, int lastds)
 //
 void R_DrawPostBSP()
 {
+   PROFILE_ZONE(PROF_MASKED);
    maskedrange_t *masked;
    drawseg_t     *ds;
    int           firstds, lastds, firstsprite, lastsprite;
@@ -2255,8 +2267,8 @@ static void R_ProjectParticle(particle_t *particle)
 
    if(x2 < x1) x2 = x1;
    
-   // off either side?
-   if(x1 >= viewwindow.width || x2 < 0)
+   // off either side of this render context's slice?
+   if(x1 > r_context->endcolumn || x2 < r_context->startcolumn)
       return;
 
    tz = M_FixedToFloat(particle->z) - view.z;
@@ -2311,8 +2323,8 @@ static void R_ProjectParticle(particle_t *particle)
    vis->gz = particle->z;
    vis->gzt = gzt;
    vis->texturemid = vis->gzt - viewz;
-   vis->x1 = x1 < 0 ? 0 : x1;
-   vis->x2 = x2 >= viewwindow.width ? viewwindow.width-1 : x2;
+   vis->x1 = x1 < r_context->startcolumn ? r_context->startcolumn : x1;
+   vis->x2 = x2 > r_context->endcolumn ? r_context->endcolumn : x2;
    vis->colour = particle->color;
    vis->patch = -1;
    vis->translucency = static_cast<uint16_t>(particle->trans - 1);
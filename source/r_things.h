@@ -39,7 +39,7 @@ extern float *screenheightarray;
 
 // Vars for R_DrawMaskedColumn
 
-extern float *mfloorclip, *mceilingclip;
+extern thread_local float *mfloorclip, *mceilingclip;
 
 // SoM 12/13/03: the stack for use with portals
 struct maskedrange_t
@@ -84,7 +84,7 @@ typedef struct cb_maskedcolumn_s
    float scale;
 } cb_maskedcolumn_t;
 
-extern cb_maskedcolumn_t maskedcolumn;
+extern thread_local cb_maskedcolumn_t maskedcolumn;
 
 ///////////////////////////////////////////////////////////////////////////////
 //
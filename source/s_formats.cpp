@@ -49,7 +49,7 @@ struct sounddata_t
 {
    unsigned int    samplerate;
    size_t          samplecount;
-   byte           *samplestart;
+   const byte     *samplestart;
    sampleformat_e  fmt;
 };
 
@@ -74,11 +74,11 @@ struct sounddata_t
 // We'll consider the sample to be in canonical padded form if it passes the
 // 17th byte from the start test.
 //
-static bool S_checkDMXPadded(byte *data)
+static bool S_checkDMXPadded(const byte *data)
 {
-   byte  testarray[16];
-   byte *pcmstart = data + DMX_SOUNDHDRSIZE;
-   byte *fsample  = pcmstart + 16;
+   byte        testarray[16];
+   const byte *pcmstart = data + DMX_SOUNDHDRSIZE;
+   const byte *fsample  = pcmstart + 16;
 
    memset(testarray, *fsample, sizeof(testarray));
 
@@ -94,7 +94,7 @@ static bool S_checkDMXPadded(byte *data)
 // * Sanity check length and samplerate
 // * Account for possible presence of DMX's DMA alignment padding bytes
 //
-static bool S_isDMXSample(byte *data, size_t len, sounddata_t &sd)
+static bool S_isDMXSample(const byte *data, size_t len, sounddata_t &sd)
 {
    // must have a header
    if(len < DMX_SOUNDHDRSIZE)
@@ -104,7 +104,7 @@ static bool S_isDMXSample(byte *data, size_t len, sounddata_t &sd)
    if(data[0] != 0x03 || data[1] != 0x00)
       return false;
 
-   byte *r = data + 2;
+   const byte *r = data + 2;
    sd.samplerate  = GetBinaryUWord(&r);
    sd.samplecount = GetBinaryUDWord(&r);
 
@@ -149,7 +149,7 @@ static bool S_isDMXSample(byte *data, size_t len, sounddata_t &sd)
 // * Currently 8- or 16-bit mono PCM only.
 // * Samplerate and sample count are sanity-checked.
 //
-static bool S_isWaveSample(byte *data, size_t len, sounddata_t &sd)
+static bool S_isWaveSample(const byte *data, size_t len, sounddata_t &sd)
 {
    size_t minLength    = 44u; // current minimum required length
    int    factOffset   = 36;  // offset at which to check for a fact chunk
@@ -167,7 +167,7 @@ static bool S_isWaveSample(byte *data, size_t len, sounddata_t &sd)
       memcmp(data + 12, "fmt ", 4))   // no fmt information
       return false;
 
-   byte *r = data + 4;
+   const byte *r = data + 4;
    size_t chunksize = GetBinaryUDWord(&r);
    if(chunksize < len - 8) // need correct chunk size; will tolerate overage
       return false;
@@ -285,7 +285,7 @@ static bool S_isWaveSample(byte *data, size_t len, sounddata_t &sd)
 // the lump data into floating point PCM for playback. If false is returned,
 // the contents of sd are undefined, and the sound should not be played.
 //
-static bool S_detectSoundFormat(sounddata_t &sd, byte *data, size_t len)
+static bool S_detectSoundFormat(sounddata_t &sd, const byte *data, size_t len)
 {
    // Is it a DMX digital sample?
    if(S_isDMXSample(data, len, sd))
@@ -333,7 +333,7 @@ static void S_convertPCMU8(sfxinfo_t *sfx, const sounddata_t &sd)
    {
       unsigned int i;
       float *dest = static_cast<float *>(sfx->data);
-      byte  *src  = sd.samplestart;
+      const byte *src = sd.samplestart;
 
       unsigned int step = (sd.samplerate << 16) / TARGETSAMPLERATE;
       unsigned int stepremainder = 0, j = 0;
@@ -359,7 +359,7 @@ static void S_convertPCMU8(sfxinfo_t *sfx, const sounddata_t &sd)
    {
       // sound is already at target samplerate, just convert to doubles
       float *dest = static_cast<float *>(sfx->data);
-      byte  *src  = sd.samplestart;
+      const byte *src = sd.samplestart;
 
       for(unsigned int i = 0; i < sfx->alen; i++)
          dest[i] = static_cast<float>(eclamp(src[i] * 2.0 / 255.0 - 1.0, -1.0, 1.0));
@@ -382,7 +382,7 @@ static void S_convertPCM16(sfxinfo_t *sfx, const sounddata_t &sd)
    {
       unsigned int i;
       float   *dest = static_cast<float *>(sfx->data);
-      int16_t *src  = reinterpret_cast<int16_t *>(sd.samplestart);
+      const int16_t *src = reinterpret_cast<const int16_t *>(sd.samplestart);
 
       unsigned int step = (sd.samplerate << 16) / TARGETSAMPLERATE;
       unsigned int stepremainder = 0, j = 0;
@@ -412,7 +412,7 @@ static void S_convertPCM16(sfxinfo_t *sfx, const sounddata_t &sd)
    {
       // sound is already at target samplerate, just convert to doubles
       float   *dest = static_cast<float *>(sfx->data);
-      int16_t *src  = reinterpret_cast<int16_t *>(sd.samplestart);
+      const int16_t *src = reinterpret_cast<const int16_t *>(sd.samplestart);
 
       for(unsigned int i = 0; i < sfx->alen; i++)
       {
@@ -477,7 +477,12 @@ bool S_LoadDigitalSoundEffect(sfxinfo_t *sfx)
    if(!sfx->data)
    {
       edefstructvar(sounddata_t, sd);
-      byte *lumpdata = (byte *)wGlobalDir.cacheLumpNum(lump, PU_STATIC);
+      byte *cached = nullptr;
+
+      // use the lump in place if it is mapped, rather than caching a copy
+      const byte *lumpdata = static_cast<const byte *>(wGlobalDir.getLumpView(lump));
+      if(!lumpdata)
+         lumpdata = cached = (byte *)wGlobalDir.cacheLumpNum(lump, PU_STATIC);
 
       if(S_detectSoundFormat(sd, lumpdata, lumplen))
       {
@@ -497,7 +502,8 @@ bool S_LoadDigitalSoundEffect(sfxinfo_t *sfx)
       }
 
       // haleyjd 06/03/06: don't need original lump data any more if loaded
-      Z_ChangeTag(lumpdata, PU_CACHE);
+      if(cached)
+         Z_ChangeTag(cached, PU_CACHE);
    }
    else
    {
@@ -0,0 +1,472 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Software sound effect mixer, for sound drivers which are handed a
+//      buffer to fill from an audio thread.
+//
+//      The main thread never touches the voices being mixed. It queues
+//      commands to start, stop and adjust them, which the audio thread
+//      applies at the start of each buffer, and the audio thread reports
+//      back the voices which finished by storing their instance ids. Neither
+//      thread ever waits on the other.
+//
+//      Each voice is resampled a chunk at a time to the output rate, with
+//      the interpolation chosen by s_interpolation, and then added into the
+//      stereo mix four frames at a time. Voices playing at their own rate
+//      skip resampling and are mixed straight from the sound's data.
+//
+//-----------------------------------------------------------------------------
+
+#include <atomic>
+
+#include "z_zone.h"
+#include "c_runcmd.h"
+#include "m_compare.h"
+#include "m_spscqueue.h"
+#include "s_mixer.h"
+#include "s_sound.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define S_MIXER_SSE
+#include <emmintrin.h>
+#endif
+
+#define MIXER_QUEUESIZE 2048 // commands which can be waiting at once
+#define MIXER_CHUNK     256  // frames resampled at a time
+
+// Voice positions and steps are 32.32 fixed point
+#define MIXER_FRACBITS  32
+#define MIXER_UNITSTEP  (uint64_t(1) << MIXER_FRACBITS)
+
+int s_interpolation = S_INTERP_LINEAR;
+
+enum
+{
+   MC_START,
+   MC_PARAMS,
+   MC_STOP
+};
+
+struct mixcmd_t
+{
+   int          type;  // MC_*
+   int          voice;
+   unsigned int id;    // MC_START, MC_STOP
+   const float *data;  // MC_START
+   unsigned int len;   // MC_START
+   bool         loop;  // MC_START
+   bool         reverb;
+   float        leftvol, rightvol, step; // MC_PARAMS
+};
+
+// Owned by the audio thread
+struct mixvoice_t
+{
+   const float *data;
+   unsigned int len;
+   uint64_t     pos;  // in samples, 32.32
+   uint64_t     step; // per output frame, 32.32
+   float        leftvol, rightvol;
+   unsigned int id;
+   bool         loop;
+   bool         reverb;
+   bool         active;
+};
+
+// Owned by the main thread
+struct mixshadow_t
+{
+   unsigned int id;
+   bool         active;
+};
+
+static SPSCQueue<mixcmd_t, MIXER_QUEUESIZE> mixqueue;
+
+static mixvoice_t  mixvoices[MAXSNDCHANNELS];
+static mixshadow_t mixshadows[MAXSNDCHANNELS];
+
+// Instance id of the last sound to finish on each voice, from the audio thread
+static std::atomic<unsigned int> mixendedids[MAXSNDCHANNELS];
+
+//=============================================================================
+//
+// Main Thread
+//
+
+//
+// S_MixerInit
+//
+// Clears all voices. Must be called before the audio thread starts mixing.
+//
+void S_MixerInit()
+{
+   memset(mixvoices,  0, sizeof(mixvoices));
+   memset(mixshadows, 0, sizeof(mixshadows));
+
+   for(std::atomic<unsigned int> &id : mixendedids)
+      id = 0;
+}
+
+//
+// S_MixerStartVoice
+//
+// Starts a sound of len samples on a voice, under a unique instance id. It is
+// silent until S_MixerSetVoiceParams is called. Returns false if the command
+// queue is full.
+//
+bool S_MixerStartVoice(int voice, unsigned int id, const float *data,
+                       unsigned int len, bool loop, bool reverb)
+{
+   mixcmd_t cmd = {};
+
+   if(!len)
+      return false;
+
+   cmd.type   = MC_START;
+   cmd.voice  = voice;
+   cmd.id     = id;
+   cmd.data   = data;
+   cmd.len    = len;
+   cmd.loop   = loop;
+   cmd.reverb = reverb;
+
+   if(!mixqueue.push(cmd))
+      return false;
+
+   mixshadows[voice].id     = id;
+   mixshadows[voice].active = true;
+   return true;
+}
+
+//
+// S_MixerSetVoiceParams
+//
+// Sets the volume of each side of a voice, and its playback rate relative to
+// the output rate. Dropped if the queue is full, as a newer update will
+// follow soon enough.
+//
+void S_MixerSetVoiceParams(int voice, float leftvol, float rightvol, float step)
+{
+   mixcmd_t cmd = {};
+
+   cmd.type     = MC_PARAMS;
+   cmd.voice    = voice;
+   cmd.leftvol  = leftvol;
+   cmd.rightvol = rightvol;
+   cmd.step     = step;
+
+   mixqueue.push(cmd);
+}
+
+//
+// S_MixerStopVoice
+//
+// Stops a voice, if it is still playing the given instance.
+//
+void S_MixerStopVoice(int voice, unsigned int id)
+{
+   mixcmd_t cmd = {};
+
+   if(!mixshadows[voice].active || mixshadows[voice].id != id)
+      return;
+
+   cmd.type  = MC_STOP;
+   cmd.voice = voice;
+   cmd.id    = id;
+
+   // if the queue is full, the sound plays out instead
+   if(mixqueue.push(cmd))
+      mixshadows[voice].active = false;
+}
+
+//
+// S_MixerVoicePlaying
+//
+bool S_MixerVoicePlaying(int voice)
+{
+   const mixshadow_t &shadow = mixshadows[voice];
+
+   return shadow.active &&
+          mixendedids[voice].load(std::memory_order_acquire) != shadow.id;
+}
+
+//
+// S_MixerVoiceID
+//
+// Returns the instance id of the sound last started on a voice.
+//
+unsigned int S_MixerVoiceID(int voice)
+{
+   return mixshadows[voice].id;
+}
+
+//=============================================================================
+//
+// Audio Thread
+//
+
+//
+// S_mixerRunCommands
+//
+// Applies everything the main thread has queued since the last buffer.
+//
+static void S_mixerRunCommands()
+{
+   mixcmd_t cmd;
+
+   while(mixqueue.pop(cmd))
+   {
+      mixvoice_t &v = mixvoices[cmd.voice];
+
+      switch(cmd.type)
+      {
+      case MC_START:
+         v.data     = cmd.data;
+         v.len      = cmd.len;
+         v.pos      = 0;
+         v.step     = MIXER_UNITSTEP;
+         v.leftvol  = v.rightvol = 0.0f;
+         v.id       = cmd.id;
+         v.loop     = cmd.loop;
+         v.reverb   = cmd.reverb;
+         v.active   = true;
+         break;
+      case MC_PARAMS:
+         v.leftvol  = cmd.leftvol;
+         v.rightvol = cmd.rightvol;
+         v.step     = uint64_t(double(cmd.step) * MIXER_UNITSTEP);
+         if(!v.step)
+            v.step = 1;
+         break;
+      case MC_STOP:
+         if(v.active && v.id == cmd.id)
+         {
+            v.active = false;
+            mixendedids[cmd.voice].store(v.id, std::memory_order_release);
+         }
+         break;
+      }
+   }
+}
+
+//
+// S_mixerWrap
+//
+// Called when a voice has run past its end. Loops it back to the start if it
+// loops and looping is allowed, and returns true; otherwise it is finished.
+//
+static bool S_mixerWrap(mixvoice_t &v, bool allowloop)
+{
+   if(v.loop && allowloop)
+   {
+      v.pos %= uint64_t(v.len) << MIXER_FRACBITS;
+      return true;
+   }
+
+   v.active = false;
+   return false;
+}
+
+//
+// S_mixerResample
+//
+// Writes up to count samples of a voice at the output rate into out, and
+// returns how many were written; fewer if the voice finished.
+//
+template<int interp>
+static int S_mixerResample(mixvoice_t &v, float *out, int count, bool allowloop)
+{
+   const float   *d    = v.data;
+   const uint32_t last = v.len - 1;
+   int            i;
+
+   for(i = 0; i < count; i++)
+   {
+      uint32_t idx = uint32_t(v.pos >> MIXER_FRACBITS);
+
+      if(idx > last)
+      {
+         if(!S_mixerWrap(v, allowloop))
+            break;
+         idx = uint32_t(v.pos >> MIXER_FRACBITS);
+      }
+
+      float frac = float(uint32_t(v.pos)) * (1.0f / 4294967296.0f);
+
+      switch(interp)
+      {
+      case S_INTERP_NONE:
+         out[i] = d[idx];
+         break;
+      case S_INTERP_LINEAR:
+         {
+            float s0 = d[idx];
+            float s1 = d[idx < last ? idx + 1 : last];
+            out[i] = s0 + frac * (s1 - s0);
+         }
+         break;
+      case S_INTERP_CUBIC:
+         {
+            float p0 = d[idx ? idx - 1 : 0];
+            float p1 = d[idx];
+            float p2 = d[idx < last ? idx + 1 : last];
+            float p3 = d[idx + 1 < last ? idx + 2 : last];
+            out[i] = p1 + 0.5f * frac * (p2 - p0 + frac * (2.0f * p0 - 5.0f * p1 +
+                     4.0f * p2 - p3 + frac * (3.0f * (p1 - p2) + p3 - p0)));
+         }
+         break;
+      }
+
+      v.pos += v.step;
+   }
+
+   return i;
+}
+
+//
+// S_mixerAccumulate
+//
+// Adds count mono samples into an interleaved stereo buffer.
+//
+static void S_mixerAccumulate(float *out, const float *in, int count,
+                              float leftvol, float rightvol)
+{
+   int i = 0;
+
+#ifdef S_MIXER_SSE
+   const __m128 vol = _mm_setr_ps(leftvol, rightvol, leftvol, rightvol);
+
+   for(; i + 4 <= count; i += 4)
+   {
+      __m128 s  = _mm_loadu_ps(in + i);
+      __m128 lo = _mm_unpacklo_ps(s, s); // s0 s0 s1 s1
+      __m128 hi = _mm_unpackhi_ps(s, s); // s2 s2 s3 s3
+      float *o  = out + 2 * i;
+
+      _mm_storeu_ps(o,     _mm_add_ps(_mm_loadu_ps(o),     _mm_mul_ps(lo, vol)));
+      _mm_storeu_ps(o + 4, _mm_add_ps(_mm_loadu_ps(o + 4), _mm_mul_ps(hi, vol)));
+   }
+#endif
+
+   for(; i < count; i++)
+   {
+      out[2 * i    ] += in[i] * leftvol;
+      out[2 * i + 1] += in[i] * rightvol;
+   }
+}
+
+//
+// S_mixerVoice
+//
+// Adds frames of one voice into out.
+//
+static void S_mixerVoice(mixvoice_t &v, float *out, int frames, int interp,
+                         bool allowloop)
+{
+   float chunk[MIXER_CHUNK];
+   int   done = 0;
+
+   while(done < frames && v.active)
+   {
+      int count = emin(frames - done, MIXER_CHUNK);
+      int got;
+      const float *src;
+
+      if(v.step == MIXER_UNITSTEP && !uint32_t(v.pos))
+      {
+         // at its own rate and on a sample; no resampling needed
+         uint32_t idx = uint32_t(v.pos >> MIXER_FRACBITS);
+
+         if(idx >= v.len)
+         {
+            S_mixerWrap(v, allowloop);
+            continue;
+         }
+
+         got = static_cast<int>(emin<uint32_t>(count, v.len - idx));
+         src = v.data + idx;
+         v.pos += uint64_t(got) << MIXER_FRACBITS;
+      }
+      else
+      {
+         switch(interp)
+         {
+         case S_INTERP_NONE:
+            got = S_mixerResample<S_INTERP_NONE>(v, chunk, count, allowloop);
+            break;
+         case S_INTERP_CUBIC:
+            got = S_mixerResample<S_INTERP_CUBIC>(v, chunk, count, allowloop);
+            break;
+         default:
+            got = S_mixerResample<S_INTERP_LINEAR>(v, chunk, count, allowloop);
+            break;
+         }
+         src = chunk;
+      }
+
+      S_mixerAccumulate(out + 2 * done, src, got, v.leftvol, v.rightvol);
+      done += got;
+   }
+}
+
+//
+// S_MixerMix
+//
+// Adds frames of every playing voice into the interleaved stereo buffers;
+// into wet for voices affected by reverb, and dry for the rest. Looping
+// voices finish at their end unless allowloop is true.
+//
+void S_MixerMix(float *dry, float *wet, int frames, bool allowloop)
+{
+   int interp = s_interpolation;
+
+   S_mixerRunCommands();
+
+   for(int i = 0; i < MAXSNDCHANNELS; i++)
+   {
+      mixvoice_t &v = mixvoices[i];
+
+      if(!v.active)
+         continue;
+
+      S_mixerVoice(v, v.reverb ? wet : dry, frames, interp, allowloop);
+
+      if(!v.active)
+         mixendedids[i].store(v.id, std::memory_order_release);
+   }
+}
+
+//=============================================================================
+//
+// Console Variables
+//
+
+static const char *interpstr[S_INTERP_NUM] = { "none", "linear", "cubic" };
+
+VARIABLE_INT(s_interpolation, NULL, S_INTERP_NONE, S_INTERP_CUBIC, interpstr);
+CONSOLE_VARIABLE(s_interpolation, s_interpolation, 0) {}
+
+// EOF
+
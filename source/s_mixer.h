@@ -0,0 +1,59 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Software sound effect mixer
+//
+//-----------------------------------------------------------------------------
+
+#ifndef S_MIXER_H__
+#define S_MIXER_H__
+
+// Resampling modes for s_interpolation
+enum
+{
+   S_INTERP_NONE,   // nearest sample
+   S_INTERP_LINEAR,
+   S_INTERP_CUBIC,  // 4-point Catmull-Rom
+   S_INTERP_NUM
+};
+
+extern int s_interpolation;
+
+// Main thread
+void         S_MixerInit();
+bool         S_MixerStartVoice(int voice, unsigned int id, const float *data,
+                               unsigned int len, bool loop, bool reverb);
+void         S_MixerSetVoiceParams(int voice, float leftvol, float rightvol,
+                                   float step);
+void         S_MixerStopVoice(int voice, unsigned int id);
+bool         S_MixerVoicePlaying(int voice);
+unsigned int S_MixerVoiceID(int voice);
+
+// Audio thread
+void S_MixerMix(float *dry, float *wet, int frames, bool allowloop);
+
+#endif
+
+// EOF
+
@@ -26,14 +26,29 @@
 //  Freeverb algorithm implementation
 //  Based on original public domain implementation by Jezar at Dreampoint
 //
+//  Everything is done a chunk of frames at a time in float. The delay lines
+//  of the combs and allpasses are all longer than a chunk, so what a filter
+//  reads back during a chunk was written before it started; each filter can
+//  then be run over the whole chunk at once, four samples to a vector. The
+//  one recursive step, the damping lowpass of the combs, is unrolled four
+//  samples deep. Denormals are flushed by the FPU (see SoundDenormalGuard)
+//  rather than scrubbed out of each sample.
+//
 //-----------------------------------------------------------------------------
 
 #include "z_zone.h"
 
 #include "e_reverbs.h"
 #include "i_sound.h"
+#include "m_compare.h"
 #include "s_reverb.h"
 
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define S_REVERB_SSE
+#include <emmintrin.h>
+#endif
+
 //
 // Defines and constants
 //
@@ -83,162 +98,329 @@
 #define ALLPASSTUNINGL4 225
 #define ALLPASSTUNINGR4 225+STEREOSPREAD
 
+// Frames processed at a time; must be a multiple of four no longer than the
+// shortest delay line above
+#define REVERB_CHUNK 128
+
 //=============================================================================
 //
-// denorms
+// Denormals
 //
 
-static inline void undenormalize(double &d)
+#ifdef S_REVERB_SSE
+#define REVERB_FLUSHZERO 0x8000 // MXCSR flush-to-zero bit
+#endif
+
+SoundDenormalGuard::SoundDenormalGuard()
+{
+#ifdef S_REVERB_SSE
+   oldstate = _mm_getcsr();
+   _mm_setcsr(oldstate | REVERB_FLUSHZERO);
+#else
+   oldstate = 0;
+#endif
+}
+
+SoundDenormalGuard::~SoundDenormalGuard()
 {
-   static const double anti_denormal = 1e-18;
-   d += anti_denormal;
-   d -= anti_denormal;
+#ifdef S_REVERB_SSE
+   _mm_setcsr(oldstate);
+#endif
 }
 
 //=============================================================================
 //
-// delay
+// Block kernels
 //
 
-#define MAXDELAY 250u
-#define MAXSR    44100u
-
-static double delayBuffer[MAXDELAY*MAXSR/1000];
+//
+// S_addTo
+//
+// dest += src
+//
+static void S_addTo(float *dest, const float *src, int count)
+{
+   int i = 0;
 
-static size_t delaySize;
-static size_t readPos;
-static size_t writePos;
+#ifdef S_REVERB_SSE
+   for(; i + 4 <= count; i += 4)
+      _mm_storeu_ps(dest + i, _mm_add_ps(_mm_loadu_ps(dest + i), _mm_loadu_ps(src + i)));
+#endif
 
-static void delay_clearBuffer()
-{
-   for(size_t i = 0; i < delaySize; i++)
-      delayBuffer[i] = 0.0;
+   for(; i < count; i++)
+      dest[i] += src[i];
 }
 
-static void delay_set(size_t delayms, size_t sr = MAXSR)
+//
+// S_feedback
+//
+// dest = input + src * scale
+//
+static void S_feedback(float *dest, const float *input, const float *src,
+                       float scale, int count)
 {
-   if(delayms > MAXDELAY)
-      delayms = MAXDELAY;
-   if(sr > MAXSR)
-      sr = MAXSR;
-   size_t curDelaySize = delaySize;
-   delaySize = delayms * sr / 1000;
+   int i = 0;
 
-   if(delaySize != curDelaySize)
+#ifdef S_REVERB_SSE
+   const __m128 vscale = _mm_set1_ps(scale);
+
+   for(; i + 4 <= count; i += 4)
    {
-      readPos  = 0;
-      writePos = delaySize - 1;
-      delay_clearBuffer();
+      __m128 v = _mm_mul_ps(_mm_loadu_ps(src + i), vscale);
+      _mm_storeu_ps(dest + i, _mm_add_ps(_mm_loadu_ps(input + i), v));
    }
+#endif
+
+   for(; i < count; i++)
+      dest[i] = input[i] + src[i] * scale;
 }
 
-static void delay_writeSample(double sample)
+//
+// S_onePole
+//
+// One-pole lowpass: state = src * a + state * b for every sample, storing
+// each result to dest. The vector path works out four samples at once from
+// the state before them, so that only one multiply-add per four samples waits
+// on the last.
+//
+static void S_onePole(float *dest, const float *src, int count,
+                      float a, float b, float &state)
 {
-   delayBuffer[writePos] = sample;
-   if(++writePos >= delaySize)
-      writePos = 0;
+   int i = 0;
+
+#ifdef S_REVERB_SSE
+   const float b2 = b * b, b3 = b2 * b;
+
+   // column j scales sample j's contribution to each of the four outputs
+   const __m128 c0 = _mm_setr_ps(a, a * b, a * b2, a * b3);
+   const __m128 c1 = _mm_setr_ps(0, a, a * b, a * b2);
+   const __m128 c2 = _mm_setr_ps(0, 0, a, a * b);
+   const __m128 c3 = _mm_setr_ps(0, 0, 0, a);
+   const __m128 cs = _mm_setr_ps(b, b2, b3, b3 * b);
+
+   __m128 vstate = _mm_set1_ps(state);
+
+   for(; i + 4 <= count; i += 4)
+   {
+      __m128 x = _mm_loadu_ps(src + i);
+      __m128 y = _mm_mul_ps(vstate, cs);
+
+      y = _mm_add_ps(y, _mm_mul_ps(_mm_shuffle_ps(x, x, 0x00), c0));
+      y = _mm_add_ps(y, _mm_mul_ps(_mm_shuffle_ps(x, x, 0x55), c1));
+      y = _mm_add_ps(y, _mm_mul_ps(_mm_shuffle_ps(x, x, 0xAA), c2));
+      y = _mm_add_ps(y, _mm_mul_ps(_mm_shuffle_ps(x, x, 0xFF), c3));
+
+      _mm_storeu_ps(dest + i, y);
+      vstate = _mm_shuffle_ps(y, y, 0xFF);
+   }
+
+   state = _mm_cvtss_f32(vstate);
+#endif
+
+   for(; i < count; i++)
+      dest[i] = state = src[i] * a + state * b;
 }
 
-static double delay_readSample()
+//
+// S_allpassKernel
+//
+// Runs an allpass over io, given what its delay line held (tap); tap is left
+// holding what should be written back.
+//
+static void S_allpassKernel(float *io, float *tap, float feedback, int count)
 {
-   double ret = delayBuffer[readPos];
-   if(++readPos >= delaySize)
-      readPos = 0;
-   return ret;
+   int i = 0;
+
+#ifdef S_REVERB_SSE
+   const __m128 vfb = _mm_set1_ps(feedback);
+
+   for(; i + 4 <= count; i += 4)
+   {
+      __m128 in  = _mm_loadu_ps(io  + i);
+      __m128 out = _mm_loadu_ps(tap + i);
+
+      _mm_storeu_ps(tap + i, _mm_add_ps(in, _mm_mul_ps(out, vfb)));
+      _mm_storeu_ps(io  + i, _mm_sub_ps(out, in));
+   }
+#endif
+
+   for(; i < count; i++)
+   {
+      float in = io[i], out = tap[i];
+
+      tap[i] = in + out * feedback;
+      io[i]  = out - in;
+   }
 }
 
 //=============================================================================
 //
-// comb
+// Delay lines
 //
 
-class comb
+class delayline
 {
 public:
-   double  feedback;
-   double  filterstore;
-   double  damp1;
-   double  damp2;
-   double *buffer;
-   int     bufsize;
-   int     bufidx;
+   float *buffer;
+   int    bufsize;
+   int    bufidx;
 
-   void setbuffer(double *buf, int size)
+   void setbuffer(float *buf, int size)
    {
       buffer  = buf;
       bufsize = size;
+      bufidx  = 0;
    }
 
-   double process(double input)
+   //
+   // read
+   //
+   // Copies out the next count samples, without moving on.
+   //
+   void read(float *dest, int count) const
    {
-      double output;
-      
-      output = buffer[bufidx];
-      undenormalize(output);
+      int first = emin(count, bufsize - bufidx);
 
-      filterstore = (output * damp2) + (filterstore * damp1);
-      undenormalize(filterstore);
+      memcpy(dest, buffer + bufidx, first * sizeof(float));
+      memcpy(dest + first, buffer, (count - first) * sizeof(float));
+   }
 
-      buffer[bufidx] = input + (filterstore * feedback);
+   //
+   // write
+   //
+   // Overwrites the next count samples, and moves on past them.
+   //
+   void write(const float *src, int count)
+   {
+      int first = emin(count, bufsize - bufidx);
 
-      if(++bufidx >= bufsize)
-         bufidx = 0;
+      memcpy(buffer + bufidx, src, first * sizeof(float));
+      memcpy(buffer, src + first, (count - first) * sizeof(float));
 
-      return output;
+      if((bufidx += count) >= bufsize)
+         bufidx -= bufsize;
    }
 
    void mute()
    {
-      for(int i = 0; i < bufsize; i++)
-         buffer[i] = 0;
-   }
-
-   void setdamp(double val)
-   {
-      damp1 = val;
-      damp2 = 1 - val;
+      memset(buffer, 0, bufsize * sizeof(float));
    }
 };
 
 //=============================================================================
 //
-// allpass
+// delay
 //
 
-class allpass
+#define MAXDELAY 250u
+#define MAXSR    44100u
+
+// Room for a chunk beyond the longest delay, so that a chunk can be written
+// before any of it is read back
+#define DELAYBUFSIZE (MAXDELAY*MAXSR/1000 + REVERB_CHUNK)
+
+static float delayBuffer[DELAYBUFSIZE];
+
+static delayline delayIn;  // writes
+static delayline delayOut; // reads, trailing delaySize - 1 samples behind
+static size_t    delaySize;
+
+static void delay_clearBuffer()
 {
-public:
-   double  feedback;
-   double *buffer;
-   int     bufsize;
-   int     bufidx;
+   memset(delayBuffer, 0, sizeof(delayBuffer));
+}
 
-   void setbuffer(double *buf, int size)
+static void delay_set(size_t delayms, size_t sr = MAXSR)
+{
+   if(delayms > MAXDELAY)
+      delayms = MAXDELAY;
+   if(sr > MAXSR)
+      sr = MAXSR;
+   size_t curDelaySize = delaySize;
+   delaySize = delayms * sr / 1000;
+
+   if(delaySize != curDelaySize)
    {
-      buffer  = buf;
-      bufsize = size;
+      delayOut.setbuffer(delayBuffer, DELAYBUFSIZE);
+      delayIn.setbuffer(delayBuffer, DELAYBUFSIZE);
+      delayIn.bufidx = delaySize ? int(delaySize - 1) : 0;
+      delay_clearBuffer();
    }
+}
+
+//
+// delay_process
+//
+// Runs a chunk through the pre-delay in place.
+//
+static void delay_process(float *samples, int count)
+{
+   delayIn.write(samples, count);
+   delayOut.read(samples, count);
+   delayOut.bufidx = (delayOut.bufidx + count) % DELAYBUFSIZE;
+}
 
-   double process(double input)
+//=============================================================================
+//
+// comb
+//
+
+class comb : public delayline
+{
+public:
+   float feedback;
+   float filterstore;
+   float damp1;
+   float damp2;
+
+   //
+   // process
+   //
+   // Adds the comb's output for a chunk to output, feeding it input.
+   //
+   void process(const float *input, float *output, int count)
    {
-      double output, bufout;
+      float tap[REVERB_CHUNK];
+      float filtered[REVERB_CHUNK];
 
-      bufout = buffer[bufidx];
-      undenormalize(bufout);
+      read(tap, count);
+      S_addTo(output, tap, count);
 
-      output = -input + bufout;
-      buffer[bufidx] = input + (bufout * feedback);
+      S_onePole(filtered, tap, count, damp2, damp1, filterstore);
+      S_feedback(tap, input, filtered, feedback, count);
 
-      if(++bufidx >= bufsize)
-         bufidx = 0;
+      write(tap, count);
+   }
 
-      return output;
+   void setdamp(float val)
+   {
+      damp1 = val;
+      damp2 = 1 - val;
    }
+};
 
-   void mute()
+//=============================================================================
+//
+// allpass
+//
+
+class allpass : public delayline
+{
+public:
+   float feedback;
+
+   //
+   // process
+   //
+   // Runs a chunk through the allpass in place.
+   //
+   void process(float *io, int count)
    {
-      for(int i = 0; i < bufsize; i++)
-         buffer[i] = 0;
+      float tap[REVERB_CHUNK];
+
+      read(tap, count);
+      S_allpassKernel(io, tap, feedback, count);
+      write(tap, count);
    }
 };
 
@@ -246,6 +428,27 @@ public:
 //
 // Equalizer
 //
+// EQ.C - Main Source file for 3 band EQ
+// http://www.musicdsp.org/showone.php?id=236
+//
+// (c) Neil C / Etanza Systems / 2K6
+// Shouts / Loves / Moans = etanza at lycos dot co dot uk
+//
+// This work is hereby placed in the public domain for all purposes, including
+// use in commercial applications.
+// The author assumes NO RESPONSIBILITY for any problems caused by the use of
+// this software.
+//
+// Each band is a four-pole lowpass; the high band is what the high filter
+// leaves out of the signal delayed by three samples, and the mid band what
+// is left of that after the low band. Folding the gains in beforehand, a
+// frame comes out as
+//
+//    (lg - mg) * low + (mg - hg) * high + hg * delayed
+//
+// with low and high the last poles of the two filters. The low and high
+// filters of both channels run side by side, one to each vector lane.
+//
 
 #define SND_PI       3.14159265
 #define INITIALEQ    false
@@ -255,37 +458,6 @@ public:
 #define INITIALLF    250.0
 #define INITIALHF    4000.0
 
-struct EQSTATE
-{
-  // Filter #1 (Low band)
-
-  double  lf;       // Frequency
-  double  f1p0;     // Poles ...
-  double  f1p1;    
-  double  f1p2;
-  double  f1p3;
-
-  // Filter #2 (High band)
-
-  double  hf;       // Frequency
-  double  f2p0;     // Poles ...
-  double  f2p1;
-  double  f2p2;
-  double  f2p3;
-
-  // Sample history buffer
-
-  double  sdm1;     // Sample data minus 1
-  double  sdm2;     //                   2
-  double  sdm3;     //                   3
-
-  // Gain Controls
-
-  double  lg;       // low  gain
-  double  mg;       // mid  gain
-  double  hg;       // high gain
-};
-
 struct eqparams_t
 {
    double lowfreq;
@@ -295,64 +467,179 @@ struct eqparams_t
    double highgain;
 };
 
-static double do_3band(EQSTATE &es, double sample)
+//
+// SoundEqualizer::setup
+//
+// Sets the band crossover frequencies and gains, and clears the filters.
+//
+void SoundEqualizer::setup(double lf, double hf, double lg, double mg,
+                           double hg, double samplerate)
 {
-   static double vsa = (1.0 / 4294967295.0);
-   
-   // Locals
-   double l, m, h;    // Low / Mid / High - Sample Values
+   clear();
 
-   // Filter #1 (lowpass)
-   es.f1p0  += (es.lf * (sample  - es.f1p0)) + vsa;
-   es.f1p1  += (es.lf * (es.f1p0 - es.f1p1));
-   es.f1p2  += (es.lf * (es.f1p1 - es.f1p2));
-   es.f1p3  += (es.lf * (es.f1p2 - es.f1p3));
+   lowgain  = float(lg);
+   midgain  = float(mg);
+   highgain = float(hg);
 
-   l         = es.f1p3;
+   // Calculate filter cutoff frequencies
+   lowfreq  = float(2 * sin(SND_PI * (lf / samplerate)));
+   highfreq = float(2 * sin(SND_PI * (hf / samplerate)));
+}
 
-   // Filter #2 (highpass)
-   es.f2p0  += (es.hf * (sample  - es.f2p0)) + vsa;
-   es.f2p1  += (es.hf * (es.f2p0 - es.f2p1));
-   es.f2p2  += (es.hf * (es.f2p1 - es.f2p2));
-   es.f2p3  += (es.hf * (es.f2p2 - es.f2p3));
+//
+// SoundEqualizer::clear
+//
+void SoundEqualizer::clear()
+{
+   memset(poles,   0, sizeof(poles));
+   memset(history, 0, sizeof(history));
+}
 
-   h         = es.sdm3 - es.f2p3;
+//
+// SoundEqualizer::process
+//
+// Equalizes frames of interleaved stereo in place, scaling them by preamp
+// on the way in.
+//
+void SoundEqualizer::process(float *stream, int frames, float preamp)
+{
+   const float lowmul  = lowgain - midgain;
+   const float highmul = midgain - highgain;
+
+#ifdef S_REVERB_SSE
+   const __m128 coef  = _mm_setr_ps(lowfreq, lowfreq, highfreq, highfreq);
+   const __m128 gains = _mm_setr_ps(lowmul, lowmul, highmul, highmul);
+   const __m128 vhg   = _mm_set1_ps(highgain);
+   const __m128 vpre  = _mm_set1_ps(preamp);
+
+   __m128 p0 = _mm_loadu_ps(poles[0]);
+   __m128 p1 = _mm_loadu_ps(poles[1]);
+   __m128 p2 = _mm_loadu_ps(poles[2]);
+   __m128 p3 = _mm_loadu_ps(poles[3]);
+
+   // the history is kept in the low two lanes
+   __m128 h1 = _mm_castsi128_ps(_mm_loadl_epi64((const __m128i *)history[0]));
+   __m128 h2 = _mm_castsi128_ps(_mm_loadl_epi64((const __m128i *)history[1]));
+   __m128 h3 = _mm_castsi128_ps(_mm_loadl_epi64((const __m128i *)history[2]));
+
+   for(int i = 0; i < frames; i++, stream += 2)
+   {
+      // L R L R
+      __m128 in = _mm_castsi128_ps(_mm_loadl_epi64((const __m128i *)stream));
+      in = _mm_mul_ps(_mm_movelh_ps(in, in), vpre);
 
-   // Calculate midrange (signal - (low + high))
-   m         = es.sdm3 - (h + l); // haleyjd 07/05/10: which is right?
+      p0 = _mm_add_ps(p0, _mm_mul_ps(coef, _mm_sub_ps(in, p0)));
+      p1 = _mm_add_ps(p1, _mm_mul_ps(coef, _mm_sub_ps(p0, p1)));
+      p2 = _mm_add_ps(p2, _mm_mul_ps(coef, _mm_sub_ps(p1, p2)));
+      p3 = _mm_add_ps(p3, _mm_mul_ps(coef, _mm_sub_ps(p2, p3)));
 
-   // Scale, Combine and store
-   l        *= es.lg;
-   m        *= es.mg;
-   h        *= es.hg;
+      __m128 bands = _mm_mul_ps(p3, gains);
+      __m128 out   = _mm_add_ps(bands, _mm_movehl_ps(bands, bands));
+      out = _mm_add_ps(out, _mm_mul_ps(h3, vhg));
 
-   // Shuffle history buffer
-   es.sdm3   = es.sdm2;
-   es.sdm2   = es.sdm1;
-   es.sdm1   = sample;                
+      _mm_storel_epi64((__m128i *)stream, _mm_castps_si128(out));
 
-   return (l + m + h);
-}
+      h3 = h2;
+      h2 = h1;
+      h1 = in;
+   }
 
-static void init_3band(const eqparams_t &params, EQSTATE &eql, EQSTATE &eqr)
-{
-   // flush out state of equalizers
-   memset(&eql, 0, sizeof(eql));
-   memset(&eqr, 0, sizeof(eqr));
+   _mm_storeu_ps(poles[0], p0);
+   _mm_storeu_ps(poles[1], p1);
+   _mm_storeu_ps(poles[2], p2);
+   _mm_storeu_ps(poles[3], p3);
+   _mm_storel_epi64((__m128i *)history[0], _mm_castps_si128(h1));
+   _mm_storel_epi64((__m128i *)history[1], _mm_castps_si128(h2));
+   _mm_storel_epi64((__m128i *)history[2], _mm_castps_si128(h3));
+#else
+   // Without a way to have denormals flushed, this "very small addend" to the
+   // first poles keeps the filters out of them.
+   static const float vsa = 1.0f / 4294967295.0f;
+
+   const float coef[4]  = { lowfreq, lowfreq, highfreq, highfreq };
+
+   for(int i = 0; i < frames; i++, stream += 2)
+   {
+      float in[4];
 
-   // Set Low/Mid/High gains 
-   eql.lg = eqr.lg = params.lowgain;
-   eql.mg = eqr.mg = params.midgain;
-   eql.hg = eqr.hg = params.highgain;
+      in[0] = in[2] = stream[0] * preamp;
+      in[1] = in[3] = stream[1] * preamp;
 
-   // Calculate filter cutoff frequencies
-   eql.lf = eqr.lf = 2 * sin(SND_PI * (params.lowfreq  / (double)MAXSR));
-   eql.hf = eqr.hf = 2 * sin(SND_PI * (params.highfreq / (double)MAXSR));
+      for(int j = 0; j < 4; j++)
+      {
+         poles[0][j] += coef[j] * (in[j]       - poles[0][j]) + vsa;
+         poles[1][j] += coef[j] * (poles[0][j] - poles[1][j]);
+         poles[2][j] += coef[j] * (poles[1][j] - poles[2][j]);
+         poles[3][j] += coef[j] * (poles[2][j] - poles[3][j]);
+      }
+
+      for(int j = 0; j < 2; j++)
+      {
+         stream[j] = lowmul * poles[3][j] + highmul * poles[3][j + 2] +
+                     highgain * history[2][j];
+
+         history[2][j] = history[1][j];
+         history[1][j] = history[0][j];
+         history[0][j] = in[j];
+      }
+   }
+#endif
 }
 
-static void clear_3band(EQSTATE &eq)
+//
+// S_SoftClipToS16
+//
+// Converts float samples to 16-bit, rounding toward zero, with a rational
+// approximation of tanh for soft clipping:
+//
+// cschueler
+// http://www.musicdsp.org/showone.php?id=238
+//
+// Notes :
+// This is a rational function to approximate a tanh-like soft clipper. It is
+// based on the pade-approximation of the tanh function with tweaked
+// coefficients.
+// The function is in the range x=-3..3 and outputs the range y=-1..1. Beyond
+// this range the output must be clamped to -1..1.
+// The first two derivatives of the function vanish at -3 and 3, so the
+// transition to the hard clipped region is C2-continuous.
+//
+// The function is exactly +/-1 at +/-3, so clamping its input does the same
+// as clamping its output.
+//
+void S_SoftClipToS16(const float *src, int16_t *dest, int count)
 {
-   eq.sdm1 = eq.sdm2 = eq.sdm3 = 0.0;
+   int i = 0;
+
+#ifdef S_REVERB_SSE
+   const __m128 lo    = _mm_set1_ps(-3.0f);
+   const __m128 hi    = _mm_set1_ps(3.0f);
+   const __m128 k27   = _mm_set1_ps(27.0f);
+   const __m128 k9    = _mm_set1_ps(9.0f);
+   const __m128 scale = _mm_set1_ps(32767.0f);
+
+   for(; i + 8 <= count; i += 8)
+   {
+      __m128i out[2];
+
+      for(int j = 0; j < 2; j++)
+      {
+         __m128 x  = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 4*j), lo), hi);
+         __m128 x2 = _mm_mul_ps(x, x);
+         __m128 y  = _mm_div_ps(_mm_mul_ps(x, _mm_add_ps(k27, x2)),
+                                _mm_add_ps(k27, _mm_mul_ps(k9, x2)));
+         out[j] = _mm_cvttps_epi32(_mm_mul_ps(y, scale));
+      }
+
+      _mm_storeu_si128((__m128i *)(dest + i), _mm_packs_epi32(out[0], out[1]));
+   }
+#endif
+
+   for(; i < count; i++)
+   {
+      float x = eclamp(src[i], -3.0f, 3.0f);
+      dest[i] = int16_t(x * (27 + x * x) / (27 + 9 * x * x) * 32767.0f);
+   }
 }
 
 //=============================================================================
@@ -374,7 +661,7 @@ public:
    bool   doEQ;
 
    // equalizer
-   EQSTATE eql, eqr;
+   SoundEqualizer eq;
    eqparams_t eqparams;
 
    // comb filters
@@ -386,32 +673,32 @@ public:
    allpass allpassR[NUMALLPASSES];
 
    // Buffers for the combs
-   double bufcombL1[COMBTUNINGL1];
-   double bufcombR1[COMBTUNINGR1];
-   double bufcombL2[COMBTUNINGL2];
-   double bufcombR2[COMBTUNINGR2];
-   double bufcombL3[COMBTUNINGL3];
-   double bufcombR3[COMBTUNINGR3];
-   double bufcombL4[COMBTUNINGL4];
-   double bufcombR4[COMBTUNINGR4];
-   double bufcombL5[COMBTUNINGL5];
-   double bufcombR5[COMBTUNINGR5];
-   double bufcombL6[COMBTUNINGL6];
-   double bufcombR6[COMBTUNINGR6];
-   double bufcombL7[COMBTUNINGL7];
-   double bufcombR7[COMBTUNINGR7];
-   double bufcombL8[COMBTUNINGL8];
-   double bufcombR8[COMBTUNINGR8];
+   float bufcombL1[COMBTUNINGL1];
+   float bufcombR1[COMBTUNINGR1];
+   float bufcombL2[COMBTUNINGL2];
+   float bufcombR2[COMBTUNINGR2];
+   float bufcombL3[COMBTUNINGL3];
+   float bufcombR3[COMBTUNINGR3];
+   float bufcombL4[COMBTUNINGL4];
+   float bufcombR4[COMBTUNINGR4];
+   float bufcombL5[COMBTUNINGL5];
+   float bufcombR5[COMBTUNINGR5];
+   float bufcombL6[COMBTUNINGL6];
+   float bufcombR6[COMBTUNINGR6];
+   float bufcombL7[COMBTUNINGL7];
+   float bufcombR7[COMBTUNINGR7];
+   float bufcombL8[COMBTUNINGL8];
+   float bufcombR8[COMBTUNINGR8];
 
    // Buffers for the allpasses
-   double bufallpassL1[ALLPASSTUNINGL1];
-   double bufallpassR1[ALLPASSTUNINGR1];
-   double bufallpassL2[ALLPASSTUNINGL2];
-   double bufallpassR2[ALLPASSTUNINGR2];
-   double bufallpassL3[ALLPASSTUNINGL3];
-   double bufallpassR3[ALLPASSTUNINGR3];
-   double bufallpassL4[ALLPASSTUNINGL4];
-   double bufallpassR4[ALLPASSTUNINGR4];
+   float bufallpassL1[ALLPASSTUNINGL1];
+   float bufallpassR1[ALLPASSTUNINGR1];
+   float bufallpassL2[ALLPASSTUNINGL2];
+   float bufallpassR2[ALLPASSTUNINGR2];
+   float bufallpassL3[ALLPASSTUNINGL3];
+   float bufallpassR3[ALLPASSTUNINGR3];
+   float bufallpassL4[ALLPASSTUNINGL4];
+   float bufallpassR4[ALLPASSTUNINGR4];
 
    revmodel()
    {
@@ -440,16 +727,19 @@ public:
       allpassL[3].setbuffer(bufallpassL4, ALLPASSTUNINGL4);
       allpassR[3].setbuffer(bufallpassR4, ALLPASSTUNINGR4);
 
+      for(int i = 0; i < NUMCOMBS; i++)
+         combL[i].filterstore = combR[i].filterstore = 0.0f;
+
       // Set default values
-      allpassL[0].feedback = 0.5;
-      allpassR[0].feedback = 0.5;
-      allpassL[1].feedback = 0.5;
-      allpassR[1].feedback = 0.5;
-      allpassL[2].feedback = 0.5;
-      allpassR[2].feedback = 0.5;
-      allpassL[3].feedback = 0.5;
-      allpassR[3].feedback = 0.5;
-      
+      allpassL[0].feedback = 0.5f;
+      allpassR[0].feedback = 0.5f;
+      allpassL[1].feedback = 0.5f;
+      allpassR[1].feedback = 0.5f;
+      allpassL[2].feedback = 0.5f;
+      allpassR[2].feedback = 0.5f;
+      allpassL[3].feedback = 0.5f;
+      allpassR[3].feedback = 0.5f;
+
       // set initial parameters
       wet      = INITIALWET * SCALEWET;
       roomsize = (INITIALROOM * SCALEROOM) + OFFSETROOM;
@@ -493,109 +783,148 @@ public:
       }
 
       delay_clearBuffer();
-      clear_3band(eql);
-      clear_3band(eqr);
+      eq.clear();
    }
 
-   void processReplace(float *inputL, float *inputR, 
-                       float *outputL, float *outputR,
-                       int numsamples, int skip)
+   //
+   // mixDown
+   //
+   // Sums a chunk of the stereo stream to mono and scales it by the gain.
+   //
+   void mixDown(const float *stream, float *mono, int count)
    {
-      double outL, outR, input;
+      const float fgain = float(gain);
+      int i = 0;
+
+#ifdef S_REVERB_SSE
+      const __m128 vgain = _mm_set1_ps(fgain);
 
-      while(numsamples-- > 0)
+      for(; i + 4 <= count; i += 4)
       {
-         outL = outR = 0;
-         input = (*inputL + *inputR) * gain;
+         __m128 a = _mm_loadu_ps(stream + 2*i);
+         __m128 b = _mm_loadu_ps(stream + 2*i + 4);
+         __m128 l = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+         __m128 r = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
 
-         // pre-delay
-         if(delay)
-         {
-            delay_writeSample(input);
-            input = delay_readSample();
-         }
+         _mm_storeu_ps(mono + i, _mm_mul_ps(_mm_add_ps(l, r), vgain));
+      }
+#endif
 
-         // accumulate comb filters in parallel
-         for(int i = 0; i < NUMCOMBS; i++)
-         {
-            outL += combL[i].process(input);
-            outR += combR[i].process(input);
-         }
+      for(; i < count; i++)
+         mono[i] = (stream[2*i] + stream[2*i + 1]) * fgain;
+   }
 
-         // feed through allpasses in series
-         for(int i = 0; i < NUMALLPASSES; i++)
-         {
-            outL = allpassL[i].process(outL);
-            outR = allpassR[i].process(outR);
-         }
+   //
+   // interleave
+   //
+   static void interleave(const float *left, const float *right, float *dest,
+                          int count)
+   {
+      int i = 0;
 
-         // equalization pass
-         if(doEQ)
-         {
-            outL = do_3band(eql, outL);
-            outR = do_3band(eqr, outR);
-         }
+#ifdef S_REVERB_SSE
+      for(; i + 4 <= count; i += 4)
+      {
+         __m128 l = _mm_loadu_ps(left  + i);
+         __m128 r = _mm_loadu_ps(right + i);
 
-         // calculate output replacing anything already there
-         *outputL = (float)(outL * wet1 + outR * wet2 + *inputL * dry);
-         *outputR = (float)(outR * wet1 + outL * wet2 + *inputR * dry);
+         _mm_storeu_ps(dest + 2*i,     _mm_unpacklo_ps(l, r));
+         _mm_storeu_ps(dest + 2*i + 4, _mm_unpackhi_ps(l, r));
+      }
+#endif
 
-         // increment sample pointers
-         inputL  += skip;
-         inputR  += skip;
-         outputL += skip;
-         outputR += skip;
+      for(; i < count; i++)
+      {
+         dest[2*i]     = left[i];
+         dest[2*i + 1] = right[i];
       }
    }
 
-   void processMix(float *inputL, float *inputR, 
-                   float *outputL, float *outputR,
-                   int numsamples, int skip)
+   //
+   // output
+   //
+   // Combines a chunk of the reverb's stereo output with the dry stream,
+   // either replacing the stream or mixing into it.
+   //
+   void output(const float *wetbuf, float *stream, int count, bool replace)
    {
-      double outL, outR, input;
+      const float fwet1 = float(wet1), fwet2 = float(wet2), fdry = float(dry);
+      int i = 0;
+
+      count *= 2;
+
+#ifdef S_REVERB_SSE
+      const __m128 vwet1 = _mm_set1_ps(fwet1);
+      const __m128 vwet2 = _mm_set1_ps(fwet2);
+      const __m128 vdry  = _mm_set1_ps(fdry);
 
-      while(numsamples-- > 0)
+      for(; i + 4 <= count; i += 4)
       {
-         outL = outR = 0;
-         input = (*inputL + *inputR) * gain;
+         __m128 w  = _mm_loadu_ps(wetbuf + i);
+         __m128 ws = _mm_shuffle_ps(w, w, _MM_SHUFFLE(2, 3, 0, 1)); // channels swapped
+         __m128 s  = _mm_loadu_ps(stream + i);
+         __m128 v  = _mm_add_ps(_mm_mul_ps(w, vwet1), _mm_mul_ps(ws, vwet2));
+
+         v = _mm_add_ps(v, _mm_mul_ps(s, vdry));
+         _mm_storeu_ps(stream + i, replace ? v : _mm_add_ps(s, v));
+      }
+#endif
+
+      for(; i < count; i++)
+      {
+         float v = wetbuf[i] * fwet1 + wetbuf[i ^ 1] * fwet2 + stream[i] * fdry;
+         stream[i] = replace ? v : stream[i] + v;
+      }
+   }
+
+   //
+   // process
+   //
+   // Runs frames of an interleaved stereo stream through the reverb.
+   //
+   void process(float *stream, int numsamples, bool replace)
+   {
+      float input[REVERB_CHUNK];
+      float outL[REVERB_CHUNK];
+      float outR[REVERB_CHUNK];
+      float wetbuf[REVERB_CHUNK * 2];
+
+      while(numsamples > 0)
+      {
+         int count = emin(numsamples, REVERB_CHUNK);
+
+         mixDown(stream, input, count);
 
          // pre-delay
          if(delay)
-         {
-            delay_writeSample(input);
-            input = delay_readSample();
-         }
+            delay_process(input, count);
 
          // accumulate comb filters in parallel
+         memset(outL, 0, count * sizeof(float));
+         memset(outR, 0, count * sizeof(float));
          for(int i = 0; i < NUMCOMBS; i++)
          {
-            outL += combL[i].process(input);
-            outR += combR[i].process(input);
+            combL[i].process(input, outL, count);
+            combR[i].process(input, outR, count);
          }
 
          // feed through allpasses in series
          for(int i = 0; i < NUMALLPASSES; i++)
          {
-            outL = allpassL[i].process(outL);
-            outR = allpassR[i].process(outR);
+            allpassL[i].process(outL, count);
+            allpassR[i].process(outR, count);
          }
 
+         interleave(outL, outR, wetbuf, count);
+
          // equalization pass
          if(doEQ)
-         {
-            outL = do_3band(eql, outL);
-            outR = do_3band(eqr, outR);
-         }
+            eq.process(wetbuf, count);
 
-         // calculate output mixing with anything already there
-         *outputL += (float)(outL * wet1 + outR * wet2 + *inputL * dry);
-         *outputR += (float)(outR * wet1 + outL * wet2 + *inputR * dry);
+         output(wetbuf, stream, count, replace);
 
-         // increment sample pointers
-         inputL  += skip;
-         inputR  += skip;
-         outputL += skip;
-         outputR += skip;
+         stream     += 2 * count;
+         numsamples -= count;
       }
    }
 
@@ -619,13 +948,14 @@ public:
 
       for(int i = 0; i < NUMCOMBS; i++)
       {
-         combL[i].feedback = roomsize1;
-         combL[i].setdamp(damp1);
-         combR[i].feedback = roomsize1;
-         combR[i].setdamp(damp1);
+         combL[i].feedback = float(roomsize1);
+         combL[i].setdamp(float(damp1));
+         combR[i].feedback = float(roomsize1);
+         combR[i].setdamp(float(damp1));
       }
 
-      init_3band(eqparams, eql, eqr);
+      eq.setup(eqparams.lowfreq, eqparams.highfreq, eqparams.lowgain,
+               eqparams.midgain, eqparams.highgain, MAXSR);
    }
 
    void setRoomSize(double value)
@@ -735,7 +1065,7 @@ void S_ReverbSetState(ereverb_t *ereverb)
 //
 void S_ProcessReverb(float *stream, int samples)
 {
-   reverb.processMix(stream, stream+1, stream, stream+1, samples, 2);
+   reverb.process(stream, samples, false);
 }
 
 //
@@ -745,7 +1075,7 @@ void S_ProcessReverb(float *stream, int samples)
 //
 void S_ProcessReverbReplace(float *stream, int samples)
 {
-   reverb.processReplace(stream, stream+1, stream, stream+1, samples, 2);
+   reverb.process(stream, samples, true);
 }
 
 // EOF
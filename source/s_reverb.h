@@ -26,6 +26,10 @@
 //  Freeverb algorithm implementation
 //  Based on original public domain implementation by Jezar at Dreampoint
 //
+//  Also home to the three-band equalizer and the float-to-16-bit output
+//  stage shared with the sound drivers. All of it works on whole buffers of
+//  interleaved stereo float samples.
+//
 //-----------------------------------------------------------------------------
 
 #ifndef S_REVERB_H__
@@ -33,6 +37,51 @@
 
 struct ereverb_t;
 
+//
+// SoundEqualizer
+//
+// Three-band equalizer for interleaved stereo float samples, keeping
+// separate filter state for each channel.
+//
+class SoundEqualizer
+{
+public:
+   // Each of the four filter poles, for the low band of the left and right
+   // channels and then the high band of each
+   float poles[4][4];
+
+   float history[3][2]; // last three input frames, newest first
+   float lowfreq;       // filter coefficients
+   float highfreq;
+   float lowgain;
+   float midgain;
+   float highgain;
+
+   void setup(double lf, double hf, double lg, double mg, double hg,
+              double samplerate);
+   void clear();
+   void process(float *stream, int frames, float preamp = 1.0f);
+};
+
+//
+// SoundDenormalGuard
+//
+// Makes the FPU flush denormals to zero for as long as it is in scope. The
+// audio callback keeps one around while it processes a buffer, so that the
+// filters don't have to scrub their state sample by sample.
+//
+class SoundDenormalGuard
+{
+protected:
+   unsigned int oldstate;
+
+public:
+   SoundDenormalGuard();
+   ~SoundDenormalGuard();
+};
+
+void S_SoftClipToS16(const float *src, int16_t *dest, int count);
+
 void S_SuspendReverb();
 void S_ResumeReverb();
 void S_ReverbSetState(ereverb_t *ereverb);
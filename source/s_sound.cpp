@@ -40,6 +40,7 @@
 #include "i_sound.h"
 #include "i_system.h"
 #include "m_compare.h"
+#include "m_profile.h"
 #include "m_random.h"
 #include "m_queue.h"
 #include "p_chase.h"
@@ -904,6 +905,7 @@ static void S_updateEnvironment(sector_t *earsec)
 //
 void S_UpdateSounds(const Mobj *listener)
 {
+   PROFILE_ZONE(PROF_SOUND);
    // sf: a camera_t holding the information about the player
    camera_t playercam = { 0 };
    sector_t *earsec = NULL;
@@ -1577,7 +1579,7 @@ musicinfo_t *S_MusicForName(const char *name)
 
 VARIABLE_BOOLEAN(s_precache,      NULL, onoff);
 VARIABLE_BOOLEAN(pitched_sounds,  NULL, onoff);
-VARIABLE_INT(default_numChannels, NULL, 1, 32,  NULL);
+VARIABLE_INT(default_numChannels, NULL, 1, MAXSNDCHANNELS, NULL);
 VARIABLE_INT(snd_SfxVolume,       NULL, 0, 15,  NULL);
 VARIABLE_INT(snd_MusicVolume,     NULL, 0, 15,  NULL);
 VARIABLE_BOOLEAN(forceFlipPan,    NULL, onoff);
@@ -151,6 +151,8 @@ bool S_CheckSoundPlaying(const PointThinker *, sfxinfo_t *aliasinfo);
 extern int s_precache;
 
 // machine-independent sound params
+#define MAXSNDCHANNELS 256 // most sounds that can ever be played at once
+
 extern int numChannels;
 extern int default_numChannels;  // killough 10/98
 
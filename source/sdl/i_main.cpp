@@ -79,9 +79,11 @@ int main(int argc, char **argv)
    // haleyjd 04/15/02: added check for failure
    // ioanch: avoid loading SDL_VIDEO if -nodraw and -nosound are combined.
    // FIXME: code duplication; the global booleans aren't assigned yet.
-   Uint32 initflags = (M_CheckParm("-nodraw") &&
-                       (M_CheckParm("-nosound") || (M_CheckParm("-nosfx") &&
-                                                    M_CheckParm("-nomusic")))) ?
+   // -headless renders offscreen, so it never needs video either.
+   Uint32 initflags = (M_CheckParm("-headless") ||
+                       (M_CheckParm("-nodraw") &&
+                        (M_CheckParm("-nosound") || (M_CheckParm("-nosfx") &&
+                                                     M_CheckParm("-nomusic"))))) ?
    SDL_INIT_JOYSTICK : SDL_INIT_VIDEO | SDL_INIT_JOYSTICK;
    if(SDL_Init(initflags) == -1)
    {
@@ -21,7 +21,6 @@
 
 #include "SDL.h"
 #include "SDL_audio.h"
-#include "SDL_thread.h"
 #include "SDL_mixer.h"
 
 #include "../z_zone.h"
@@ -38,17 +37,15 @@
 #include "../m_argv.h"
 #include "../m_compare.h"
 #include "../mn_engin.h"
-#include "../s_reverb.h"
 #include "../s_formats.h"
+#include "../s_mixer.h"
+#include "../s_reverb.h"
 #include "../s_sound.h"
 #include "../v_misc.h"
 #include "../w_wad.h"
 
 extern bool snd_init;
 
-// Needed for calling the actual sound output.
-#define MAX_CHANNELS 32
-
 int audio_buffers;
 
 // haleyjd 12/18/13: size at which mix buffers must be allocated
@@ -61,43 +58,9 @@ static float *mixbuffer[2];
 // haleyjd 10/28/05: updated for Julian's music code, need full quality now
 static const int snd_samplerate = 44100;
 
-typedef struct channel_info_s
-{
-  // SFX id of the playing sound effect.
-  // Used to catch duplicates (like chainsaw).
-  sfxinfo_t *id;
-  // The channel step amount...
-  unsigned int step;
-  // ... and a 0.16 bit remainder of last step.
-  unsigned int stepremainder;
-  unsigned int samplerate;
-  // The channel data pointers, start and end.
-  float *data;
-  float *startdata; // haleyjd
-  float *enddata;
-  // Hardware left and right channel volume lookup.
-  float  leftvol, rightvol;
-  // haleyjd 06/03/06: looping
-  int loop;
-  // unique instance id
-  unsigned int idnum;
-  // if true, channel is affected by reverb
-  bool reverb;
-
-  // haleyjd 10/02/08: SDL semaphore to protect channel
-  SDL_sem *semaphore;
-  bool shouldstop; // haleyjd 05/16/11
-
-} channel_info_t;
-
-static channel_info_t channelinfo[MAX_CHANNELS+1];
-
-// Pitch to stepping lookup, unused.
+// Pitch to stepping lookup
 static int steptable[256];
 
-// Volume lookups.
-//static int vol_lookup[128*256];
-
 //
 // addsfx
 //
@@ -113,7 +76,7 @@ static int steptable[256];
 static bool addsfx(sfxinfo_t *sfx, int channel, int loop, unsigned int id, bool reverb)
 {
 #ifdef RANGECHECK
-   if(channel < 0 || channel >= MAX_CHANNELS)
+   if(channel < 0 || channel >= MAXSNDCHANNELS)
       I_Error("addsfx: channel out of range!\n");
 #endif
 
@@ -125,40 +88,9 @@ static bool addsfx(sfxinfo_t *sfx, int channel, int loop, unsigned int id, bool
    if(!S_LoadDigitalSoundEffect(sfx))
       return false;
 
-   // haleyjd 10/02/08: critical section
-   if(SDL_SemWait(channelinfo[channel].semaphore) == 0)
-   {
-      channelinfo[channel].data = (float *)sfx->data;
-      
-      // Set pointer to end of raw data.
-      channelinfo[channel].enddata = (float *)sfx->data + sfx->alen - 1;
-      
-      // haleyjd 06/03/06: keep track of start of sound
-      channelinfo[channel].startdata = channelinfo[channel].data;
-      
-      channelinfo[channel].stepremainder = 0;
-      
-      // Preserve sound SFX id
-      channelinfo[channel].id = sfx;
-      
-      // Set looping
-      channelinfo[channel].loop = loop;
-
-      // Set reverb
-      channelinfo[channel].reverb = reverb;
-      
-      // Set instance ID
-      channelinfo[channel].idnum = id;
-
-      // Shouldn't be stopped - haleyjd 05/16/11
-      channelinfo[channel].shouldstop = false;
-
-      SDL_SemPost(channelinfo[channel].semaphore);
-
-      return true;
-   }
-   else
-      return false; // acquisition failed
+   // handed over to the mixer, which fails only if its queue is full
+   return S_MixerStartVoice(channel, id, static_cast<const float *>(sfx->data),
+                            sfx->alen, !!loop, reverb);
 }
 
 //
@@ -172,13 +104,13 @@ static void updateSoundParams(int handle, int volume, int separation, int pitch)
    int slot = handle;
    int rightvol;
    int leftvol;
-   int step = steptable[pitch];
+   float step;
    
    if(!snd_init)
       return;
 
 #ifdef RANGECHECK
-   if(handle < 0 || handle >= MAX_CHANNELS)
+   if(handle < 0 || handle >= MAXSNDCHANNELS)
       I_Error("I_UpdateSoundParams: handle out of range\n");
 #endif
    
@@ -198,162 +130,33 @@ static void updateSoundParams(int handle, int volume, int separation, int pitch)
    separation = separation - 257;
    rightvol   = volume - ((volume*separation*separation) >> 16);  
 
-   // volume levels are softened slightly by dividing by 191 rather than ideal 127
-   channelinfo[slot].leftvol  = (float)(eclamp((double)leftvol  / 191.0, 0.0, 1.0));
-   channelinfo[slot].rightvol = (float)(eclamp((double)rightvol / 191.0, 0.0, 1.0));
-
-   // haleyjd 06/07/09: critical section is not needed here because this data
-   // can be out of sync without affecting the sound update loop. This may cause
-   // momentary out-of-sync volume between the left and right sound channels, but
-   // the impact would be practically unnoticeable.
-
    // Set stepping
    // MWM 2000-12-24: Calculates proportion of channel samplerate
    // to global samplerate for mixing purposes.
    // Patched to shift left *then* divide, to minimize roundoff errors
    // as well as to use SAMPLERATE as defined above, not to assume 11025 Hz
    if(pitched_sounds)
-      channelinfo[slot].step = step;
+      step = (float)steptable[pitch] / FPFRACUNIT;
    else
-      channelinfo[slot].step = 1 << 16;   
+      step = 1.0f;
+
+   // volume levels are softened slightly by dividing by 191 rather than ideal 127
+   S_MixerSetVoiceParams(slot,
+                         (float)(eclamp((double)leftvol  / 191.0, 0.0, 1.0)),
+                         (float)(eclamp((double)rightvol / 191.0, 0.0, 1.0)),
+                         step);
 }
 
 //=============================================================================
 //
 // Three-Band Equalization
 //
-
-static double preampmul;
-
-struct EQSTATE
-{
-  // Filter #1 (Low band)
-
-  double  lf;       // Frequency
-  double  f1p0;     // Poles ...
-  double  f1p1;    
-  double  f1p2;
-  double  f1p3;
-
-  // Filter #2 (High band)
-
-  double  hf;       // Frequency
-  double  f2p0;     // Poles ...
-  double  f2p1;
-  double  f2p2;
-  double  f2p3;
-
-  // Sample history buffer
-
-  double  sdm1;     // Sample data minus 1
-  double  sdm2;     //                   2
-  double  sdm3;     //                   3
-
-  // Gain Controls
-
-  double  lg;       // low  gain
-  double  mg;       // mid  gain
-  double  hg;       // high gain
-  
-};  
-
-// haleyjd 04/21/10: equalizers for each stereo channel
-static EQSTATE eqstate[2];
-
-//
-// rational_tanh
-//
-// cschueler
-// http://www.musicdsp.org/showone.php?id=238
-//
-// Notes :
-// This is a rational function to approximate a tanh-like soft clipper. It is
-// based on the pade-approximation of the tanh function with tweaked 
-// coefficients.
-// The function is in the range x=-3..3 and outputs the range y=-1..1. Beyond
-// this range the output must be clamped to -1..1.
-// The first two derivatives of the function vanish at -3 and 3, so the 
-// transition to the hard clipped region is C2-continuous.
-//
-static double rational_tanh(double x)
-{
-   if(x < -3)
-      return -1;
-   else if(x > 3)
-      return 1;
-   else
-      return x * ( 27 + x * x ) / ( 27 + 9 * x * x );
-}
-
-//
-// do_3band
-//
-// EQ.C - Main Source file for 3 band EQ
-// http://www.musicdsp.org/showone.php?id=236
+// The equalizer itself is in s_reverb.cpp, shared with the reverb's.
 //
-// (c) Neil C / Etanza Systems / 2K6
-// Shouts / Loves / Moans = etanza at lycos dot co dot uk
-//
-// This work is hereby placed in the public domain for all purposes, including
-// use in commercial applications.
-// The author assumes NO RESPONSIBILITY for any problems caused by the use of
-// this software.
-//
-// haleyjd 12/19/13: rewritten to loop over the sample buffer and do output
-// directly back to the SDL audio stream.
-//
-static void do_3band(float *stream, float *end, Sint16 *dest)
-{
-   int esnum = 0;
-
-   // haleyjd: This "very small addend" is supposed to take care of P4
-   // denormalization problems. Do we actually need it?
-   static double vsa = (1.0 / 4294967295.0);
-   // Locals
-   double sample, l, m, h;    // Low / Mid / High - Sample Values
-
-   while(stream != end)
-   {
-      auto es = &eqstate[esnum];
-      esnum ^= 1; // haleyjd: toggle between equalizer channels
-
-      sample = *stream++ * preampmul;
-
-      // Filter #1 (lowpass)
-      es->f1p0  += (es->lf * (sample   - es->f1p0)) + vsa;
-      es->f1p1  += (es->lf * (es->f1p0 - es->f1p1));
-      es->f1p2  += (es->lf * (es->f1p1 - es->f1p2));
-      es->f1p3  += (es->lf * (es->f1p2 - es->f1p3));
-
-      l          = es->f1p3;
 
-      // Filter #2 (highpass)
-      es->f2p0  += (es->hf * (sample   - es->f2p0)) + vsa;
-      es->f2p1  += (es->hf * (es->f2p0 - es->f2p1));
-      es->f2p2  += (es->hf * (es->f2p1 - es->f2p2));
-      es->f2p3  += (es->hf * (es->f2p2 - es->f2p3));
-
-      h          = es->sdm3 - es->f2p3;
-
-      // Calculate midrange (signal - (low + high))
-      m          = es->sdm3 - (h + l); // haleyjd 07/05/10: which is right?
-      //m          = sample - (h + l); // the one above seems more correct to me.
-
-      // Scale, Combine and store
-      l         *= es->lg;
-      m         *= es->mg;
-      h         *= es->hg;
-
-      // Shuffle history buffer
-      es->sdm3   = es->sdm2;
-      es->sdm2   = es->sdm1;
-      es->sdm1   = sample;                
-
-      // Return result
-      // haleyjd: use rational_tanh for soft clipping
-      *dest++ = (Sint16)(rational_tanh(l + m + h) * 32767.0);
-   }
-}
+// haleyjd 04/21/10: equalizers for each stereo channel
+static SoundEqualizer equalizer;
+static float          preampmul;
 
 //
 // End Equalizer Code
@@ -422,92 +225,22 @@ static inline void I_SDLMixBuffers()
 // I_SDLUpdateSoundCB
 //
 // SDL_mixer postmix callback routine. Possibly dispatched asynchronously.
-// We do our own mixing on up to 32 digital sound channels.
+// We do our own mixing of the digital sound channels (see s_mixer.cpp).
 //
 static void I_SDLUpdateSoundCB(void *userdata, Uint8 *stream, int len)
 {
+   SoundDenormalGuard denormalguard;
+
    // convert input samples to floating point
    I_SDLConvertSoundBuffer(stream, len);
 
-   float *leftout;
-   // Pointer to end of mixbuffer
-   float *leftend0 = mixbuffer[0] + (len/SAMPLESIZE);
-   float *leftend1 = mixbuffer[1] + (len/SAMPLESIZE);
-   float *leftend;
+   // haleyjd 06/03/06: looping samples only restart if not paused
+   bool allowloop = !paused &&
+      ((!menuactive && !consoleactive) || demoplayback || netgame);
 
-   // Mix audio channels
-   for(channel_info_t *chan = channelinfo; chan != &channelinfo[numChannels]; chan++)
-   {
-      // fast rejection before semaphore lock
-      if(chan->shouldstop || !chan->data)
-         continue;
-         
-      // try to acquire semaphore, but do not block; if the main thread is using
-      // this channel we'll just skip it for now - safer and faster.
-      if(SDL_SemTryWait(chan->semaphore) != 0)
-         continue;
-
-      // Left and right channel are in audio stream, alternating.
-      if(chan->reverb)
-      {
-         leftout  = mixbuffer[1];
-         leftend  = leftend1;
-      }
-      else
-      {
-         leftout = mixbuffer[0];
-         leftend = leftend0;
-      }
-
-      // Lost before semaphore acquired? (very unlikely, but must check for 
-      // safety). BTW, don't move this up or you'll chew major CPU whenever this
-      // does happen.
-      if(chan->shouldstop || !chan->data)
-      {
-         SDL_SemPost(chan->semaphore);
-         continue;
-      }
-
-      while(leftout != leftend)
-      {
-         float sample  = *(chan->data);         
-         *(leftout + 0) = *(leftout + 0) + sample * chan->leftvol;
-         *(leftout + 1) = *(leftout + 1) + sample * chan->rightvol;
-         
-         // Increment current pointers in stream
-         leftout += STEP;
-         
-         // Increment index
-         chan->stepremainder += chan->step;
-         
-         // MSB is next sample
-         chan->data += chan->stepremainder >> 16;
-         
-         // Limit to LSB
-         chan->stepremainder &= 0xffff;
-         
-         // Check whether we are done
-         if(chan->data >= chan->enddata)
-         {
-            if(chan->loop && !paused && 
-               ((!menuactive && !consoleactive) || demoplayback || netgame))
-            {
-               // haleyjd 06/03/06: restart a looping sample if not paused
-               chan->data = chan->startdata;
-               chan->stepremainder = 0;
-            }
-            else
-            {
-               // flag the channel to be stopped by the main thread ASAP
-               chan->data = NULL;
-               break;
-            }
-         }
-      }
-
-      // release semaphore and move on to the next channel
-      SDL_SemPost(chan->semaphore);
-   }
+   // Mix audio channels; left and right channel are in audio stream,
+   // alternating.
+   S_MixerMix(mixbuffer[0], mixbuffer[1], len/(SAMPLESIZE*STEP), allowloop);
 
    // do reverberation if an effect is active
    if(s_reverbactive)
@@ -517,7 +250,10 @@ static void I_SDLUpdateSoundCB(void *userdata, Uint8 *stream, int len)
    I_SDLMixBuffers();
 
    // haleyjd 04/21/10: equalization output pass
-   do_3band(mixbuffer[0], leftend0, (Sint16 *)stream);
+   equalizer.process(mixbuffer[0], len/(SAMPLESIZE*STEP), preampmul);
+
+   // haleyjd: use rational_tanh for soft clipping
+   S_SoftClipToS16(mixbuffer[0], (int16_t *)stream, len/SAMPLESIZE);
 }
 
 //
@@ -525,8 +261,6 @@ static void I_SDLUpdateSoundCB(void *userdata, Uint8 *stream, int len)
 //
 //============================================================================
 
-#define SND_PI 3.14159265
-
 //
 // I_SetChannels
 //
@@ -541,8 +275,7 @@ static void I_SetChannels()
    int *steptablemid = steptable + 128;
    
    // Okay, reset internal mixing channels to zero.
-   for(i = 0; i < MAX_CHANNELS; i++)
-      memset(&channelinfo[i], 0, sizeof(channel_info_t));
+   S_MixerInit();
    
    // This table provides step widths for pitch parameters.
    for(i = -128; i < 128; i++)
@@ -553,28 +286,12 @@ static void I_SetChannels()
    mixbuffer[0] = buf;
    mixbuffer[1] = buf + mixbuffer_size;
 
-   // haleyjd 10/02/08: create semaphores
-   for(i = 0; i < MAX_CHANNELS; i++)
-   {
-      channelinfo[i].semaphore = SDL_CreateSemaphore(1);
-
-      if(!channelinfo[i].semaphore)
-         I_Error("I_SetChannels: failed to create semaphore for channel %d\n", i);
-   }
-
    // haleyjd 04/21/10: initialize equalizers
-
-   // Set Low/Mid/High gains 
-   eqstate[0].lg = eqstate[1].lg = s_lowgain;
-   eqstate[0].mg = eqstate[1].mg = s_midgain;
-   eqstate[0].hg = eqstate[1].hg = s_highgain;
-
-   // Calculate filter cutoff frequencies
-   eqstate[0].lf = eqstate[1].lf = 2 * sin(SND_PI * (s_lowfreq  / (double)snd_samplerate));
-   eqstate[0].hf = eqstate[1].hf = 2 * sin(SND_PI * (s_highfreq / (double)snd_samplerate));
+   equalizer.setup(s_lowfreq, s_highfreq, s_lowgain, s_midgain, s_highgain,
+                   snd_samplerate);
 
    // Calculate preamplification factor
-   preampmul = s_eqpreamp;
+   preampmul = (float)s_eqpreamp;
 }
 
 //=============================================================================
@@ -589,20 +306,12 @@ static void I_SetChannels()
 //
 static void I_SDLUpdateEQParams()
 {
-   // flush out state of equalizers
-   memset(eqstate, 0, sizeof(eqstate));
-
-   // Set Low/Mid/High gains 
-   eqstate[0].lg = eqstate[1].lg = s_lowgain;
-   eqstate[0].mg = eqstate[1].mg = s_midgain;
-   eqstate[0].hg = eqstate[1].hg = s_highgain;
-
-   // Calculate filter cutoff frequencies
-   eqstate[0].lf = eqstate[1].lf = 2 * sin(SND_PI * (s_lowfreq  / (double)snd_samplerate));
-   eqstate[0].hf = eqstate[1].hf = 2 * sin(SND_PI * (s_highfreq / (double)snd_samplerate));
+   // flush out state of equalizers and set the new parameters
+   equalizer.setup(s_lowfreq, s_highfreq, s_lowgain, s_midgain, s_highgain,
+                   snd_samplerate);
 
    // Calculate preamp factor
-   preampmul = s_eqpreamp;
+   preampmul = (float)s_eqpreamp;
 }
 
 //
@@ -628,7 +337,7 @@ static int I_SDLStartSound(sfxinfo_t *sound, int cnum, int vol, int sep,
    // haleyjd 06/03/06: look for an unused hardware channel
    for(handle = 0; handle < numChannels; handle++)
    {
-      if(channelinfo[handle].data == NULL || channelinfo[handle].shouldstop)
+      if(!S_MixerVoicePlaying(handle))
          break;
    }
 
@@ -657,12 +366,11 @@ static int I_SDLStartSound(sfxinfo_t *sound, int cnum, int vol, int sep,
 static void I_SDLStopSound(int handle, int id)
 {
 #ifdef RANGECHECK
-   if(handle < 0 || handle >= MAX_CHANNELS)
+   if(handle < 0 || handle >= MAXSNDCHANNELS)
       I_Error("I_SDLStopSound: handle out of range\n");
 #endif
    
-   if(channelinfo[handle].idnum == (unsigned int)id)
-      channelinfo[handle].shouldstop = true;
+   S_MixerStopVoice(handle, (unsigned int)id);
 }
 
 //
@@ -673,11 +381,11 @@ static void I_SDLStopSound(int handle, int id)
 static int I_SDLSoundIsPlaying(int handle)
 {
 #ifdef RANGECHECK
-   if(handle < 0 || handle >= MAX_CHANNELS)
+   if(handle < 0 || handle >= MAXSNDCHANNELS)
       I_Error("I_SDLSoundIsPlaying: handle out of range\n");
 #endif
  
-   return !channelinfo[handle].shouldstop && channelinfo[handle].data;
+   return S_MixerVoicePlaying(handle);
 }
 
 //
@@ -691,11 +399,11 @@ static int I_SDLSoundIsPlaying(int handle)
 static int I_SDLSoundID(int handle)
 {
 #ifdef RANGECHECK
-   if(handle < 0 || handle >= MAX_CHANNELS)
+   if(handle < 0 || handle >= MAXSNDCHANNELS)
       I_Error("I_SDLSoundID: handle out of range\n");
 #endif
 
-   return channelinfo[handle].idnum;
+   return S_MixerVoiceID(handle);
 }
 
 //
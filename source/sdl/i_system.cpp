@@ -46,6 +46,7 @@
 #include "../w_wad.h"
 #include "../v_video.h"
 #include "../m_argv.h"
+#include "../p_saveg.h"
 #include "../g_bind.h"
 #include "../textscreen/txt_main.h"
 
@@ -150,6 +151,7 @@ void I_Quit(void)
    //         06/06/10: check each call, as an I_FatalError called from any of this
    //                   code could escalate the error status.
 
+   IFNOTFATAL(P_FinishSaveWrite()); // a save might still be being written
    IFNOTFATAL(M_SaveDefaults());
    IFNOTFATAL(M_SaveSysConfig());
    IFNOTFATAL(G_SaveDefaults()); // haleyjd
@@ -0,0 +1,93 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      ThreadPool test: workers added by resize must not rerun the last job.
+//
+//-----------------------------------------------------------------------------
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+// Built in, so the test can see the pool's pending count.
+#include "../m_threadpool.cpp"
+
+static std::atomic<int> jobcount;
+
+//
+// TestPool
+//
+class TestPool : public ThreadPool
+{
+public:
+   int getPending()
+   {
+      std::lock_guard<std::mutex> lock(pImpl->mutex);
+      return pImpl->pending;
+   }
+};
+
+static void CountJob(int, void *)
+{
+   ++jobcount;
+}
+
+static int failures;
+
+static void Check(bool cond, const char *what)
+{
+   if(!cond)
+   {
+      std::printf("FAILED: %s\n", what);
+      ++failures;
+   }
+}
+
+int main()
+{
+   TestPool pool;
+
+   pool.resize(2);
+   pool.run(CountJob, nullptr);
+   Check(jobcount == 2, "first job runs once per thread");
+   Check(pool.getPending() == 0, "first job leaves nothing pending");
+
+   // New workers must sit idle until the next job
+   pool.resize(6);
+   std::this_thread::sleep_for(std::chrono::milliseconds(100));
+   Check(jobcount == 2, "growing the pool doesn't rerun the job");
+   Check(pool.getPending() == 0, "growing the pool leaves nothing pending");
+
+   pool.run(CountJob, nullptr);
+   Check(jobcount == 8, "next job runs once per thread");
+   Check(pool.getPending() == 0, "next job leaves nothing pending");
+
+   if(!failures)
+      std::printf("ok\n");
+
+   return failures ? 1 : 0;
+}
+
+// EOF
@@ -0,0 +1,732 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Node builder test. Builds nodes for two fixture maps and checks the
+//      XGL3 output: every subsector is a convex polygon of one sector, every
+//      sidedef is covered by its segs exactly, every node's children lie on
+//      the right sides of its partition, and points inside the map locate to
+//      a subsector which contains them and belongs to the sector they are in.
+//      Also checks the reject table and a round trip through the node cache.
+//
+//      The first map has a room with a pillar, a square room split into two
+//      sectors by a diagonal, and a six-sided room. The second is one large
+//      room full of pillars, big enough that partition choice is threaded.
+//
+//-----------------------------------------------------------------------------
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+
+// Built in, so the test can use the NodeBuilder directly.
+#include "../p_nodebuild.cpp"
+
+#include "../m_utils.h"
+#include "../p_saveg.h"
+
+//=============================================================================
+//
+// Engine stand-ins
+//
+
+vertex_t *vertexes;
+int       numvertexes;
+line_t   *lines;
+int       numlines;
+sector_t *sectors;
+int       numsectors;
+char     *usergamepath;
+int       gametic;
+HALTimer  i_haltimer;
+
+static unsigned int TestGetTicks()
+{
+   return 0;
+}
+
+void C_Printf(const char *, ...)
+{
+}
+
+void usermsg(const char *, ...)
+{
+}
+
+int M_CheckParm(const char *)
+{
+   return 0;
+}
+
+void I_Error(const char *error, ...)
+{
+   va_list args;
+   va_start(args, error);
+   vfprintf(stderr, error, args);
+   va_end(args);
+   exit(1);
+}
+
+void I_FatalError(int, const char *error, ...)
+{
+   va_list args;
+   va_start(args, error);
+   vfprintf(stderr, error, args);
+   va_end(args);
+   exit(1);
+}
+
+// Referenced by qstring, never called here
+unsigned int D_HashTableKey(const char *)     { return 0; }
+unsigned int D_HashTableKeyCase(const char *) { return 0; }
+void SaveArchive::archiveSize(size_t &)               {}
+void SaveArchive::archiveLString(char *&, size_t &)   {}
+
+//=============================================================================
+//
+// Fixture maps
+//
+
+static std::vector<fixed_t> fixverts;     // x, y pairs
+static std::vector<int>     fixlines;     // v1, v2, front sector, back sector
+static int                  fixsectors;
+
+static int TestVertex(double x, double y)
+{
+   fixed_t fx = M_DoubleToFixed(x), fy = M_DoubleToFixed(y);
+
+   for(size_t i = 0; i < fixverts.size(); i += 2)
+   {
+      if(fixverts[i] == fx && fixverts[i + 1] == fy)
+         return int(i / 2);
+   }
+   fixverts.push_back(fx);
+   fixverts.push_back(fy);
+   return int(fixverts.size() / 2 - 1);
+}
+
+static void TestLine(double x1, double y1, double x2, double y2, int front,
+                     int back = -1)
+{
+   fixlines.push_back(TestVertex(x1, y1));
+   fixlines.push_back(TestVertex(x2, y2));
+   fixlines.push_back(front);
+   fixlines.push_back(back);
+}
+
+//
+// TestLoop
+//
+// Lines all the way around a polygon, facing right as they go, so a loop
+// given clockwise faces in and one given anticlockwise faces out.
+//
+static void TestLoop(const double *pts, int count, int sector)
+{
+   for(int i = 0; i < count; i++)
+   {
+      int j = (i + 1) % count;
+      TestLine(pts[i * 2], pts[i * 2 + 1], pts[j * 2], pts[j * 2 + 1], sector);
+   }
+}
+
+//
+// TestLoadMap
+//
+// Sets up the level arrays from the fixture. Sidedef numbers are only
+// checked against -1 by the builder, so line n's sides are 2n and 2n+1.
+//
+static void TestLoadMap()
+{
+   numvertexes = int(fixverts.size() / 2);
+   numlines    = int(fixlines.size() / 4);
+   numsectors  = fixsectors;
+
+   vertexes = ecalloc(vertex_t *, numvertexes, sizeof(vertex_t));
+   lines    = ecalloc(line_t *,   numlines,    sizeof(line_t));
+   sectors  = ecalloc(sector_t *, numsectors,  sizeof(sector_t));
+
+   for(int i = 0; i < numvertexes; i++)
+   {
+      vertexes[i].x = fixverts[i * 2];
+      vertexes[i].y = fixverts[i * 2 + 1];
+   }
+   for(int i = 0; i < numlines; i++)
+   {
+      const int *fl = &fixlines[i * 4];
+      line_t    &li = lines[i];
+
+      li.v1          = &vertexes[fl[0]];
+      li.v2          = &vertexes[fl[1]];
+      li.sidenum[0]  = i * 2;
+      li.sidenum[1]  = fl[3] >= 0 ? i * 2 + 1 : -1;
+      li.frontsector = &sectors[fl[2]];
+      li.backsector  = fl[3] >= 0 ? &sectors[fl[3]] : nullptr;
+   }
+}
+
+static void TestFreeMap()
+{
+   efree(vertexes);
+   efree(lines);
+   efree(sectors);
+   fixverts.clear();
+   fixlines.clear();
+}
+
+static bool TestInsideConvex(const double *pts, int count, double x, double y)
+{
+   for(int i = 0; i < count; i++)
+   {
+      int j = (i + 1) % count;
+      double dx = pts[j * 2] - pts[i * 2], dy = pts[j * 2 + 1] - pts[i * 2 + 1];
+
+      // clockwise, so inside is on the right
+      if((x - pts[i * 2]) * dy - (y - pts[i * 2 + 1]) * dx <= 0)
+         return false;
+   }
+   return true;
+}
+
+static const double roomA[]  = { 0,0, 0,256, 256,256, 256,0 };
+static const double pillar[] = { 96,96, 160,96, 160,160, 96,160 };
+static const double roomC[]  = { 0,448, 64,640, 192,640, 256,512, 192,384, 64,384 };
+
+//
+// TestRoomsMap
+//
+// Sector 0 is room A with its pillar, 1 and 2 the halves of room B, and 3 is
+// room C. Only 1 and 2 can see each other.
+//
+static void TestRoomsMap()
+{
+   TestLoop(roomA, 4, 0);
+   TestLoop(pillar, 4, 0);
+
+   TestLine(384,   0, 384, 256, 1);
+   TestLine(384, 256, 640, 256, 1);
+   TestLine(640, 256, 640,   0, 2);
+   TestLine(640,   0, 384,   0, 2);
+   TestLine(384,   0, 640, 256, 2, 1);
+
+   TestLoop(roomC, 6, 3);
+
+   fixsectors = 4;
+}
+
+static int TestRoomsSector(double x, double y)
+{
+   if(TestInsideConvex(roomA, 4, x, y))
+   {
+      // the pillar runs anticlockwise, so its inside is on the left
+      for(int i = 0; i < 4; i++)
+      {
+         int j = (i + 1) % 4;
+         double dx = pillar[j * 2] - pillar[i * 2];
+         double dy = pillar[j * 2 + 1] - pillar[i * 2 + 1];
+         if((x - pillar[i * 2]) * dy - (y - pillar[i * 2 + 1]) * dx > 0)
+            return 0;
+      }
+      return -1;
+   }
+   if(x > 384 && x < 640 && y > 0 && y < 256 && fabs(y - (x - 384)) > 1)
+      return y > x - 384 ? 1 : 2;
+   if(TestInsideConvex(roomC, 6, x, y))
+      return 3;
+   return -1;
+}
+
+#define GRIDPILLARS 24
+#define GRIDSPACING 160
+#define GRIDSIZE    (GRIDPILLARS * GRIDSPACING)
+
+//
+// TestGridMap
+//
+static void TestGridMap()
+{
+   const double room[] = { 0,0, 0,GRIDSIZE, GRIDSIZE,GRIDSIZE, GRIDSIZE,0 };
+
+   TestLoop(room, 4, 0);
+   for(int i = 0; i < GRIDPILLARS; i++)
+   {
+      for(int j = 0; j < GRIDPILLARS; j++)
+      {
+         // every other pillar is turned a little to give the builder slopes
+         double x = i * GRIDSPACING + 64, y = j * GRIDSPACING + 64;
+         double s = ((i + j) & 1) ? 8 : 0;
+         const double pts[] = { x,y+s, x+32,y, x+32-s,y+32, x,y+32-s };
+         TestLoop(pts, 4, 0);
+      }
+   }
+   fixsectors = 1;
+}
+
+static int TestGridSector(double x, double y)
+{
+   if(x <= 0 || y <= 0 || x >= GRIDSIZE || y >= GRIDSIZE)
+      return -1;
+
+   // near a pillar counts as unknown
+   double px = fmod(x, GRIDSPACING), py = fmod(y, GRIDSPACING);
+   if(px > 60 && px < 100 && py > 60 && py < 100)
+      return -1;
+   return 0;
+}
+
+//=============================================================================
+//
+// XGL3 checks
+//
+
+static int failures;
+
+static void Check(bool cond, const char *what)
+{
+   if(!cond)
+   {
+      std::printf("FAILED: %s\n", what);
+      ++failures;
+   }
+}
+
+struct testnodes_t
+{
+   std::vector<double>   vx, vy;
+   std::vector<uint32_t> firstseg, numsegs;
+   std::vector<uint32_t> segv1, segline;
+   std::vector<uint8_t>  segside;
+   std::vector<double>   nx, ny, ndx, ndy;
+   std::vector<uint32_t> child[2];
+};
+
+static uint32_t TestGet32(const byte *&p)
+{
+   uint32_t v = p[0] | p[1] << 8 | p[2] << 16 | uint32_t(p[3]) << 24;
+   p += 4;
+   return v;
+}
+
+static bool TestParse(const byte *data, int length, testnodes_t &tn)
+{
+   const byte *p = data, *end = data + length;
+
+   if(length < 8 || memcmp(p, "XGL3", 4))
+      return false;
+   p += 4;
+
+   uint32_t orgverts = TestGet32(p), newverts = TestGet32(p);
+   if(orgverts != uint32_t(numvertexes))
+      return false;
+   for(int i = 0; i < numvertexes; i++)
+   {
+      tn.vx.push_back(M_FixedToDouble(vertexes[i].x));
+      tn.vy.push_back(M_FixedToDouble(vertexes[i].y));
+   }
+   for(uint32_t i = 0; i < newverts; i++)
+   {
+      tn.vx.push_back(M_FixedToDouble(fixed_t(TestGet32(p))));
+      tn.vy.push_back(M_FixedToDouble(fixed_t(TestGet32(p))));
+   }
+
+   uint32_t count = TestGet32(p), first = 0;
+   for(uint32_t i = 0; i < count; i++)
+   {
+      tn.firstseg.push_back(first);
+      tn.numsegs.push_back(TestGet32(p));
+      first += tn.numsegs.back();
+   }
+
+   count = TestGet32(p);
+   if(count != first)
+      return false;
+   for(uint32_t i = 0; i < count; i++)
+   {
+      tn.segv1.push_back(TestGet32(p));
+      TestGet32(p); // partner
+      tn.segline.push_back(TestGet32(p));
+      tn.segside.push_back(*p++);
+      if(tn.segv1.back() >= tn.vx.size())
+         return false;
+   }
+
+   count = TestGet32(p);
+   for(uint32_t i = 0; i < count; i++)
+   {
+      tn.nx.push_back(M_FixedToDouble(fixed_t(TestGet32(p))));
+      tn.ny.push_back(M_FixedToDouble(fixed_t(TestGet32(p))));
+      tn.ndx.push_back(M_FixedToDouble(fixed_t(TestGet32(p))));
+      tn.ndy.push_back(M_FixedToDouble(fixed_t(TestGet32(p))));
+      p += 16; // bounding boxes
+      tn.child[0].push_back(TestGet32(p));
+      tn.child[1].push_back(TestGet32(p));
+   }
+
+   return p == end;
+}
+
+static double TestNodeDist(const testnodes_t &tn, int node, double x, double y)
+{
+   double len = sqrt(tn.ndx[node] * tn.ndx[node] + tn.ndy[node] * tn.ndy[node]);
+   return ((x - tn.nx[node]) * tn.ndy[node] - (y - tn.ny[node]) * tn.ndx[node]) / len;
+}
+
+//
+// TestSubsectorSector
+//
+// The sector of a subsector's real segs, which must all agree, or -1.
+//
+static int TestSubsectorSector(const testnodes_t &tn, uint32_t ss)
+{
+   int sector = -1;
+
+   for(uint32_t s = tn.firstseg[ss]; s < tn.firstseg[ss] + tn.numsegs[ss]; s++)
+   {
+      if(tn.segline[s] == NB_NOLINE)
+         continue;
+
+      const int *fl  = &fixlines[tn.segline[s] * 4];
+      int        sec = fl[2 + tn.segside[s]];
+
+      if(sector != -1 && sec != sector)
+         return -2;
+      sector = sec;
+   }
+   return sector;
+}
+
+static void TestSubsectorVerts(const testnodes_t &tn, uint32_t child,
+                               std::vector<uint32_t> &out)
+{
+   if(child & NF_SUBSECTOR)
+   {
+      uint32_t ss = child & ~NF_SUBSECTOR;
+      for(uint32_t s = tn.firstseg[ss]; s < tn.firstseg[ss] + tn.numsegs[ss]; s++)
+         out.push_back(tn.segv1[s]);
+      return;
+   }
+   TestSubsectorVerts(tn, tn.child[0][child], out);
+   TestSubsectorVerts(tn, tn.child[1][child], out);
+}
+
+//
+// TestTree
+//
+// Checks everything that can be checked from the nodes alone, then locates
+// points on a grid over the map and checks where they land.
+//
+static void TestTree(const testnodes_t &tn, int (*sectorAt)(double, double),
+                     double maxx, double maxy, double step)
+{
+   size_t numss = tn.numsegs.size();
+
+   Check(numss > 0 && tn.nx.size() == numss - 1, "one node fewer than subsectors");
+
+   // subsectors are convex polygons of one sector going clockwise
+   bool convex = true, onesector = true;
+   std::vector<double> covered(numlines * 2, 0.0);
+
+   for(size_t ss = 0; ss < numss; ss++)
+   {
+      uint32_t first = tn.firstseg[ss], n = tn.numsegs[ss];
+      double   area  = 0;
+
+      if(n < 3)
+         convex = false;
+
+      for(uint32_t k = 0; k < n; k++)
+      {
+         uint32_t a = tn.segv1[first + k];
+         uint32_t b = tn.segv1[first + (k + 1) % n];
+         uint32_t c = tn.segv1[first + (k + 2) % n];
+         double cross = (tn.vx[b] - tn.vx[a]) * (tn.vy[c] - tn.vy[b]) -
+                        (tn.vy[b] - tn.vy[a]) * (tn.vx[c] - tn.vx[b]);
+
+         if(cross > 1e-3)
+            convex = false;
+         area += tn.vx[a] * tn.vy[b] - tn.vx[b] * tn.vy[a];
+
+         uint32_t line = tn.segline[first + k];
+         if(line != NB_NOLINE)
+         {
+            covered[line * 2 + tn.segside[first + k]] +=
+               hypot(tn.vx[b] - tn.vx[a], tn.vy[b] - tn.vy[a]);
+         }
+      }
+      if(area >= 0)
+         convex = false;
+      if(TestSubsectorSector(tn, uint32_t(ss)) < 0)
+         onesector = false;
+   }
+   Check(convex, "subsectors are clockwise convex polygons");
+   Check(onesector, "subsectors belong to one sector");
+
+   bool exact = true;
+   for(int i = 0; i < numlines; i++)
+   {
+      double len = hypot(M_FixedToDouble(lines[i].v2->x - lines[i].v1->x),
+                         M_FixedToDouble(lines[i].v2->y - lines[i].v1->y));
+      for(int side = 0; side < 2; side++)
+      {
+         double want = lines[i].sidenum[side] == -1 ? 0 : len;
+         if(fabs(covered[i * 2 + side] - want) > 0.01)
+            exact = false;
+      }
+   }
+   Check(exact, "segs cover each sidedef exactly");
+
+   bool sides = true;
+   for(size_t node = 0; node < tn.nx.size(); node++)
+   {
+      for(int c = 0; c < 2; c++)
+      {
+         std::vector<uint32_t> verts;
+         TestSubsectorVerts(tn, tn.child[c][node], verts);
+         for(uint32_t v : verts)
+         {
+            double d = TestNodeDist(tn, int(node), tn.vx[v], tn.vy[v]);
+            if(c ? d > 0.01 : d < -0.01)
+               sides = false;
+         }
+      }
+   }
+   Check(sides, "node children lie on their own side");
+
+   // locate points the way R_PointInSubsector does
+   bool located = true;
+   int  points  = 0;
+   for(double x = step / 2 + 0.25; x < maxx; x += step)
+   {
+      for(double y = step / 2 + 0.125; y < maxy; y += step)
+      {
+         int sector = sectorAt(x, y);
+         if(sector < 0)
+            continue;
+
+         uint32_t child = uint32_t(tn.nx.size() - 1);
+         while(!(child & NF_SUBSECTOR))
+            child = tn.child[TestNodeDist(tn, int(child), x, y) > 0 ? 0 : 1][child];
+
+         uint32_t ss = child & ~NF_SUBSECTOR;
+         std::vector<double> pts;
+         for(uint32_t s = tn.firstseg[ss]; s < tn.firstseg[ss] + tn.numsegs[ss]; s++)
+         {
+            pts.push_back(tn.vx[tn.segv1[s]]);
+            pts.push_back(tn.vy[tn.segv1[s]]);
+         }
+         if(!TestInsideConvex(pts.data(), int(tn.numsegs[ss]), x, y) ||
+            TestSubsectorSector(tn, ss) != sector)
+            located = false;
+         ++points;
+      }
+   }
+   Check(points > 100 && located, "points land in a subsector of their sector");
+}
+
+static void TestBuild(const char *name, int (*sectorAt)(double, double),
+                      double maxx, double maxy, double step)
+{
+   int   len1, len2;
+   byte *data1, *data2;
+
+   {
+      NodeBuilder builder;
+      data1 = builder.build(len1);
+   }
+   {
+      NodeBuilder builder;
+      data2 = builder.build(len2);
+   }
+
+   testnodes_t tn;
+
+   Check(data1 && TestParse(data1, len1, tn), "XGL3 output parses");
+   Check(data2 && len1 == len2 && !memcmp(data1, data2, len1),
+         "building twice gives the same nodes");
+
+   if(data1 && tn.numsegs.size())
+      TestTree(tn, sectorAt, maxx, maxy, step);
+
+   std::printf("%s: %d subsectors, %d segs, %d nodes\n", name,
+               int(tn.numsegs.size()), int(tn.segv1.size()), int(tn.nx.size()));
+
+   efree(data1);
+   efree(data2);
+}
+
+//=============================================================================
+//
+// Reject and node cache
+//
+
+static void TestReject()
+{
+   int   size   = (numsectors * numsectors + 7) / 8;
+   byte *reject = ecalloc(byte *, 1, size);
+   const int group[] = { 0, 1, 1, 2 };
+   bool  right  = true;
+
+   P_BuildReject(reject);
+
+   for(int i = 0; i < numsectors; i++)
+   {
+      for(int j = 0; j < numsectors; j++)
+      {
+         int  pnum = i * numsectors + j;
+         bool bit  = (reject[pnum >> 3] >> (pnum & 7)) & 1;
+         if(bit != (group[i] != group[j]))
+            right = false;
+      }
+   }
+   Check(right, "reject marks only sectors no line joins");
+
+   efree(reject);
+}
+
+static int TestCountCache(const std::string &dir)
+{
+   DIR *d = opendir(dir.c_str());
+   int  count = 0;
+
+   if(!d)
+      return 0;
+   while(dirent *ent = readdir(d))
+   {
+      if(strstr(ent->d_name, ".xgl3") && !strstr(ent->d_name, ".tmp"))
+         ++count;
+   }
+   closedir(d);
+   return count;
+}
+
+static std::string TestCacheFile(const std::string &dir)
+{
+   DIR *d = opendir(dir.c_str());
+   std::string name;
+
+   if(!d)
+      return name;
+   while(dirent *ent = readdir(d))
+   {
+      if(strstr(ent->d_name, ".xgl3"))
+         name = dir + "/" + ent->d_name;
+   }
+   closedir(d);
+   return name;
+}
+
+//
+// TestCache
+//
+// The first load builds nodes and writes them out. A doctored cache file is
+// then what the next load returns, which shows the cache is read; changing
+// the geometry must not find it.
+//
+static void TestCache()
+{
+   char tmpl[] = "/tmp/nodebuildXXXXXX";
+
+   if(!mkdtemp(tmpl))
+   {
+      Check(false, "temporary directory for the cache");
+      return;
+   }
+   usergamepath = tmpl;
+
+   std::string nodedir = std::string(tmpl) + "/nodes";
+   int   len1, len2, len3;
+   byte *data1 = P_BuildNodes(len1);
+
+   Check(data1 != nullptr, "nodes are built for the cache");
+   Check(TestCountCache(nodedir) == 1, "built nodes are written to the cache");
+
+   std::string cachefile = TestCacheFile(nodedir);
+   byte *onfile = nullptr;
+   int   onlen  = M_ReadFile(cachefile.c_str(), &onfile);
+
+   Check(data1 && onlen == len1 && !memcmp(onfile, data1, len1),
+         "cache file holds the built nodes");
+
+   // tag the last byte, so only a read from the cache can return it
+   onfile[onlen - 1] ^= 0xff;
+   M_WriteFile(cachefile.c_str(), onfile, size_t(onlen));
+
+   byte *data2 = P_BuildNodes(len2);
+   Check(data2 && len2 == onlen && !memcmp(data2, onfile, onlen),
+         "second load is read from the cache");
+
+   // different geometry must build afresh
+   vertexes[0].x += FRACUNIT;
+   byte *data3 = P_BuildNodes(len3);
+   Check(data3 && (len3 != onlen || memcmp(data3, onfile, onlen)),
+         "changed geometry doesn't use the old cache");
+   Check(TestCountCache(nodedir) == 2, "changed geometry gets its own cache file");
+   vertexes[0].x -= FRACUNIT;
+
+   efree(data1);
+   efree(data2);
+   efree(data3);
+   efree(onfile);
+
+   // tidy up
+   if(DIR *d = opendir(nodedir.c_str()))
+   {
+      while(dirent *ent = readdir(d))
+      {
+         if(ent->d_name[0] != '.')
+            remove((nodedir + "/" + ent->d_name).c_str());
+      }
+      closedir(d);
+   }
+   rmdir(nodedir.c_str());
+   rmdir(tmpl);
+   usergamepath = nullptr;
+}
+
+int main()
+{
+   i_haltimer.GetTicks = TestGetTicks;
+
+   TestRoomsMap();
+   TestLoadMap();
+   TestBuild("rooms", TestRoomsSector, 640, 640, 4);
+   TestReject();
+   TestCache();
+   TestFreeMap();
+
+   TestGridMap();
+   TestLoadMap();
+   TestBuild("grid", TestGridSector, GRIDSIZE, GRIDSIZE, 24);
+   TestFreeMap();
+
+   if(!failures)
+      std::printf("ok\n");
+
+   return failures ? 1 : 0;
+}
+
+// EOF
@@ -33,6 +33,11 @@
 // Global list of all VAllocItem instances
 DLListItem<VAllocItem> *VAllocItem::vAllocList;
 
+// Current video mode, and a count of mode changes for render contexts
+int VAllocItem::modeWidth;
+int VAllocItem::modeHeight;
+int VAllocItem::modeGeneration;
+
 //
 // VAllocItem::FreeAllocs
 //
@@ -52,6 +57,10 @@ void VAllocItem::SetNewMode(int w, int h)
 {
    DLListItem<VAllocItem> *cur = vAllocList;
 
+   modeWidth  = w;
+   modeHeight = h;
+   ++modeGeneration;
+
    while(cur)
    {
       (*cur)->allocator(w, h);
@@ -59,6 +68,25 @@ void VAllocItem::SetNewMode(int w, int h)
    }
 }
 
+//
+// VAllocItem::SetNewContextMode
+//
+// Invokes the allocation method of only the per-context VAllocItem instances,
+// using the most recently set video mode. Called on renderer worker threads
+// so that their thread_local buffers are created in that thread.
+//
+void VAllocItem::SetNewContextMode()
+{
+   DLListItem<VAllocItem> *cur = vAllocList;
+
+   while(cur)
+   {
+      if((*cur)->perContext)
+         (*cur)->allocator(modeWidth, modeHeight);
+      cur = cur->dllNext;
+   }
+}
+
 
 // EOF
 
@@ -39,18 +39,26 @@ public:
 
 protected:
    static DLListItem<VAllocItem> *vAllocList;
+   static int modeWidth;
+   static int modeHeight;
+   static int modeGeneration;
 
    DLListItem<VAllocItem> links;
    allocfn_t allocator;
+   bool      perContext; // buffer is thread_local to each render context
 
 public:
-   explicit VAllocItem(allocfn_t p_allocator) : links(), allocator(p_allocator) 
+   explicit VAllocItem(allocfn_t p_allocator, bool p_perContext = false) 
+      : links(), allocator(p_allocator), perContext(p_perContext)
    {
       links.insert(this, &vAllocList);
    }
 
    static void FreeAllocs();
    static void SetNewMode(int w, int h);
+   static void SetNewContextMode();
+
+   static int GetGeneration() { return modeGeneration; }
 };
 
 #define VALLOCFNNAME(name) VAllocFn_ ## name
@@ -63,6 +71,17 @@ public:
    VALLOCDECL(name);      \
    VALLOCFNDEF(name)
 
+// Per-render-context allocations, for buffers that are thread_local. These
+// are run on the main thread by SetNewMode and on each renderer worker thread
+// by SetNewContextMode.
+#define VCTXALLOCDECL(name) \
+   static VAllocItem vAllocItem_ ## name (VALLOCFNNAME(name), true)
+
+#define VCTXALLOCATION(name) \
+   VALLOCFNSIG(name);        \
+   VCTXALLOCDECL(name);      \
+   VALLOCFNDEF(name)
+
 #endif
 
 // EOF
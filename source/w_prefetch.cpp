@@ -0,0 +1,272 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Background lump reading. A batch of lumps which will be wanted soon is
+//      read on a worker thread while the game goes on, so that caching them
+//      later costs no disk access or inflation.
+//
+//      Everything which touches the zone heap or a shared FILE is done on
+//      the main thread, when a batch is started or finished; the worker only
+//      ever reads memory that stays put and fills buffers it was handed:
+//
+//      * Lumps of mapped files, and stored lumps of mapped zips, have their
+//        pages faulted in, so the copy made when they are cached is quick.
+//      * Deflated lumps of mapped zips are inflated, and go into the zip
+//        lump cache when the batch is finished.
+//      * Lumps which are files of their own are read into zone blocks, which
+//        become the lumps' cached data when the batch is finished.
+//
+//      Lumps of wads which could not be mapped are read through a FILE that
+//      the main thread shares, so they are left alone.
+//
+//-----------------------------------------------------------------------------
+
+#include <atomic>
+#include <thread>
+
+#include "z_zone.h"
+#include "m_collection.h"
+#include "w_prefetch.h"
+#include "w_wad.h"
+#include "w_zip.h"
+
+#define PREFETCH_PAGESIZE 4096
+
+enum
+{
+   PF_TOUCH,   // fault in the pages of data already mapped
+   PF_INFLATE, // inflate a deflated zip lump from its mapped data
+   PF_FILE     // read a lump which is a file of its own
+};
+
+struct prefetchitem_t
+{
+   lumpinfo_t    *lump;
+   int            kind; // PF_*
+   const uint8_t *src;  // for PF_TOUCH and PF_INFLATE, the mapped data
+   void          *data; // for PF_INFLATE and PF_FILE, the buffer to fill
+   bool           ok;
+};
+
+static PODCollection<prefetchitem_t> prefetchitems;
+
+// Never destroyed, so that exiting while a batch is read isn't fatal
+static std::thread      *prefetchthread;
+static std::atomic<bool> prefetchdone;
+
+// Keeps the reads of W_prefetchTouch from being optimized away
+static volatile uint8_t prefetchsink;
+
+//
+// W_prefetchTouch
+//
+// Reads one byte of every page of a mapped lump.
+//
+static void W_prefetchTouch(const uint8_t *src, size_t size)
+{
+   uint8_t sum = 0;
+
+   for(size_t i = 0; i < size; i += PREFETCH_PAGESIZE)
+      sum += src[i];
+   sum += src[size - 1];
+
+   prefetchsink = sum;
+}
+
+//
+// W_prefetchFile
+//
+// Reads a file lump into its buffer, the same as W_FileReadLump.
+//
+static bool W_prefetchFile(const lumpinfo_t *lump, void *dest)
+{
+   FILE  *f;
+   size_t sizeread = 0;
+
+   if((f = fopen(lump->filepath, "rb")))
+   {
+      sizeread = fread(dest, 1, lump->size, f);
+      fclose(f);
+   }
+
+   return sizeread == lump->size;
+}
+
+//
+// W_prefetchThread
+//
+// Worker thread for one batch.
+//
+static void W_prefetchThread()
+{
+   for(prefetchitem_t &item : prefetchitems)
+   {
+      switch(item.kind)
+      {
+      case PF_TOUCH:
+         W_prefetchTouch(item.src, item.lump->size);
+         item.ok = true;
+         break;
+      case PF_INFLATE:
+         item.ok = ZIP_InflateLump(item.lump->zip.zipLump, item.src, item.data);
+         break;
+      case PF_FILE:
+         item.ok = W_prefetchFile(item.lump, item.data);
+         break;
+      }
+   }
+
+   prefetchdone = true;
+}
+
+//
+// W_StartPrefetch
+//
+// Starts reading the given lumps of a directory in the background. Lumps
+// which are already cached and invalid lump numbers are skipped. A batch
+// still in progress is finished first.
+//
+void W_StartPrefetch(WadDirectory &dir, const int *lumps, size_t count)
+{
+   lumpinfo_t **lumpinfo = dir.getLumpInfo();
+   int          numlumps = dir.getNumLumps();
+   size_t       inflatelimit = static_cast<size_t>(zip_cachesize) << 20;
+   size_t       inflatetotal = 0;
+
+   W_FinishPrefetch();
+
+   for(size_t i = 0; i < count; i++)
+   {
+      if(lumps[i] < 0 || lumps[i] >= numlumps)
+         continue;
+
+      lumpinfo_t *lump = lumpinfo[lumps[i]];
+      prefetchitem_t item = { lump, PF_TOUCH, nullptr, nullptr, false };
+
+      if(!lump->size || lump->cache[lumpinfo_t::fmt_default])
+         continue;
+
+      switch(lump->type)
+      {
+      case lumpinfo_t::lump_direct:
+         if(!(item.src = static_cast<const uint8_t *>(lump->direct.mapped)))
+            continue;
+         break;
+      case lumpinfo_t::lump_file:
+         item.kind = PF_FILE;
+         break;
+      case lumpinfo_t::lump_zip:
+         {
+            ZipLump *zl = lump->zip.zipLump;
+
+            if((item.src = static_cast<const uint8_t *>(zl->getView())))
+               break;
+
+            // only as much as the inflated lump cache can hold at once
+            if(zl->method != ZipFile::METHOD_DEFLATE || zl->cached ||
+               (zl->flags & ZipFile::LF_PREFETCHING) ||
+               inflatetotal + zl->size > inflatelimit ||
+               !(item.src = zl->getMappedData()))
+               continue;
+
+            item.kind = PF_INFLATE;
+            zl->flags |= ZipFile::LF_PREFETCHING;
+            inflatetotal += zl->size;
+         }
+         break;
+      default: // memory lumps are already as close as they can be
+         continue;
+      }
+
+      if(item.kind == PF_INFLATE)
+         item.data = emalloc(void *, lump->size);
+      else if(item.kind == PF_FILE)
+         item.data = Z_Malloc(lump->size, PU_STATIC, nullptr);
+
+      prefetchitems.add(item);
+   }
+
+   if(prefetchitems.isEmpty())
+      return;
+
+   prefetchdone   = false;
+   prefetchthread = new std::thread(W_prefetchThread);
+}
+
+//
+// W_PrefetchDone
+//
+// Returns true if no batch is being read, so that W_FinishPrefetch will not
+// have to wait.
+//
+bool W_PrefetchDone()
+{
+   return !prefetchthread || prefetchdone;
+}
+
+//
+// W_FinishPrefetch
+//
+// Waits for the batch being read, if any, and hands what was read over to
+// the lump caches. Must be called before any directory a batch came from is
+// destroyed.
+//
+void W_FinishPrefetch()
+{
+   if(!prefetchthread)
+      return;
+
+   prefetchthread->join();
+   delete prefetchthread;
+   prefetchthread = nullptr;
+
+   for(prefetchitem_t &item : prefetchitems)
+   {
+      lumpinfo_t *lump = item.lump;
+
+      switch(item.kind)
+      {
+      case PF_INFLATE:
+         ZIP_AdoptInflatedLump(lump->zip.zipLump, item.data, item.ok);
+         break;
+      case PF_FILE:
+         // a read the main thread made meanwhile wins
+         if(item.ok && !lump->cache[lumpinfo_t::fmt_default])
+         {
+            Z_ChangeUser(item.data, &lump->cache[lumpinfo_t::fmt_default]);
+            Z_ChangeTag(item.data, PU_CACHE);
+         }
+         else
+            Z_Free(item.data);
+         break;
+      default:
+         break;
+      }
+   }
+
+   prefetchitems.makeEmpty();
+}
+
+// EOF
+
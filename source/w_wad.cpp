@@ -39,6 +39,7 @@
 #include "d_files.h"
 #include "e_hash.h"
 #include "hal/i_directory.h"
+#include "hal/i_mapfile.h"
 #include "m_argv.h"
 #include "m_collection.h"
 #include "m_dllist.h"
@@ -149,11 +150,43 @@ public:
 
    PODCollection<lumpinfo_t *>  infoptrs; // lumpinfo_t allocations
    DLListItem<ZipFile>         *zipFiles; // zip files attached to this waddir
+   PODCollection<mappedfile_t>  mappings; // archive files mapped into memory
 
    WadDirectoryPimpl()
-      : ZoneObject(), infoptrs(), zipFiles(nullptr)
+      : ZoneObject(), infoptrs(), zipFiles(nullptr), mappings()
    {
    }
+
+   //
+   // Map an archive file into memory, for W_DirectReadLump and
+   // WadDirectory::getLumpView. Returns nullptr if it can't be mapped, or
+   // if -nommap was given.
+   //
+   const byte *mapFile(FILE *f, size_t &size)
+   {
+      static int nommap = -1;
+      mappedfile_t map;
+
+      if(nommap < 0)
+         nommap = !!M_CheckParm("-nommap");
+
+      if(nommap || !I_MapFile(f, map))
+         return nullptr;
+
+      mappings.add(map);
+      size = map.size;
+      return static_cast<const byte *>(map.base);
+   }
+
+   //
+   // Unmap all files mapped by mapFile
+   //
+   void unmapFiles()
+   {
+      for(mappedfile_t &map : mappings)
+         I_UnmapFile(map);
+      mappings.clear();
+   }
 };
 
 qstring             WadDirectoryPimpl::FnPrototype;
@@ -327,6 +360,11 @@ bool WadDirectory::addSingleFile(openwad_t &openData, const wfileadd_t &addInfo,
    lump_p->direct.file     = openData.handle;
    lump_p->direct.position = static_cast<size_t>(singleinfo.filepos);
 
+   size_t mapsize;
+   const byte *mapbase = pImpl->mapFile(openData.handle, mapsize);
+   if(mapbase && lump_p->size <= mapsize)
+      lump_p->direct.mapped = mapbase;
+
    lump_p->li_namespace = addInfo.li_namespace; // killough 4/17/98
 
    strncpy(lump_p->name, singleinfo.name, 8);
@@ -532,6 +570,13 @@ bool WadDirectory::addWadFile(openwad_t &openData, const wfileadd_t &addInfo,
    // Add lumpinfo_t's for all lumps in the wad file
    lump_p = reAllocLumpInfo(header.numlumps, startlump);
 
+   // Map the file, so that lumps can be read from memory. Subfiles share
+   // their container's handle, and are left alone.
+   size_t      mapsize = 0;
+   const byte *mapbase = nullptr;
+   if(!(addInfo.flags & WFA_SUBFILE))
+      mapbase = pImpl->mapFile(openData.handle, mapsize);
+
    // Merge into the directory
    for(int i = startlump; i < this->numlumps; i++, lump_p++, fileinfo++)
    {
@@ -547,6 +592,11 @@ bool WadDirectory::addWadFile(openwad_t &openData, const wfileadd_t &addInfo,
       if(addInfo.flags & WFA_SUBFILE)
          lump_p->direct.position += static_cast<size_t>(baseoffset);
 
+      // lumps running off the end of the file must be read, to fail properly
+      if(mapbase && lump_p->direct.position <= mapsize &&
+         lump_p->size <= mapsize - lump_p->direct.position)
+         lump_p->direct.mapped = mapbase + lump_p->direct.position;
+
       lump_p->li_namespace = addInfo.li_namespace;     // killough 4/17/98
 
       strncpy(lump_p->name, fileinfo->name, 8);
@@ -592,6 +642,12 @@ bool WadDirectory::addZipFile(openwad_t &openData,
          IWADSource = source;
    }
 
+   // Map the zip, so that stored entries can be read from memory
+   size_t      mapsize = 0;
+   const byte *mapbase = pImpl->mapFile(openData.handle, mapsize);
+   if(mapbase)
+      zip->setMapping(mapbase, mapsize);
+
    // Allocate lumpinfo_t structures for the zip file's internal file lumps
    lump_p = reAllocLumpInfo(numZipLumps, startlump);
 
@@ -1661,6 +1717,9 @@ void *WadDirectory::cacheLumpNum(int lump, int tag,
    if(lump < 0 || lump >= numlumps)
       I_Error("WadDirectory::CacheLumpNum: %i >= numlumps\n", lump);
 
+   // render contexts on other threads may want the same lump
+   ZoneLockGuard lock;
+
    if(!(lumpinfo[lump]->cache[fmt]))      // read the lump in
    {
       readLump(lump,
@@ -1677,11 +1736,67 @@ void *WadDirectory::cacheLumpNum(int lump, int tag,
 
       if(tag < oldtag)
          Z_ChangeTag(lumpinfo[lump]->cache[fmt], tag);
+      else
+         Z_TouchCache(lumpinfo[lump]->cache[fmt]);
    }
 
    return lumpinfo[lump]->cache[fmt];
 }
 
+//
+// WadDirectory::getLumpView
+//
+// Returns a pointer to the raw data of a lump where it already sits in
+// memory: in a mapped archive file, an uncompressed zip entry of a mapped
+// zip, or an in-memory wad. Returns nullptr for any other lump, which must be
+// cached instead. The data is read-only, and lasts as long as the directory.
+// Unlike cacheLumpNum, this costs no zone memory at all.
+//
+const void *WadDirectory::getLumpView(int lump) const
+{
+   if(lump < 0 || lump >= numlumps)
+      I_Error("WadDirectory::getLumpView: %i >= numlumps\n", lump);
+
+   lumpinfo_t *lptr = lumpinfo[lump];
+
+   switch(lptr->type)
+   {
+   case lumpinfo_t::lump_direct:
+      return lptr->direct.mapped;
+   case lumpinfo_t::lump_memory:
+      return static_cast<const byte *>(lptr->memory.data) + lptr->memory.position;
+   case lumpinfo_t::lump_zip:
+      return lptr->zip.zipLump->getView();
+   default:
+      return nullptr;
+   }
+}
+
+//
+// WadDirectory::prefetchLumps
+//
+// Hints that the given lumps are about to be read. Deflated zip lumps among
+// them are inflated ahead of time, in parallel (see ZIP_PrefetchLumps).
+// Invalid lump numbers are ignored.
+//
+void WadDirectory::prefetchLumps(const int *lumps, size_t count) const
+{
+   PODCollection<ZipLump *> zipLumps;
+
+   for(size_t i = 0; i < count; i++)
+   {
+      if(lumps[i] < 0 || lumps[i] >= numlumps)
+         continue;
+
+      lumpinfo_t *lptr = lumpinfo[lumps[i]];
+      if(lptr->type == lumpinfo_t::lump_zip)
+         zipLumps.add(lptr->zip.zipLump);
+   }
+
+   if(!zipLumps.isEmpty())
+      ZIP_PrefetchLumps(&zipLumps[0], zipLumps.getLength());
+}
+
 //
 // W_CacheLumpName
 //
@@ -1822,6 +1937,8 @@ void WadDirectory::close()
       // free all resources loaded from the wad
       freeDirectoryLumps();
 
+      pImpl->unmapFiles();
+
       if(lumpinfo[0]->type == lumpinfo_t::lump_direct && lumpinfo[0]->direct.file)
          fclose(lumpinfo[0]->direct.file);
 
@@ -1852,6 +1969,13 @@ static size_t W_DirectReadLump(lumpinfo_t *l, void *dest)
    size_t ret;
    directlump_t &direct = l->direct;
 
+   // lumps in mapped files are only a copy away
+   if(direct.mapped)
+   {
+      memcpy(dest, direct.mapped, size);
+      return size;
+   }
+
    // killough 10/98: Add flashing disk indicator
    fseek(direct.file, static_cast<long>(direct.position), SEEK_SET);
    ret = fread(dest, 1, size, direct.file);
@@ -52,6 +52,7 @@ struct directlump_t
 {
    FILE *file;       // for a direct lump, a pointer to the file it is in
    size_t position;  // for direct and memory lumps, offset into file/buffer
+   const void *mapped; // the lump's data, if its file is mapped into memory
 };
 
 // A memory lump is loaded in a buffer in RAM and just needs to be memcpy'd.
@@ -323,6 +324,8 @@ public:
                       const WadLumpLoader *lfmt = nullptr) const;
    void *cacheLumpName(const char *name, int tag,
                        const WadLumpLoader *lfmt = nullptr) const;
+   const void *getLumpView(int lump) const;
+   void  prefetchLumps(const int *lumps, size_t count) const;
    void  cacheLumpAuto(int lumpnum, ZAutoBuffer &buffer) const;
    void  cacheLumpAuto(const char *name, ZAutoBuffer &buffer) const;
    bool  writeLump(const char *lumpname, const char *destpath) const;
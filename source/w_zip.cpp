@@ -26,19 +26,26 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <atomic>
+
 #include "z_auto.h"
 
 #include "i_system.h"
+#include "c_runcmd.h"
 #include "m_buffer.h"
+#include "m_collection.h"
 #include "m_compare.h"
 #include "m_qstr.h"
 #include "m_structio.h"
 #include "m_swap.h"
+#include "m_threadpool.h"
 #include "w_wad.h"
 #include "w_zip.h"
 
 #include "../zlib/zlib.h"
 
+static void ZIP_uncacheLump(ZipLump *lump);
+
 // Internal ZIP file structures
 
 #define ZIP_LOCAL_FILE_SIG  "PK\x3\x4"
@@ -260,11 +267,12 @@ ZipFile::~ZipFile()
    // free the directory
    if(lumps && numLumps)
    {
-      // free lump names
+      // free lump names and inflated copies
       for(int i = 0; i < numLumps; i++)
       {
          if(lumps[i].name)
             efree(lumps[i].name);
+         ZIP_uncacheLump(&lumps[i]);
       }
 
       // free the lump directory
@@ -713,6 +721,375 @@ void ZipLump::setAddress(InBuffer &fin)
    flags &= ~ZipFile::LF_CALCOFFSET;
 }
 
+//
+// ZIP_InflateMemory
+//
+// Inflates a deflated lump straight from the bytes of a mapped zip. Touches
+// nothing shared, so it is safe on any thread. Returns false if the stream is
+// bad or too short.
+//
+static bool ZIP_InflateMemory(const uint8_t *src, size_t srclen, void *dest,
+                              size_t len)
+{
+   z_stream zlStream = {};
+   int      code;
+
+   if(inflateInit2(&zlStream, -MAX_WBITS) != Z_OK)
+      return false;
+
+   zlStream.next_in   = const_cast<Bytef *>(src);
+   zlStream.avail_in  = static_cast<uInt>(srclen);
+   zlStream.next_out  = static_cast<Bytef *>(dest);
+   zlStream.avail_out = static_cast<uInt>(len);
+
+   code = inflate(&zlStream, Z_FINISH);
+   inflateEnd(&zlStream);
+
+   // as in ZIPDeflateReader, a full output buffer is all that's asked for
+   return (code == Z_STREAM_END || code == Z_OK || code == Z_BUF_ERROR) &&
+          !zlStream.avail_out;
+}
+
+//=============================================================================
+//
+// Inflated Lump Cache
+//
+// Deflated lumps are inflated anew every time they are read, which is every
+// time the zone copy made by WadDirectory::cacheLumpNum has been purged. A
+// copy of each inflated lump is kept here as well, up to zip_cachesize
+// megabytes, and the least recently read lumps are dropped to make room.
+//
+
+struct zipcacheitem_t
+{
+   ZipLump        *lump;
+   void           *data;
+   zipcacheitem_t *prev; // more recently read
+   zipcacheitem_t *next; // less recently read
+};
+
+int zip_cachesize = 32;
+
+static zipcacheitem_t *zipcachehead; // most recently read
+static zipcacheitem_t *zipcachetail; // least recently read
+static size_t          zipcachebytes;
+
+//
+// ZIP_cacheLimit
+//
+static size_t ZIP_cacheLimit()
+{
+   return static_cast<size_t>(zip_cachesize) << 20;
+}
+
+//
+// ZIP_unlinkCacheItem
+//
+static void ZIP_unlinkCacheItem(zipcacheitem_t *item)
+{
+   if(item->prev)
+      item->prev->next = item->next;
+   else
+      zipcachehead = item->next;
+
+   if(item->next)
+      item->next->prev = item->prev;
+   else
+      zipcachetail = item->prev;
+
+   item->prev = item->next = nullptr;
+}
+
+//
+// ZIP_linkCacheItem
+//
+// Puts an item at the most recently read end of the list.
+//
+static void ZIP_linkCacheItem(zipcacheitem_t *item)
+{
+   item->prev = nullptr;
+   if((item->next = zipcachehead))
+      zipcachehead->prev = item;
+   else
+      zipcachetail = item;
+   zipcachehead = item;
+}
+
+//
+// ZIP_uncacheLump
+//
+// Drops a lump's inflated copy, if it has one.
+//
+static void ZIP_uncacheLump(ZipLump *lump)
+{
+   zipcacheitem_t *item;
+
+   if(!(item = lump->cached))
+      return;
+
+   ZIP_unlinkCacheItem(item);
+   zipcachebytes -= lump->size;
+   lump->cached = nullptr;
+
+   efree(item->data);
+   efree(item);
+}
+
+//
+// ZIP_trimCache
+//
+// Drops least recently read lumps until there are room bytes to spare.
+//
+static void ZIP_trimCache(size_t room)
+{
+   size_t limit = ZIP_cacheLimit();
+
+   while(zipcachetail && (room > limit || zipcachebytes > limit - room))
+      ZIP_uncacheLump(zipcachetail->lump);
+}
+
+//
+// ZIP_addCachedLump
+//
+// Takes ownership of data, an inflated copy of the lump allocated with
+// emalloc, and keeps it in the cache.
+//
+static void ZIP_addCachedLump(ZipLump *lump, void *data)
+{
+   ZIP_trimCache(lump->size);
+
+   zipcacheitem_t *item = estructalloc(zipcacheitem_t, 1);
+
+   item->lump = lump;
+   item->data = data;
+   ZIP_linkCacheItem(item);
+
+   lump->cached = item;
+   zipcachebytes += lump->size;
+}
+
+//
+// ZIP_readCachedLump
+//
+// Copies a lump out of the cache, and returns true, if it is there.
+//
+static bool ZIP_readCachedLump(ZipLump *lump, void *buffer)
+{
+   zipcacheitem_t *item;
+
+   if(!(item = lump->cached))
+      return false;
+
+   memcpy(buffer, item->data, lump->size);
+
+   // now the most recently read
+   ZIP_unlinkCacheItem(item);
+   ZIP_linkCacheItem(item);
+
+   return true;
+}
+
+//
+// ZIP_cacheLumpCopy
+//
+// Keeps a copy of a lump which was just inflated into buffer, if it fits.
+//
+static void ZIP_cacheLumpCopy(ZipLump *lump, const void *buffer)
+{
+   if(!lump->size || lump->size > ZIP_cacheLimit())
+      return;
+
+   void *data = emalloc(void *, lump->size);
+   memcpy(data, buffer, lump->size);
+   ZIP_addCachedLump(lump, data);
+}
+
+//
+// Lump prefetching
+//
+// The lumps about to be needed are inflated all at once into the cache, on
+// as many threads as there are cores, so that a level starts without stalls
+// on zlib. Only lumps of mapped zips can be inflated off the main thread.
+//
+
+struct zipprefetch_t
+{
+   ZipLump       *lump;
+   const uint8_t *src;  // compressed data in the mapped file
+   void          *data; // inflated data
+   bool           ok;
+};
+
+struct zipprefetchjob_t
+{
+   zipprefetch_t      *items;
+   size_t              numitems;
+   std::atomic<size_t> next; // next item to inflate
+};
+
+static ThreadPool *zipprefetchpool;
+
+//
+// ZIP_prefetchJob
+//
+// Thread pool job; inflates items until none are left.
+//
+static void ZIP_prefetchJob(int threadnum, void *data)
+{
+   zipprefetchjob_t *job = static_cast<zipprefetchjob_t *>(data);
+   size_t            i;
+
+   while((i = job->next++) < job->numitems)
+   {
+      zipprefetch_t &item = job->items[i];
+      item.ok = ZIP_InflateMemory(item.src, item.lump->compressed, item.data,
+                                  item.lump->size);
+   }
+}
+
+//
+// ZIP_PrefetchLumps
+//
+// Inflates any of the given lumps which are deflated, in a mapped zip, and
+// not cached already, as far as the cache has room for them.
+//
+void ZIP_PrefetchLumps(ZipLump *const *lumps, size_t count)
+{
+   PODCollection<zipprefetch_t> items;
+   size_t limit = ZIP_cacheLimit();
+   size_t total = 0;
+
+   ZoneLockGuard lock;
+
+   for(size_t i = 0; i < count; i++)
+   {
+      ZipLump *lump = lumps[i];
+      const uint8_t *src;
+
+      if(lump->method != ZipFile::METHOD_DEFLATE || lump->cached ||
+         (lump->flags & ZipFile::LF_PREFETCHING) || !lump->size)
+         continue;
+
+      // no more than the cache can hold at once
+      if(total + lump->size > limit)
+         continue;
+
+      if(!(src = lump->getMappedData()))
+         continue;
+
+      zipprefetch_t &item = items.addNew();
+      item.lump = lump;
+      item.src  = src;
+      item.data = emalloc(void *, lump->size);
+      item.ok   = false;
+
+      lump->flags |= ZipFile::LF_PREFETCHING;
+      total += lump->size;
+   }
+
+   if(items.isEmpty())
+      return;
+
+   zipprefetchjob_t job;
+   job.items    = &items[0];
+   job.numitems = items.getLength();
+   job.next     = 0;
+
+   if(!zipprefetchpool)
+   {
+      zipprefetchpool = new ThreadPool();
+      zipprefetchpool->resize(ThreadPool::HardwareThreads());
+   }
+   zipprefetchpool->run(ZIP_prefetchJob, &job);
+
+   for(zipprefetch_t &item : items)
+   {
+      item.lump->flags &= ~ZipFile::LF_PREFETCHING;
+
+      // bad streams are left for ZipLump::read to report
+      if(item.ok)
+         ZIP_addCachedLump(item.lump, item.data);
+      else
+         efree(item.data);
+   }
+}
+
+//
+// ZIP_InflateLump
+//
+// Inflates a deflated lump from its compressed data in a mapped zip, as
+// returned by ZipLump::getMappedData. Safe on any thread, for the same reason
+// as ZIP_InflateMemory.
+//
+bool ZIP_InflateLump(const ZipLump *lump, const uint8_t *src, void *dest)
+{
+   return ZIP_InflateMemory(src, lump->compressed, dest, lump->size);
+}
+
+//
+// ZIP_AdoptInflatedLump
+//
+// Takes back a lump inflated in the background by ZIP_InflateLump into data,
+// which was allocated with emalloc, and which LF_PREFETCHING was set on. The
+// data is kept in the cache if it is good and the lump wasn't cached in the
+// meantime; otherwise it is freed.
+//
+void ZIP_AdoptInflatedLump(ZipLump *lump, void *data, bool ok)
+{
+   ZoneLockGuard lock;
+
+   lump->flags &= ~ZipFile::LF_PREFETCHING;
+
+   if(ok && !lump->cached && lump->size <= ZIP_cacheLimit())
+      ZIP_addCachedLump(lump, data);
+   else
+      efree(data);
+}
+
+//
+// ZipLump::getMappedData
+//
+// Returns the lump's data as it is stored in the mapped zip file, compressed
+// or not, or nullptr if the zip isn't mapped.
+//
+const uint8_t *ZipLump::getMappedData()
+{
+   size_t         mappedSize;
+   const uint8_t *mapped = file->getMapping(mappedSize);
+
+   if(!mapped)
+      return nullptr;
+
+   // find the data past the local header, once
+   if(flags & ZipFile::LF_CALCOFFSET)
+   {
+      InBuffer reader;
+
+      reader.openExisting(file->getFile(), InBuffer::LENDIAN);
+      setAddress(reader);
+   }
+
+   if(offset < 0 || size_t(offset) > mappedSize ||
+      compressed > mappedSize - size_t(offset))
+      return nullptr;
+
+   return mapped + offset;
+}
+
+//
+// ZipLump::getView
+//
+// Returns the lump's data where it lies in the mapped zip file, if it is
+// stored uncompressed and the zip could be mapped. Returns nullptr otherwise.
+//
+const void *ZipLump::getView()
+{
+   if(method != ZipFile::METHOD_STORED || compressed < size)
+      return nullptr;
+
+   return getMappedData();
+}
+
 //
 // ZipLump::read(void *)
 //
@@ -722,6 +1099,30 @@ void ZipLump::read(void *buffer)
 {
    InBuffer reader;
 
+   // stored lumps in a mapped zip are only a copy away
+   if(const void *view = getView())
+   {
+      memcpy(buffer, view, size);
+      return;
+   }
+
+   if(method == ZipFile::METHOD_DEFLATE)
+   {
+      ZoneLockGuard lock;
+      const uint8_t *src;
+
+      if(ZIP_readCachedLump(this, buffer))
+         return;
+
+      if((src = getMappedData()))
+      {
+         if(!ZIP_InflateMemory(src, compressed, buffer, size))
+            I_Error("ZipLump::read: invalid deflate stream in '%s'\n", name);
+         ZIP_cacheLumpCopy(this, buffer);
+         return;
+      }
+   }
+
    reader.openExisting(file->getFile(), InBuffer::LENDIAN);
 
    // Calculate an offset beyond the lump's local file header, if such hasn't
@@ -743,6 +1144,10 @@ void ZipLump::read(void *buffer)
       break;
    case ZipFile::METHOD_DEFLATE:
       ZIP_ReadDeflated(reader, buffer, size);
+      {
+         ZoneLockGuard lock;
+         ZIP_cacheLumpCopy(this, buffer);
+      }
       break;
    default:
       // shouldn't happen; files with other methods are removed from the directory
@@ -769,5 +1174,17 @@ void ZipLump::read(ZAutoBuffer &buf, bool asString)
    }
 }
 
+//=============================================================================
+//
+// Console Variables
+//
+
+VARIABLE_INT(zip_cachesize, NULL, 0, 1024, NULL);
+CONSOLE_VARIABLE(zip_cachesize, zip_cachesize, 0)
+{
+   ZoneLockGuard lock;
+   ZIP_trimCache(0);
+}
+
 // EOF
 
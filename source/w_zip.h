@@ -37,6 +37,7 @@ class  WadDirectory;
 class  ZAutoBuffer;
 struct ZIPEndOfCentralDir;
 class  ZipFile;
+struct zipcacheitem_t;
 
 struct ZipLump
 {
@@ -49,7 +50,11 @@ struct ZipLump
    char     *name;       // full name 
    ZipFile  *file;       // parent zipfile
 
+   zipcacheitem_t *cached; // inflated copy kept in the lump cache, if any
+
    void setAddress(InBuffer &fin);
+   const uint8_t *getMappedData();
+   const void *getView();
    void read(void *buffer);
    void read(ZAutoBuffer &buf, bool asString);
 };
@@ -81,7 +86,8 @@ public:
    enum
    {
       LF_CALCOFFSET    = 0x00000001, // Needs true data offset calculated
-      LF_ISEMBEDDEDWAD = 0x00000002  // Is an embedded WAD file
+      LF_ISEMBEDDEDWAD = 0x00000002, // Is an embedded WAD file
+      LF_PREFETCHING   = 0x00000004  // Being inflated ahead of time
    };
 
 protected:
@@ -89,6 +95,9 @@ protected:
    int      numLumps; // directory size
    FILE    *file;     // physical disk file
 
+   const uint8_t *mapped;  // file mapped into memory, if it could be
+   size_t      mappedSize;
+
    DLListItem<ZipFile> links; // links for use by WadDirectory
 
    DLListItem<ZipWad> *wads;  // wads loaded from inside the zip
@@ -99,7 +108,8 @@ protected:
 
 public:
    ZipFile() 
-      : ZoneObject(), lumps(NULL), numLumps(0), file(NULL), links(), wads(NULL) 
+      : ZoneObject(), lumps(NULL), numLumps(0), file(NULL), mapped(NULL),
+        mappedSize(0), links(), wads(NULL) 
    {
    }
    
@@ -114,8 +124,19 @@ public:
    int      findLump(const char *name) const;
    int      getNumLumps() const { return numLumps; }   
    FILE    *getFile()     const { return file;     }
+
+   // The mapping belongs to the caller, and must outlive the ZipFile
+   void setMapping(const uint8_t *base, size_t size) { mapped = base; mappedSize = size; }
+   const uint8_t *getMapping(size_t &size) const { size = mappedSize; return mapped; }
 };
 
+// Size limit of the inflated lump cache, in megabytes
+extern int zip_cachesize;
+
+void ZIP_PrefetchLumps(ZipLump *const *lumps, size_t count);
+bool ZIP_InflateLump(const ZipLump *lump, const uint8_t *src, void *dest);
+void ZIP_AdoptInflatedLump(ZipLump *lump, void *data, bool ok);
+
 #endif
 
 // EOF
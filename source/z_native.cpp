@@ -29,17 +29,28 @@
 // When running with this heap, there is no limitation to the amount of memory
 // allocated except what the system will provide.
 //
+// Purgables are dumped least recently used first, whenever they add up to
+// more than zone_cachesize megabytes or the machine runs out of RAM.
+//
+// During level setup, small PU_LEVEL blocks are packed into large arena
+// chunks rather than each getting a malloc of its own.
+//
 // Limitations:
-// * Purgables are never currently dumped unless the machine runs out of RAM.
 // * Instrumentation cannot track the amount of free memory.
 // * Heap check is limited to a zone ID check.
 //
 //-----------------------------------------------------------------------------
 
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+
 #include "z_zone.h"
 #include "i_system.h"
+#include "c_io.h"
 #include "doomstat.h"
 #include "m_argv.h"
+#include "z_pool.h"
 
 //=============================================================================
 //
@@ -96,7 +107,9 @@ typedef struct memblock
   struct memblock *next,**prev;
   size_t size;
   void **user;
+  struct arenachunk *chunk;  // arena chunk the block was carved from, if any
   unsigned char tag;
+  unsigned short site;       // call site it's charged to in the statistics
 
 #ifdef INSTRUMENTED
   const char *file;
@@ -118,8 +131,529 @@ static const size_t header_size = (sizeof(memblock_t) + 15) & ~15;
 static memblock_t *blockbytag[PU_MAX];   // used for tracking all zone blocks
 
 // ZoneObject class statics
-ZoneObject *ZoneObject::objectbytag[PU_MAX]; // like blockbytag but for objects
-void       *ZoneObject::newalloc;            // most recent ZoneObject alloc
+ZoneObject   *ZoneObject::objectbytag[PU_MAX]; // like blockbytag but for objects
+thread_local void *ZoneObject::newalloc;       // most recent ZoneObject alloc
+
+//=============================================================================
+//
+// Allocation Statistics
+//
+// Unlike INSTRUMENTED, these are always built. Live blocks and bytes are kept
+// per tag at all times, along with counts of allocations and frees. While
+// z_statsample is N > 0, every Nth allocation is also charged to the file and
+// line it was made from, and its free is charged back there, so the call
+// sites making the most of them can be found; and the totals of each tic are
+// kept in a rolling timeline of the last ZSTAT_TIMELINE tics.
+//
+
+#define ZSTAT_MAXSITES  4096        // call sites tracked; a power of two
+#define ZSTAT_TIMELINE  (35*60*5)   // tics kept in the timeline
+
+static const char *namefortag[PU_MAX] =
+{
+   "PU_FREE", 
+   "PU_STATIC",
+   "PU_PERMANENT",
+   "PU_SOUND",
+   "PU_MUSIC",
+   "PU_RENDERER",
+   "PU_VALLOC",
+   "PU_AUTO",
+   "PU_LEVEL",
+   "PU_CACHE",
+};
+
+int z_statsample; // charge every Nth allocation to its call site; 0 = off
+
+struct zonetagstats_t
+{
+   size_t   liveblocks, livebytes;
+   uint64_t allocs, frees;
+};
+
+struct zonesite_t
+{
+   const char *file;
+   int         line;
+   uint64_t    allocs, frees;          // sampled blocks
+   uint64_t    allocbytes, freedbytes;
+};
+
+struct zonetic_t
+{
+   int      tic;
+   uint32_t allocs, frees;
+   uint64_t allocbytes, freedbytes;
+   size_t   livebytes[PU_MAX];         // as of the end of the tic
+};
+
+static zonetagstats_t tagstats[PU_MAX];
+
+static zonesite_t zonesites[ZSTAT_MAXSITES]; // index 0 is never used
+static int        numzonesites;
+static int        samplecount;
+
+static zonetic_t *timeline;
+static int        timelinehead; // newest entry
+static int        timelinelen;
+
+//
+// Z_findSite
+//
+// Finds or adds the statistics of a call site. Returns 0 if the table is
+// full.
+//
+static int Z_findSite(const char *file, int line)
+{
+   unsigned int hash = (unsigned int)(((uintptr_t)file >> 3) * 31 + line);
+
+   for(int i = 0; i < ZSTAT_MAXSITES; i++)
+   {
+      int idx = (hash + i) & (ZSTAT_MAXSITES - 1);
+      zonesite_t &site = zonesites[idx];
+
+      if(!idx)
+         continue;
+      if(site.file == file && site.line == line)
+         return idx;
+      if(!site.file)
+      {
+         if(numzonesites == ZSTAT_MAXSITES - 2) // keep a hole to end searches
+            return 0;
+         ++numzonesites;
+         site.file = file;
+         site.line = line;
+         return idx;
+      }
+   }
+
+   return 0;
+}
+
+//
+// Z_timelineTic
+//
+// Returns the timeline entry for the current tic, starting a new one if the
+// tic has moved on.
+//
+static zonetic_t *Z_timelineTic()
+{
+   if(!timeline && !(timeline = (zonetic_t *)(calloc(ZSTAT_TIMELINE, sizeof(zonetic_t)))))
+      return NULL;
+
+   if(!timelinelen || timeline[timelinehead].tic != gametic)
+   {
+      if(timelinelen)
+      {
+         for(int tag = 0; tag < PU_MAX; tag++)
+            timeline[timelinehead].livebytes[tag] = tagstats[tag].livebytes;
+      }
+
+      timelinehead = (timelinehead + 1) % ZSTAT_TIMELINE;
+      if(timelinelen < ZSTAT_TIMELINE)
+         ++timelinelen;
+
+      memset(&timeline[timelinehead], 0, sizeof(zonetic_t));
+      timeline[timelinehead].tic = gametic;
+   }
+
+   return &timeline[timelinehead];
+}
+
+//
+// Z_recordAlloc
+//
+static void Z_recordAlloc(memblock_t *block, int tag, const char *file, int line)
+{
+   tagstats[tag].allocs++;
+   block->site = 0;
+
+   if(z_statsample <= 0)
+      return;
+
+   if(++samplecount >= z_statsample)
+   {
+      samplecount = 0;
+      if((block->site = (unsigned short)(Z_findSite(file, line))))
+      {
+         zonesites[block->site].allocs++;
+         zonesites[block->site].allocbytes += block->size;
+      }
+   }
+
+   if(zonetic_t *zt = Z_timelineTic())
+   {
+      zt->allocs++;
+      zt->allocbytes += block->size;
+   }
+}
+
+//
+// Z_recordFree
+//
+static void Z_recordFree(memblock_t *block)
+{
+   tagstats[block->tag].frees++;
+
+   if(block->site)
+   {
+      zonesites[block->site].frees++;
+      zonesites[block->site].freedbytes += block->size;
+   }
+
+   if(z_statsample <= 0)
+      return;
+
+   if(zonetic_t *zt = Z_timelineTic())
+   {
+      zt->frees++;
+      zt->freedbytes += block->size;
+   }
+}
+
+//
+// Z_ResetStats
+//
+// Forgets the call sites and the timeline.
+//
+void Z_ResetStats()
+{
+   ZoneLockGuard lock;
+
+   for(int tag = 0; tag < PU_MAX; tag++)
+      tagstats[tag].allocs = tagstats[tag].frees = 0;
+
+   // blocks charged to a site no longer count toward it
+   for(int tag = PU_FREE + 1; tag < PU_MAX; tag++)
+   {
+      for(memblock_t *block = blockbytag[tag]; block; block = block->next)
+         block->site = 0;
+   }
+
+   memset(zonesites, 0, sizeof(zonesites));
+   numzonesites = 0;
+   samplecount  = 0;
+   timelinelen  = 0;
+}
+
+//
+// Z_PrintTagStats
+//
+void Z_PrintTagStats()
+{
+   ZoneLockGuard lock;
+   zonetagstats_t stats[PU_MAX];
+
+   // printing may allocate
+   memcpy(stats, tagstats, sizeof(stats));
+
+   C_Printf("tag          blocks        KB      allocs       frees\n");
+   for(int tag = PU_FREE + 1; tag < PU_MAX; tag++)
+   {
+      C_Printf("%-12s %6u %9u %11llu %11llu\n", namefortag[tag],
+               (unsigned int)stats[tag].liveblocks,
+               (unsigned int)(stats[tag].livebytes >> 10),
+               (unsigned long long)stats[tag].allocs,
+               (unsigned long long)stats[tag].frees);
+   }
+}
+
+//
+// Z_PrintTopAllocators
+//
+// Lists the call sites which have allocated the most bytes since the
+// statistics were reset, whether or not they've been freed since.
+//
+void Z_PrintTopAllocators(int count)
+{
+   ZoneLockGuard lock;
+   static zonesite_t sites[ZSTAT_MAXSITES];
+   int numsites = 0;
+
+   for(const zonesite_t &site : zonesites)
+   {
+      if(site.file)
+         sites[numsites++] = site;
+   }
+
+   std::sort(sites, sites + numsites,
+             [](const zonesite_t &a, const zonesite_t &b) {
+                return a.allocbytes > b.allocbytes;
+             });
+
+   if(!numsites)
+   {
+      C_Printf("No call sites recorded; set z_statsample first\n");
+      return;
+   }
+
+   // counts are scaled back up by the sampling rate
+   const uint64_t scale = z_statsample > 0 ? z_statsample : 1;
+
+   C_Printf("     allocs   alloc KB    live KB  source\n");
+   for(int i = 0; i < numsites && i < count; i++)
+   {
+      const zonesite_t &site = sites[i];
+
+      C_Printf("%11llu %10llu %10lld  %s:%d\n",
+               (unsigned long long)(site.allocs * scale),
+               (unsigned long long)((site.allocbytes * scale) >> 10),
+               (long long)(((int64_t)(site.allocbytes - site.freedbytes) * (int64_t)scale) / 1024),
+               site.file, site.line);
+   }
+}
+
+//
+// Z_WriteTimeline
+//
+// Writes the timeline to a CSV file, oldest tic first. Returns false if the
+// file couldn't be written.
+//
+bool Z_WriteTimeline(const char *filename)
+{
+   ZoneLockGuard lock;
+   FILE *f;
+
+   if(!(f = fopen(filename, "w")))
+      return false;
+
+   fputs("tic,allocs,frees,allocbytes,freedbytes", f);
+   for(int tag = PU_FREE + 1; tag < PU_MAX; tag++)
+      fprintf(f, ",%s", namefortag[tag]);
+   fputc('\n', f);
+
+   // the current tic isn't over yet, so its live bytes are as of now
+   if(timelinelen)
+   {
+      for(int tag = 0; tag < PU_MAX; tag++)
+         timeline[timelinehead].livebytes[tag] = tagstats[tag].livebytes;
+   }
+
+   for(int i = timelinelen - 1; i >= 0; i--)
+   {
+      const zonetic_t &zt = timeline[(timelinehead - i + ZSTAT_TIMELINE) % ZSTAT_TIMELINE];
+
+      fprintf(f, "%d,%u,%u,%llu,%llu", zt.tic, zt.allocs, zt.frees,
+              (unsigned long long)zt.allocbytes, (unsigned long long)zt.freedbytes);
+      for(int tag = PU_FREE + 1; tag < PU_MAX; tag++)
+         fprintf(f, ",%llu", (unsigned long long)zt.livebytes[tag]);
+      fputc('\n', f);
+   }
+
+   return !fclose(f);
+}
+
+//=============================================================================
+//
+// Cache Budget
+//
+// The PU_CACHE chain is kept in least-recently-used order. A block goes to
+// the head of the chain when it is tagged PU_CACHE or touched again through
+// Z_TouchCache, so the block at its tail is always the stalest one. Between
+// frames, Z_TrimCache lets go of blocks from the tail while the chain holds
+// more than zone_cachesize megabytes; when malloc fails, only as many are let
+// go of as it takes for the allocation to succeed.
+//
+
+int zone_cachesize = 256; // megabytes of PU_CACHE blocks to keep; 0 = no limit
+
+static memblock_t *cachetail;  // least recently used PU_CACHE block
+static size_t      cachebytes; // bytes held in PU_CACHE blocks
+
+static void Z_purgeCache(size_t bytes);
+
+//
+// Z_linkBlock
+//
+// Puts a block at the head of the chain for a tag.
+//
+static void Z_linkBlock(memblock_t *block, int tag)
+{
+   if((block->next = blockbytag[tag]))
+      block->next->prev = &block->next;
+   else if(tag == PU_CACHE)
+      cachetail = block;
+   blockbytag[tag] = block;
+   block->prev = &blockbytag[tag];
+
+   if(tag == PU_CACHE)
+      cachebytes += block->size;
+
+   tagstats[tag].liveblocks++;
+   tagstats[tag].livebytes += block->size;
+}
+
+//
+// Z_unlinkBlock
+//
+// Takes a block out of the chain for its current tag.
+//
+static void Z_unlinkBlock(memblock_t *block)
+{
+   if(block->tag == PU_CACHE)
+   {
+      // the block before this one, if any, becomes the tail
+      if(block == cachetail)
+      {
+         cachetail = block->prev == &blockbytag[PU_CACHE] ? NULL :
+            (memblock_t *)((byte *)block->prev - offsetof(memblock_t, next));
+      }
+      cachebytes -= block->size;
+   }
+
+   tagstats[block->tag].liveblocks--;
+   tagstats[block->tag].livebytes -= block->size;
+
+   if((*block->prev = block->next))
+      block->next->prev = block->prev;
+}
+
+//=============================================================================
+//
+// Level Arena
+//
+// Level setup makes thousands of small PU_LEVEL allocations which all live
+// until the next level is set up. While ZoneArenaGuard is in effect, these
+// are carved one after another out of large chunks. A chunk counts the
+// blocks in it which are still in use, and is only released once the last
+// of them has been freed, so every block can still be freed, retagged or
+// reallocated one at a time exactly as if it had been malloc'ed.
+//
+
+#define ARENA_CHUNKSIZE (1024*1024) // size of an arena chunk
+#define ARENA_MAXALLOC  (64*1024)   // larger blocks are malloc'ed anyway
+
+struct arenachunk
+{
+   size_t used; // bytes taken from the chunk, its own header included
+   size_t live; // blocks in the chunk not yet freed
+};
+
+static const size_t arenaheader_size = (sizeof(arenachunk) + 15) & ~15;
+
+static arenachunk *arenacur;   // chunk being filled
+static int         arenadepth; // active ZoneArenaGuards
+
+//
+// Z_SetLevelArena
+//
+// Called by ZoneArenaGuard.
+//
+void Z_SetLevelArena(bool enable)
+{
+   arenadepth += enable ? 1 : -1;
+}
+
+//
+// Z_arenaAlloc
+//
+// Carves a block of the given size, header included, out of the current
+// chunk, starting a new chunk if it's full. Returns NULL if no chunk could be
+// had.
+//
+static memblock_t *Z_arenaAlloc(size_t bytes)
+{
+   bytes = (bytes + 15) & ~15;
+
+   if(!arenacur || arenacur->used + bytes > ARENA_CHUNKSIZE)
+   {
+      arenachunk *chunk;
+
+      while(!(chunk = (arenachunk *)(malloc(ARENA_CHUNKSIZE))) && cachetail)
+         Z_purgeCache(ARENA_CHUNKSIZE);
+      if(!chunk)
+         return NULL;
+
+      // the full chunk is released along with its last block
+      if(arenacur && !arenacur->live)
+         free(arenacur);
+
+      arenacur = chunk;
+      arenacur->used = arenaheader_size;
+      arenacur->live = 0;
+   }
+
+   memblock_t *block = (memblock_t *)((byte *)arenacur + arenacur->used);
+
+   arenacur->used += bytes;
+   arenacur->live++;
+   block->chunk = arenacur;
+
+   return block;
+}
+
+//
+// Z_releaseBlock
+//
+// Gives back the memory of a block that has been freed.
+//
+static void Z_releaseBlock(memblock_t *block)
+{
+   arenachunk *chunk = block->chunk;
+
+   if(!chunk)
+   {
+      free(block);
+      return;
+   }
+
+   if(--chunk->live)
+      return;
+
+   // the current chunk is emptied and filled again from the start
+   if(chunk == arenacur)
+      chunk->used = arenaheader_size;
+   else
+      free(chunk);
+}
+
+//=============================================================================
+//
+// Heap Locking
+//
+// The heap is normally only touched from the main thread. While the renderer
+// has worker threads running (see r_context.cpp) all heap operations, along 
+// with any lazily-filled caches that live on the heap, are serialized through
+// one recursive mutex. The lock is skipped entirely when locking is disabled,
+// so single-threaded operation pays nothing more than a flag test.
+//
+
+static std::recursive_mutex zonemutex;
+static bool                 zonelocking;
+
+//
+// Z_SetLocking
+//
+// Turns heap locking on or off. Must only be called from the main thread 
+// while no other thread can be inside the zone heap.
+//
+void Z_SetLocking(bool enable)
+{
+   zonelocking = enable;
+}
+
+//
+// Z_Lock
+//
+// Acquires the heap lock if locking is enabled. Returns true if the lock was
+// taken, in which case Z_Unlock must be called to release it.
+//
+bool Z_Lock()
+{
+   if(!zonelocking)
+      return false;
+
+   zonemutex.lock();
+   return true;
+}
+
+//
+// Z_Unlock
+//
+void Z_Unlock()
+{
+   zonemutex.unlock();
+}
 
 //=============================================================================
 //
@@ -303,6 +837,70 @@ void Z_Init(void)
 // Core Memory Management Routines
 //
 
+//
+// Z_purgeCache
+//
+// Frees the least recently used PU_CACHE blocks until at least the given
+// number of bytes has been let go of, or none are left.
+//
+static void Z_purgeCache(size_t bytes)
+{
+   size_t freed = 0;
+
+   while(cachetail && freed < bytes)
+   {
+      freed += cachetail->size + header_size;
+      (Z_Free)((byte *)cachetail + header_size, __FILE__, __LINE__);
+   }
+}
+
+//
+// Z_TrimCache
+//
+// Brings the PU_CACHE blocks back within zone_cachesize. Called once a frame,
+// at a point where no code can be holding on to a purgable block.
+//
+void Z_TrimCache()
+{
+   ZoneLockGuard lock;
+
+   if(zone_cachesize <= 0)
+      return;
+
+   const size_t budget = static_cast<size_t>(zone_cachesize) << 20;
+
+   while(cachetail && cachebytes > budget)
+      (Z_Free)((byte *)cachetail + header_size, __FILE__, __LINE__);
+}
+
+//
+// Z_TouchCache
+//
+// Marks a PU_CACHE block as just used, so that it's the last to be let go of.
+// Blocks of other tags are left alone.
+//
+void Z_TouchCache(void *ptr)
+{
+   ZoneLockGuard lock;
+   memblock_t *block = (memblock_t *)((byte *)ptr - header_size);
+
+   if(block->tag == PU_CACHE && blockbytag[PU_CACHE] != block)
+   {
+      Z_unlinkBlock(block);
+      Z_linkBlock(block, PU_CACHE);
+   }
+}
+
+//
+// Z_CacheBytes
+//
+// Returns the number of bytes held in PU_CACHE blocks.
+//
+size_t Z_CacheBytes()
+{
+   return cachebytes;
+}
+
 //
 // Z_Malloc
 //
@@ -310,6 +908,7 @@ void Z_Init(void)
 //
 void *(Z_Malloc)(size_t size, int tag, void **user, const char *file, int line)
 {
+   ZoneLockGuard lock;
    memblock_t *block;
    byte *ret;
 
@@ -322,13 +921,16 @@ void *(Z_Malloc)(size_t size, int tag, void **user, const char *file, int line)
    if(!size)
       return user ? *user = NULL : NULL;          // malloc(0) returns NULL
    
-   if(!(block = (memblock_t *)(malloc(size + header_size))))
+   block = NULL;
+   if(tag == PU_LEVEL && arenadepth > 0 && size + header_size <= ARENA_MAXALLOC)
+      block = Z_arenaAlloc(size + header_size);
+
+   if(!block)
    {
-      if(blockbytag[PU_CACHE])
-      {
-         Z_FreeTags(PU_CACHE, PU_CACHE);
-         block = (memblock_t *)(malloc(size + header_size));
-      }
+      while(!(block = (memblock_t *)(malloc(size + header_size))) && cachetail)
+         Z_purgeCache(size + header_size);
+      if(block)
+         block->chunk = NULL;
    }
 
    if(!block)
@@ -339,10 +941,8 @@ void *(Z_Malloc)(size_t size, int tag, void **user, const char *file, int line)
    
    block->size = size;
    
-   if((block->next = blockbytag[tag]))
-      block->next->prev = &block->next;
-   blockbytag[tag] = block;
-   block->prev = &blockbytag[tag];
+   Z_recordAlloc(block, tag, file, line);
+   Z_linkBlock(block, tag);
            
    INSTRUMENT(memorybytag[tag] += block->size);
    INSTRUMENT(block->file = file);
@@ -371,6 +971,8 @@ void *(Z_Malloc)(size_t size, int tag, void **user, const char *file, int line)
 //
 void (Z_Free)(void *p, const char *file, int line)
 {
+   ZoneLockGuard lock;
+
    DEBUG_CHECKHEAP();
 
    if(p)
@@ -402,6 +1004,8 @@ void (Z_Free)(void *p, const char *file, int line)
                      );
       }
       INSTRUMENT(memorybytag[block->tag] -= block->size);
+      Z_recordFree(block);
+      Z_unlinkBlock(block);
       block->tag = PU_FREE;       // Mark block freed
 
       // scramble memory -- weed out any bugs
@@ -410,10 +1014,7 @@ void (Z_Free)(void *p, const char *file, int line)
       if(block->user)            // Nullify user if one exists
          *block->user = NULL;
 
-      if((*block->prev = block->next))
-         block->next->prev = block->prev;
-         
-      free(block);
+      Z_releaseBlock(block);
          
       Z_LogPrintf("* Z_Free(p=%p, file=%s:%d)\n", p, file, line);
    }
@@ -424,10 +1025,14 @@ void (Z_Free)(void *p, const char *file, int line)
 //
 void (Z_FreeTags)(int lowtag, int hightag, const char *file, int line)
 {
+   ZoneLockGuard lock;
    memblock_t *block;
 
    // haleyjd 03/30/2011: delete ZoneObjects of the same tags as well
    ZoneObject::FreeTags(lowtag, hightag);
+
+   // pooled objects go away with their pools' blocks
+   ZonePool::FreeTags(lowtag, hightag);
    
    if(lowtag <= PU_FREE)
       lowtag = PU_FREE+1;
@@ -459,6 +1064,7 @@ void (Z_FreeTags)(int lowtag, int hightag, const char *file, int line)
 //
 void (Z_ChangeTag)(void *ptr, int tag, const char *file, int line)
 {
+   ZoneLockGuard lock;
    memblock_t *block;
    
    DEBUG_CHECKHEAP();
@@ -483,12 +1089,9 @@ void (Z_ChangeTag)(void *ptr, int tag, const char *file, int line)
              "Z_ChangeTag: an owner is required for purgable blocks",
              block, file, line);
 
-   if((*block->prev = block->next))
-      block->next->prev = block->prev;
-   if((block->next = blockbytag[tag]))
-      block->next->prev = &block->next;
-   block->prev = &blockbytag[tag];
-   blockbytag[tag] = block;
+   // retagging a block PU_CACHE also makes it the most recently used
+   Z_unlinkBlock(block);
+   Z_linkBlock(block, tag);
 
    INSTRUMENT(memorybytag[block->tag] -= block->size);
    INSTRUMENT(memorybytag[tag] += block->size);
@@ -499,6 +1102,69 @@ void (Z_ChangeTag)(void *ptr, int tag, const char *file, int line)
                ptr, tag, file, line);
 }
 
+//
+// Z_ChangeUser
+//
+// Sets a new owner pointer for a block, and points the owner at the block.
+// This lets a block be filled in privately and then published all at once,
+// which matters when other threads may be testing the owner pointer.
+//
+void (Z_ChangeUser)(void *ptr, void **user, const char *file, int line)
+{
+   ZoneLockGuard lock;
+   memblock_t *block;
+
+   if(!ptr)
+   {
+      I_FatalError(I_ERR_KILL,
+                   "Z_ChangeUser: can't change a NULL pointer at %s:%d\n",
+                   file, line);
+   }
+
+   block = (memblock_t *)((byte *) ptr - header_size);
+
+   Z_IDCheck(IDBOOL(block->id != ZONEID),
+             "Z_ChangeUser: Changed a user without ZONEID", block, file, line);
+
+   Z_IDCheck(IDBOOL(block->tag >= PU_PURGELEVEL && !user),
+             "Z_ChangeUser: an owner is required for purgable blocks",
+             block, file, line);
+
+   if(block->user)
+      *block->user = NULL;
+
+   block->user = user;
+   if(user)
+      *user = ptr;
+
+   Z_LogPrintf("* Z_ChangeUser(p=%p, user=%p, file=%s:%d)\n",
+               ptr, user, file, line);
+}
+
+//
+// Z_moveArenaBlock
+//
+// Reallocates a block from the level arena by copying it to a new block.
+//
+static void *Z_moveArenaBlock(memblock_t *block, size_t n, int tag, void **user,
+                              const char *file, int line)
+{
+   void *ptr = (byte *)block + header_size;
+
+   // nullify current user, if any, so freeing the old block won't touch
+   // the new one's
+   if(block->user)
+      *block->user = NULL;
+   block->user = NULL;
+
+   void *p = (Z_Malloc)(n, tag, user, file, line);
+   memcpy(p, ptr, n < block->size ? n : block->size);
+
+   (Z_Free)(ptr, file, line);
+
+   return p;
+}
+
 //
 // Z_Realloc
 //
@@ -508,6 +1174,7 @@ void (Z_ChangeTag)(void *ptr, int tag, const char *file, int line)
 void *(Z_Realloc)(void *ptr, size_t n, int tag, void **user,
                   const char *file, int line)
 {
+   ZoneLockGuard lock;
    void *p;
    memblock_t *block, *newblock, *origblock;
 
@@ -534,29 +1201,28 @@ void *(Z_Realloc)(void *ptr, size_t n, int tag, void **user,
    if(block->tag == PU_PERMANENT)
       tag = PU_PERMANENT;
 
+   // blocks in the level arena can't be given to realloc; copy them instead
+   if(block->chunk)
+      return Z_moveArenaBlock(block, n, tag, user, file, line);
+
    // nullify current user, if any
    if(block->user)
       *(block->user) = NULL;
 
    // detach from list before reallocation
-   if((*block->prev = block->next))
-      block->next->prev = block->prev;
+   Z_recordFree(block);
+   Z_unlinkBlock(block);
 
    block->next = NULL;
    block->prev = NULL;
 
    INSTRUMENT(memorybytag[block->tag] -= block->size);
 
-   if(!(newblock = (memblock_t *)(realloc(block, n + header_size))))
-   {
-      // haleyjd 07/09/10: Note that unlinking the block above makes this safe 
-      // even if the current block is PU_CACHE; Z_FreeTags won't find it.
-      if(blockbytag[PU_CACHE])
-      {
-         Z_FreeTags(PU_CACHE, PU_CACHE);
-         newblock = (memblock_t *)(realloc(block, n + header_size));
-      }
-   }
+   // haleyjd 07/09/10: Note that unlinking the block above makes this safe 
+   // even if the current block is PU_CACHE; the purge won't find it.
+   while(!(newblock = (memblock_t *)(realloc(block, n + header_size))) &&
+         cachetail)
+      Z_purgeCache(n + header_size);
 
    if(!(block = newblock))
    {
@@ -583,10 +1249,8 @@ void *(Z_Realloc)(void *ptr, size_t n, int tag, void **user,
       *user = p;
 
    // reattach to list at possibly new address, new tag
-   if((block->next = blockbytag[tag]))
-      block->next->prev = &block->next;
-   blockbytag[tag] = block;
-   block->prev = &blockbytag[tag];
+   Z_recordAlloc(block, tag, file, line);
+   Z_linkBlock(block, tag);
 
    INSTRUMENT(memorybytag[tag] += block->size);
    INSTRUMENT(block->file = file);
@@ -656,6 +1320,7 @@ void (Z_CheckHeap)(const char *file, int line)
 //
 int (Z_CheckTag)(void *ptr, const char *file, int line)
 {
+   ZoneLockGuard lock;
    memblock_t *block = (memblock_t *)((byte *) ptr - header_size);
 
    DEBUG_CHECKHEAP();
@@ -733,20 +1398,6 @@ void Z_PrintZoneHeap(void)
 //
 void Z_DumpCore()
 {
-   static const char *namefortag[PU_MAX] =
-   {
-      "PU_FREE", 
-      "PU_STATIC",
-      "PU_PERMANENT",
-      "PU_SOUND",
-      "PU_MUSIC",
-      "PU_RENDERER",
-      "PU_VALLOC",
-      "PU_AUTO",
-      "PU_LEVEL",
-      "PU_CACHE",
-   };
-
    int tag;
    memblock_t *block;
    uint32_t dirofs = 12;
@@ -893,6 +1544,8 @@ void Z_SysFree(void *p)
 //
 void Z_FreeAlloca(void)
 {
+   ZoneLockGuard lock;
+
    memblock_t *block = blockbytag[PU_AUTO];
 
    if(!block)
@@ -1012,6 +1665,8 @@ ZoneObject::ZoneObject()
 {
    if(newalloc)
    {
+      ZoneLockGuard lock;
+
       zonealloc = newalloc;
       newalloc  = NULL;
       addToTagList(getZoneTag());
@@ -1055,6 +1710,7 @@ void ZoneObject::changeTag(int tag)
 {
    if(zonealloc) // If not a zone object, this is a no-op
    {
+      ZoneLockGuard lock;
       int curtag = getZoneTag();
 
       // not actually changing?
@@ -1082,6 +1738,7 @@ ZoneObject::~ZoneObject()
 {
    if(zonealloc)
    {
+      ZoneLockGuard lock;
       removeFromTagList();
       zonealloc = NULL;
    }
@@ -1124,6 +1781,7 @@ void ZoneObject::operator delete (void *p, int, void **)
 //
 void ZoneObject::FreeTags(int lowtag, int hightag)
 {
+   ZoneLockGuard lock;
    ZoneObject *obj;
 
    if(lowtag <= PU_FREE)
@@ -0,0 +1,125 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Fixed-size object pools carved from large zone blocks.
+//
+//      Objects which are created and destroyed constantly, such as Mobj,
+//      cost a zone block header each and end up scattered all over the heap,
+//      so every walk over a thing list misses the cache on every link. A pool
+//      keeps them packed together, in the order they were spawned.
+//
+//-----------------------------------------------------------------------------
+
+#include "z_zone.h"
+#include "z_pool.h"
+
+// All pools, for Z_FreeTags
+ZonePool *ZonePool::pools;
+
+//
+// ZonePool Constructor
+//
+// Pools are meant to be static objects. No memory is taken until the first
+// object is allocated.
+//
+ZonePool::ZonePool(size_t size, size_t count, int pooltag)
+   : objsize((size + 15) & ~size_t(15)), blockobjs(count), tag(pooltag),
+     freecells(nullptr), nextcell(nullptr), endcell(nullptr), nextpool(pools)
+{
+   pools = this;
+}
+
+//
+// ZonePool::reset
+//
+// Forgets all objects, after the zone blocks holding them were freed.
+//
+void ZonePool::reset()
+{
+   freecells = nullptr;
+   nextcell  = nullptr;
+   endcell   = nullptr;
+}
+
+//
+// ZonePool::alloc
+//
+// Returns a zero-filled object, taking a new zone block if there is no room
+// left in the pool.
+//
+void *ZonePool::alloc()
+{
+   ZoneLockGuard lock;
+   void *ptr;
+
+   if(freecells)
+   {
+      ptr = freecells;
+      freecells = freecells->next;
+   }
+   else
+   {
+      if(nextcell == endcell)
+      {
+         nextcell = emalloctag(char *, objsize * blockobjs, tag, nullptr);
+         endcell  = nextcell + objsize * blockobjs;
+      }
+      ptr = nextcell;
+      nextcell += objsize;
+   }
+
+   return memset(ptr, 0, objsize);
+}
+
+//
+// ZonePool::free
+//
+// Returns an object to the pool. The zone block it came from is kept.
+//
+void ZonePool::free(void *ptr)
+{
+   ZoneLockGuard lock;
+   poolcell_t *cell = static_cast<poolcell_t *>(ptr);
+
+   cell->next = freecells;
+   freecells  = cell;
+}
+
+//
+// ZonePool::FreeTags
+//
+// Called from Z_FreeTags. Empties every pool whose blocks are about to be
+// freed.
+//
+void ZonePool::FreeTags(int lowtag, int hightag)
+{
+   for(ZonePool *pool = pools; pool; pool = pool->nextpool)
+   {
+      if(pool->tag >= lowtag && pool->tag <= hightag)
+         pool->reset();
+   }
+}
+
+// EOF
+
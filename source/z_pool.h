@@ -0,0 +1,76 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Fixed-size object pools carved from large zone blocks.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef Z_POOL_H__
+#define Z_POOL_H__
+
+//
+// ZonePool
+//
+// Hands out zero-filled objects of one size, packed side by side in large
+// zone blocks of the pool's tag instead of each getting a block of its own.
+// Freed objects are reused before fresh space is taken. The blocks vanish in
+// Z_FreeTags along with the rest of their tag, and the objects in them are
+// NOT destroyed as other ZoneObjects would be, so only classes which need no
+// destruction at that point may be pooled.
+//
+class ZonePool
+{
+protected:
+   struct poolcell_t
+   {
+      poolcell_t *next;
+   };
+
+   size_t      objsize;   // bytes per object, rounded up for alignment
+   size_t      blockobjs; // objects per zone block
+   int         tag;       // tag of the zone blocks
+   poolcell_t *freecells; // objects freed for reuse
+   char       *nextcell;  // unused space in the newest block
+   char       *endcell;
+   ZonePool   *nextpool;  // next pool in the global list
+
+   static ZonePool *pools;
+
+   void reset();
+
+public:
+   ZonePool(size_t size, size_t count, int pooltag);
+
+   void *alloc();
+   void  free(void *ptr);
+
+   size_t getObjectSize() const { return objsize; }
+
+   static void FreeTags(int lowtag, int hightag);
+};
+
+#endif
+
+// EOF
+
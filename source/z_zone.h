@@ -101,6 +101,7 @@ void *(Z_Malloc)(size_t size, int tag, void **ptr, const char *, int);
 void  (Z_Free)(void *ptr, const char *, int);
 void  (Z_FreeTags)(int lowtag, int hightag, const char *, int);
 void  (Z_ChangeTag)(void *ptr, int tag, const char *, int);
+void  (Z_ChangeUser)(void *ptr, void **user, const char *, int);
 void   Z_Init();
 void *(Z_Calloc)(size_t n, size_t n2, int tag, void **user, const char *, int);
 void *(Z_Realloc)(void *p, size_t n, int tag, void **user, const char *, int);
@@ -112,6 +113,65 @@ char *(Z_Strdupa)(const char *s, const char *file, int line);
 void  (Z_CheckHeap)(const char *, int);   
 int   (Z_CheckTag)(void *, const char *, int);
 
+// Least-recently-used purging of PU_CACHE blocks
+extern int zone_cachesize; // megabytes of PU_CACHE blocks to keep; 0 = no limit
+
+void   Z_TrimCache();
+void   Z_TouchCache(void *ptr);
+size_t Z_CacheBytes();
+
+// Allocation statistics, kept per tag and, while sampling, per call site
+extern int z_statsample; // charge every Nth allocation to its call site; 0 = off
+
+void Z_PrintTagStats();
+void Z_PrintTopAllocators(int count);
+bool Z_WriteTimeline(const char *filename);
+void Z_ResetStats();
+
+// Heap locking, for use while other threads may allocate (see r_context.cpp)
+void Z_SetLocking(bool enable);
+bool Z_Lock();
+void Z_Unlock();
+
+//
+// ZoneLockGuard
+//
+// Holds the heap lock for the lifetime of the object, if locking is enabled.
+// The lock is recursive, so guards may nest freely.
+//
+class ZoneLockGuard
+{
+protected:
+   bool locked;
+
+public:
+   ZoneLockGuard() : locked(Z_Lock()) {}
+   ~ZoneLockGuard() { if(locked) Z_Unlock(); }
+
+   ZoneLockGuard(const ZoneLockGuard &) = delete;
+   ZoneLockGuard &operator = (const ZoneLockGuard &) = delete;
+};
+
+// Level arena, for allocations made while setting up a level
+void Z_SetLevelArena(bool enable);
+
+//
+// ZoneArenaGuard
+//
+// For the lifetime of the object, small PU_LEVEL blocks are carved out of
+// large arena chunks. Blocks are otherwise no different, and may be freed,
+// retagged and reallocated as usual. Guards may nest.
+//
+class ZoneArenaGuard
+{
+public:
+   ZoneArenaGuard()  { Z_SetLevelArena(true);  }
+   ~ZoneArenaGuard() { Z_SetLevelArena(false); }
+
+   ZoneArenaGuard(const ZoneArenaGuard &) = delete;
+   ZoneArenaGuard &operator = (const ZoneArenaGuard &) = delete;
+};
+
 void *Z_SysMalloc(size_t size);
 void *Z_SysCalloc(size_t n1, size_t n2);
 void *Z_SysRealloc(void *ptr, size_t size);
@@ -120,6 +180,7 @@ void  Z_SysFree(void *p);
 #define Z_Free(a)          (Z_Free)     (a,      __FILE__,__LINE__)
 #define Z_FreeTags(a,b)    (Z_FreeTags) (a,b,    __FILE__,__LINE__)
 #define Z_ChangeTag(a,b)   (Z_ChangeTag)(a,b,    __FILE__,__LINE__)
+#define Z_ChangeUser(a,b)  (Z_ChangeUser)(a,b,   __FILE__,__LINE__)
 #define Z_Malloc(a,b,c)    (Z_Malloc)   (a,b,c,  __FILE__,__LINE__)
 #define Z_Strdup(a,b,c)    (Z_Strdup)   (a,b,c,  __FILE__,__LINE__)
 #define Z_Calloc(a,b,c,d)  (Z_Calloc)   (a,b,c,d,__FILE__,__LINE__)
@@ -198,7 +259,7 @@ class ZoneObject
 private:
    // static data
    static ZoneObject *objectbytag[PU_MAX];
-   static void *newalloc;
+   static thread_local void *newalloc;
 
    // instance data
    void        *zonealloc; // If non-null, the object is living on the zone heap